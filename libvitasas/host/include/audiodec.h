@@ -0,0 +1,95 @@
+#ifndef VITASAS_HOST_AUDIODEC_H
+#define VITASAS_HOST_AUDIODEC_H
+
+/* Host stand-in for libaudiodec. Hardware decoding is not available on the host. */
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_AUDIODEC_TYPE_AT9		0x1003
+#define SCE_AUDIODEC_TYPE_MP3		0x1004
+#define SCE_AUDIODEC_TYPE_AAC		0x1005
+
+#define SCE_AUDIODEC_WORD_LENGTH_16BITS		16
+
+#define SCE_AUDIODEC_ALIGNMENT_SIZE		0x100
+#define SCE_AUDIODEC_AT9_MAX_ES_SIZE	1024
+#define SCE_AUDIODEC_MP3_MAX_ES_SIZE	1441
+#define SCE_AUDIODEC_AAC_MAX_ES_SIZE	1536
+
+#define SCE_AUDIODEC_ERROR_NOT_SUPPORTED	-2140733439	/* 0x807F0001 */
+
+typedef struct SceAudiodecInitStreamParam {
+	SceUInt32 size;
+	SceUInt32 totalStreams;
+} SceAudiodecInitStreamParam;
+
+typedef union SceAudiodecInitParam {
+	SceUInt32 size;
+	SceAudiodecInitStreamParam at9;
+	SceAudiodecInitStreamParam mp3;
+	SceAudiodecInitStreamParam aac;
+} SceAudiodecInitParam;
+
+typedef struct SceAudiodecInfoAt9 {
+	SceUInt32 size;
+	SceUInt8 configData[4];
+	SceUInt32 ch;
+	SceUInt32 bitRate;
+	SceUInt32 samplingRate;
+	SceUInt32 superFrameSize;
+	SceUInt32 framesInSuperFrame;
+} SceAudiodecInfoAt9;
+
+typedef struct SceAudiodecInfoMp3 {
+	SceUInt32 size;
+	SceUInt32 ch;
+	SceUInt32 version;
+} SceAudiodecInfoMp3;
+
+typedef struct SceAudiodecInfoAac {
+	SceUInt32 size;
+	SceUInt32 isAdts;
+	SceUInt32 ch;
+	SceUInt32 samplingRate;
+	SceUInt32 isSbr;
+} SceAudiodecInfoAac;
+
+typedef union SceAudiodecInfo {
+	SceUInt32 size;
+	SceAudiodecInfoAt9 at9;
+	SceAudiodecInfoMp3 mp3;
+	SceAudiodecInfoAac aac;
+} SceAudiodecInfo;
+
+typedef struct SceAudiodecCtrl {
+	SceUInt32 size;
+	SceInt32 handle;
+	SceUInt8 *pEs;
+	SceUInt32 inputEsSize;
+	SceUInt32 maxEsSize;
+	void *pPcm;
+	SceUInt32 outputPcmSize;
+	SceUInt32 maxPcmSize;
+	SceUInt32 wordLength;
+	SceAudiodecInfo *pInfo;
+} SceAudiodecCtrl;
+
+int sceAudiodecInitLibrary(SceUInt32 codecType, SceAudiodecInitParam *pInitParam);
+int sceAudiodecTermLibrary(SceUInt32 codecType);
+int sceAudiodecCreateDecoder(SceAudiodecCtrl *pCtrl, SceUInt32 codecType);
+int sceAudiodecCreateDecoderExternal(SceAudiodecCtrl *pCtrl, SceUInt32 codecType, SceUIntPtr vaContext, SceUInt32 contextSize);
+int sceAudiodecDeleteDecoder(SceAudiodecCtrl *pCtrl);
+int sceAudiodecDeleteDecoderExternal(SceAudiodecCtrl *pCtrl, SceUInt32 *pVaContext);
+int sceAudiodecDecode(SceAudiodecCtrl *pCtrl);
+int sceAudiodecClearContext(SceAudiodecCtrl *pCtrl);
+int sceAudiodecGetContextSize(SceAudiodecCtrl *pCtrl, SceUInt32 codecType);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
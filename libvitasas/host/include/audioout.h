@@ -0,0 +1,38 @@
+#ifndef VITASAS_HOST_AUDIOOUT_H
+#define VITASAS_HOST_AUDIOOUT_H
+
+/* Host stand-in for the audio output API */
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_AUDIO_OUT_PORT_TYPE_MAIN		0
+#define SCE_AUDIO_OUT_PORT_TYPE_BGM			1
+#define SCE_AUDIO_OUT_PORT_TYPE_VOICE		2
+
+#define SCE_AUDIO_OUT_PARAM_FORMAT_S16_MONO		0
+#define SCE_AUDIO_OUT_PARAM_FORMAT_S16_STEREO	1
+
+#define SCE_AUDIO_OUT_MAX_VOL		32768
+#define SCE_AUDIO_VOLUME_0DB		SCE_AUDIO_OUT_MAX_VOL
+
+#define SCE_AUDIO_VOLUME_FLAG_L_CH	(1 << 0)
+#define SCE_AUDIO_VOLUME_FLAG_R_CH	(1 << 1)
+
+#define SCE_AUDIO_OUT_ERROR_INVALID_PORT	-2144993277	/* 0x80260003 */
+
+int sceAudioOutOpenPort(int portType, int len, int freq, int param);
+int sceAudioOutReleasePort(int port);
+int sceAudioOutOutput(int port, const void *ptr);
+int sceAudioOutSetVolume(int port, int flag, int *vol);
+int sceAudioOutSetConfig(int port, int len, int freq, int param);
+int sceAudioOutGetRestSample(int port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
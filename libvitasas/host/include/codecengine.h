@@ -0,0 +1,21 @@
+#ifndef VITASAS_HOST_CODECENGINE_H
+#define VITASAS_HOST_CODECENGINE_H
+
+/* Host stand-in for the Codec Engine memory API */
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SceUID sceCodecEngineOpenUnmapMemBlock(void *pMemBlock, SceUInt32 memBlockSize);
+int sceCodecEngineCloseUnmapMemBlock(SceUID uid);
+SceUIntPtr sceCodecEngineAllocMemoryFromUnmapMemBlock(SceUID uid, SceUInt32 size, SceUInt32 alignment);
+int sceCodecEngineFreeMemoryFromUnmapMemBlock(SceUID uid, SceUIntPtr p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
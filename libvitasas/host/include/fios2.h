@@ -0,0 +1,68 @@
+#ifndef VITASAS_HOST_FIOS2_H
+#define VITASAS_HOST_FIOS2_H
+
+/* Host stand-in for the FIOS2 synchronous file API, backed by plain files */
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_FIOS_PATH_MAX		1024
+
+typedef SceInt32 SceFiosFH;
+typedef SceInt64 SceFiosSize;
+typedef SceInt64 SceFiosOffset;
+typedef SceInt64 SceFiosDate;
+
+typedef struct SceFiosOpAttr {
+	SceInt64 deadline;
+	void *pCallback;
+	void *pCallbackContext;
+	SceInt32 priority;
+	SceUInt32 opflags;
+	SceUInt32 userTag;
+	void *userPtr;
+	void *pReserved;
+} SceFiosOpAttr;
+
+typedef struct SceFiosOpenParams {
+	SceUInt32 openFlags;
+	SceUInt32 reserved;
+	void *buffer;
+	SceFiosSize bufferSize;
+} SceFiosOpenParams;
+
+typedef struct SceFiosStat {
+	SceFiosOffset fileSize;
+	SceFiosDate accessDate;
+	SceFiosDate modificationDate;
+	SceFiosDate creationDate;
+	SceUInt32 statFlags;
+	SceUInt32 reserved;
+	SceInt64 uid;
+	SceInt64 gid;
+	SceInt64 dev;
+	SceInt64 ino;
+	SceInt64 mode;
+} SceFiosStat;
+
+typedef struct SceFiosTuple {
+	SceFiosOffset offset;
+	SceFiosSize size;
+	char path[SCE_FIOS_PATH_MAX];
+} SceFiosTuple;
+
+int sceFiosFHOpenSync(const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams);
+int sceFiosFHCloseSync(const SceFiosOpAttr *pAttr, SceFiosFH fh);
+SceFiosSize sceFiosFHReadSync(const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length);
+SceFiosSize sceFiosFHPreadSync(const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length, SceFiosOffset offset);
+int sceFiosStatSync(const SceFiosOpAttr *pAttr, const char *pPath, SceFiosStat *pOutStatus);
+int sceFiosResolveSync(const SceFiosOpAttr *pAttr, const SceFiosTuple *pInTuple, SceFiosTuple *pOutTuple);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
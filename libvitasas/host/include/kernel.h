@@ -0,0 +1,156 @@
+#ifndef VITASAS_HOST_KERNEL_H
+#define VITASAS_HOST_KERNEL_H
+
+/* Host stand-in for the subset of the kernel API used by libvitaSAS */
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Errors */
+
+#define SCE_KERNEL_ERROR_ERROR				-2147352575	/* 0x80020001 */
+#define SCE_KERNEL_ERROR_INVALID_ARGUMENT	-2147352573	/* 0x80020003 */
+#define SCE_KERNEL_ERROR_NO_MEMORY			-2147352176	/* 0x80020190 */
+#define SCE_KERNEL_ERROR_WAIT_TIMEOUT		-2147319803	/* 0x80028005 */
+
+/* Memory blocks */
+
+typedef int SceKernelMemBlockType;
+
+#define SCE_KERNEL_MEMBLOCK_TYPE_USER_RW						0x0c20d060U
+#define SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE				0x0c208060U
+#define SCE_KERNEL_MEMBLOCK_TYPE_USER_MAIN_PHYCONT_NC_RW		0x0c80d060U
+
+typedef struct SceKernelAllocMemBlockOpt {
+	SceSize size;
+	SceUInt32 attr;
+	SceSize alignment;
+} SceKernelAllocMemBlockOpt;
+
+SceUID sceKernelAllocMemBlock(const char *name, SceKernelMemBlockType type, SceSize vsize, const SceKernelAllocMemBlockOpt *pOpt);
+int sceKernelFreeMemBlock(SceUID uid);
+int sceKernelGetMemBlockBase(SceUID uid, void **ppBase);
+
+/* Threads */
+
+#define SCE_KERNEL_START_SUCCESS		0
+#define SCE_KERNEL_STOP_SUCCESS			0
+
+#define SCE_KERNEL_CPU_MASK_USER_0		0x00010000
+#define SCE_KERNEL_CPU_MASK_USER_1		0x00020000
+#define SCE_KERNEL_CPU_MASK_USER_2		0x00040000
+#define SCE_KERNEL_CPU_MASK_USER_ALL	(SCE_KERNEL_CPU_MASK_USER_0 | SCE_KERNEL_CPU_MASK_USER_1 | SCE_KERNEL_CPU_MASK_USER_2)
+
+#define SCE_KERNEL_DEFAULT_PRIORITY_USER	0x10000100
+#define SCE_KERNEL_THREAD_STACK_SIZE_DEFAULT_USER_MAIN	(256 * 1024)
+
+typedef SceInt32 (*SceKernelThreadEntry)(SceSize argSize, void *pArgBlock);
+
+SceUID sceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int initPriority, SceSize stackSize, SceUInt32 attr, int cpuAffinityMask, const void *pOptParam);
+int sceKernelStartThread(SceUID threadId, SceSize argSize, const void *pArgBlock);
+int sceKernelWaitThreadEnd(SceUID threadId, SceInt32 *pExitStatus, SceUInt32 *pTimeout);
+int sceKernelDeleteThread(SceUID threadId);
+int sceKernelExitDeleteThread(SceInt32 exitStatus);
+int sceKernelDelayThread(SceUInt32 usec);
+SceUID sceKernelGetThreadId(void);
+SceUInt64 sceKernelGetProcessTimeWide(void);
+
+/* Event flags */
+
+#define SCE_KERNEL_ATTR_SINGLE				0x00000000U
+#define SCE_KERNEL_ATTR_MULTI				0x00001000U
+#define SCE_KERNEL_EVF_WAITMODE_AND			0x00000000U
+#define SCE_KERNEL_EVF_WAITMODE_OR			0x00000001U
+#define SCE_KERNEL_EVF_WAITMODE_CLEAR_ALL	0x00000002U
+#define SCE_KERNEL_EVF_WAITMODE_CLEAR_PAT	0x00000004U
+
+SceUID sceKernelCreateEventFlag(const char *pName, SceUInt32 attr, SceUInt32 initPattern, const void *pOptParam);
+int sceKernelDeleteEventFlag(SceUID evfId);
+int sceKernelSetEventFlag(SceUID evfId, SceUInt32 bitPattern);
+int sceKernelClearEventFlag(SceUID evfId, SceUInt32 bitPattern);
+int sceKernelWaitEventFlag(SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout);
+int sceKernelPollEventFlag(SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat);
+
+/* Semaphores */
+
+SceUID sceKernelCreateSema(const char *pName, SceUInt32 attr, SceInt32 initCount, SceInt32 maxCount, const void *pOptParam);
+int sceKernelDeleteSema(SceUID semaId);
+int sceKernelSignalSema(SceUID semaId, SceInt32 signalCount);
+int sceKernelWaitSema(SceUID semaId, SceInt32 needCount, SceUInt32 *pTimeout);
+int sceKernelPollSema(SceUID semaId, SceInt32 needCount);
+
+/* Lightweight mutexes */
+
+#define SCE_KERNEL_LW_MUTEX_ATTR_TH_FIFO		0x00000000U
+#define SCE_KERNEL_LW_MUTEX_ATTR_TH_PRIO		0x00002000U
+#define SCE_KERNEL_LW_MUTEX_ATTR_RECURSIVE		0x00000002U
+
+typedef struct SceKernelLwMutexWork {
+	SceInt64 data[8];
+} SceKernelLwMutexWork;
+
+int sceKernelCreateLwMutex(SceKernelLwMutexWork *pWork, const char *pName, SceUInt32 attr, int initCount, const void *pOptParam);
+int sceKernelDeleteLwMutex(SceKernelLwMutexWork *pWork);
+int sceKernelLockLwMutex(SceKernelLwMutexWork *pWork, int lockCount, SceUInt32 *pTimeout);
+int sceKernelTryLockLwMutex(SceKernelLwMutexWork *pWork, int lockCount);
+int sceKernelUnlockLwMutex(SceKernelLwMutexWork *pWork, int unlockCount);
+
+/* C library */
+
+void *sceClibMemset(void *s, int c, SceSize n);
+void *sceClibMemcpy(void *dst, const void *src, SceSize n);
+void *sceClibMemmove(void *dst, const void *src, SceSize n);
+int sceClibMemcmp(const void *s1, const void *s2, SceSize n);
+int sceClibStrcmp(const char *s1, const char *s2);
+SceSize sceClibStrnlen(const char *s, SceSize maxlen);
+char *sceClibStrncpy(char *dst, const char *src, SceSize n);
+int sceClibPrintf(const char *fmt, ...);
+int sceClibSnprintf(char *buf, SceSize len, const char *fmt, ...);
+
+typedef void* SceClibMspace;
+
+SceClibMspace sceClibMspaceCreate(void *base, SceSize capacity);
+int sceClibMspaceDestroy(SceClibMspace msp);
+void *sceClibMspaceMalloc(SceClibMspace msp, SceSize size);
+void *sceClibMspaceMemalign(SceClibMspace msp, SceSize boundary, SceSize size);
+void *sceClibMspaceRealloc(SceClibMspace msp, void *ptr, SceSize size);
+void *sceClibMspaceReallocalign(SceClibMspace msp, void *ptr, SceSize size, SceSize boundary);
+void sceClibMspaceFree(SceClibMspace msp, void *ptr);
+SceSize sceClibMspaceMallocUsableSize(void *p);
+SceBool sceClibMspaceIsHeapEmpty(SceClibMspace msp);
+
+/* File IO */
+
+#define SCE_O_RDONLY	0x0001
+#define SCE_O_WRONLY	0x0002
+#define SCE_O_RDWR		(SCE_O_RDONLY | SCE_O_WRONLY)
+#define SCE_O_APPEND	0x0100
+#define SCE_O_CREAT		0x0200
+#define SCE_O_TRUNC		0x0400
+
+#define SCE_SEEK_SET	0
+#define SCE_SEEK_CUR	1
+#define SCE_SEEK_END	2
+
+typedef struct SceIoStat {
+	SceMode st_mode;
+	unsigned int st_attr;
+	SceOff st_size;
+} SceIoStat;
+
+SceUID sceIoOpen(const char *filename, int flag, SceMode mode);
+int sceIoClose(SceUID fd);
+SceSSize sceIoRead(SceUID fd, void *buf, SceSize nbyte);
+SceSSize sceIoPread(SceUID fd, void *buf, SceSize nbyte, SceOff offset);
+SceSSize sceIoWrite(SceUID fd, const void *buf, SceSize nbyte);
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence);
+int sceIoGetstat(const char *name, SceIoStat *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
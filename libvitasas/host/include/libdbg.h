@@ -0,0 +1,13 @@
+#ifndef VITASAS_HOST_LIBDBG_H
+#define VITASAS_HOST_LIBDBG_H
+
+/* Host stand-in for libdbg logging macros */
+
+#include <stdio.h>
+
+#define SCE_DBG_LOG_ERROR(...)		do { fprintf(stderr, "[ERROR] " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define SCE_DBG_LOG_WARNING(...)	do { fprintf(stderr, "[WARNING] " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define SCE_DBG_LOG_INFO(...)		do { } while (0)
+#define SCE_DBG_LOG_DEBUG(...)		do { } while (0)
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef VITASAS_HOST_LIBSYSMODULE_H
+#define VITASAS_HOST_LIBSYSMODULE_H
+
+/* Host stand-in for libsysmodule */
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_SYSMODULE_SAS	0x0007
+
+int sceSysmoduleLoadModule(SceUInt16 id);
+int sceSysmoduleUnloadModule(SceUInt16 id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef VITASAS_HOST_SAS_H
+#define VITASAS_HOST_SAS_H
+
+/* Host stand-in for the SAS module internal API */
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_SAS_VOICE_MAX			32
+#define SCE_SAS_GRAIN_SAMPLES		256
+#define SCE_SAS_VOLUME_MAX			4096
+#define SCE_SAS_PITCH_BASE			0x1000
+#define SCE_SAS_PITCH_MAX			0x4000
+
+#define SCE_SAS_LOOP_DISABLE		0
+#define SCE_SAS_LOOP_ENABLE			1
+
+#define SCE_SAS_FX_TYPE_OFF			-1
+#define SCE_SAS_FX_TYPE_ROOM		0
+#define SCE_SAS_FX_TYPE_STUDIO_A	1
+#define SCE_SAS_FX_TYPE_STUDIO_B	2
+#define SCE_SAS_FX_TYPE_STUDIO_C	3
+#define SCE_SAS_FX_TYPE_HALL		4
+#define SCE_SAS_FX_TYPE_SPACE		5
+#define SCE_SAS_FX_TYPE_ECHO		6
+#define SCE_SAS_FX_TYPE_DELAY		7
+#define SCE_SAS_FX_TYPE_PIPE		8
+
+#define SCE_SAS_ERROR_INVALID_VALUE		-2142108415	/* 0x80420001 */
+#define SCE_SAS_ERROR_NOT_SUPPORTED		-2142108414	/* 0x80420002 */
+
+#define SCE_SAS_FAILED(x)	((x) < 0)
+
+SceInt32 sceSasGetNeededMemorySizeInternal(const char *config, SceSize *outSize);
+SceInt32 sceSasInitInternal(const char *config, void *buffer, SceSize bufferSize, SceUID *outSasHandle);
+SceInt32 sceSasExitInternal(SceUID sasHandle, void **outBuffer, SceSize *outBufferSize);
+SceInt32 sceSasSetGrainInternal(SceUID sasHandle, SceUInt32 grain);
+SceInt32 sceSasCoreInternal(SceUID sasHandle, SceInt16 out[], SceInt32 lvol, SceInt32 rvol);
+
+SceInt32 sceSasSetVoiceInternal(SceUID sasHandle, SceInt32 iVoiceNum, const void *vagBuf, SceSize size, SceUInt32 loopflag);
+SceInt32 sceSasSetVoicePCMInternal(SceUID sasHandle, SceInt32 iVoiceNum, const void *pcmBuf, SceSize size, SceInt32 loopsize);
+SceInt32 sceSasSetNoiseInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceUInt32 uClk);
+SceInt32 sceSasSetVolumeInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceInt32 l, SceInt32 r, SceInt32 wl, SceInt32 wr);
+SceInt32 sceSasSetPitchInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceInt32 pitch);
+SceInt32 sceSasSetADSRInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceInt32 flag, SceUInt32 a, SceUInt32 d, SceUInt32 s, SceUInt32 r);
+SceInt32 sceSasSetADSRmodeInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceInt32 flag, SceUInt32 a, SceUInt32 d, SceUInt32 s, SceUInt32 r);
+SceInt32 sceSasSetSLInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceUInt32 sl);
+SceInt32 sceSasSetSimpleADSRInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceUInt32 adsr1, SceUInt32 adsr2);
+SceInt32 sceSasSetKeyOnInternal(SceUID sasHandle, SceInt32 iVoiceNum);
+SceInt32 sceSasSetKeyOffInternal(SceUID sasHandle, SceInt32 iVoiceNum);
+SceInt32 sceSasGetEndStateInternal(SceUID sasHandle, SceInt32 iVoiceNum);
+SceInt32 sceSasGetEnvelopeInternal(SceUID sasHandle, SceInt32 iVoiceNum);
+
+SceInt32 sceSasSetEffectInternal(SceUID sasHandle, SceInt32 drySwitch, SceInt32 wetSwitch);
+SceInt32 sceSasSetEffectTypeInternal(SceUID sasHandle, SceInt32 type);
+SceInt32 sceSasSetEffectVolumeInternal(SceUID sasHandle, SceInt32 valL, SceInt32 valR);
+SceInt32 sceSasSetEffectParamInternal(SceUID sasHandle, SceUInt32 delayTime, SceUInt32 feedback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef VITASAS_HOST_SCEBASE_H
+#define VITASAS_HOST_SCEBASE_H
+
+/* Host stand-in for the SDK base types used by libvitaSAS */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_OK		0
+#define SCE_NULL	NULL
+#define SCE_TRUE	1
+#define SCE_FALSE	0
+
+typedef int8_t			SceInt8;
+typedef uint8_t			SceUInt8;
+typedef int16_t			SceInt16;
+typedef uint16_t		SceUInt16;
+typedef int32_t			SceInt32;
+typedef uint32_t		SceUInt32;
+typedef int64_t			SceInt64;
+typedef uint64_t		SceUInt64;
+typedef int				SceInt;
+typedef unsigned int	SceUInt;
+typedef int				SceBool;
+typedef uintptr_t		SceUIntPtr;
+typedef intptr_t		SceIntPtr;
+typedef unsigned int	SceSize;
+typedef int				SceSSize;
+typedef int32_t			SceUID;
+typedef int64_t			SceOff;
+typedef int				SceMode;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
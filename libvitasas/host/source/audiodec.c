@@ -0,0 +1,100 @@
+#include <kernel.h>
+#include <audiodec.h>
+#include <codecengine.h>
+
+/*
+ * Hardware decoders and the Codec Engine don't exist on the host. Every call fails, so AT9, MP3
+ * and AAC decoders can't be created and the library reports it through the usual error paths.
+ */
+
+int sceAudiodecInitLibrary(SceUInt32 codecType, SceAudiodecInitParam *pInitParam)
+{
+	(void)codecType;
+	(void)pInitParam;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+int sceAudiodecTermLibrary(SceUInt32 codecType)
+{
+	(void)codecType;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+int sceAudiodecCreateDecoder(SceAudiodecCtrl *pCtrl, SceUInt32 codecType)
+{
+	(void)pCtrl;
+	(void)codecType;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+int sceAudiodecCreateDecoderExternal(SceAudiodecCtrl *pCtrl, SceUInt32 codecType, SceUIntPtr vaContext, SceUInt32 contextSize)
+{
+	(void)pCtrl;
+	(void)codecType;
+	(void)vaContext;
+	(void)contextSize;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+int sceAudiodecDeleteDecoder(SceAudiodecCtrl *pCtrl)
+{
+	(void)pCtrl;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+int sceAudiodecDeleteDecoderExternal(SceAudiodecCtrl *pCtrl, SceUInt32 *pVaContext)
+{
+	(void)pCtrl;
+	(void)pVaContext;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+int sceAudiodecDecode(SceAudiodecCtrl *pCtrl)
+{
+	(void)pCtrl;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+int sceAudiodecClearContext(SceAudiodecCtrl *pCtrl)
+{
+	(void)pCtrl;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+int sceAudiodecGetContextSize(SceAudiodecCtrl *pCtrl, SceUInt32 codecType)
+{
+	(void)pCtrl;
+	(void)codecType;
+
+	/* Callers store the size unsigned and only check for 0 */
+
+	return 0;
+}
+
+SceUID sceCodecEngineOpenUnmapMemBlock(void *pMemBlock, SceUInt32 memBlockSize)
+{
+	(void)pMemBlock;
+	(void)memBlockSize;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+int sceCodecEngineCloseUnmapMemBlock(SceUID uid)
+{
+	(void)uid;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
+
+SceUIntPtr sceCodecEngineAllocMemoryFromUnmapMemBlock(SceUID uid, SceUInt32 size, SceUInt32 alignment)
+{
+	(void)uid;
+	(void)size;
+	(void)alignment;
+	return 0;
+}
+
+int sceCodecEngineFreeMemoryFromUnmapMemBlock(SceUID uid, SceUIntPtr p)
+{
+	(void)uid;
+	(void)p;
+	return SCE_AUDIODEC_ERROR_NOT_SUPPORTED;
+}
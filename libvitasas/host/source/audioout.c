@@ -0,0 +1,252 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <kernel.h>
+#include <audioout.h>
+
+/*
+ * Host audio output. Ports are null sinks paced like the hardware: sceAudioOutOutput() returns once
+ * the previous buffer has been consumed, so render loops run in real time. Pacing is disabled with
+ * VITASAS_HOST_AUDIO_NO_WAIT=1 for benchmarks. If VITASAS_HOST_WAV_DIR is set, every port writes
+ * its output to <dir>/port<N>.wav as well.
+ */
+
+#define HOST_AUDIO_OUT_PORT_MAX		8
+
+typedef struct HostAudioOutPort {
+	int isOpen;
+	int portType;
+	int len;
+	int freq;
+	int numChannels;
+	int vol[2];
+	SceUInt64 queueEnd;
+	FILE* wavFile;
+	SceUInt32 wavDataSize;
+} HostAudioOutPort;
+
+static HostAudioOutPort s_ports[HOST_AUDIO_OUT_PORT_MAX];
+static pthread_mutex_t s_portMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void host_audio_out_put_u32(unsigned char* p, SceUInt32 value)
+{
+	p[0] = value & 0xFF;
+	p[1] = (value >> 8) & 0xFF;
+	p[2] = (value >> 16) & 0xFF;
+	p[3] = (value >> 24) & 0xFF;
+}
+
+static void host_audio_out_put_u16(unsigned char* p, SceUInt32 value)
+{
+	p[0] = value & 0xFF;
+	p[1] = (value >> 8) & 0xFF;
+}
+
+/* Header is rewritten with final sizes when the port is released */
+
+static void host_audio_out_write_wav_header(HostAudioOutPort* port)
+{
+	unsigned char header[44];
+	SceUInt32 blockAlign = port->numChannels * sizeof(SceInt16);
+
+	memcpy(header, "RIFF", 4);
+	host_audio_out_put_u32(header + 4, 36 + port->wavDataSize);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	host_audio_out_put_u32(header + 16, 16);
+	host_audio_out_put_u16(header + 20, 1);
+	host_audio_out_put_u16(header + 22, port->numChannels);
+	host_audio_out_put_u32(header + 24, port->freq);
+	host_audio_out_put_u32(header + 28, port->freq * blockAlign);
+	host_audio_out_put_u16(header + 32, blockAlign);
+	host_audio_out_put_u16(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	host_audio_out_put_u32(header + 40, port->wavDataSize);
+
+	fseek(port->wavFile, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), port->wavFile);
+	fseek(port->wavFile, 0, SEEK_END);
+}
+
+static HostAudioOutPort* host_audio_out_port(int port)
+{
+	if (port < 0 || port >= HOST_AUDIO_OUT_PORT_MAX || !s_ports[port].isOpen)
+		return NULL;
+
+	return &s_ports[port];
+}
+
+static int host_audio_out_check_config(int len, int freq, int param)
+{
+	if (len <= 0 || (len & 0x3F) != 0)
+		return 0;
+	if (freq <= 0)
+		return 0;
+	if (param != SCE_AUDIO_OUT_PARAM_FORMAT_S16_MONO && param != SCE_AUDIO_OUT_PARAM_FORMAT_S16_STEREO)
+		return 0;
+
+	return 1;
+}
+
+int sceAudioOutOpenPort(int portType, int len, int freq, int param)
+{
+	const char* wavDir = getenv("VITASAS_HOST_WAV_DIR");
+	HostAudioOutPort* port = NULL;
+	char path[1024];
+	int portId = SCE_AUDIO_OUT_ERROR_INVALID_PORT;
+
+	if (!host_audio_out_check_config(len, freq, param))
+		return SCE_AUDIO_OUT_ERROR_INVALID_PORT;
+
+	pthread_mutex_lock(&s_portMutex);
+
+	for (int i = 0; i < HOST_AUDIO_OUT_PORT_MAX; i++) {
+		if (!s_ports[i].isOpen) {
+			port = &s_ports[i];
+			portId = i;
+			break;
+		}
+	}
+
+	if (port != NULL) {
+		memset(port, 0, sizeof(HostAudioOutPort));
+		port->isOpen = 1;
+		port->portType = portType;
+		port->len = len;
+		port->freq = freq;
+		port->numChannels = param == SCE_AUDIO_OUT_PARAM_FORMAT_S16_MONO ? 1 : 2;
+		port->vol[0] = port->vol[1] = SCE_AUDIO_VOLUME_0DB;
+
+		if (wavDir != NULL && wavDir[0] != '\0') {
+			snprintf(path, sizeof(path), "%s/port%d.wav", wavDir, portId);
+			port->wavFile = fopen(path, "wb");
+			if (port->wavFile != NULL)
+				host_audio_out_write_wav_header(port);
+		}
+	}
+
+	pthread_mutex_unlock(&s_portMutex);
+
+	return portId;
+}
+
+int sceAudioOutReleasePort(int port)
+{
+	HostAudioOutPort* hostPort;
+
+	pthread_mutex_lock(&s_portMutex);
+
+	hostPort = host_audio_out_port(port);
+	if (hostPort == NULL) {
+		pthread_mutex_unlock(&s_portMutex);
+		return SCE_AUDIO_OUT_ERROR_INVALID_PORT;
+	}
+
+	if (hostPort->wavFile != NULL) {
+		host_audio_out_write_wav_header(hostPort);
+		fclose(hostPort->wavFile);
+	}
+
+	hostPort->isOpen = 0;
+
+	pthread_mutex_unlock(&s_portMutex);
+
+	return SCE_OK;
+}
+
+int sceAudioOutOutput(int port, const void *ptr)
+{
+	const char* noWait = getenv("VITASAS_HOST_AUDIO_NO_WAIT");
+	HostAudioOutPort* hostPort = host_audio_out_port(port);
+	SceUInt64 now, duration;
+
+	if (hostPort == NULL)
+		return SCE_AUDIO_OUT_ERROR_INVALID_PORT;
+
+	/* NULL flushes the pending buffer, nothing is queued on the host */
+
+	if (ptr == NULL)
+		return SCE_OK;
+
+	if (hostPort->wavFile != NULL) {
+		fwrite(ptr, sizeof(SceInt16) * hostPort->numChannels, hostPort->len, hostPort->wavFile);
+		hostPort->wavDataSize += sizeof(SceInt16) * hostPort->numChannels * hostPort->len;
+	}
+
+	if (noWait != NULL && noWait[0] == '1')
+		return SCE_OK;
+
+	/* One buffer may be queued behind the one being played */
+
+	duration = (SceUInt64)hostPort->len * 1000000 / hostPort->freq;
+	now = sceKernelGetProcessTimeWide();
+
+	if (hostPort->queueEnd > now + duration)
+		sceKernelDelayThread((SceUInt32)(hostPort->queueEnd - duration - now));
+
+	now = sceKernelGetProcessTimeWide();
+	hostPort->queueEnd = (hostPort->queueEnd > now ? hostPort->queueEnd : now) + duration;
+
+	return SCE_OK;
+}
+
+int sceAudioOutSetVolume(int port, int flag, int *vol)
+{
+	HostAudioOutPort* hostPort = host_audio_out_port(port);
+
+	if (hostPort == NULL)
+		return SCE_AUDIO_OUT_ERROR_INVALID_PORT;
+
+	if (flag & SCE_AUDIO_VOLUME_FLAG_L_CH)
+		hostPort->vol[0] = vol[0];
+	if (flag & SCE_AUDIO_VOLUME_FLAG_R_CH)
+		hostPort->vol[1] = vol[1];
+
+	return SCE_OK;
+}
+
+int sceAudioOutSetConfig(int port, int len, int freq, int param)
+{
+	HostAudioOutPort* hostPort = host_audio_out_port(port);
+
+	if (hostPort == NULL)
+		return SCE_AUDIO_OUT_ERROR_INVALID_PORT;
+
+	/* Negative values keep the current setting */
+
+	if (len < 0)
+		len = hostPort->len;
+	if (freq < 0)
+		freq = hostPort->freq;
+	if (param < 0)
+		param = hostPort->numChannels == 1 ? SCE_AUDIO_OUT_PARAM_FORMAT_S16_MONO : SCE_AUDIO_OUT_PARAM_FORMAT_S16_STEREO;
+
+	if (!host_audio_out_check_config(len, freq, param))
+		return SCE_AUDIO_OUT_ERROR_INVALID_PORT;
+
+	hostPort->len = len;
+	hostPort->freq = freq;
+
+	/* Channel count of an open WAV stream can't change */
+
+	if (hostPort->wavFile == NULL)
+		hostPort->numChannels = param == SCE_AUDIO_OUT_PARAM_FORMAT_S16_MONO ? 1 : 2;
+
+	return SCE_OK;
+}
+
+int sceAudioOutGetRestSample(int port)
+{
+	HostAudioOutPort* hostPort = host_audio_out_port(port);
+	SceUInt64 now;
+
+	if (hostPort == NULL)
+		return SCE_AUDIO_OUT_ERROR_INVALID_PORT;
+
+	now = sceKernelGetProcessTimeWide();
+	if (hostPort->queueEnd <= now)
+		return 0;
+
+	return (int)((hostPort->queueEnd - now) * hostPort->freq / 1000000);
+}
@@ -0,0 +1,325 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <kernel.h>
+#include <fios2.h>
+
+/*
+ * Host implementation of sceIo and the synchronous FIOS2 calls on top of POSIX file descriptors.
+ * Paths are used as given, except for the FIOS2 archive stand-in below, errors are reported as SCE
+ * errno codes (0x80010000 | errno).
+ */
+
+#define HOST_IO_ERROR(e)	((int)(0x80010000 | (e)))
+
+#define HOST_IO_ARCHIVE_PATH_MAX	256
+#define HOST_IO_FH_MAX				1024
+
+typedef struct HostIoArchiveEntry {
+	char path[HOST_IO_ARCHIVE_PATH_MAX];
+	SceFiosOffset offset;
+	SceFiosSize size;
+} HostIoArchiveEntry;
+
+typedef struct HostIoArchive {
+	const char* path;
+	HostIoArchiveEntry* entries;
+	unsigned int numEntries;
+} HostIoArchive;
+
+typedef struct HostIoFileRange {
+	int isArchived;
+	SceFiosOffset offset;
+	SceFiosSize size;
+} HostIoFileRange;
+
+static HostIoArchive s_archive;
+static pthread_once_t s_archiveOnce = PTHREAD_ONCE_INIT;
+static HostIoFileRange s_fileRanges[HOST_IO_FH_MAX];
+
+static int host_io_flags(int flag)
+{
+	int flags = 0;
+
+	if ((flag & SCE_O_RDWR) == SCE_O_RDWR)
+		flags = O_RDWR;
+	else if (flag & SCE_O_WRONLY)
+		flags = O_WRONLY;
+	else
+		flags = O_RDONLY;
+
+	if (flag & SCE_O_APPEND)
+		flags |= O_APPEND;
+	if (flag & SCE_O_CREAT)
+		flags |= O_CREAT;
+	if (flag & SCE_O_TRUNC)
+		flags |= O_TRUNC;
+
+	return flags;
+}
+
+/* sceIo */
+
+SceUID sceIoOpen(const char *filename, int flag, SceMode mode)
+{
+	int fd = open(filename, host_io_flags(flag), mode != 0 ? mode : 0666);
+
+	if (fd < 0)
+		return HOST_IO_ERROR(errno);
+
+	return fd;
+}
+
+int sceIoClose(SceUID fd)
+{
+	if (close(fd) < 0)
+		return HOST_IO_ERROR(errno);
+
+	return SCE_OK;
+}
+
+SceSSize sceIoRead(SceUID fd, void *buf, SceSize nbyte)
+{
+	ssize_t result = read(fd, buf, nbyte);
+
+	if (result < 0)
+		return HOST_IO_ERROR(errno);
+
+	return (SceSSize)result;
+}
+
+SceSSize sceIoPread(SceUID fd, void *buf, SceSize nbyte, SceOff offset)
+{
+	ssize_t result = pread(fd, buf, nbyte, (off_t)offset);
+
+	if (result < 0)
+		return HOST_IO_ERROR(errno);
+
+	return (SceSSize)result;
+}
+
+SceSSize sceIoWrite(SceUID fd, const void *buf, SceSize nbyte)
+{
+	ssize_t result = write(fd, buf, nbyte);
+
+	if (result < 0)
+		return HOST_IO_ERROR(errno);
+
+	return (SceSSize)result;
+}
+
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence)
+{
+	off_t result = lseek(fd, (off_t)offset, whence == SCE_SEEK_END ? SEEK_END : (whence == SCE_SEEK_CUR ? SEEK_CUR : SEEK_SET));
+
+	if (result < 0)
+		return HOST_IO_ERROR(errno);
+
+	return (SceOff)result;
+}
+
+int sceIoGetstat(const char *name, SceIoStat *buf)
+{
+	struct stat st;
+
+	if (stat(name, &st) < 0)
+		return HOST_IO_ERROR(errno);
+
+	memset(buf, 0, sizeof(SceIoStat));
+	buf->st_mode = (SceMode)st.st_mode;
+	buf->st_size = (SceOff)st.st_size;
+
+	return SCE_OK;
+}
+
+/*
+ * Archive stand-in. If VITASAS_HOST_FIOS_ARCHIVE names a file, lines of <archive>.idx in the form
+ * "<path> <offset> <size>" map paths to ranges of that file, like files of a mounted archive. FIOS2
+ * calls on mapped paths read from the range and sceFiosResolveSync() reports it.
+ */
+
+static void host_io_archive_load(void)
+{
+	const char* archivePath = getenv("VITASAS_HOST_FIOS_ARCHIVE");
+	HostIoArchiveEntry entry;
+	unsigned int capacity = 0;
+	char indexPath[1024];
+	long long offset, size;
+	FILE* index;
+	void* entries;
+
+	if (archivePath == NULL || archivePath[0] == '\0')
+		return;
+
+	snprintf(indexPath, sizeof(indexPath), "%s.idx", archivePath);
+	index = fopen(indexPath, "r");
+	if (index == NULL)
+		return;
+
+	while (fscanf(index, "%255s %lld %lld", entry.path, &offset, &size) == 3) {
+		if (s_archive.numEntries == capacity) {
+			capacity = capacity != 0 ? capacity * 2 : 64;
+			entries = realloc(s_archive.entries, capacity * sizeof(HostIoArchiveEntry));
+			if (entries == NULL)
+				break;
+			s_archive.entries = entries;
+		}
+
+		entry.offset = offset;
+		entry.size = size;
+		s_archive.entries[s_archive.numEntries++] = entry;
+	}
+
+	fclose(index);
+
+	s_archive.path = archivePath;
+}
+
+static const HostIoArchiveEntry* host_io_archive_find(const char* path)
+{
+	pthread_once(&s_archiveOnce, host_io_archive_load);
+
+	for (unsigned int i = 0; i < s_archive.numEntries; i++) {
+		if (strcmp(s_archive.entries[i].path, path) == 0)
+			return &s_archive.entries[i];
+	}
+
+	return NULL;
+}
+
+/* Archived files can't be read past their end */
+
+static SceFiosSize host_io_clamp_length(SceFiosFH fh, SceFiosSize length, SceFiosOffset offset)
+{
+	const HostIoFileRange* range = &s_fileRanges[fh];
+
+	if (offset >= range->size)
+		return 0;
+
+	return length < range->size - offset ? length : range->size - offset;
+}
+
+/* FIOS2, file handles are plain descriptors */
+
+int sceFiosFHOpenSync(const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams)
+{
+	const HostIoArchiveEntry* entry = host_io_archive_find(pPath);
+	int fd;
+
+	(void)pAttr;
+	(void)pOpenParams;
+
+	fd = open(entry != NULL ? s_archive.path : pPath, O_RDONLY);
+	if (fd < 0)
+		return HOST_IO_ERROR(errno);
+
+	if (fd >= HOST_IO_FH_MAX) {
+		close(fd);
+		return HOST_IO_ERROR(EMFILE);
+	}
+
+	s_fileRanges[fd].isArchived = entry != NULL;
+	if (entry != NULL) {
+		s_fileRanges[fd].offset = entry->offset;
+		s_fileRanges[fd].size = entry->size;
+		lseek(fd, (off_t)entry->offset, SEEK_SET);
+	}
+
+	*pOutFH = fd;
+
+	return SCE_OK;
+}
+
+int sceFiosFHCloseSync(const SceFiosOpAttr *pAttr, SceFiosFH fh)
+{
+	(void)pAttr;
+
+	if (fh >= 0 && fh < HOST_IO_FH_MAX)
+		s_fileRanges[fh].isArchived = 0;
+
+	return sceIoClose(fh);
+}
+
+SceFiosSize sceFiosFHReadSync(const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length)
+{
+	ssize_t result;
+
+	(void)pAttr;
+
+	if (fh >= 0 && fh < HOST_IO_FH_MAX && s_fileRanges[fh].isArchived)
+		length = host_io_clamp_length(fh, length, lseek(fh, 0, SEEK_CUR) - s_fileRanges[fh].offset);
+
+	result = read(fh, pBuf, (size_t)length);
+	if (result < 0)
+		return HOST_IO_ERROR(errno);
+
+	return (SceFiosSize)result;
+}
+
+SceFiosSize sceFiosFHPreadSync(const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length, SceFiosOffset offset)
+{
+	ssize_t result;
+
+	(void)pAttr;
+
+	if (fh >= 0 && fh < HOST_IO_FH_MAX && s_fileRanges[fh].isArchived) {
+		length = host_io_clamp_length(fh, length, offset);
+		offset += s_fileRanges[fh].offset;
+	}
+
+	result = pread(fh, pBuf, (size_t)length, (off_t)offset);
+	if (result < 0)
+		return HOST_IO_ERROR(errno);
+
+	return (SceFiosSize)result;
+}
+
+int sceFiosStatSync(const SceFiosOpAttr *pAttr, const char *pPath, SceFiosStat *pOutStatus)
+{
+	const HostIoArchiveEntry* entry = host_io_archive_find(pPath);
+	struct stat st;
+
+	(void)pAttr;
+
+	if (stat(entry != NULL ? s_archive.path : pPath, &st) < 0)
+		return HOST_IO_ERROR(errno);
+
+	if (entry != NULL)
+		st.st_size = (off_t)entry->size;
+
+	memset(pOutStatus, 0, sizeof(SceFiosStat));
+	pOutStatus->fileSize = (SceFiosOffset)st.st_size;
+	pOutStatus->mode = (SceInt64)st.st_mode;
+	pOutStatus->dev = (SceInt64)st.st_dev;
+	pOutStatus->ino = (SceInt64)st.st_ino;
+
+	return SCE_OK;
+}
+
+/* Archived paths resolve to their range of the archive, every other path resolves to itself */
+
+int sceFiosResolveSync(const SceFiosOpAttr *pAttr, const SceFiosTuple *pInTuple, SceFiosTuple *pOutTuple)
+{
+	const HostIoArchiveEntry* entry = host_io_archive_find(pInTuple->path);
+
+	(void)pAttr;
+
+	if (entry != NULL) {
+		pOutTuple->offset = pInTuple->offset + entry->offset;
+		pOutTuple->size = pInTuple->size != 0 ? pInTuple->size : entry->size;
+		strncpy(pOutTuple->path, s_archive.path, SCE_FIOS_PATH_MAX - 1);
+		pOutTuple->path[SCE_FIOS_PATH_MAX - 1] = '\0';
+		return SCE_OK;
+	}
+
+	if (pOutTuple != pInTuple)
+		memcpy(pOutTuple, pInTuple, sizeof(SceFiosTuple));
+
+	return SCE_OK;
+}
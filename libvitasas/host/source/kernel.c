@@ -0,0 +1,834 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <kernel.h>
+#include <libsysmodule.h>
+
+/*
+ * Host implementation of the kernel subset used by libvitaSAS. Objects live in a fixed UID table,
+ * threads are pthreads, memory blocks are anonymous mappings and event flags/semaphores are built
+ * on a mutex and a condition variable. Thread priorities are ignored, CPU masks are mapped onto
+ * the first host CPUs where the platform allows it.
+ */
+
+#define HOST_OBJECT_MAX		4096
+#define HOST_OBJECT_UID_BASE	0x100
+
+#define HOST_OBJECT_NONE		0
+#define HOST_OBJECT_MEMBLOCK	1
+#define HOST_OBJECT_THREAD		2
+#define HOST_OBJECT_EVENT_FLAG	3
+#define HOST_OBJECT_SEMA		4
+
+#define HOST_THREAD_STACK_MIN	(256 * 1024)
+
+typedef struct HostObject {
+	int type;
+	void* ptr;
+} HostObject;
+
+typedef struct HostMemBlock {
+	void* base;
+	SceSize size;
+} HostMemBlock;
+
+typedef struct HostThread {
+	pthread_t thread;
+	SceKernelThreadEntry entry;
+	SceSize stackSize;
+	int cpuAffinityMask;
+	int isStarted;
+	SceSize argSize;
+	void* argBlock;
+} HostThread;
+
+typedef struct HostWaitObject {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	SceUInt32 attr;
+	SceUInt32 pattern;
+	SceInt32 count;
+	SceInt32 maxCount;
+} HostWaitObject;
+
+static HostObject s_objects[HOST_OBJECT_MAX];
+static pthread_mutex_t s_objectMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* UID table */
+
+static SceUID host_object_add(int type, void* ptr)
+{
+	SceUID uid = SCE_KERNEL_ERROR_NO_MEMORY;
+
+	pthread_mutex_lock(&s_objectMutex);
+
+	for (int i = 0; i < HOST_OBJECT_MAX; i++) {
+		if (s_objects[i].type == HOST_OBJECT_NONE) {
+			s_objects[i].type = type;
+			s_objects[i].ptr = ptr;
+			uid = HOST_OBJECT_UID_BASE + i;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&s_objectMutex);
+
+	return uid;
+}
+
+static void* host_object_get(SceUID uid, int type)
+{
+	void* ptr = NULL;
+	int index = uid - HOST_OBJECT_UID_BASE;
+
+	if (index < 0 || index >= HOST_OBJECT_MAX)
+		return NULL;
+
+	pthread_mutex_lock(&s_objectMutex);
+
+	if (s_objects[index].type == type)
+		ptr = s_objects[index].ptr;
+
+	pthread_mutex_unlock(&s_objectMutex);
+
+	return ptr;
+}
+
+static void* host_object_remove(SceUID uid, int type)
+{
+	void* ptr = NULL;
+	int index = uid - HOST_OBJECT_UID_BASE;
+
+	if (index < 0 || index >= HOST_OBJECT_MAX)
+		return NULL;
+
+	pthread_mutex_lock(&s_objectMutex);
+
+	if (s_objects[index].type == type) {
+		ptr = s_objects[index].ptr;
+		s_objects[index].type = HOST_OBJECT_NONE;
+		s_objects[index].ptr = NULL;
+	}
+
+	pthread_mutex_unlock(&s_objectMutex);
+
+	return ptr;
+}
+
+/* Timeouts are given in microseconds and are not updated with the remaining time */
+
+static void host_deadline(struct timespec* deadline, SceUInt32 usec)
+{
+	clock_gettime(CLOCK_REALTIME, deadline);
+	deadline->tv_sec += usec / 1000000;
+	deadline->tv_nsec += (long)(usec % 1000000) * 1000;
+	if (deadline->tv_nsec >= 1000000000) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000;
+	}
+}
+
+static int host_wait(HostWaitObject* object, const struct timespec* deadline)
+{
+	if (deadline == NULL)
+		return pthread_cond_wait(&object->cond, &object->mutex);
+
+	return pthread_cond_timedwait(&object->cond, &object->mutex, deadline);
+}
+
+static HostWaitObject* host_wait_object_create(SceUInt32 attr)
+{
+	HostWaitObject* object = calloc(1, sizeof(HostWaitObject));
+
+	if (object == NULL)
+		return NULL;
+
+	pthread_mutex_init(&object->mutex, NULL);
+	pthread_cond_init(&object->cond, NULL);
+	object->attr = attr;
+
+	return object;
+}
+
+static void host_wait_object_destroy(HostWaitObject* object)
+{
+	pthread_cond_destroy(&object->cond);
+	pthread_mutex_destroy(&object->mutex);
+	free(object);
+}
+
+/* Memory blocks */
+
+SceUID sceKernelAllocMemBlock(const char *name, SceKernelMemBlockType type, SceSize vsize, const SceKernelAllocMemBlockOpt *pOpt)
+{
+	HostMemBlock* block;
+	SceUID uid;
+
+	(void)name;
+	(void)type;
+	(void)pOpt;
+
+	if (vsize == 0 || (vsize & 0xFFF) != 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	block = malloc(sizeof(HostMemBlock));
+	if (block == NULL)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	block->size = vsize;
+	block->base = mmap(NULL, vsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (block->base == MAP_FAILED) {
+		free(block);
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	uid = host_object_add(HOST_OBJECT_MEMBLOCK, block);
+	if (uid < 0) {
+		munmap(block->base, vsize);
+		free(block);
+	}
+
+	return uid;
+}
+
+int sceKernelFreeMemBlock(SceUID uid)
+{
+	HostMemBlock* block = host_object_remove(uid, HOST_OBJECT_MEMBLOCK);
+
+	if (block == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	munmap(block->base, block->size);
+	free(block);
+
+	return SCE_OK;
+}
+
+int sceKernelGetMemBlockBase(SceUID uid, void **ppBase)
+{
+	HostMemBlock* block = host_object_get(uid, HOST_OBJECT_MEMBLOCK);
+
+	if (block == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	*ppBase = block->base;
+
+	return SCE_OK;
+}
+
+/* Threads */
+
+static void host_thread_set_affinity(HostThread* thread)
+{
+#if defined(__linux__)
+	static const int userCores[] = { SCE_KERNEL_CPU_MASK_USER_0, SCE_KERNEL_CPU_MASK_USER_1, SCE_KERNEL_CPU_MASK_USER_2 };
+	long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t cpuSet;
+	int isSet = 0;
+
+	if (thread->cpuAffinityMask == 0 || numCpus <= 0)
+		return;
+
+	CPU_ZERO(&cpuSet);
+
+	for (int i = 0; i < 3; i++) {
+		if (thread->cpuAffinityMask & userCores[i]) {
+			CPU_SET(i % numCpus, &cpuSet);
+			isSet = 1;
+		}
+	}
+
+	if (isSet)
+		pthread_setaffinity_np(thread->thread, sizeof(cpuSet), &cpuSet);
+#else
+	(void)thread;
+#endif
+}
+
+static void* host_thread_entry(void* arg)
+{
+	HostThread* thread = arg;
+
+	return (void*)(SceIntPtr)thread->entry(thread->argSize, thread->argBlock);
+}
+
+SceUID sceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int initPriority, SceSize stackSize, SceUInt32 attr, int cpuAffinityMask, const void *pOptParam)
+{
+	HostThread* thread;
+	SceUID uid;
+
+	(void)name;
+	(void)initPriority;
+	(void)attr;
+	(void)pOptParam;
+
+	if (entry == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	thread = calloc(1, sizeof(HostThread));
+	if (thread == NULL)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	thread->entry = entry;
+	thread->stackSize = stackSize < HOST_THREAD_STACK_MIN ? HOST_THREAD_STACK_MIN : stackSize;
+	thread->cpuAffinityMask = cpuAffinityMask;
+
+	uid = host_object_add(HOST_OBJECT_THREAD, thread);
+	if (uid < 0)
+		free(thread);
+
+	return uid;
+}
+
+int sceKernelStartThread(SceUID threadId, SceSize argSize, const void *pArgBlock)
+{
+	HostThread* thread = host_object_get(threadId, HOST_OBJECT_THREAD);
+	pthread_attr_t attr;
+	int result;
+
+	if (thread == NULL || thread->isStarted)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	/* Argument block is copied like on the target */
+
+	if (argSize != 0) {
+		thread->argBlock = malloc(argSize);
+		if (thread->argBlock == NULL)
+			return SCE_KERNEL_ERROR_NO_MEMORY;
+		memcpy(thread->argBlock, pArgBlock, argSize);
+	}
+	thread->argSize = argSize;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, thread->stackSize);
+	result = pthread_create(&thread->thread, &attr, host_thread_entry, thread);
+	pthread_attr_destroy(&attr);
+
+	if (result != 0) {
+		free(thread->argBlock);
+		thread->argBlock = NULL;
+		return SCE_KERNEL_ERROR_ERROR;
+	}
+
+	thread->isStarted = 1;
+	host_thread_set_affinity(thread);
+
+	return SCE_OK;
+}
+
+int sceKernelWaitThreadEnd(SceUID threadId, SceInt32 *pExitStatus, SceUInt32 *pTimeout)
+{
+	HostThread* thread;
+	void* status;
+
+	(void)pTimeout;
+
+	/* Thread exits with sceKernelExitDeleteThread(), so the object is released by the waiter */
+
+	thread = host_object_remove(threadId, HOST_OBJECT_THREAD);
+	if (thread == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	if (thread->isStarted) {
+		pthread_join(thread->thread, &status);
+		if (pExitStatus != NULL)
+			*pExitStatus = (SceInt32)(SceIntPtr)status;
+	}
+
+	free(thread->argBlock);
+	free(thread);
+
+	return SCE_OK;
+}
+
+int sceKernelDeleteThread(SceUID threadId)
+{
+	HostThread* thread = host_object_get(threadId, HOST_OBJECT_THREAD);
+
+	if (thread == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	/* Only dormant threads can be deleted */
+
+	if (thread->isStarted)
+		return SCE_KERNEL_ERROR_ERROR;
+
+	host_object_remove(threadId, HOST_OBJECT_THREAD);
+	free(thread);
+
+	return SCE_OK;
+}
+
+int sceKernelExitDeleteThread(SceInt32 exitStatus)
+{
+	return exitStatus;
+}
+
+int sceKernelDelayThread(SceUInt32 usec)
+{
+	struct timespec delay;
+
+	delay.tv_sec = usec / 1000000;
+	delay.tv_nsec = (long)(usec % 1000000) * 1000;
+
+	while (nanosleep(&delay, &delay) != 0 && errno == EINTR);
+
+	return SCE_OK;
+}
+
+/* Every host thread gets an ID on first use, outside of the object UID range */
+
+#define HOST_THREAD_ID_BASE		0x40000000
+
+static volatile int s_nextThreadId = HOST_THREAD_ID_BASE;
+static __thread SceUID s_threadId;
+
+SceUID sceKernelGetThreadId(void)
+{
+	if (s_threadId == 0)
+		s_threadId = __sync_fetch_and_add(&s_nextThreadId, 1);
+
+	return s_threadId;
+}
+
+SceUInt64 sceKernelGetProcessTimeWide(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (SceUInt64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* Event flags */
+
+static int host_event_flag_match(SceUInt32 pattern, SceUInt32 bitPattern, SceUInt32 waitMode)
+{
+	if (waitMode & SCE_KERNEL_EVF_WAITMODE_OR)
+		return (pattern & bitPattern) != 0;
+
+	return (pattern & bitPattern) == bitPattern;
+}
+
+static void host_event_flag_consume(HostWaitObject* evf, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat)
+{
+	if (pResultPat != NULL)
+		*pResultPat = evf->pattern;
+
+	if (waitMode & SCE_KERNEL_EVF_WAITMODE_CLEAR_ALL)
+		evf->pattern = 0;
+	else if (waitMode & SCE_KERNEL_EVF_WAITMODE_CLEAR_PAT)
+		evf->pattern &= ~bitPattern;
+}
+
+SceUID sceKernelCreateEventFlag(const char *pName, SceUInt32 attr, SceUInt32 initPattern, const void *pOptParam)
+{
+	HostWaitObject* evf;
+	SceUID uid;
+
+	(void)pName;
+	(void)pOptParam;
+
+	evf = host_wait_object_create(attr);
+	if (evf == NULL)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	evf->pattern = initPattern;
+
+	uid = host_object_add(HOST_OBJECT_EVENT_FLAG, evf);
+	if (uid < 0)
+		host_wait_object_destroy(evf);
+
+	return uid;
+}
+
+int sceKernelDeleteEventFlag(SceUID evfId)
+{
+	HostWaitObject* evf = host_object_remove(evfId, HOST_OBJECT_EVENT_FLAG);
+
+	if (evf == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	host_wait_object_destroy(evf);
+
+	return SCE_OK;
+}
+
+int sceKernelSetEventFlag(SceUID evfId, SceUInt32 bitPattern)
+{
+	HostWaitObject* evf = host_object_get(evfId, HOST_OBJECT_EVENT_FLAG);
+
+	if (evf == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	pthread_mutex_lock(&evf->mutex);
+	evf->pattern |= bitPattern;
+	pthread_cond_broadcast(&evf->cond);
+	pthread_mutex_unlock(&evf->mutex);
+
+	return SCE_OK;
+}
+
+int sceKernelClearEventFlag(SceUID evfId, SceUInt32 bitPattern)
+{
+	HostWaitObject* evf = host_object_get(evfId, HOST_OBJECT_EVENT_FLAG);
+
+	if (evf == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	/* Bits that are 0 in bitPattern are cleared */
+
+	pthread_mutex_lock(&evf->mutex);
+	evf->pattern &= bitPattern;
+	pthread_mutex_unlock(&evf->mutex);
+
+	return SCE_OK;
+}
+
+int sceKernelWaitEventFlag(SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout)
+{
+	HostWaitObject* evf = host_object_get(evfId, HOST_OBJECT_EVENT_FLAG);
+	struct timespec deadline;
+	int result = SCE_OK;
+
+	if (evf == NULL || bitPattern == 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	if (pTimeout != NULL)
+		host_deadline(&deadline, *pTimeout);
+
+	pthread_mutex_lock(&evf->mutex);
+
+	while (!host_event_flag_match(evf->pattern, bitPattern, waitMode)) {
+		if (host_wait(evf, pTimeout != NULL ? &deadline : NULL) == ETIMEDOUT) {
+			result = SCE_KERNEL_ERROR_WAIT_TIMEOUT;
+			break;
+		}
+	}
+
+	if (result == SCE_OK)
+		host_event_flag_consume(evf, bitPattern, waitMode, pResultPat);
+
+	pthread_mutex_unlock(&evf->mutex);
+
+	return result;
+}
+
+int sceKernelPollEventFlag(SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat)
+{
+	HostWaitObject* evf = host_object_get(evfId, HOST_OBJECT_EVENT_FLAG);
+	int result = SCE_OK;
+
+	if (evf == NULL || bitPattern == 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	pthread_mutex_lock(&evf->mutex);
+
+	if (host_event_flag_match(evf->pattern, bitPattern, waitMode))
+		host_event_flag_consume(evf, bitPattern, waitMode, pResultPat);
+	else
+		result = SCE_KERNEL_ERROR_ERROR;
+
+	pthread_mutex_unlock(&evf->mutex);
+
+	return result;
+}
+
+/* Semaphores */
+
+SceUID sceKernelCreateSema(const char *pName, SceUInt32 attr, SceInt32 initCount, SceInt32 maxCount, const void *pOptParam)
+{
+	HostWaitObject* sema;
+	SceUID uid;
+
+	(void)pName;
+	(void)pOptParam;
+
+	if (initCount < 0 || maxCount <= 0 || initCount > maxCount)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	sema = host_wait_object_create(attr);
+	if (sema == NULL)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	sema->count = initCount;
+	sema->maxCount = maxCount;
+
+	uid = host_object_add(HOST_OBJECT_SEMA, sema);
+	if (uid < 0)
+		host_wait_object_destroy(sema);
+
+	return uid;
+}
+
+int sceKernelDeleteSema(SceUID semaId)
+{
+	HostWaitObject* sema = host_object_remove(semaId, HOST_OBJECT_SEMA);
+
+	if (sema == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	host_wait_object_destroy(sema);
+
+	return SCE_OK;
+}
+
+int sceKernelSignalSema(SceUID semaId, SceInt32 signalCount)
+{
+	HostWaitObject* sema = host_object_get(semaId, HOST_OBJECT_SEMA);
+	int result = SCE_OK;
+
+	if (sema == NULL || signalCount <= 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	pthread_mutex_lock(&sema->mutex);
+
+	if (sema->count + signalCount > sema->maxCount) {
+		result = SCE_KERNEL_ERROR_ERROR;
+	}
+	else {
+		sema->count += signalCount;
+		pthread_cond_broadcast(&sema->cond);
+	}
+
+	pthread_mutex_unlock(&sema->mutex);
+
+	return result;
+}
+
+int sceKernelWaitSema(SceUID semaId, SceInt32 needCount, SceUInt32 *pTimeout)
+{
+	HostWaitObject* sema = host_object_get(semaId, HOST_OBJECT_SEMA);
+	struct timespec deadline;
+	int result = SCE_OK;
+
+	if (sema == NULL || needCount <= 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	if (pTimeout != NULL)
+		host_deadline(&deadline, *pTimeout);
+
+	pthread_mutex_lock(&sema->mutex);
+
+	while (sema->count < needCount) {
+		if (host_wait(sema, pTimeout != NULL ? &deadline : NULL) == ETIMEDOUT) {
+			result = SCE_KERNEL_ERROR_WAIT_TIMEOUT;
+			break;
+		}
+	}
+
+	if (result == SCE_OK)
+		sema->count -= needCount;
+
+	pthread_mutex_unlock(&sema->mutex);
+
+	return result;
+}
+
+int sceKernelPollSema(SceUID semaId, SceInt32 needCount)
+{
+	HostWaitObject* sema = host_object_get(semaId, HOST_OBJECT_SEMA);
+	int result = SCE_OK;
+
+	if (sema == NULL || needCount <= 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	pthread_mutex_lock(&sema->mutex);
+
+	if (sema->count >= needCount)
+		sema->count -= needCount;
+	else
+		result = SCE_KERNEL_ERROR_ERROR;
+
+	pthread_mutex_unlock(&sema->mutex);
+
+	return result;
+}
+
+/* Lightweight mutexes, the work area holds a pointer to a pthread mutex */
+
+static pthread_mutex_t* host_lw_mutex(SceKernelLwMutexWork *pWork)
+{
+	pthread_mutex_t* mutex;
+
+	memcpy(&mutex, pWork->data, sizeof(mutex));
+
+	return mutex;
+}
+
+int sceKernelCreateLwMutex(SceKernelLwMutexWork *pWork, const char *pName, SceUInt32 attr, int initCount, const void *pOptParam)
+{
+	pthread_mutexattr_t mutexAttr;
+	pthread_mutex_t* mutex;
+
+	(void)pName;
+	(void)pOptParam;
+
+	mutex = malloc(sizeof(pthread_mutex_t));
+	if (mutex == NULL)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	pthread_mutexattr_init(&mutexAttr);
+	if (attr & SCE_KERNEL_LW_MUTEX_ATTR_RECURSIVE)
+		pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_RECURSIVE);
+	else
+		pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_ERRORCHECK);
+	pthread_mutex_init(mutex, &mutexAttr);
+	pthread_mutexattr_destroy(&mutexAttr);
+
+	memset(pWork, 0, sizeof(SceKernelLwMutexWork));
+	memcpy(pWork->data, &mutex, sizeof(mutex));
+
+	for (int i = 0; i < initCount; i++)
+		pthread_mutex_lock(mutex);
+
+	return SCE_OK;
+}
+
+int sceKernelDeleteLwMutex(SceKernelLwMutexWork *pWork)
+{
+	pthread_mutex_t* mutex = host_lw_mutex(pWork);
+
+	if (mutex == NULL)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	pthread_mutex_destroy(mutex);
+	free(mutex);
+	memset(pWork, 0, sizeof(SceKernelLwMutexWork));
+
+	return SCE_OK;
+}
+
+int sceKernelLockLwMutex(SceKernelLwMutexWork *pWork, int lockCount, SceUInt32 *pTimeout)
+{
+	pthread_mutex_t* mutex = host_lw_mutex(pWork);
+
+	(void)pTimeout;
+
+	if (mutex == NULL || lockCount <= 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	for (int i = 0; i < lockCount; i++) {
+		if (pthread_mutex_lock(mutex) != 0)
+			return SCE_KERNEL_ERROR_ERROR;
+	}
+
+	return SCE_OK;
+}
+
+int sceKernelTryLockLwMutex(SceKernelLwMutexWork *pWork, int lockCount)
+{
+	pthread_mutex_t* mutex = host_lw_mutex(pWork);
+
+	if (mutex == NULL || lockCount <= 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	if (pthread_mutex_trylock(mutex) != 0)
+		return SCE_KERNEL_ERROR_ERROR;
+
+	for (int i = 1; i < lockCount; i++)
+		pthread_mutex_lock(mutex);
+
+	return SCE_OK;
+}
+
+int sceKernelUnlockLwMutex(SceKernelLwMutexWork *pWork, int unlockCount)
+{
+	pthread_mutex_t* mutex = host_lw_mutex(pWork);
+
+	if (mutex == NULL || unlockCount <= 0)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	for (int i = 0; i < unlockCount; i++) {
+		if (pthread_mutex_unlock(mutex) != 0)
+			return SCE_KERNEL_ERROR_ERROR;
+	}
+
+	return SCE_OK;
+}
+
+/* C library */
+
+void *sceClibMemset(void *s, int c, SceSize n)
+{
+	return memset(s, c, n);
+}
+
+void *sceClibMemcpy(void *dst, const void *src, SceSize n)
+{
+	return memcpy(dst, src, n);
+}
+
+void *sceClibMemmove(void *dst, const void *src, SceSize n)
+{
+	return memmove(dst, src, n);
+}
+
+int sceClibMemcmp(const void *s1, const void *s2, SceSize n)
+{
+	return memcmp(s1, s2, n);
+}
+
+int sceClibStrcmp(const char *s1, const char *s2)
+{
+	return strcmp(s1, s2);
+}
+
+SceSize sceClibStrnlen(const char *s, SceSize maxlen)
+{
+	return strnlen(s, maxlen);
+}
+
+char *sceClibStrncpy(char *dst, const char *src, SceSize n)
+{
+	return strncpy(dst, src, n);
+}
+
+int sceClibPrintf(const char *fmt, ...)
+{
+	va_list args;
+	int result;
+
+	va_start(args, fmt);
+	result = vprintf(fmt, args);
+	va_end(args);
+
+	return result;
+}
+
+int sceClibSnprintf(char *buf, SceSize len, const char *fmt, ...)
+{
+	va_list args;
+	int result;
+
+	va_start(args, fmt);
+	result = vsnprintf(buf, len, fmt, args);
+	va_end(args);
+
+	return result;
+}
+
+/* System modules are always present */
+
+int sceSysmoduleLoadModule(SceUInt16 id)
+{
+	(void)id;
+	return SCE_OK;
+}
+
+int sceSysmoduleUnloadModule(SceUInt16 id)
+{
+	(void)id;
+	return SCE_OK;
+}
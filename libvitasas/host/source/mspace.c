@@ -0,0 +1,270 @@
+#include <string.h>
+
+#include <kernel.h>
+
+/*
+ * Host implementation of the Clib mspace allocator. heap.c locates the owning mspace of a pointer
+ * by its address, so allocations have to come from the memory handed to sceClibMspaceCreate().
+ * This is a plain first-fit allocator with boundary tags; chunks tile the whole region and are
+ * coalesced with their free neighbours on release. Callers are expected to serialize access.
+ */
+
+#define HOST_MSPACE_ALIGN		16
+#define HOST_MSPACE_MAGIC		0x4D535043
+#define HOST_MSPACE_CHUNK_MIN	(2 * sizeof(HostMspaceChunk))
+
+typedef struct HostMspaceChunk {
+	SceUInt32 size;
+	SceUInt32 prevSize;
+	SceUInt32 isUsed;
+	SceUInt32 magic;
+} HostMspaceChunk;
+
+typedef struct HostMspace {
+	HostMspaceChunk* first;
+	HostMspaceChunk* end;
+	SceUInt32 numUsed;
+	SceUInt32 magic;
+} HostMspace;
+
+#define HOST_MSPACE_ROUND_UP(x, a)	(((x) + ((a) - 1)) & ~((SceUIntPtr)(a) - 1))
+
+static HostMspaceChunk* host_mspace_next(HostMspaceChunk* chunk)
+{
+	return (HostMspaceChunk*)((char*)chunk + chunk->size);
+}
+
+static HostMspaceChunk* host_mspace_prev(HostMspaceChunk* chunk)
+{
+	return (HostMspaceChunk*)((char*)chunk - chunk->prevSize);
+}
+
+static HostMspaceChunk* host_mspace_chunk(void* ptr)
+{
+	return (HostMspaceChunk*)ptr - 1;
+}
+
+static SceSize host_mspace_chunk_size(SceSize size)
+{
+	SceSize chunkSize = HOST_MSPACE_ROUND_UP(size, HOST_MSPACE_ALIGN) + sizeof(HostMspaceChunk);
+
+	return chunkSize < HOST_MSPACE_CHUNK_MIN ? HOST_MSPACE_CHUNK_MIN : chunkSize;
+}
+
+/* Cut chunk down to size, the remainder becomes a free chunk if it is large enough */
+
+static void host_mspace_split(HostMspaceChunk* chunk, SceSize size)
+{
+	HostMspaceChunk* rest;
+
+	if (chunk->size - size < HOST_MSPACE_CHUNK_MIN)
+		return;
+
+	rest = (HostMspaceChunk*)((char*)chunk + size);
+	rest->size = chunk->size - size;
+	rest->prevSize = size;
+	rest->isUsed = 0;
+	rest->magic = HOST_MSPACE_MAGIC;
+	host_mspace_next(rest)->prevSize = rest->size;
+
+	chunk->size = size;
+}
+
+static void* host_mspace_use(HostMspace* mspace, HostMspaceChunk* chunk, SceSize size)
+{
+	host_mspace_split(chunk, size);
+	chunk->isUsed = 1;
+	mspace->numUsed++;
+
+	return chunk + 1;
+}
+
+SceClibMspace sceClibMspaceCreate(void *base, SceSize capacity)
+{
+	SceUIntPtr start = HOST_MSPACE_ROUND_UP((SceUIntPtr)base, HOST_MSPACE_ALIGN);
+	SceUIntPtr limit = ((SceUIntPtr)base + capacity) & ~((SceUIntPtr)HOST_MSPACE_ALIGN - 1);
+	HostMspace* mspace = (HostMspace*)start;
+
+	/* Control block, at least one minimal chunk and the end marker */
+
+	if (limit < start || limit - start < sizeof(HostMspace) + HOST_MSPACE_CHUNK_MIN + sizeof(HostMspaceChunk))
+		return NULL;
+
+	mspace->first = (HostMspaceChunk*)(start + sizeof(HostMspace));
+	mspace->end = (HostMspaceChunk*)(limit - sizeof(HostMspaceChunk));
+	mspace->numUsed = 0;
+	mspace->magic = HOST_MSPACE_MAGIC;
+
+	mspace->first->size = (SceUInt32)((char*)mspace->end - (char*)mspace->first);
+	mspace->first->prevSize = 0;
+	mspace->first->isUsed = 0;
+	mspace->first->magic = HOST_MSPACE_MAGIC;
+
+	mspace->end->size = 0;
+	mspace->end->prevSize = mspace->first->size;
+	mspace->end->isUsed = 1;
+	mspace->end->magic = HOST_MSPACE_MAGIC;
+
+	return mspace;
+}
+
+int sceClibMspaceDestroy(SceClibMspace msp)
+{
+	HostMspace* mspace = msp;
+
+	if (mspace == NULL || mspace->magic != HOST_MSPACE_MAGIC)
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
+
+	mspace->magic = 0;
+
+	return SCE_OK;
+}
+
+void *sceClibMspaceMalloc(SceClibMspace msp, SceSize size)
+{
+	HostMspace* mspace = msp;
+	SceSize chunkSize = host_mspace_chunk_size(size);
+
+	for (HostMspaceChunk* chunk = mspace->first; chunk != mspace->end; chunk = host_mspace_next(chunk)) {
+		if (!chunk->isUsed && chunk->size >= chunkSize)
+			return host_mspace_use(mspace, chunk, chunkSize);
+	}
+
+	return NULL;
+}
+
+void *sceClibMspaceMemalign(SceClibMspace msp, SceSize boundary, SceSize size)
+{
+	HostMspace* mspace = msp;
+	SceSize chunkSize = host_mspace_chunk_size(size);
+	SceUIntPtr payload, aligned;
+	SceSize gap;
+
+	if (boundary <= HOST_MSPACE_ALIGN)
+		return sceClibMspaceMalloc(msp, size);
+
+	if (boundary & (boundary - 1))
+		return NULL;
+
+	for (HostMspaceChunk* chunk = mspace->first; chunk != mspace->end; chunk = host_mspace_next(chunk)) {
+		if (chunk->isUsed)
+			continue;
+
+		/* Leading gap must be able to hold a free chunk of its own */
+
+		payload = (SceUIntPtr)(chunk + 1);
+		aligned = HOST_MSPACE_ROUND_UP(payload, boundary);
+		if (aligned != payload && aligned - payload < HOST_MSPACE_CHUNK_MIN)
+			aligned = HOST_MSPACE_ROUND_UP(payload + HOST_MSPACE_CHUNK_MIN, boundary);
+		gap = (SceSize)(aligned - payload);
+
+		if (chunk->size < gap + chunkSize)
+			continue;
+
+		if (gap != 0) {
+			host_mspace_split(chunk, gap);
+			chunk = host_mspace_next(chunk);
+		}
+
+		return host_mspace_use(mspace, chunk, chunkSize);
+	}
+
+	return NULL;
+}
+
+void sceClibMspaceFree(SceClibMspace msp, void *ptr)
+{
+	HostMspace* mspace = msp;
+	HostMspaceChunk* chunk;
+	HostMspaceChunk* next;
+	HostMspaceChunk* prev;
+
+	if (ptr == NULL)
+		return;
+
+	chunk = host_mspace_chunk(ptr);
+	if (chunk->magic != HOST_MSPACE_MAGIC || !chunk->isUsed)
+		return;
+
+	chunk->isUsed = 0;
+	mspace->numUsed--;
+
+	next = host_mspace_next(chunk);
+	if (!next->isUsed) {
+		chunk->size += next->size;
+		next->magic = 0;
+		host_mspace_next(chunk)->prevSize = chunk->size;
+	}
+
+	if (chunk != mspace->first) {
+		prev = host_mspace_prev(chunk);
+		if (!prev->isUsed) {
+			prev->size += chunk->size;
+			chunk->magic = 0;
+			host_mspace_next(prev)->prevSize = prev->size;
+		}
+	}
+}
+
+void *sceClibMspaceRealloc(SceClibMspace msp, void *ptr, SceSize size)
+{
+	void* newptr;
+	SceSize usableSize;
+
+	if (ptr == NULL)
+		return sceClibMspaceMalloc(msp, size);
+
+	usableSize = sceClibMspaceMallocUsableSize(ptr);
+	if (usableSize >= size)
+		return ptr;
+
+	newptr = sceClibMspaceMalloc(msp, size);
+	if (newptr == NULL)
+		return NULL;
+
+	memcpy(newptr, ptr, usableSize);
+	sceClibMspaceFree(msp, ptr);
+
+	return newptr;
+}
+
+void *sceClibMspaceReallocalign(SceClibMspace msp, void *ptr, SceSize size, SceSize boundary)
+{
+	void* newptr;
+	SceSize usableSize;
+
+	if (ptr == NULL)
+		return sceClibMspaceMemalign(msp, boundary, size);
+
+	usableSize = sceClibMspaceMallocUsableSize(ptr);
+	if (usableSize >= size && ((SceUIntPtr)ptr & (boundary - 1)) == 0)
+		return ptr;
+
+	newptr = sceClibMspaceMemalign(msp, boundary, size);
+	if (newptr == NULL)
+		return NULL;
+
+	memcpy(newptr, ptr, usableSize < size ? usableSize : size);
+	sceClibMspaceFree(msp, ptr);
+
+	return newptr;
+}
+
+SceSize sceClibMspaceMallocUsableSize(void *p)
+{
+	HostMspaceChunk* chunk;
+
+	if (p == NULL)
+		return 0;
+
+	chunk = host_mspace_chunk(p);
+
+	return chunk->size - sizeof(HostMspaceChunk);
+}
+
+SceBool sceClibMspaceIsHeapEmpty(SceClibMspace msp)
+{
+	HostMspace* mspace = msp;
+
+	return mspace->numUsed == 0;
+}
@@ -0,0 +1,285 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <kernel.h>
+#include <sas.h>
+
+#include "vitaSAS.h"
+#include "soft_mixer.h"
+
+/*
+ * Host SAS core. Every SAS handle wraps a software mixer and voice calls are forwarded to it as
+ * commands, so systems created with VITASAS_MIXER_SAS render the same way they do with
+ * VITASAS_MIXER_SOFTWARE. VAG voices and the effect unit are not available.
+ */
+
+#define HOST_SAS_SYSTEM_MAX		16
+#define HOST_SAS_WORK_SIZE		256
+
+typedef struct HostSasSystem {
+	int isUsed;
+	void* buffer;
+	SceSize bufferSize;
+	SceUInt32 grain;
+	vitaSASSoftMixer* mixer;
+} HostSasSystem;
+
+static HostSasSystem s_systems[HOST_SAS_SYSTEM_MAX];
+static pthread_mutex_t s_systemMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static HostSasSystem* host_sas_system(SceUID sasHandle)
+{
+	if (sasHandle < 0 || sasHandle >= HOST_SAS_SYSTEM_MAX || !s_systems[sasHandle].isUsed)
+		return NULL;
+
+	return &s_systems[sasHandle];
+}
+
+static SceInt32 host_sas_apply(SceUID sasHandle, SceUInt32 type, SceInt32 iVoiceNum, const void* ptr, SceUInt32 arg0, SceUInt32 arg1, SceUInt32 arg2, SceUInt32 arg3, SceUInt32 arg4)
+{
+	HostSasSystem* system = host_sas_system(sasHandle);
+	vitaSASCommand command;
+
+	if (system == NULL || iVoiceNum < 0)
+		return SCE_SAS_ERROR_INVALID_VALUE;
+
+	command.sequence = 0;
+	command.type = type;
+	command.voiceID = (uint32_t)iVoiceNum;
+	command.arg[0] = arg0;
+	command.arg[1] = arg1;
+	command.arg[2] = arg2;
+	command.arg[3] = arg3;
+	command.arg[4] = arg4;
+	command.ptr = ptr;
+
+	if (vitaSAS_internal_soft_mixer_apply(system->mixer, &command) < 0)
+		return SCE_SAS_ERROR_INVALID_VALUE;
+
+	return SCE_OK;
+}
+
+static unsigned int host_sas_parse_num_voices(const char *config)
+{
+	const char* value = config != NULL ? strstr(config, "numVoices=") : NULL;
+	unsigned long numVoices;
+
+	if (value == NULL)
+		return SCE_SAS_VOICE_MAX;
+
+	numVoices = strtoul(value + sizeof("numVoices=") - 1, NULL, 10);
+	if (numVoices == 0 || numVoices > VITASAS_VOICE_POOL_MAX)
+		return SCE_SAS_VOICE_MAX;
+
+	return (unsigned int)numVoices;
+}
+
+SceInt32 sceSasGetNeededMemorySizeInternal(const char *config, SceSize *outSize)
+{
+	(void)config;
+
+	*outSize = HOST_SAS_WORK_SIZE;
+
+	return SCE_OK;
+}
+
+SceInt32 sceSasInitInternal(const char *config, void *buffer, SceSize bufferSize, SceUID *outSasHandle)
+{
+	HostSasSystem* system = NULL;
+	SceUID handle = -1;
+
+	if (buffer == NULL || bufferSize < HOST_SAS_WORK_SIZE)
+		return SCE_SAS_ERROR_INVALID_VALUE;
+
+	pthread_mutex_lock(&s_systemMutex);
+
+	for (int i = 0; i < HOST_SAS_SYSTEM_MAX; i++) {
+		if (!s_systems[i].isUsed) {
+			system = &s_systems[i];
+			system->isUsed = 1;
+			handle = i;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&s_systemMutex);
+
+	if (system == NULL)
+		return SCE_SAS_ERROR_NOT_SUPPORTED;
+
+	system->mixer = vitaSAS_internal_soft_mixer_create(host_sas_parse_num_voices(config));
+	if (system->mixer == NULL) {
+		system->isUsed = 0;
+		return SCE_SAS_ERROR_INVALID_VALUE;
+	}
+
+	system->buffer = buffer;
+	system->bufferSize = bufferSize;
+	system->grain = SCE_SAS_GRAIN_SAMPLES;
+
+	*outSasHandle = handle;
+
+	return SCE_OK;
+}
+
+SceInt32 sceSasExitInternal(SceUID sasHandle, void **outBuffer, SceSize *outBufferSize)
+{
+	HostSasSystem* system = host_sas_system(sasHandle);
+
+	if (system == NULL)
+		return SCE_SAS_ERROR_INVALID_VALUE;
+
+	vitaSAS_internal_soft_mixer_destroy(system->mixer);
+
+	if (outBuffer != NULL)
+		*outBuffer = system->buffer;
+	if (outBufferSize != NULL)
+		*outBufferSize = system->bufferSize;
+
+	pthread_mutex_lock(&s_systemMutex);
+	memset(system, 0, sizeof(HostSasSystem));
+	pthread_mutex_unlock(&s_systemMutex);
+
+	return SCE_OK;
+}
+
+SceInt32 sceSasSetGrainInternal(SceUID sasHandle, SceUInt32 grain)
+{
+	HostSasSystem* system = host_sas_system(sasHandle);
+
+	if (system == NULL || grain < 64 || grain > 2048 || (grain & 0x3F) != 0)
+		return SCE_SAS_ERROR_INVALID_VALUE;
+
+	system->grain = grain;
+
+	return SCE_OK;
+}
+
+SceInt32 sceSasCoreInternal(SceUID sasHandle, SceInt16 out[], SceInt32 lvol, SceInt32 rvol)
+{
+	HostSasSystem* system = host_sas_system(sasHandle);
+
+	if (system == NULL || out == NULL)
+		return SCE_SAS_ERROR_INVALID_VALUE;
+
+	vitaSAS_internal_soft_mixer_render(system->mixer, out, system->grain, lvol, rvol);
+
+	return SCE_OK;
+}
+
+/* Voices */
+
+SceInt32 sceSasSetVoiceInternal(SceUID sasHandle, SceInt32 iVoiceNum, const void *vagBuf, SceSize size, SceUInt32 loopflag)
+{
+	(void)sasHandle;
+	(void)iVoiceNum;
+	(void)vagBuf;
+	(void)size;
+	(void)loopflag;
+
+	return SCE_SAS_ERROR_NOT_SUPPORTED;
+}
+
+SceInt32 sceSasSetVoicePCMInternal(SceUID sasHandle, SceInt32 iVoiceNum, const void *pcmBuf, SceSize size, SceInt32 loopsize)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_VOICE_PCM, iVoiceNum, pcmBuf, size, (SceUInt32)loopsize, 0, 0, 0);
+}
+
+SceInt32 sceSasSetNoiseInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceUInt32 uClk)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_NOISE, iVoiceNum, NULL, uClk, 0, 0, 0, 0);
+}
+
+SceInt32 sceSasSetVolumeInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceInt32 l, SceInt32 r, SceInt32 wl, SceInt32 wr)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_VOLUME, iVoiceNum, NULL, (SceUInt32)l, (SceUInt32)r, (SceUInt32)wl, (SceUInt32)wr, 0);
+}
+
+SceInt32 sceSasSetPitchInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceInt32 pitch)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_PITCH, iVoiceNum, NULL, (SceUInt32)pitch, 0, 0, 0, 0);
+}
+
+SceInt32 sceSasSetADSRInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceInt32 flag, SceUInt32 a, SceUInt32 d, SceUInt32 s, SceUInt32 r)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_ADSR, iVoiceNum, NULL, (SceUInt32)flag, a, d, s, r);
+}
+
+SceInt32 sceSasSetADSRmodeInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceInt32 flag, SceUInt32 a, SceUInt32 d, SceUInt32 s, SceUInt32 r)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_ADSR_MODE, iVoiceNum, NULL, (SceUInt32)flag, a, d, s, r);
+}
+
+SceInt32 sceSasSetSLInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceUInt32 sl)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_SL, iVoiceNum, NULL, sl, 0, 0, 0, 0);
+}
+
+SceInt32 sceSasSetSimpleADSRInternal(SceUID sasHandle, SceInt32 iVoiceNum, SceUInt32 adsr1, SceUInt32 adsr2)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_SIMPLE_ADSR, iVoiceNum, NULL, adsr1, adsr2, 0, 0, 0);
+}
+
+SceInt32 sceSasSetKeyOnInternal(SceUID sasHandle, SceInt32 iVoiceNum)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_KEY_ON, iVoiceNum, NULL, 0, 0, 0, 0, 0);
+}
+
+SceInt32 sceSasSetKeyOffInternal(SceUID sasHandle, SceInt32 iVoiceNum)
+{
+	return host_sas_apply(sasHandle, VITASAS_COMMAND_SET_KEY_OFF, iVoiceNum, NULL, 0, 0, 0, 0, 0);
+}
+
+SceInt32 sceSasGetEndStateInternal(SceUID sasHandle, SceInt32 iVoiceNum)
+{
+	HostSasSystem* system = host_sas_system(sasHandle);
+
+	if (system == NULL || iVoiceNum < 0)
+		return SCE_SAS_ERROR_INVALID_VALUE;
+
+	return vitaSAS_internal_soft_mixer_get_end_state(system->mixer, (unsigned int)iVoiceNum);
+}
+
+SceInt32 sceSasGetEnvelopeInternal(SceUID sasHandle, SceInt32 iVoiceNum)
+{
+	HostSasSystem* system = host_sas_system(sasHandle);
+
+	if (system == NULL || iVoiceNum < 0 || (unsigned int)iVoiceNum >= system->mixer->numVoices)
+		return SCE_SAS_ERROR_INVALID_VALUE;
+
+	return system->mixer->voices[iVoiceNum].envelope.height;
+}
+
+/* Effect unit is not emulated, settings are accepted */
+
+SceInt32 sceSasSetEffectInternal(SceUID sasHandle, SceInt32 drySwitch, SceInt32 wetSwitch)
+{
+	(void)drySwitch;
+	(void)wetSwitch;
+
+	return host_sas_system(sasHandle) != NULL ? SCE_OK : SCE_SAS_ERROR_INVALID_VALUE;
+}
+
+SceInt32 sceSasSetEffectTypeInternal(SceUID sasHandle, SceInt32 type)
+{
+	(void)type;
+
+	return host_sas_system(sasHandle) != NULL ? SCE_OK : SCE_SAS_ERROR_INVALID_VALUE;
+}
+
+SceInt32 sceSasSetEffectVolumeInternal(SceUID sasHandle, SceInt32 valL, SceInt32 valR)
+{
+	(void)valL;
+	(void)valR;
+
+	return host_sas_system(sasHandle) != NULL ? SCE_OK : SCE_SAS_ERROR_INVALID_VALUE;
+}
+
+SceInt32 sceSasSetEffectParamInternal(SceUID sasHandle, SceUInt32 delayTime, SceUInt32 feedback)
+{
+	(void)delayTime;
+	(void)feedback;
+
+	return host_sas_system(sasHandle) != NULL ? SCE_OK : SCE_SAS_ERROR_INVALID_VALUE;
+}
@@ -0,0 +1,159 @@
+#include <sys/stat.h>
+
+#include <fios2.h>
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "host_test.h"
+
+/*
+ * vitaSAS_load_audio_batch() against loading the same files one by one. Samples are packed into
+ * an archive served by the FIOS2 stand-in of the host backend (VITASAS_HOST_FIOS_ARCHIVE), so batch
+ * reads are sorted and merged, and are also written as loose files for the sceIo path.
+ * Files are requested in shuffled order.
+ */
+
+#define BENCH_NUM_FILES		600
+#define BENCH_FILE_SIZE_MAX	(512 + 4095 * 2)
+
+static char s_pathStorage[BENCH_NUM_FILES][300];
+static char* s_paths[BENCH_NUM_FILES];
+static vitaSASAudio* s_audio[BENCH_NUM_FILES];
+static uint32_t s_sizes[BENCH_NUM_FILES];
+
+static void fill_sample(int16_t* data, uint32_t size, unsigned int index)
+{
+	uint32_t random = 0x12345u + index;
+
+	for (uint32_t i = 0; i < size / 2; i++)
+		data[i] = (int16_t)host_test_rand(&random);
+}
+
+static int write_samples(const char* dir)
+{
+	static int16_t data[BENCH_FILE_SIZE_MAX / 2];
+	char archivePath[300], indexPath[300], path[300];
+	uint64_t offset = 0;
+	FILE* archive;
+	FILE* index;
+
+	snprintf(archivePath, sizeof(archivePath), "%s/sfx.arc", dir);
+	snprintf(indexPath, sizeof(indexPath), "%s/sfx.arc.idx", dir);
+	snprintf(path, sizeof(path), "%s/sfx", dir);
+	mkdir(path, 0777);
+
+	archive = fopen(archivePath, "wb");
+	index = fopen(indexPath, "w");
+	if (archive == NULL || index == NULL)
+		return -1;
+
+	for (unsigned int i = 0; i < BENCH_NUM_FILES; i++) {
+		s_sizes[i] = 512 + (i * 97 % 4096) * 2;
+		fill_sample(data, s_sizes[i], i);
+
+		fwrite(data, 1, s_sizes[i], archive);
+		fprintf(index, "arc/%u.pcm %llu %u\n", i, (unsigned long long)offset, s_sizes[i]);
+		offset += s_sizes[i];
+
+		snprintf(path, sizeof(path), "%s/sfx/%u.pcm", dir, i);
+		if (host_test_write_file(path, data, s_sizes[i]) < 0)
+			return -1;
+	}
+
+	fclose(archive);
+	fclose(index);
+
+	setenv("VITASAS_HOST_FIOS_ARCHIVE", archivePath, 1);
+
+	return 0;
+}
+
+static void set_paths(const char* format, const char* dir)
+{
+	for (unsigned int i = 0; i < BENCH_NUM_FILES; i++) {
+		unsigned int file = i * 37 % BENCH_NUM_FILES;
+
+		if (dir != NULL)
+			snprintf(s_pathStorage[i], sizeof(s_pathStorage[i]), format, dir, file);
+		else
+			snprintf(s_pathStorage[i], sizeof(s_pathStorage[i]), format, file);
+		s_paths[i] = s_pathStorage[i];
+	}
+}
+
+static void check_and_free(void)
+{
+	static int16_t data[BENCH_FILE_SIZE_MAX / 2];
+
+	for (unsigned int i = 0; i < BENCH_NUM_FILES; i++) {
+		unsigned int file = i * 37 % BENCH_NUM_FILES;
+
+		HOST_TEST_CHECK(s_audio[i] != NULL);
+		if (s_audio[i] == NULL)
+			continue;
+
+		fill_sample(data, s_sizes[file], file);
+		HOST_TEST_CHECK_EQ(s_audio[i]->data_size, s_sizes[file]);
+		HOST_TEST_CHECK(memcmp(s_audio[i]->datap, data, s_sizes[file]) == 0);
+
+		vitaSAS_free_audio(s_audio[i]);
+		s_audio[i] = NULL;
+	}
+}
+
+static void bench(const char* name, int io_type, unsigned int iterations)
+{
+	uint64_t perFile = 0, batch = 0, start;
+
+	for (unsigned int it = 0; it < iterations; it++) {
+		start = host_test_time_ns();
+		for (unsigned int i = 0; i < BENCH_NUM_FILES; i++)
+			s_audio[i] = vitaSAS_load_audio_PCM(s_paths[i], io_type);
+		perFile += host_test_time_ns() - start;
+		check_and_free();
+
+		start = host_test_time_ns();
+		HOST_TEST_CHECK_EQ(vitaSAS_load_audio_batch(s_paths, BENCH_NUM_FILES, io_type, s_audio), BENCH_NUM_FILES);
+		batch += host_test_time_ns() - start;
+		check_and_free();
+	}
+
+	printf("%-8s per-file %8.3f ms, batch %8.3f ms per %d files (%.2fx)\n", name,
+		perFile / 1e6 / iterations, batch / 1e6 / iterations, BENCH_NUM_FILES, batch != 0 ? (double)perFile / batch : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int iterations = host_test_iterations(argc, argv, 50);
+	SceFiosTuple tuple;
+	char dir[256];
+
+	if (host_test_make_dir(dir, sizeof(dir)) < 0 || write_samples(dir) < 0) {
+		fprintf(stderr, "can't write samples\n");
+		return 1;
+	}
+
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+
+	/* Archived files resolve to a range of the archive */
+
+	memset(&tuple, 0, sizeof(tuple));
+	strcpy(tuple.path, "arc/1.pcm");
+	HOST_TEST_CHECK_EQ(sceFiosResolveSync(NULL, &tuple, &tuple), SCE_OK);
+	HOST_TEST_CHECK(strstr(tuple.path, "sfx.arc") != NULL);
+	HOST_TEST_CHECK_EQ(tuple.offset, s_sizes[0]);
+	HOST_TEST_CHECK_EQ(tuple.size, s_sizes[1]);
+
+	set_paths("arc/%u.pcm", NULL);
+	bench("FIOS2", 1, iterations);
+
+	set_paths("%s/sfx/%u.pcm", dir);
+	bench("sceIo", 0, iterations);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_pool_usage(), 0);
+
+	vitaSAS_finish();
+	host_test_remove_dir(dir);
+
+	return host_test_result("bench_batch_loader");
+}
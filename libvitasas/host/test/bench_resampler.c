@@ -0,0 +1,50 @@
+#include "resampler.h"
+#include "host_test.h"
+
+/* resampler_process() throughput for the common load-time conversions on 10 seconds of noise */
+
+static void bench(uint32_t inRate, uint32_t outRate, unsigned int iterations)
+{
+	unsigned int numInput = inRate * 10, numOutput;
+	int16_t* src = malloc(numInput * sizeof(int16_t));
+	int16_t* table = malloc(resampler_get_table_size(inRate, outRate));
+	uint32_t random = 1;
+	uint64_t initTime, processTime = 0, start;
+	int16_t* dst;
+	resampler rs;
+
+	for (unsigned int i = 0; i < numInput; i++)
+		src[i] = (int16_t)host_test_rand(&random);
+
+	start = host_test_time_ns();
+	resampler_init(&rs, inRate, outRate, table);
+	initTime = host_test_time_ns() - start;
+
+	numOutput = resampler_get_num_output(&rs, numInput);
+	dst = malloc(numOutput * sizeof(int16_t));
+
+	for (unsigned int i = 0; i < iterations; i++) {
+		start = host_test_time_ns();
+		resampler_process(&rs, dst, numOutput, src, numInput);
+		processTime += host_test_time_ns() - start;
+	}
+
+	printf("%5u -> %5u: %4u phases %3u taps, init %.2f ms, %.1f M output samples/s\n", inRate, outRate, rs.numPhases, rs.numTaps,
+		initTime / 1e6, (double)numOutput * iterations * 1000.0 / processTime);
+
+	free(dst);
+	free(table);
+	free(src);
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int iterations = host_test_iterations(argc, argv, 20);
+
+	bench(44100, 48000, iterations);
+	bench(48000, 22050, iterations);
+	bench(22050, 48000, iterations);
+	bench(32000, 48000, iterations);
+
+	return host_test_result("bench_resampler");
+}
@@ -0,0 +1,68 @@
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "vag_codec.h"
+#include "host_test.h"
+
+/* vag_codec_decode() and vitaSAS_decode_VAG_to_PCM() throughput on 10 seconds of encoded noise */
+
+#define BENCH_SAMPLING_RATE	48000
+#define BENCH_NUM_SAMPLES	(BENCH_SAMPLING_RATE * 10)
+
+int main(int argc, char* argv[])
+{
+	unsigned int iterations = host_test_iterations(argc, argv, 50);
+	unsigned int size = vag_codec_get_encoded_size(BENCH_NUM_SAMPLES);
+	int16_t* src = malloc(BENCH_NUM_SAMPLES * sizeof(int16_t));
+	uint8_t* vag = malloc(size);
+	uint64_t codecTime = 0, audioTime = 0, start;
+	uint32_t random = 1;
+	vag_codec_info info;
+	vitaSASAudio* audio;
+	vitaSASAudio* pcm;
+	int16_t* dst;
+
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+
+	for (unsigned int i = 0; i < BENCH_NUM_SAMPLES; i++)
+		src[i] = (int16_t)(host_test_rand(&random) % 60001 - 30000);
+
+	vag_codec_encode(vag, src, BENCH_NUM_SAMPLES, BENCH_SAMPLING_RATE);
+
+	HOST_TEST_CHECK_EQ(vag_codec_parse_header(vag, size, &info), 0);
+	vag_codec_scan_blocks(vag, &info);
+	dst = malloc(info.numSamples * sizeof(int16_t));
+
+	for (unsigned int i = 0; i < iterations; i++) {
+		start = host_test_time_ns();
+		HOST_TEST_CHECK_EQ(vag_codec_decode(dst, vag, &info), (int)info.numSamples);
+		codecTime += host_test_time_ns() - start;
+	}
+
+	audio = vitaSAS_load_audio_custom(vag, size);
+
+	for (unsigned int i = 0; i < iterations; i++) {
+		start = host_test_time_ns();
+		pcm = vitaSAS_decode_VAG_to_PCM(audio);
+		audioTime += host_test_time_ns() - start;
+
+		HOST_TEST_CHECK(pcm != NULL);
+		if (pcm == NULL)
+			break;
+
+		HOST_TEST_CHECK(memcmp(pcm->datap, dst, info.numSamples * sizeof(int16_t)) == 0);
+		vitaSAS_free_audio(pcm);
+	}
+
+	printf("vag_codec_decode          %8.1f M samples/s\n", (double)info.numSamples * iterations * 1000.0 / codecTime);
+	printf("vitaSAS_decode_VAG_to_PCM %8.1f M samples/s\n", (double)info.numSamples * iterations * 1000.0 / audioTime);
+
+	vitaSAS_free_audio(audio);
+	vitaSAS_finish();
+
+	free(dst);
+	free(vag);
+	free(src);
+
+	return host_test_result("bench_vag_decode");
+}
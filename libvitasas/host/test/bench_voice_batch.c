@@ -0,0 +1,116 @@
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "host_test.h"
+
+/*
+ * Setup of 30 voices at once (an explosion) through vitaSAS_system_set_voices_batch() against
+ * per-voice vitaSAS_system_set_voice_PCM() and vitaSAS_system_set_key_on() calls, with and without
+ * command queue. Both paths must render the same output.
+ */
+
+#define BENCH_NUM_VOICES	30
+#define BENCH_NUM_FRAMES	4800
+#define BENCH_GRAIN			256
+
+static int16_t s_pcm[BENCH_NUM_FRAMES];
+static vitaSASVoiceSetup s_setup[BENCH_NUM_VOICES];
+
+static void setup_per_voice(vitaSASSystem* system)
+{
+	for (int i = 0; i < BENCH_NUM_VOICES; i++) {
+		vitaSAS_system_set_voice_PCM(system, s_setup[i].voiceID, s_setup[i].audio, &s_setup[i].param);
+		vitaSAS_system_set_key_on(system, s_setup[i].voiceID);
+	}
+}
+
+static void setup_batch(vitaSASSystem* system)
+{
+	vitaSAS_system_set_voices_batch(system, s_setup, BENCH_NUM_VOICES);
+}
+
+static double bench_setup(vitaSASSystem* system, void (*setup)(vitaSASSystem*), unsigned int iterations)
+{
+	static int16_t out[BENCH_GRAIN * 2];
+	uint64_t elapsed = 0;
+	uint64_t start;
+
+	for (unsigned int i = 0; i < iterations; i++) {
+		start = host_test_time_ns();
+		setup(system);
+		elapsed += host_test_time_ns() - start;
+
+		/* Apply queued commands outside of the measurement */
+
+		vitaSAS_system_render_grains(system, out, 1);
+	}
+
+	return (double)elapsed / iterations;
+}
+
+static void check_same_output(unsigned int commandQueueSize)
+{
+	static int16_t outPerVoice[BENCH_GRAIN * 2 * 8];
+	static int16_t outBatch[BENCH_GRAIN * 2 * 8];
+	vitaSASSystem* perVoice = host_test_create_system("numVoices=32", commandQueueSize);
+	vitaSASSystem* batch = host_test_create_system("numVoices=32", commandQueueSize);
+
+	setup_per_voice(perVoice);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_set_voices_batch(batch, s_setup, BENCH_NUM_VOICES), SCE_OK);
+
+	vitaSAS_system_render_grains(perVoice, outPerVoice, 8);
+	vitaSAS_system_render_grains(batch, outBatch, 8);
+
+	HOST_TEST_CHECK(memcmp(outPerVoice, outBatch, sizeof(outBatch)) == 0);
+	HOST_TEST_CHECK(outBatch[BENCH_GRAIN] != 0);
+
+	vitaSAS_system_destroy(perVoice);
+	vitaSAS_system_destroy(batch);
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int iterations = host_test_iterations(argc, argv, 20000);
+	static const unsigned int queueSizes[2] = {0, 256};
+	vitaSASAudio* audio;
+
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+
+	for (int i = 0; i < BENCH_NUM_FRAMES; i++)
+		s_pcm[i] = (int16_t)((i % 120) * 250 - 15000);
+
+	audio = vitaSAS_load_audio_custom(s_pcm, sizeof(s_pcm));
+
+	for (int i = 0; i < BENCH_NUM_VOICES; i++) {
+		s_setup[i].voiceID = i;
+		s_setup[i].type = VITASAS_VOICE_TYPE_PCM;
+		s_setup[i].audio = audio;
+		s_setup[i].keyOn = 1;
+		s_setup[i].param.loopSize = -1;
+		s_setup[i].param.pitch = 2048 + i * 128;
+		s_setup[i].param.volLDry = 200 + i * 10;
+		s_setup[i].param.volRDry = 500 - i * 10;
+		s_setup[i].param.adsr1 = 0x000A;
+		s_setup[i].param.adsr2 = 0x1F;
+	}
+
+	for (int i = 0; i < 2; i++) {
+		vitaSASSystem* system = host_test_create_system("numVoices=32", queueSizes[i]);
+		double perVoiceNs, batchNs;
+
+		check_same_output(queueSizes[i]);
+
+		perVoiceNs = bench_setup(system, setup_per_voice, iterations);
+		batchNs = bench_setup(system, setup_batch, iterations);
+
+		printf("command queue %3u: per-voice %8.0f ns, batch %8.0f ns per %d voices (%.2fx)\n",
+			queueSizes[i], perVoiceNs, batchNs, BENCH_NUM_VOICES, batchNs > 0.0 ? perVoiceNs / batchNs : 0.0);
+
+		vitaSAS_system_destroy(system);
+	}
+
+	vitaSAS_free_audio(audio);
+	vitaSAS_finish();
+
+	return host_test_result("bench_voice_batch");
+}
@@ -0,0 +1,161 @@
+#ifndef VITASAS_HOST_TEST_H
+#define VITASAS_HOST_TEST_H
+
+/*
+ * Helpers shared by the host tests and benchmarks. Tests count failed checks and return
+ * non-zero from main, benchmarks take an optional iteration count on the command line so
+ * ctest can run them quickly while a manual run can measure for longer.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vitaSAS.h"
+
+static int host_test_failures = 0;
+
+#define HOST_TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			host_test_failures++; \
+		} \
+	} while (0)
+
+#define HOST_TEST_CHECK_EQ(a, b) \
+	do { \
+		long long host_test_a = (long long)(a); \
+		long long host_test_b = (long long)(b); \
+		if (host_test_a != host_test_b) { \
+			fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, host_test_a, host_test_b); \
+			host_test_failures++; \
+		} \
+	} while (0)
+
+static inline int host_test_result(const char* name)
+{
+	if (host_test_failures != 0) {
+		fprintf(stderr, "%s: %d check(s) failed\n", name, host_test_failures);
+		return 1;
+	}
+
+	printf("%s: passed\n", name);
+
+	return 0;
+}
+
+/* Monotonic time in nanoseconds and microseconds */
+
+static inline uint64_t host_test_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t host_test_time_us(void)
+{
+	return host_test_time_ns() / 1000ULL;
+}
+
+/* Iteration count of a benchmark, first argument or the default */
+
+static inline unsigned int host_test_iterations(int argc, char* argv[], unsigned int defaultCount)
+{
+	if (argc > 1 && atoi(argv[1]) > 0)
+		return (unsigned int)atoi(argv[1]);
+
+	return defaultCount;
+}
+
+/* Deterministic xorshift generator so failures reproduce */
+
+static inline uint32_t host_test_rand(uint32_t* state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+}
+
+/* Scratch directory for files generated by a test, removed by host_test_remove_dir() */
+
+static inline int host_test_make_dir(char* path, size_t size)
+{
+	const char* tmp = getenv("TMPDIR");
+
+	snprintf(path, size, "%s/vitasas_test_XXXXXX", tmp != NULL ? tmp : "/tmp");
+
+	return mkdtemp(path) != NULL ? 0 : -1;
+}
+
+static inline void host_test_remove_dir(const char* path)
+{
+	char command[512];
+
+	snprintf(command, sizeof(command), "rm -rf '%s'", path);
+	if (system(command) != 0)
+		fprintf(stderr, "failed to remove %s\n", path);
+}
+
+static inline int host_test_write_file(const char* path, const void* data, size_t size)
+{
+	FILE* file = fopen(path, "wb");
+	size_t written;
+
+	if (file == NULL)
+		return -1;
+
+	written = fwrite(data, 1, size, file);
+	fclose(file);
+
+	return written == size ? 0 : -1;
+}
+
+/* Pull-mode system rendered with vitaSAS_system_render_grains(): software mixer, 256 sample grain */
+
+static inline void host_test_system_param(VitaSASSystemParam* param, unsigned int commandQueueSize)
+{
+	memset(param, 0, sizeof(*param));
+	param->outputPort = VITASAS_OUTPUT_PORT_NONE;
+	param->samplingRate = 48000;
+	param->numGrain = 256;
+	param->thStackSize = 0x4000;
+	param->subSystemNum = -1;
+	param->commandQueueSize = commandQueueSize;
+	param->mixerType = VITASAS_MIXER_SOFTWARE;
+}
+
+static inline vitaSASSystem* host_test_create_system(const char* config, unsigned int commandQueueSize)
+{
+	VitaSASSystemParam param;
+
+	host_test_system_param(&param, commandQueueSize);
+
+	return vitaSAS_system_create(config, &param);
+}
+
+/* One-shot voice at original pitch and full volume on both channels with a near-infinite release */
+
+static inline void host_test_voice_param(vitaSASVoiceParam* param)
+{
+	memset(param, 0, sizeof(*param));
+	param->loopSize = -1;
+	param->pitch = 4096;
+	param->volLDry = 4096;
+	param->volRDry = 4096;
+	param->adsr1 = 0x000A;
+	param->adsr2 = 0x1F;
+}
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * Scalar reference build of pcm_kernels.c for test_pcm_kernels. Every kernel gets a ref_ prefix so it
+ * links next to the vector build in the library.
+ */
+
+#define PCM_KERNELS_SCALAR
+
+#define pcm_kernels_scale_s16_stereo			ref_pcm_kernels_scale_s16_stereo
+#define pcm_kernels_mix_s16_stereo				ref_pcm_kernels_mix_s16_stereo
+#define pcm_kernels_deinterleave_s16_stereo		ref_pcm_kernels_deinterleave_s16_stereo
+#define pcm_kernels_interleave_s16_stereo		ref_pcm_kernels_interleave_s16_stereo
+#define pcm_kernels_add_s16						ref_pcm_kernels_add_s16
+#define pcm_kernels_ramp_s16_stereo				ref_pcm_kernels_ramp_s16_stereo
+#define pcm_kernels_mono_to_stereo_s16			ref_pcm_kernels_mono_to_stereo_s16
+#define pcm_kernels_stereo_to_mono_s16			ref_pcm_kernels_stereo_to_mono_s16
+#define pcm_kernels_dither_init					ref_pcm_kernels_dither_init
+#define pcm_kernels_convert_u8_s16				ref_pcm_kernels_convert_u8_s16
+#define pcm_kernels_convert_s24_s16				ref_pcm_kernels_convert_s24_s16
+#define pcm_kernels_convert_s32_s16				ref_pcm_kernels_convert_s32_s16
+#define pcm_kernels_convert_f32_s16				ref_pcm_kernels_convert_f32_s16
+#define pcm_kernels_convert_s16_f32				ref_pcm_kernels_convert_s16_f32
+#define pcm_kernels_measure_s16					ref_pcm_kernels_measure_s16
+#define pcm_kernels_accumulate_mono_s16			ref_pcm_kernels_accumulate_mono_s16
+#define pcm_kernels_pack_s32_s16				ref_pcm_kernels_pack_s32_s16
+#define pcm_kernels_pack_mix_s32_s16_stereo		ref_pcm_kernels_pack_mix_s32_s16_stereo
+
+#include "../../source/pcm_kernels.c"
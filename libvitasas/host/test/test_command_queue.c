@@ -0,0 +1,294 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "host_test.h"
+
+/*
+ * Several producers push single commands, reserve/commit batches and stage command frames into a
+ * small queue while the main thread pops. Every command carries its producer and a per-producer
+ * sequence number, batch and frame commands also carry their index and the batch size.
+ *
+ * Then per-voice calls of a system are made inside command frames while another thread renders:
+ * two voices play the same sample into opposite channels and get their volume changed together,
+ * so both channels are equal on every grain only if every frame lands on a single grain.
+ */
+
+#define TEST_PRODUCERS		4
+#define TEST_COMMANDS		200000
+#define TEST_QUEUE_SIZE		64
+#define TEST_BATCH_MAX		8
+#define TEST_FRAMES			1000
+#define TEST_GRAIN			256
+
+static vitaSASCommandQueue s_queue;
+static vitaSASSystem* s_system;
+static volatile int s_isRendering = 1;
+static volatile int s_numUnequalGrains = 0;
+
+static void fill_command(vitaSASCommand* command, uint32_t producer, uint32_t sequence, uint32_t index, uint32_t count)
+{
+	command->type = 0;
+	command->voiceID = producer;
+	command->arg[0] = sequence;
+	command->arg[1] = index;
+	command->arg[2] = count;
+	command->arg[3] = ~sequence;
+	command->arg[4] = 0;
+	command->ptr = NULL;
+}
+
+static void* producer_thread(void* arg)
+{
+	uint32_t producer = (uint32_t)(uintptr_t)arg;
+	uint32_t random = 0x9E3779B9u * (producer + 1);
+	uint32_t sequence = 0;
+	vitaSASCommandFrame* frame;
+	vitaSASCommand command;
+	uint32_t count;
+	int32_t pos;
+
+	while (sequence < TEST_COMMANDS) {
+		if (host_test_rand(&random) % 3 != 0) {
+			fill_command(&command, producer, sequence, 0, 1);
+			while (vitaSAS_internal_command_queue_push(&s_queue, &command) != SCE_OK)
+				sched_yield();
+			sequence++;
+			continue;
+		}
+
+		count = 1 + host_test_rand(&random) % TEST_BATCH_MAX;
+		if (count > TEST_COMMANDS - sequence)
+			count = TEST_COMMANDS - sequence;
+
+		if (host_test_rand(&random) & 1) {
+
+			/* Frame, dropped as a whole if it doesn't fit the queue on commit */
+
+			do {
+				while (vitaSAS_internal_command_queue_begin_frame(&s_queue, sceKernelGetThreadId()) != SCE_OK)
+					sched_yield();
+
+				frame = vitaSAS_internal_command_queue_find_frame(&s_queue, sceKernelGetThreadId());
+				for (uint32_t i = 0; i < count; i++) {
+					fill_command(&command, producer, sequence + i, i, count);
+					vitaSAS_internal_command_queue_stage(&s_queue, frame, &command);
+				}
+			} while (vitaSAS_internal_command_queue_commit_frame(&s_queue, sceKernelGetThreadId()) != SCE_OK && (sched_yield(), 1));
+
+			sequence += count;
+			continue;
+		}
+
+		while (vitaSAS_internal_command_queue_reserve(&s_queue, count, &pos) != SCE_OK)
+			sched_yield();
+
+		for (uint32_t i = 0; i < count; i++)
+			fill_command(&s_queue.commands[((uint32_t)pos + i) & s_queue.mask], producer, sequence + i, i, count);
+
+		vitaSAS_internal_command_queue_commit(&s_queue, pos, count);
+		sequence += count;
+	}
+
+	return NULL;
+}
+
+static void* render_thread(void* arg)
+{
+	static int16_t out[TEST_GRAIN * 2];
+
+	(void)arg;
+
+	while (s_isRendering) {
+		vitaSAS_system_render_grains(s_system, out, 1);
+
+		for (int i = 0; i < TEST_GRAIN; i++) {
+			if (out[i * 2] != out[i * 2 + 1]) {
+				s_numUnequalGrains++;
+				break;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/* The render thread gets plenty of time to pick up the first half of the changes on its own */
+
+static void set_volumes(uint32_t volume)
+{
+	vitaSAS_system_set_volume(s_system, 0, volume, 0, 0, 0);
+	vitaSAS_system_set_pitch(s_system, 0, 4096);
+	usleep(20);
+	vitaSAS_system_set_pitch(s_system, 1, 4096);
+	vitaSAS_system_set_volume(s_system, 1, 0, volume, 0, 0);
+}
+
+static void check_system_frames(void)
+{
+	static int16_t pcm[4096];
+	vitaSASVoiceParam voiceParam;
+	vitaSASCommand command;
+	vitaSASAudio* audio;
+	pthread_t renderer;
+	uint32_t random = 7, volume;
+
+	for (int i = 0; i < 4096; i++)
+		pcm[i] = (int16_t)((i % 50) * 400 - 10000);
+
+	audio = vitaSAS_load_audio_custom(pcm, sizeof(pcm));
+
+	s_system = host_test_create_system("numVoices=8", TEST_QUEUE_SIZE);
+	HOST_TEST_CHECK(s_system != NULL);
+	if (s_system == NULL)
+		return;
+
+	/* Only the outermost commit publishes */
+
+	HOST_TEST_CHECK_EQ(vitaSAS_system_begin_commands(s_system), SCE_OK);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_begin_commands(s_system), SCE_OK);
+	vitaSAS_system_set_pitch(s_system, 0, 4096);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_commit_commands(s_system), SCE_OK);
+	HOST_TEST_CHECK(!vitaSAS_internal_command_queue_pop(&s_system->commandQueue, &command));
+	HOST_TEST_CHECK_EQ(vitaSAS_system_commit_commands(s_system), SCE_OK);
+	HOST_TEST_CHECK(vitaSAS_internal_command_queue_pop(&s_system->commandQueue, &command));
+	HOST_TEST_CHECK_EQ(vitaSAS_system_commit_commands(s_system), -1);
+
+	/* Frame larger than the queue is dropped as a whole */
+
+	HOST_TEST_CHECK_EQ(vitaSAS_system_begin_commands(s_system), SCE_OK);
+	for (int i = 0; i <= TEST_QUEUE_SIZE; i++)
+		vitaSAS_system_set_pitch(s_system, 0, 4096);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_commit_commands(s_system), VITASAS_ERROR_COMMAND_QUEUE_FULL);
+	HOST_TEST_CHECK(!vitaSAS_internal_command_queue_pop(&s_system->commandQueue, &command));
+
+	/* Same sample on voice 0 (left) and voice 1 (right), set up and keyed on together */
+
+	host_test_voice_param(&voiceParam);
+	voiceParam.loopSize = 0;
+	voiceParam.volRDry = 0;
+
+	HOST_TEST_CHECK_EQ(vitaSAS_system_begin_commands(s_system), SCE_OK);
+	vitaSAS_system_set_voice_PCM(s_system, 0, audio, &voiceParam);
+	voiceParam.volLDry = 0;
+	voiceParam.volRDry = 4096;
+	vitaSAS_system_set_voice_PCM(s_system, 1, audio, &voiceParam);
+	vitaSAS_system_set_key_on(s_system, 0);
+	vitaSAS_system_set_key_on(s_system, 1);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_commit_commands(s_system), SCE_OK);
+
+	pthread_create(&renderer, NULL, render_thread, NULL);
+
+	for (int i = 0; i < TEST_FRAMES; i++) {
+		volume = host_test_rand(&random) % 8192;
+
+		while (vitaSAS_system_begin_commands(s_system) != SCE_OK)
+			sched_yield();
+
+		set_volumes(volume);
+
+		while (vitaSAS_system_commit_commands(s_system) != SCE_OK) {
+			sched_yield();
+			vitaSAS_system_begin_commands(s_system);
+			set_volumes(volume);
+		}
+	}
+
+	s_isRendering = 0;
+	pthread_join(renderer, NULL);
+
+	HOST_TEST_CHECK_EQ(s_numUnequalGrains, 0);
+
+	vitaSAS_system_destroy(s_system);
+	vitaSAS_free_audio(audio);
+}
+
+int main(void)
+{
+	pthread_t producers[TEST_PRODUCERS];
+	uint32_t expected[TEST_PRODUCERS] = {0};
+	uint32_t received = 0;
+	vitaSASCommand command;
+	uint64_t start;
+
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+	HOST_TEST_CHECK_EQ(vitaSAS_internal_command_queue_create(&s_queue, TEST_QUEUE_SIZE), 0);
+
+	start = host_test_time_us();
+
+	for (uintptr_t i = 0; i < TEST_PRODUCERS; i++)
+		pthread_create(&producers[i], NULL, producer_thread, (void*)i);
+
+	while (received < TEST_PRODUCERS * TEST_COMMANDS) {
+		uint32_t producer, count;
+
+		if (!vitaSAS_internal_command_queue_pop(&s_queue, &command)) {
+
+			/* Lost commands never arrive, don't wait for them forever */
+
+			if (host_test_time_us() - start > 60000000ULL) {
+				fprintf(stderr, "timed out after %u commands\n", received);
+				return 1;
+			}
+
+			sched_yield();
+			continue;
+		}
+
+		producer = command.voiceID;
+		if (producer >= TEST_PRODUCERS) {
+			fprintf(stderr, "invalid producer %u\n", producer);
+			return 1;
+		}
+
+		/* Nothing lost or duplicated and producer order is kept */
+
+		HOST_TEST_CHECK_EQ(command.arg[0], expected[producer]);
+		HOST_TEST_CHECK_EQ(command.arg[3], ~command.arg[0]);
+		HOST_TEST_CHECK_EQ(command.arg[1], 0);
+		expected[producer] = command.arg[0] + 1;
+		received++;
+
+		/* The rest of a batch follows immediately, published together with its first command */
+
+		count = command.arg[2];
+		for (uint32_t i = 1; i < count; i++) {
+			if (!vitaSAS_internal_command_queue_pop(&s_queue, &command)) {
+				fprintf(stderr, "batch of %u commands split after %u\n", count, i);
+				return 1;
+			}
+
+			HOST_TEST_CHECK_EQ(command.voiceID, producer);
+			HOST_TEST_CHECK_EQ(command.arg[0], expected[producer]);
+			HOST_TEST_CHECK_EQ(command.arg[1], i);
+			HOST_TEST_CHECK_EQ(command.arg[2], count);
+			expected[producer] = command.arg[0] + 1;
+			received++;
+		}
+	}
+
+	/* Producers may be stuck on a queue that is out of step, don't join them */
+
+	if (host_test_failures != 0)
+		return host_test_result("test_command_queue");
+
+	for (int i = 0; i < TEST_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+
+	for (int i = 0; i < TEST_PRODUCERS; i++)
+		HOST_TEST_CHECK_EQ(expected[i], TEST_COMMANDS);
+
+	HOST_TEST_CHECK(!vitaSAS_internal_command_queue_pop(&s_queue, &command));
+
+	printf("%u commands from %d producers in %llu us\n", received, TEST_PRODUCERS, (unsigned long long)(host_test_time_us() - start));
+
+	vitaSAS_internal_command_queue_destroy(&s_queue);
+
+	check_system_frames();
+
+	vitaSAS_finish();
+
+	return host_test_result("test_command_queue");
+}
@@ -0,0 +1,187 @@
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "host_test.h"
+
+/* Kernel objects of the host backend and a pull-mode render through the whole library */
+
+static SceKernelLwMutexWork s_mutex;
+static SceUID s_sema;
+static volatile int s_counter;
+
+static SceInt32 worker_thread(SceSize argSize, void* pArgBlock)
+{
+	(void)argSize;
+	(void)pArgBlock;
+
+	for (int i = 0; i < 10000; i++) {
+		sceKernelLockLwMutex(&s_mutex, 1, NULL);
+		s_counter++;
+		sceKernelUnlockLwMutex(&s_mutex, 1);
+	}
+
+	sceKernelSignalSema(s_sema, 1);
+
+	return 0;
+}
+
+static void test_kernel_objects(void)
+{
+	SceUID threads[4];
+	SceUInt32 pattern = 0;
+	SceUInt32 timeout = 1000;
+	SceUID evf, block;
+	void* base = NULL;
+
+	/* Memory blocks */
+
+	block = sceKernelAllocMemBlock("test", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, 0x10000, NULL);
+	HOST_TEST_CHECK(block > 0);
+	HOST_TEST_CHECK_EQ(sceKernelGetMemBlockBase(block, &base), SCE_OK);
+	HOST_TEST_CHECK(base != NULL);
+	memset(base, 0x5A, 0x10000);
+	HOST_TEST_CHECK_EQ(sceKernelFreeMemBlock(block), SCE_OK);
+
+	/* Event flags */
+
+	evf = sceKernelCreateEventFlag("test", SCE_KERNEL_ATTR_MULTI, 0, NULL);
+	HOST_TEST_CHECK(evf > 0);
+	HOST_TEST_CHECK(sceKernelPollEventFlag(evf, 1, SCE_KERNEL_EVF_WAITMODE_OR, &pattern) < 0);
+	HOST_TEST_CHECK_EQ(sceKernelWaitEventFlag(evf, 1, SCE_KERNEL_EVF_WAITMODE_OR, &pattern, &timeout), SCE_KERNEL_ERROR_WAIT_TIMEOUT);
+	sceKernelSetEventFlag(evf, 3);
+	HOST_TEST_CHECK_EQ(sceKernelWaitEventFlag(evf, 2, SCE_KERNEL_EVF_WAITMODE_AND | SCE_KERNEL_EVF_WAITMODE_CLEAR_PAT, &pattern, NULL), SCE_OK);
+	HOST_TEST_CHECK_EQ(pattern, 3);
+	HOST_TEST_CHECK_EQ(sceKernelPollEventFlag(evf, 1, SCE_KERNEL_EVF_WAITMODE_OR, &pattern), SCE_OK);
+	HOST_TEST_CHECK(sceKernelPollEventFlag(evf, 2, SCE_KERNEL_EVF_WAITMODE_OR, &pattern) < 0);
+	sceKernelDeleteEventFlag(evf);
+
+	/* Threads, semaphores and lightweight mutexes */
+
+	HOST_TEST_CHECK_EQ(sceKernelCreateLwMutex(&s_mutex, "test", SCE_KERNEL_LW_MUTEX_ATTR_RECURSIVE, 0, NULL), SCE_OK);
+	HOST_TEST_CHECK_EQ(sceKernelLockLwMutex(&s_mutex, 1, NULL), SCE_OK);
+	HOST_TEST_CHECK_EQ(sceKernelTryLockLwMutex(&s_mutex, 1), SCE_OK);
+	sceKernelUnlockLwMutex(&s_mutex, 1);
+	sceKernelUnlockLwMutex(&s_mutex, 1);
+
+	s_sema = sceKernelCreateSema("test", 0, 0, 4, NULL);
+	HOST_TEST_CHECK(s_sema > 0);
+	s_counter = 0;
+
+	for (int i = 0; i < 4; i++) {
+		threads[i] = sceKernelCreateThread("test", worker_thread, 0x10000100, 0x4000, 0, 0, NULL);
+		HOST_TEST_CHECK(threads[i] > 0);
+		sceKernelStartThread(threads[i], 0, NULL);
+	}
+
+	HOST_TEST_CHECK_EQ(sceKernelWaitSema(s_sema, 4, NULL), SCE_OK);
+
+	for (int i = 0; i < 4; i++) {
+		sceKernelWaitThreadEnd(threads[i], NULL, NULL);
+		sceKernelDeleteThread(threads[i]);
+	}
+
+	HOST_TEST_CHECK_EQ(s_counter, 40000);
+	HOST_TEST_CHECK(sceKernelPollSema(s_sema, 1) < 0);
+
+	sceKernelDeleteSema(s_sema);
+	sceKernelDeleteLwMutex(&s_mutex);
+}
+
+static void test_io(void)
+{
+	char dir[256], path[300];
+	char buffer[16];
+	SceIoStat stat;
+	SceUID fd;
+
+	HOST_TEST_CHECK_EQ(host_test_make_dir(dir, sizeof(dir)), 0);
+	snprintf(path, sizeof(path), "%s/io.bin", dir);
+
+	fd = sceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0666);
+	HOST_TEST_CHECK(fd >= 0);
+	HOST_TEST_CHECK_EQ(sceIoWrite(fd, "0123456789", 10), 10);
+	sceIoClose(fd);
+
+	HOST_TEST_CHECK_EQ(sceIoGetstat(path, &stat), SCE_OK);
+	HOST_TEST_CHECK_EQ(stat.st_size, 10);
+
+	fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+	HOST_TEST_CHECK(fd >= 0);
+	HOST_TEST_CHECK_EQ(sceIoPread(fd, buffer, 4, 6), 4);
+	HOST_TEST_CHECK(memcmp(buffer, "6789", 4) == 0);
+	HOST_TEST_CHECK_EQ(sceIoLseek(fd, 0, SCE_SEEK_END), 10);
+	sceIoClose(fd);
+
+	HOST_TEST_CHECK(sceIoOpen("/nonexistent/vitasas", SCE_O_RDONLY, 0) < 0);
+
+	host_test_remove_dir(dir);
+}
+
+static void test_pull_render(unsigned int mixerType)
+{
+	static int16_t pcm[4800];
+	static int16_t out[256 * 2 * 40];
+	VitaSASSystemParam param;
+	vitaSASVoiceParam voiceParam;
+	vitaSASSystem* system;
+	vitaSASAudio* audio;
+	SceUID eventFlagId;
+	int32_t peak = 0;
+	int voiceID;
+
+	for (int i = 0; i < 4800; i++)
+		pcm[i] = (int16_t)((i % 100) * 300 - 15000);
+
+	host_test_system_param(&param, 0);
+	param.mixerType = mixerType;
+
+	system = vitaSAS_system_create("numVoices=8", &param);
+	HOST_TEST_CHECK(system != NULL);
+	if (system == NULL)
+		return;
+
+	audio = vitaSAS_load_audio_custom(pcm, sizeof(pcm));
+	HOST_TEST_CHECK(audio != NULL);
+
+	host_test_voice_param(&voiceParam);
+
+	voiceID = vitaSAS_system_alloc_voice_PCM(system, audio, &voiceParam, NULL, NULL);
+	HOST_TEST_CHECK(voiceID >= 0);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_set_key_on(system, voiceID), SCE_OK);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_system_render_grains(system, out, 40), SCE_OK);
+
+	for (int i = 0; i < 256 * 2 * 40; i++) {
+		int32_t sample = out[i] < 0 ? -out[i] : out[i];
+		if (sample > peak)
+			peak = sample;
+	}
+
+	/* 4800 samples at 48 kHz end within the 10240 rendered ones */
+
+	HOST_TEST_CHECK(peak > 1000);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_end_state(system, voiceID), 1);
+
+	/* Pause flag goes away with the system */
+
+	eventFlagId = system->audioWork.eventFlagId;
+	HOST_TEST_CHECK(eventFlagId > 0);
+
+	vitaSAS_system_destroy(system);
+	vitaSAS_free_audio(audio);
+
+	HOST_TEST_CHECK(sceKernelSetEventFlag(eventFlagId, 1) < 0);
+}
+
+int main(void)
+{
+	test_kernel_objects();
+	test_io();
+
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+	test_pull_render(VITASAS_MIXER_SOFTWARE);
+	test_pull_render(VITASAS_MIXER_SAS);
+	HOST_TEST_CHECK_EQ(vitaSAS_finish(), SCE_OK);
+
+	return host_test_result("test_host_backend");
+}
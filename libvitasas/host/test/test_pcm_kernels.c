@@ -0,0 +1,246 @@
+#include <math.h>
+
+#include "pcm_kernels.h"
+#include "host_test.h"
+
+/*
+ * The vector kernels of the library against the scalar reference build (pcm_kernels_scalar.c), over every
+ * length up to a few vectors plus leftovers, unaligned sources and destinations, S16 extremes, out of
+ * range and NaN floats, and with and without dither. Output and dither state must be bit identical.
+ */
+
+void ref_pcm_kernels_scale_s16_stereo(int16_t* dst, const int16_t* src, unsigned int numFrames, uint32_t volL, uint32_t volR);
+void ref_pcm_kernels_mix_s16_stereo(int16_t* dst, const int16_t* src, unsigned int numFrames, uint32_t volL, uint32_t volR);
+void ref_pcm_kernels_deinterleave_s16_stereo(int16_t* dstL, int16_t* dstR, const int16_t* src, unsigned int numFrames);
+void ref_pcm_kernels_interleave_s16_stereo(int16_t* dst, const int16_t* srcL, const int16_t* srcR, unsigned int numFrames);
+void ref_pcm_kernels_add_s16(int16_t* dst, const int16_t* src, unsigned int numSamples);
+void ref_pcm_kernels_ramp_s16_stereo(int16_t* dst, const int16_t* src, unsigned int numFrames, uint32_t startL, uint32_t startR, uint32_t endL, uint32_t endR);
+void ref_pcm_kernels_mono_to_stereo_s16(int16_t* dst, const int16_t* src, unsigned int numFrames);
+void ref_pcm_kernels_stereo_to_mono_s16(int16_t* dst, const int16_t* src, unsigned int numFrames);
+void ref_pcm_kernels_convert_u8_s16(int16_t* dst, const uint8_t* src, unsigned int numSamples);
+void ref_pcm_kernels_convert_s24_s16(int16_t* dst, const uint8_t* src, unsigned int numSamples, pcm_kernels_dither* dither);
+void ref_pcm_kernels_convert_s32_s16(int16_t* dst, const int32_t* src, unsigned int numSamples, pcm_kernels_dither* dither);
+void ref_pcm_kernels_convert_f32_s16(int16_t* dst, const float* src, unsigned int numSamples, pcm_kernels_dither* dither);
+void ref_pcm_kernels_convert_s16_f32(float* dst, const int16_t* src, unsigned int numSamples);
+void ref_pcm_kernels_measure_s16(const int16_t* src, unsigned int numSamples, pcm_kernels_level* level);
+void ref_pcm_kernels_accumulate_mono_s16(int32_t* acc, const int16_t* src, unsigned int numFrames, int32_t volL, int32_t volR);
+void ref_pcm_kernels_pack_s32_s16(int16_t* dst, const int32_t* acc, unsigned int numSamples);
+void ref_pcm_kernels_pack_mix_s32_s16_stereo(int16_t* dst, const int32_t* acc, unsigned int numFrames, int32_t volL, int32_t volR);
+
+#define TEST_MAX_FRAMES		70
+#define TEST_NUM_ROUNDS		64
+#define TEST_BUFFER_SIZE	(TEST_MAX_FRAMES * 2 + 16)
+
+static int16_t s_s16[TEST_BUFFER_SIZE * 2];
+static int32_t s_s32[TEST_BUFFER_SIZE];
+static uint8_t s_u8[TEST_BUFFER_SIZE * 3];
+static float s_f32[TEST_BUFFER_SIZE];
+
+/* Outputs of the library kernel and of the reference, compared as a whole so writes past the end show up */
+
+static int16_t s_out[TEST_BUFFER_SIZE], s_ref[TEST_BUFFER_SIZE];
+static int16_t s_out2[TEST_BUFFER_SIZE], s_ref2[TEST_BUFFER_SIZE];
+static int32_t s_acc[TEST_BUFFER_SIZE], s_accRef[TEST_BUFFER_SIZE];
+static float s_outF32[TEST_BUFFER_SIZE], s_refF32[TEST_BUFFER_SIZE];
+
+static const char* s_kernel;
+static unsigned int s_numFrames, s_offset;
+
+#define TEST_CHECK_SAME(a, b) \
+	do { \
+		if (memcmp(a, b, sizeof(a)) != 0) { \
+			fprintf(stderr, "%s:%d: %s differs from the reference, %u frames, offset %u\n", __FILE__, __LINE__, s_kernel, s_numFrames, s_offset); \
+			host_test_failures++; \
+		} \
+	} while (0)
+
+static void reset_outputs(uint32_t* random)
+{
+	for (unsigned int i = 0; i < TEST_BUFFER_SIZE; i++) {
+		s_out[i] = s_ref[i] = (int16_t)host_test_rand(random);
+		s_out2[i] = s_ref2[i] = (int16_t)host_test_rand(random);
+		s_acc[i] = s_accRef[i] = (int32_t)(host_test_rand(random) % (1 << 24)) - (1 << 23);
+		s_outF32[i] = s_refF32[i] = 0.0f;
+	}
+}
+
+/* A tenth of the samples are -32768 or 32767 so saturation paths are hit */
+
+static void fill_inputs(uint32_t* random)
+{
+	static const float specials[] = {1.5f, -1.5f, 1.0f, -1.0f, -3.0f, INFINITY, -INFINITY, NAN};
+	uint32_t r;
+
+	for (unsigned int i = 0; i < TEST_BUFFER_SIZE * 2; i++) {
+		r = host_test_rand(random);
+		s_s16[i] = r % 10 == 0 ? -32768 : r % 10 == 1 ? 32767 : (int16_t)(r >> 8);
+	}
+
+	for (unsigned int i = 0; i < TEST_BUFFER_SIZE; i++) {
+		r = host_test_rand(random);
+		s_s32[i] = r % 10 == 0 ? INT32_MIN : r % 10 == 1 ? INT32_MAX : (int32_t)host_test_rand(random);
+		s_f32[i] = r % 4 == 0 ? specials[(r >> 8) % 8] : ((int32_t)(host_test_rand(random) % (1 << 24)) - (1 << 23)) / 8388608.0f * 1.01f;
+	}
+
+	for (unsigned int i = 0; i < TEST_BUFFER_SIZE * 3; i++)
+		s_u8[i] = (uint8_t)host_test_rand(random);
+}
+
+static void check_round(unsigned int numFrames, unsigned int offset, uint32_t* random)
+{
+	const int16_t* src = s_s16 + offset;
+	uint32_t volL = host_test_rand(random) % 0x9000, volR = host_test_rand(random) % 0x9000;
+	uint32_t endL = host_test_rand(random) % 0x9000, endR = host_test_rand(random) % 0x9000;
+	int32_t gainL = (int32_t)(host_test_rand(random) % 16384) - 8192, gainR = (int32_t)(host_test_rand(random) % 16384) - 8192;
+	pcm_kernels_dither dither, ditherRef;
+	pcm_kernels_level level, levelRef;
+
+	s_numFrames = numFrames;
+	s_offset = offset;
+
+	/* Destinations are offset in the other direction so source and destination alignment differ */
+
+	s_kernel = "scale_s16_stereo";
+	reset_outputs(random);
+	pcm_kernels_scale_s16_stereo(s_out + 3 - offset, src, numFrames, volL, volR);
+	ref_pcm_kernels_scale_s16_stereo(s_ref + 3 - offset, src, numFrames, volL, volR);
+	TEST_CHECK_SAME(s_out, s_ref);
+
+	s_kernel = "mix_s16_stereo";
+	reset_outputs(random);
+	pcm_kernels_mix_s16_stereo(s_out + 3 - offset, src, numFrames, volL, volR);
+	ref_pcm_kernels_mix_s16_stereo(s_ref + 3 - offset, src, numFrames, volL, volR);
+	TEST_CHECK_SAME(s_out, s_ref);
+
+	s_kernel = "deinterleave_s16_stereo";
+	reset_outputs(random);
+	pcm_kernels_deinterleave_s16_stereo(s_out + 3 - offset, s_out2 + offset, src, numFrames);
+	ref_pcm_kernels_deinterleave_s16_stereo(s_ref + 3 - offset, s_ref2 + offset, src, numFrames);
+	TEST_CHECK_SAME(s_out, s_ref);
+	TEST_CHECK_SAME(s_out2, s_ref2);
+
+	s_kernel = "interleave_s16_stereo";
+	reset_outputs(random);
+	pcm_kernels_interleave_s16_stereo(s_out + 3 - offset, src, s_s16 + TEST_BUFFER_SIZE + 1, numFrames);
+	ref_pcm_kernels_interleave_s16_stereo(s_ref + 3 - offset, src, s_s16 + TEST_BUFFER_SIZE + 1, numFrames);
+	TEST_CHECK_SAME(s_out, s_ref);
+
+	s_kernel = "add_s16";
+	reset_outputs(random);
+	pcm_kernels_add_s16(s_out + 3 - offset, src, numFrames * 2);
+	ref_pcm_kernels_add_s16(s_ref + 3 - offset, src, numFrames * 2);
+	TEST_CHECK_SAME(s_out, s_ref);
+
+	s_kernel = "ramp_s16_stereo";
+	reset_outputs(random);
+	pcm_kernels_ramp_s16_stereo(s_out + 3 - offset, src, numFrames, volL, volR, endL, endR);
+	ref_pcm_kernels_ramp_s16_stereo(s_ref + 3 - offset, src, numFrames, volL, volR, endL, endR);
+	TEST_CHECK_SAME(s_out, s_ref);
+
+	s_kernel = "mono_to_stereo_s16";
+	reset_outputs(random);
+	pcm_kernels_mono_to_stereo_s16(s_out + 3 - offset, src, numFrames);
+	ref_pcm_kernels_mono_to_stereo_s16(s_ref + 3 - offset, src, numFrames);
+	TEST_CHECK_SAME(s_out, s_ref);
+
+	s_kernel = "stereo_to_mono_s16";
+	reset_outputs(random);
+	pcm_kernels_stereo_to_mono_s16(s_out + 3 - offset, src, numFrames);
+	ref_pcm_kernels_stereo_to_mono_s16(s_ref + 3 - offset, src, numFrames);
+	TEST_CHECK_SAME(s_out, s_ref);
+
+	s_kernel = "convert_u8_s16";
+	reset_outputs(random);
+	pcm_kernels_convert_u8_s16(s_out + 3 - offset, s_u8 + offset, numFrames * 2);
+	ref_pcm_kernels_convert_u8_s16(s_ref + 3 - offset, s_u8 + offset, numFrames * 2);
+	TEST_CHECK_SAME(s_out, s_ref);
+
+	for (int withDither = 0; withDither < 2; withDither++) {
+		pcm_kernels_dither_init(&dither, host_test_rand(random));
+		ditherRef = dither;
+
+		s_kernel = withDither ? "convert_s24_s16 dithered" : "convert_s24_s16";
+		reset_outputs(random);
+		pcm_kernels_convert_s24_s16(s_out + 3 - offset, s_u8 + offset, numFrames * 2, withDither ? &dither : NULL);
+		ref_pcm_kernels_convert_s24_s16(s_ref + 3 - offset, s_u8 + offset, numFrames * 2, withDither ? &ditherRef : NULL);
+		TEST_CHECK_SAME(s_out, s_ref);
+
+		s_kernel = withDither ? "convert_s32_s16 dithered" : "convert_s32_s16";
+		reset_outputs(random);
+		pcm_kernels_convert_s32_s16(s_out + 3 - offset, s_s32 + offset, numFrames * 2, withDither ? &dither : NULL);
+		ref_pcm_kernels_convert_s32_s16(s_ref + 3 - offset, s_s32 + offset, numFrames * 2, withDither ? &ditherRef : NULL);
+		TEST_CHECK_SAME(s_out, s_ref);
+
+		s_kernel = withDither ? "convert_f32_s16 dithered" : "convert_f32_s16";
+		reset_outputs(random);
+		pcm_kernels_convert_f32_s16(s_out + 3 - offset, s_f32 + offset, numFrames * 2, withDither ? &dither : NULL);
+		ref_pcm_kernels_convert_f32_s16(s_ref + 3 - offset, s_f32 + offset, numFrames * 2, withDither ? &ditherRef : NULL);
+		TEST_CHECK_SAME(s_out, s_ref);
+
+		s_kernel = "dither state";
+		HOST_TEST_CHECK(memcmp(&dither, &ditherRef, sizeof(dither)) == 0);
+	}
+
+	s_kernel = "convert_s16_f32";
+	reset_outputs(random);
+	pcm_kernels_convert_s16_f32(s_outF32 + 3 - offset, src, numFrames * 2);
+	ref_pcm_kernels_convert_s16_f32(s_refF32 + 3 - offset, src, numFrames * 2);
+	TEST_CHECK_SAME(s_outF32, s_refF32);
+
+	s_kernel = "measure_s16";
+	pcm_kernels_measure_s16(src, numFrames * 2, &level);
+	ref_pcm_kernels_measure_s16(src, numFrames * 2, &levelRef);
+	HOST_TEST_CHECK_EQ(level.peak, levelRef.peak);
+	HOST_TEST_CHECK_EQ(level.rms, levelRef.rms);
+	HOST_TEST_CHECK_EQ(level.sumSquares, levelRef.sumSquares);
+
+	s_kernel = "accumulate_mono_s16";
+	reset_outputs(random);
+	pcm_kernels_accumulate_mono_s16(s_acc + 3 - offset, src, numFrames, gainL, gainR);
+	ref_pcm_kernels_accumulate_mono_s16(s_accRef + 3 - offset, src, numFrames, gainL, gainR);
+	TEST_CHECK_SAME(s_acc, s_accRef);
+
+	s_kernel = "pack_s32_s16";
+	reset_outputs(random);
+	pcm_kernels_pack_s32_s16(s_out + 3 - offset, s_s32 + offset, numFrames * 2);
+	ref_pcm_kernels_pack_s32_s16(s_ref + 3 - offset, s_s32 + offset, numFrames * 2);
+	TEST_CHECK_SAME(s_out, s_ref);
+
+	s_kernel = "pack_mix_s32_s16_stereo";
+	reset_outputs(random);
+	pcm_kernels_pack_mix_s32_s16_stereo(s_out + 3 - offset, s_acc + offset, numFrames, gainL, gainR);
+	ref_pcm_kernels_pack_mix_s32_s16_stereo(s_ref + 3 - offset, s_acc + offset, numFrames, gainL, gainR);
+	TEST_CHECK_SAME(s_out, s_ref);
+}
+
+int main(void)
+{
+	static const int16_t extremes[4] = {-32768, -32768, 100, -100};
+	static const int16_t flat[8] = {1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000};
+	static const int16_t ramped[8] = {0, 1000, 250, 750, 500, 500, 750, 250};
+	pcm_kernels_level level;
+	int16_t out[8];
+	uint32_t random = 1;
+
+#if !defined(PCM_KERNELS_NEON) && !defined(PCM_KERNELS_SSE2)
+	printf("no vector kernels on this target, comparing the scalar build with itself\n");
+#endif
+
+	for (unsigned int round = 0; round < TEST_NUM_ROUNDS; round++) {
+		fill_inputs(&random);
+
+		for (unsigned int numFrames = 0; numFrames <= TEST_MAX_FRAMES; numFrames++)
+			check_round(numFrames, round & 3, &random);
+	}
+
+	/* Known values: peak of -32768 and a ramp from silence to unity and back */
+
+	pcm_kernels_measure_s16(extremes, 4, &level);
+	HOST_TEST_CHECK_EQ(level.peak, 32768);
+	HOST_TEST_CHECK_EQ(level.sumSquares, 2ULL * 32768 * 32768 + 2 * 100 * 100);
+
+	pcm_kernels_ramp_s16_stereo(out, flat, 4, 0, 4096, 4096, 0);
+	HOST_TEST_CHECK(memcmp(out, ramped, sizeof(out)) == 0);
+
+	return host_test_result("test_pcm_kernels");
+}
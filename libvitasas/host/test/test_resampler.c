@@ -0,0 +1,121 @@
+#include <math.h>
+
+#include "resampler.h"
+#include "host_test.h"
+
+/*
+ * Resampler quality on sines: SNR against the ideal output at 1 kHz and high in the passband, and
+ * rejection of a tone above the output Nyquist frequency when decimating.
+ */
+
+static int16_t* convert(uint32_t inRate, uint32_t outRate, const int16_t* src, unsigned int numInput, unsigned int* numOutput)
+{
+	int16_t* table = malloc(resampler_get_table_size(inRate, outRate));
+	int16_t* dst;
+	resampler rs;
+
+	resampler_init(&rs, inRate, outRate, table);
+	*numOutput = resampler_get_num_output(&rs, numInput);
+
+	dst = malloc(*numOutput * sizeof(int16_t));
+	resampler_process(&rs, dst, *numOutput, src, numInput);
+
+	free(table);
+
+	return dst;
+}
+
+static int16_t* make_sine(uint32_t rate, double frequency, double amplitude, unsigned int numSamples)
+{
+	int16_t* src = malloc(numSamples * sizeof(int16_t));
+
+	for (unsigned int i = 0; i < numSamples; i++)
+		src[i] = (int16_t)lrint(amplitude * 32767.0 * sin(2.0 * M_PI * frequency * i / rate));
+
+	return src;
+}
+
+/* Filter edges at both ends are left out */
+
+static double sine_snr(uint32_t inRate, uint32_t outRate, double frequency)
+{
+	unsigned int numInput = inRate, numOutput;
+	int16_t* src = make_sine(inRate, frequency, 0.5, numInput);
+	int16_t* dst = convert(inRate, outRate, src, numInput, &numOutput);
+	double signal = 0.0, noise = 0.0, expected;
+
+	for (unsigned int i = 256; i < numOutput - 256; i++) {
+		expected = 0.5 * 32767.0 * sin(2.0 * M_PI * frequency * i / outRate);
+		signal += expected * expected;
+		noise += (dst[i] - expected) * (dst[i] - expected);
+	}
+
+	free(src);
+	free(dst);
+
+	return 10.0 * log10(signal / (noise + 1e-9));
+}
+
+static double alias_level(uint32_t inRate, uint32_t outRate, double frequency)
+{
+	unsigned int numInput = inRate, numOutput;
+	int16_t* src = make_sine(inRate, frequency, 0.9, numInput);
+	int16_t* dst = convert(inRate, outRate, src, numInput, &numOutput);
+	double energy = 0.0;
+
+	for (unsigned int i = 256; i < numOutput - 256; i++)
+		energy += (double)dst[i] * dst[i];
+
+	energy /= numOutput - 512;
+
+	free(src);
+	free(dst);
+
+	return 10.0 * log10(energy / (0.81 * 32767.0 * 32767.0 / 2.0) + 1e-12);
+}
+
+static void check_conversion(uint32_t inRate, uint32_t outRate, double minSnr)
+{
+	double lowRate = inRate < outRate ? inRate : outRate;
+	double snr1k = sine_snr(inRate, outRate, 1000.0);
+	double snrHigh = sine_snr(inRate, outRate, 0.3 * lowRate);
+
+	printf("%5u -> %5u: SNR %.1f dB at 1 kHz, %.1f dB at %.0f Hz\n", inRate, outRate, snr1k, snrHigh, 0.3 * lowRate);
+
+	HOST_TEST_CHECK(snr1k >= minSnr);
+	HOST_TEST_CHECK(snrHigh >= minSnr - 2.0);
+}
+
+int main(void)
+{
+	unsigned int numOutput;
+	resampler rs;
+	int16_t* table;
+	double alias;
+
+	/* Rates are reduced to the smallest ratio, output length follows it */
+
+	table = malloc(resampler_get_table_size(44100, 48000));
+	resampler_init(&rs, 44100, 48000, table);
+	HOST_TEST_CHECK_EQ(rs.inRate, 147);
+	HOST_TEST_CHECK_EQ(rs.outRate, 160);
+	numOutput = resampler_get_num_output(&rs, 44100);
+	HOST_TEST_CHECK(numOutput >= 47999 && numOutput <= 48001);
+	HOST_TEST_CHECK_EQ(resampler_get_num_output(&rs, 0), 0);
+	free(table);
+
+	check_conversion(44100, 48000, 72.0);
+	check_conversion(48000, 22050, 72.0);
+	check_conversion(22050, 48000, 72.0);
+	check_conversion(48000, 44100, 72.0);
+
+	/* More phases than RESAMPLER_PHASES_MAX, nearest phase is used */
+
+	check_conversion(44056, 48000, 65.0);
+
+	alias = alias_level(48000, 22050, 0.6 * 22050);
+	printf("48000 -> 22050: %.1f dB alias of %.0f Hz\n", alias, 0.6 * 22050);
+	HOST_TEST_CHECK(alias <= -65.0);
+
+	return host_test_result("test_resampler");
+}
@@ -0,0 +1,319 @@
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "host_test.h"
+
+/*
+ * Sample cache sharing: every spelling of a path maps to one sample, references are released through
+ * vitaSAS_free_audio() and the cache can't be disabled while any is left. Threads loading a path for
+ * the first time at once all get the sample from a single read.
+ *
+ * Eviction: unreferenced samples beyond the budget go least recently used first, samples set on a voice stay
+ * until the voice ends or is released, and sample memory allocations that fail evict and retry. Files are
+ * rewritten after loading, so data that is read again tells an evicted sample from a resident one.
+ */
+
+#define TEST_SAMPLE_SIZE	4096
+#define TEST_NUM_THREADS	8
+
+static char s_path[TEST_NUM_THREADS][300];
+static vitaSASAudio* s_loaded[TEST_NUM_THREADS];
+static pthread_barrier_t s_barrier;
+
+static void* load_thread(void* arg)
+{
+	int index = (int)(intptr_t)arg;
+
+	pthread_barrier_wait(&s_barrier);
+	s_loaded[index] = vitaSAS_load_audio_VAG(s_path[index], 0);
+
+	return NULL;
+}
+
+static void check_path_dedup(const char* dir)
+{
+	char path[300], alias[300];
+	vitaSASAudio* audio;
+	vitaSASAudio* shared;
+
+	HOST_TEST_CHECK_EQ(vitaSAS_enable_sample_cache(16), SCE_OK);
+
+	snprintf(path, sizeof(path), "%s/A/b.vag", dir);
+	snprintf(alias, sizeof(alias), "%s/a/./B.vag", dir);
+
+	audio = vitaSAS_load_audio_VAG(path, 0);
+	HOST_TEST_CHECK(audio != NULL);
+	shared = vitaSAS_load_audio_VAG(alias, 0);
+	HOST_TEST_CHECK(shared == audio);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), TEST_SAMPLE_SIZE);
+
+	/* Last reference keeps the cache enabled, released data stays loaded until the cache goes */
+
+	if (audio != NULL)
+		vitaSAS_free_audio(audio);
+	HOST_TEST_CHECK_EQ(vitaSAS_disable_sample_cache(), VITASAS_ERROR_NOT_SUPPORTED);
+
+	if (shared != NULL)
+		vitaSAS_free_audio(shared);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), TEST_SAMPLE_SIZE);
+	HOST_TEST_CHECK_EQ(vitaSAS_disable_sample_cache(), SCE_OK);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), 0);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_pool_usage(), 0);
+}
+
+static void check_concurrent_load(const char* dir)
+{
+	pthread_t threads[TEST_NUM_THREADS];
+	unsigned int singleUsage;
+	vitaSASAudio* audio;
+	char path[300];
+
+	/* Sample memory of one uncached load */
+
+	snprintf(path, sizeof(path), "%s/c.vag", dir);
+	audio = vitaSAS_load_audio_VAG(path, 0);
+	HOST_TEST_CHECK(audio != NULL);
+	if (audio == NULL)
+		return;
+	singleUsage = vitaSAS_get_sample_pool_usage();
+	vitaSAS_free_audio(audio);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_enable_sample_cache(16), SCE_OK);
+	pthread_barrier_init(&s_barrier, NULL, TEST_NUM_THREADS);
+
+	for (int i = 0; i < TEST_NUM_THREADS; i++) {
+		snprintf(s_path[i], sizeof(s_path[i]), i % 2 == 0 ? "%s/c.vag" : "%s/.//c.vag", dir);
+		pthread_create(&threads[i], NULL, load_thread, (void*)(intptr_t)i);
+	}
+
+	for (int i = 0; i < TEST_NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_barrier_destroy(&s_barrier);
+
+	/* A second read would have allocated a second copy of the data */
+
+	for (int i = 0; i < TEST_NUM_THREADS; i++)
+		HOST_TEST_CHECK(s_loaded[i] != NULL && s_loaded[i] == s_loaded[0]);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), TEST_SAMPLE_SIZE);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_pool_usage(), singleUsage);
+
+	for (int i = 0; i < TEST_NUM_THREADS; i++) {
+		if (s_loaded[i] != NULL)
+			vitaSAS_free_audio(s_loaded[i]);
+	}
+
+	HOST_TEST_CHECK_EQ(vitaSAS_disable_sample_cache(), SCE_OK);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_pool_usage(), 0);
+}
+
+static void write_sample(const char* dir, const char* name, uint8_t value)
+{
+	static uint8_t data[TEST_SAMPLE_SIZE];
+	char path[300];
+
+	memset(data, value, sizeof(data));
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	HOST_TEST_CHECK_EQ(host_test_write_file(path, data, sizeof(data)), 0);
+}
+
+/* First byte of the sample data, 0 if it can't be loaded */
+
+static uint8_t load_sample(const char* dir, const char* name, vitaSASAudio** audio)
+{
+	char path[300];
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	*audio = vitaSAS_load_audio_PCM(path, 0);
+	HOST_TEST_CHECK(*audio != NULL);
+
+	return *audio != NULL ? ((uint8_t*)(*audio)->datap)[0] : 0;
+}
+
+static uint8_t reload_sample(const char* dir, const char* name)
+{
+	vitaSASAudio* audio;
+	uint8_t value = load_sample(dir, name, &audio);
+
+	if (audio != NULL)
+		vitaSAS_free_audio(audio);
+
+	return value;
+}
+
+static void check_budget_eviction(const char* dir)
+{
+	vitaSASAudio* audio;
+
+	HOST_TEST_CHECK_EQ(vitaSAS_enable_sample_cache(16), SCE_OK);
+	vitaSAS_set_sample_cache_budget(2 * TEST_SAMPLE_SIZE);
+
+	write_sample(dir, "e1.pcm", 1);
+	write_sample(dir, "e2.pcm", 2);
+	write_sample(dir, "e3.pcm", 3);
+
+	HOST_TEST_CHECK_EQ(reload_sample(dir, "e1.pcm"), 1);
+	HOST_TEST_CHECK_EQ(reload_sample(dir, "e2.pcm"), 2);
+	write_sample(dir, "e1.pcm", 11);
+	write_sample(dir, "e2.pcm", 12);
+
+	/* Third sample pushes out the oldest unreferenced one */
+
+	HOST_TEST_CHECK_EQ(load_sample(dir, "e3.pcm", &audio), 3);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), 2 * TEST_SAMPLE_SIZE);
+	HOST_TEST_CHECK_EQ(reload_sample(dir, "e2.pcm"), 2);
+	HOST_TEST_CHECK_EQ(reload_sample(dir, "e1.pcm"), 11);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), 2 * TEST_SAMPLE_SIZE);
+
+	if (audio != NULL)
+		vitaSAS_free_audio(audio);
+
+	vitaSAS_set_sample_cache_budget(0);
+	HOST_TEST_CHECK_EQ(vitaSAS_disable_sample_cache(), SCE_OK);
+}
+
+static void check_voice_pin(const char* dir)
+{
+	static int16_t out[256 * 2];
+	vitaSASVoiceParam voiceParam;
+	vitaSASSystem* system;
+	vitaSASAudio* audio;
+	int voiceID;
+
+	system = host_test_create_system("numVoices=8", 64);
+	HOST_TEST_CHECK(system != NULL);
+	if (system == NULL)
+		return;
+
+	host_test_voice_param(&voiceParam);
+	HOST_TEST_CHECK_EQ(vitaSAS_enable_sample_cache(16), SCE_OK);
+
+	/* Voice playing the sample keeps it loaded past the budget after the game reference is gone */
+
+	write_sample(dir, "p1.pcm", 1);
+	load_sample(dir, "p1.pcm", &audio);
+	if (audio == NULL)
+		goto done;
+
+	voiceID = vitaSAS_system_alloc_voice_PCM(system, audio, &voiceParam, NULL, NULL);
+	HOST_TEST_CHECK(voiceID >= 0);
+	vitaSAS_free_audio(audio);
+	write_sample(dir, "p1.pcm", 11);
+
+	vitaSAS_set_sample_cache_budget(1);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), TEST_SAMPLE_SIZE);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_system_set_key_on(system, voiceID), SCE_OK);
+	for (int i = 0; i < 4; i++)
+		vitaSAS_system_render_grains(system, out, 1);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), TEST_SAMPLE_SIZE);
+	HOST_TEST_CHECK_EQ(reload_sample(dir, "p1.pcm"), 1);
+
+	/* 2048 samples at unity pitch end within 8 grains, the reclaimed voice drops the sample */
+
+	for (int i = 0; i < 8; i++)
+		vitaSAS_system_render_grains(system, out, 1);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), 8);
+	vitaSAS_set_sample_cache_budget(1);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), 0);
+
+	/* Released voice drops it too, after its waveform command has been applied */
+
+	vitaSAS_set_sample_cache_budget(0);
+	write_sample(dir, "p2.pcm", 2);
+	load_sample(dir, "p2.pcm", &audio);
+	if (audio == NULL)
+		goto done;
+
+	voiceID = vitaSAS_system_alloc_voice_PCM(system, audio, &voiceParam, NULL, NULL);
+	HOST_TEST_CHECK(voiceID >= 0);
+	vitaSAS_free_audio(audio);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_release_voice(system, voiceID), SCE_OK);
+	vitaSAS_system_render_grains(system, out, 1);
+
+	vitaSAS_set_sample_cache_budget(1);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), 0);
+
+done:
+
+	vitaSAS_set_sample_cache_budget(0);
+	vitaSAS_system_destroy(system);
+	HOST_TEST_CHECK_EQ(vitaSAS_disable_sample_cache(), SCE_OK);
+}
+
+/* Sample pool budget that fits one sample, a second load only succeeds after the first one is evicted */
+
+static void check_evict_and_retry(const char* dir, unsigned int singleUsage)
+{
+	vitaSASAudio* audio;
+
+	vitaSAS_set_sample_pool_size(VITASAS_SAMPLE_POOL_BLOCK_SIZE_DEFAULT, singleUsage + singleUsage / 2);
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+	HOST_TEST_CHECK_EQ(vitaSAS_enable_sample_cache(16), SCE_OK);
+
+	write_sample(dir, "r1.pcm", 1);
+	write_sample(dir, "r2.pcm", 2);
+
+	HOST_TEST_CHECK_EQ(reload_sample(dir, "r1.pcm"), 1);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), TEST_SAMPLE_SIZE);
+
+	HOST_TEST_CHECK_EQ(load_sample(dir, "r2.pcm", &audio), 2);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_cache_usage(), TEST_SAMPLE_SIZE);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_pool_usage(), singleUsage);
+
+	if (audio != NULL)
+		vitaSAS_free_audio(audio);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_disable_sample_cache(), SCE_OK);
+	vitaSAS_finish();
+	vitaSAS_set_sample_pool_size(VITASAS_SAMPLE_POOL_BLOCK_SIZE_DEFAULT, 0);
+}
+
+int main(void)
+{
+	static uint8_t data[TEST_SAMPLE_SIZE];
+	char dir[256], path[300];
+	unsigned int singleUsage;
+	vitaSASAudio* audio;
+
+	for (int i = 0; i < TEST_SAMPLE_SIZE; i++)
+		data[i] = (uint8_t)i;
+
+	if (host_test_make_dir(dir, sizeof(dir)) < 0)
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/A", dir);
+	HOST_TEST_CHECK_EQ(mkdir(path, 0777), 0);
+	snprintf(path, sizeof(path), "%s/A/b.vag", dir);
+	HOST_TEST_CHECK_EQ(host_test_write_file(path, data, sizeof(data)), 0);
+	snprintf(path, sizeof(path), "%s/c.vag", dir);
+	HOST_TEST_CHECK_EQ(host_test_write_file(path, data, sizeof(data)), 0);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+
+	check_path_dedup(dir);
+	check_concurrent_load(dir);
+	check_budget_eviction(dir);
+	check_voice_pin(dir);
+
+	/* Sample memory of one sample for the pool budget */
+
+	load_sample(dir, "c.vag", &audio);
+	singleUsage = vitaSAS_get_sample_pool_usage();
+	if (audio != NULL)
+		vitaSAS_free_audio(audio);
+
+	vitaSAS_finish();
+
+	check_evict_and_retry(dir, singleUsage);
+
+	host_test_remove_dir(dir);
+
+	return host_test_result("test_sample_cache");
+}
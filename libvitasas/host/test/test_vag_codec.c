@@ -0,0 +1,154 @@
+#include <math.h>
+
+#include "vag_codec.h"
+#include "host_test.h"
+
+/*
+ * vag_codec_encode() output layout: size, header fields, the silent lead-in block and the loop end flag
+ * on the last block only, and the quality of the samples vag_codec_decode() gets back.
+ */
+
+#define TEST_SAMPLING_RATE	44100
+
+static uint32_t read_be32(const uint8_t* src)
+{
+	return (uint32_t)src[0] << 24 | (uint32_t)src[1] << 16 | (uint32_t)src[2] << 8 | (uint32_t)src[3];
+}
+
+/* Encode, check the layout and decode, decoded samples follow the lead-in block */
+
+static int16_t* round_trip(const int16_t* src, unsigned int numSamples)
+{
+	unsigned int numBlocks = numSamples != 0 ? (numSamples + VAG_CODEC_BLOCK_SAMPLES - 1) / VAG_CODEC_BLOCK_SAMPLES : 1;
+	unsigned int size = vag_codec_get_encoded_size(numSamples);
+	uint8_t* vag = malloc(size);
+	int16_t* dst;
+	vag_codec_info info;
+	unsigned int lastBlock = 0, numLoopEnd = 0;
+
+	HOST_TEST_CHECK_EQ(size, VAG_CODEC_HEADER_SIZE + (numBlocks + 1) * VAG_CODEC_BLOCK_SIZE);
+	HOST_TEST_CHECK_EQ(vag_codec_encode(vag, src, numSamples, TEST_SAMPLING_RATE), size);
+
+	HOST_TEST_CHECK_EQ(read_be32(vag), VAG_CODEC_MAGIC);
+	HOST_TEST_CHECK(memcmp(vag, "VAGp", 4) == 0);
+	HOST_TEST_CHECK_EQ(read_be32(vag + 4), VAG_CODEC_VERSION);
+	HOST_TEST_CHECK_EQ(read_be32(vag + 12), size - VAG_CODEC_HEADER_SIZE);
+	HOST_TEST_CHECK_EQ(read_be32(vag + 16), TEST_SAMPLING_RATE);
+
+	for (unsigned int i = VAG_CODEC_HEADER_SIZE; i < VAG_CODEC_HEADER_SIZE + VAG_CODEC_BLOCK_SIZE; i++)
+		HOST_TEST_CHECK_EQ(vag[i], 0);
+
+	for (unsigned int i = VAG_CODEC_HEADER_SIZE; i < size; i += VAG_CODEC_BLOCK_SIZE) {
+		HOST_TEST_CHECK((vag[i] >> 4) < VAG_CODEC_NUM_FILTERS);
+		HOST_TEST_CHECK_EQ(vag[i + 1] & (VAG_CODEC_FLAG_LOOP_REPEAT | VAG_CODEC_FLAG_LOOP_START), 0);
+		if (vag[i + 1] & VAG_CODEC_FLAG_LOOP_END) {
+			lastBlock = i;
+			numLoopEnd++;
+		}
+	}
+
+	HOST_TEST_CHECK_EQ(numLoopEnd, 1);
+	HOST_TEST_CHECK_EQ(lastBlock, size - VAG_CODEC_BLOCK_SIZE);
+
+	HOST_TEST_CHECK_EQ(vag_codec_parse_header(vag, size, &info), 0);
+	vag_codec_scan_blocks(vag, &info);
+	HOST_TEST_CHECK_EQ(info.samplingRate, TEST_SAMPLING_RATE);
+	HOST_TEST_CHECK_EQ(info.numSamples, (numBlocks + 1) * VAG_CODEC_BLOCK_SAMPLES);
+	HOST_TEST_CHECK_EQ(info.loopStart, -1);
+	HOST_TEST_CHECK_EQ(info.loopEnd, -1);
+
+	dst = malloc(info.numSamples * sizeof(int16_t));
+	HOST_TEST_CHECK_EQ(vag_codec_decode(dst, vag, &info), (int)info.numSamples);
+
+	for (unsigned int i = 0; i < VAG_CODEC_BLOCK_SAMPLES; i++)
+		HOST_TEST_CHECK_EQ(dst[i], 0);
+
+	free(vag);
+
+	return dst;
+}
+
+static double round_trip_snr(const int16_t* src, unsigned int numSamples)
+{
+	int16_t* dst = round_trip(src, numSamples);
+	double signal = 0.0, noise = 0.0;
+
+	for (unsigned int i = 0; i < numSamples; i++) {
+		signal += (double)src[i] * src[i];
+		noise += (double)(src[i] - dst[VAG_CODEC_BLOCK_SAMPLES + i]) * (src[i] - dst[VAG_CODEC_BLOCK_SAMPLES + i]);
+	}
+
+	free(dst);
+
+	return 10.0 * log10(signal / (noise + 1e-9));
+}
+
+int main(void)
+{
+	static const unsigned int shortLengths[] = {1, 13, 27, 28, 29, 56, 57};
+	unsigned int numSamples = TEST_SAMPLING_RATE * 2;
+	int16_t* src = malloc(numSamples * sizeof(int16_t));
+	uint32_t random = 1;
+	int16_t* dst;
+	double snr, accumulator = 0.0;
+
+	memset(src, 0, numSamples * sizeof(int16_t));
+
+	/* Empty input still gets a data block carrying the end flag */
+
+	dst = round_trip(src, 0);
+	free(dst);
+
+	/* Silence stays silent */
+
+	dst = round_trip(src, numSamples);
+	for (unsigned int i = 0; i < numSamples; i++) {
+		if (dst[VAG_CODEC_BLOCK_SAMPLES + i] != 0) {
+			HOST_TEST_CHECK_EQ(dst[VAG_CODEC_BLOCK_SAMPLES + i], 0);
+			break;
+		}
+	}
+	free(dst);
+
+	/* Partial last blocks are padded with silence, the jump to it costs some quality */
+
+	for (unsigned int i = 0; i < numSamples; i++)
+		src[i] = (int16_t)lrint(16000.0 * sin(2.0 * M_PI * 440.0 * i / TEST_SAMPLING_RATE));
+
+	for (unsigned int i = 0; i < sizeof(shortLengths) / sizeof(shortLengths[0]); i++) {
+		snr = round_trip_snr(src + 1000, shortLengths[i]);
+		HOST_TEST_CHECK(snr >= 18.0);
+	}
+
+	/* Tonal material, brown noise and full scale white noise, which clips the residual range */
+
+	snr = round_trip_snr(src, numSamples);
+	printf("sine 440 Hz: %.1f dB\n", snr);
+	HOST_TEST_CHECK(snr >= 50.0);
+
+	for (unsigned int i = 0; i < numSamples; i++) {
+		src[i] = (int16_t)lrint(8000.0 * sin(2.0 * M_PI * 440.0 * i / TEST_SAMPLING_RATE) +
+			6000.0 * sin(2.0 * M_PI * 3100.0 * i / TEST_SAMPLING_RATE) + 3000.0 * sin(2.0 * M_PI * 9000.0 * i / TEST_SAMPLING_RATE));
+	}
+	snr = round_trip_snr(src, numSamples);
+	printf("three tones: %.1f dB\n", snr);
+	HOST_TEST_CHECK(snr >= 25.0);
+
+	for (unsigned int i = 0; i < numSamples; i++) {
+		accumulator = 0.97 * accumulator + (int)(host_test_rand(&random) % 2001) - 1000;
+		src[i] = (int16_t)lrint(accumulator * 0.8);
+	}
+	snr = round_trip_snr(src, numSamples);
+	printf("brown noise: %.1f dB\n", snr);
+	HOST_TEST_CHECK(snr >= 30.0);
+
+	for (unsigned int i = 0; i < numSamples; i++)
+		src[i] = (int16_t)host_test_rand(&random);
+	snr = round_trip_snr(src, numSamples);
+	printf("white noise: %.1f dB\n", snr);
+	HOST_TEST_CHECK(snr >= 20.0);
+
+	free(src);
+
+	return host_test_result("test_vag_codec");
+}
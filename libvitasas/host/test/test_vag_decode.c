@@ -0,0 +1,155 @@
+#include <math.h>
+
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "vag_codec.h"
+#include "host_test.h"
+
+/*
+ * vitaSAS_get_VAG_info() and vitaSAS_decode_VAG_to_PCM() against a straightforward decoder, including
+ * shifts above 12, loop flags and rejected data, and the quality of an encode and decode round trip.
+ */
+
+#define TEST_SAMPLING_RATE	48000
+#define TEST_NUM_SAMPLES	48000
+
+static const int32_t s_filters[VAG_CODEC_NUM_FILTERS][2] = {
+	{ 0, 0 }, { 60, 0 }, { 115, -52 }, { 98, -55 }, { 122, -60 }
+};
+
+static unsigned int reference_decode(int16_t* dst, const uint8_t* vag, unsigned int size)
+{
+	int32_t s1 = 0, s2 = 0, sample;
+	unsigned int numSamples = 0, shift, filter, nibble;
+
+	for (unsigned int offset = VAG_CODEC_HEADER_SIZE; offset < size; offset += VAG_CODEC_BLOCK_SIZE) {
+		shift = vag[offset] & 0xF;
+		filter = vag[offset] >> 4;
+		if (shift > 12)
+			shift = 9;
+
+		for (unsigned int i = 0; i < VAG_CODEC_BLOCK_SAMPLES; i++) {
+			nibble = (vag[offset + 2 + i / 2] >> ((i & 1) * 4)) & 0xF;
+			sample = ((int16_t)(nibble << 12) >> shift) + ((s1 * s_filters[filter][0] + s2 * s_filters[filter][1] + 32) >> 6);
+			if (sample > 32767)
+				sample = 32767;
+			else if (sample < -32768)
+				sample = -32768;
+			s2 = s1;
+			s1 = sample;
+			dst[numSamples++] = (int16_t)sample;
+		}
+
+		if (vag[offset + 1] & VAG_CODEC_FLAG_LOOP_END)
+			break;
+	}
+
+	return numSamples;
+}
+
+int main(void)
+{
+	unsigned int size = vag_codec_get_encoded_size(TEST_NUM_SAMPLES);
+	int16_t* src = malloc(TEST_NUM_SAMPLES * sizeof(int16_t));
+	int16_t* expected = malloc(size / VAG_CODEC_BLOCK_SIZE * VAG_CODEC_BLOCK_SAMPLES * sizeof(int16_t));
+	uint8_t* vag = malloc(size);
+	unsigned int numExpected;
+	vitaSASVAGInfo info;
+	vitaSASAudio* audio;
+	vitaSASAudio* pcm;
+	uint32_t random = 1;
+	double signal = 0.0, noise = 0.0, snr;
+
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+
+	/* Round trip of a 1 kHz sine, the decoded sample follows the lead-in block */
+
+	for (unsigned int i = 0; i < TEST_NUM_SAMPLES; i++)
+		src[i] = (int16_t)lrint(16000.0 * sin(2.0 * M_PI * 1000.0 * i / TEST_SAMPLING_RATE));
+
+	vag_codec_encode(vag, src, TEST_NUM_SAMPLES, TEST_SAMPLING_RATE);
+	audio = vitaSAS_load_audio_custom(vag, size);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_get_VAG_info(audio, &info), SCE_OK);
+	HOST_TEST_CHECK_EQ(info.samplingRate, TEST_SAMPLING_RATE);
+	HOST_TEST_CHECK_EQ(info.dataSize, size - VAG_CODEC_HEADER_SIZE);
+	HOST_TEST_CHECK_EQ(info.numSamples, (size - VAG_CODEC_HEADER_SIZE) / VAG_CODEC_BLOCK_SIZE * VAG_CODEC_BLOCK_SAMPLES);
+	HOST_TEST_CHECK_EQ(info.loopStart, -1);
+	HOST_TEST_CHECK_EQ(info.loopEnd, -1);
+
+	pcm = vitaSAS_decode_VAG_to_PCM(audio);
+	HOST_TEST_CHECK(pcm != NULL);
+	if (pcm != NULL) {
+		HOST_TEST_CHECK_EQ(pcm->data_size, info.numSamples * sizeof(int16_t));
+
+		for (unsigned int i = 0; i < TEST_NUM_SAMPLES; i++) {
+			int32_t error = src[i] - ((int16_t*)pcm->datap)[VAG_CODEC_BLOCK_SAMPLES + i];
+
+			signal += (double)src[i] * src[i];
+			noise += (double)error * error;
+		}
+
+		snr = 10.0 * log10(signal / (noise + 1e-9));
+		printf("sine 1 kHz round trip: %.1f dB\n", snr);
+		HOST_TEST_CHECK(snr >= 50.0);
+
+		vitaSAS_free_audio(pcm);
+	}
+
+	/* Every shift decodes like the reference, shifts above 12 like 9 */
+
+	for (unsigned int i = 0; i < TEST_NUM_SAMPLES; i++)
+		src[i] = (int16_t)(host_test_rand(&random) % 60001 - 30000);
+
+	vag_codec_encode(vag, src, TEST_NUM_SAMPLES, TEST_SAMPLING_RATE);
+	for (unsigned int offset = VAG_CODEC_HEADER_SIZE + VAG_CODEC_BLOCK_SIZE; offset < size; offset += VAG_CODEC_BLOCK_SIZE)
+		vag[offset] = (uint8_t)((vag[offset] & 0xF0) | (host_test_rand(&random) % 16));
+
+	numExpected = reference_decode(expected, vag, size);
+	pcm = vitaSAS_decode_VAG_to_PCM(audio);
+	HOST_TEST_CHECK(pcm != NULL);
+	if (pcm != NULL) {
+		HOST_TEST_CHECK_EQ(pcm->data_size, numExpected * sizeof(int16_t));
+		HOST_TEST_CHECK(memcmp(pcm->datap, expected, numExpected * sizeof(int16_t)) == 0);
+		vitaSAS_free_audio(pcm);
+	}
+
+	/* Loop start on block 3, loop end with repeat on block 10 ends the data */
+
+	vag[VAG_CODEC_HEADER_SIZE + VAG_CODEC_BLOCK_SIZE * 3 + 1] = VAG_CODEC_FLAG_LOOP_START;
+	vag[VAG_CODEC_HEADER_SIZE + VAG_CODEC_BLOCK_SIZE * 10 + 1] = VAG_CODEC_FLAG_LOOP_END | VAG_CODEC_FLAG_LOOP_REPEAT;
+
+	HOST_TEST_CHECK_EQ(vitaSAS_get_VAG_info(audio, &info), SCE_OK);
+	HOST_TEST_CHECK_EQ(info.numSamples, 11 * VAG_CODEC_BLOCK_SAMPLES);
+	HOST_TEST_CHECK_EQ(info.loopStart, 3 * VAG_CODEC_BLOCK_SAMPLES);
+	HOST_TEST_CHECK_EQ(info.loopEnd, 11 * VAG_CODEC_BLOCK_SAMPLES);
+
+	numExpected = reference_decode(expected, vag, size);
+	pcm = vitaSAS_decode_VAG_to_PCM(audio);
+	HOST_TEST_CHECK(pcm != NULL);
+	if (pcm != NULL) {
+		HOST_TEST_CHECK_EQ(pcm->data_size, numExpected * sizeof(int16_t));
+		HOST_TEST_CHECK(memcmp(pcm->datap, expected, numExpected * sizeof(int16_t)) == 0);
+		vitaSAS_free_audio(pcm);
+	}
+
+	/* Extended HE-ADPCM filters and a wrong magic are rejected */
+
+	vag[VAG_CODEC_HEADER_SIZE + VAG_CODEC_BLOCK_SIZE * 5] = 0x52;
+	HOST_TEST_CHECK(vitaSAS_decode_VAG_to_PCM(audio) == NULL);
+
+	memcpy(vag, "XXXX", 4);
+	HOST_TEST_CHECK(vitaSAS_get_VAG_info(audio, &info) < 0);
+	HOST_TEST_CHECK(vitaSAS_decode_VAG_to_PCM(audio) == NULL);
+
+	vitaSAS_free_audio(audio);
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_pool_usage(), 0);
+	vitaSAS_finish();
+
+	free(vag);
+	free(expected);
+	free(src);
+
+	return host_test_result("test_vag_decode");
+}
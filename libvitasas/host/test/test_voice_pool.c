@@ -0,0 +1,130 @@
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "host_test.h"
+
+/* Voice pool allocation, release and reclamation of mono voices and stereo pairs */
+
+#define TEST_NUM_VOICES		8
+#define TEST_NUM_FRAMES		2400
+
+static int16_t s_pcm[TEST_NUM_FRAMES * 2];
+static int16_t s_out[256 * 2];
+
+static void render(vitaSASSystem* system, unsigned int numGrains)
+{
+	for (unsigned int i = 0; i < numGrains; i++)
+		vitaSAS_system_render_grains(system, s_out, 1);
+}
+
+int main(void)
+{
+	vitaSASVoiceParam voiceParam;
+	vitaSASAudio* mono;
+	vitaSASAudio* stereo;
+	vitaSASSystem* system;
+	int voices[TEST_NUM_VOICES];
+	int voiceID;
+
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+
+	system = host_test_create_system("numVoices=8", 64);
+	HOST_TEST_CHECK(system != NULL);
+	if (system == NULL)
+		return host_test_result("test_voice_pool");
+
+	for (int i = 0; i < TEST_NUM_FRAMES * 2; i++)
+		s_pcm[i] = (int16_t)((i % 64) * 500 - 16000);
+
+	mono = vitaSAS_load_audio_custom(s_pcm, TEST_NUM_FRAMES * sizeof(int16_t));
+	stereo = vitaSAS_load_audio_custom(s_pcm, sizeof(s_pcm));
+	stereo->numChannels = 2;
+
+	host_test_voice_param(&voiceParam);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES);
+
+	/* Every voice can be handed out once */
+
+	for (int i = 0; i < TEST_NUM_VOICES; i++) {
+		voices[i] = vitaSAS_system_alloc_voice_PCM(system, mono, &voiceParam, NULL, NULL);
+		HOST_TEST_CHECK_EQ(voices[i], i);
+	}
+
+	HOST_TEST_CHECK_EQ(vitaSAS_system_alloc_voice_PCM(system, mono, &voiceParam, NULL, NULL), VITASAS_ERROR_NO_FREE_VOICE);
+	render(system, 1);
+
+	for (int i = 0; i < TEST_NUM_VOICES; i++)
+		HOST_TEST_CHECK_EQ(vitaSAS_system_release_voice(system, voices[i]), SCE_OK);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES);
+
+	/* Stereo pair released before its commands were applied returns both voices */
+
+	voiceID = vitaSAS_system_alloc_voice_PCM(system, stereo, &voiceParam, NULL, NULL);
+	HOST_TEST_CHECK(voiceID >= 0);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES - 2);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_release_voice(system, voiceID), SCE_OK);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES);
+	render(system, 1);
+
+	/* Mono voice that takes over the left voice must not free the right one */
+
+	voiceID = vitaSAS_system_alloc_voice_PCM(system, mono, &voiceParam, NULL, NULL);
+	voices[0] = vitaSAS_system_alloc_voice_PCM(system, mono, &voiceParam, NULL, NULL);
+	HOST_TEST_CHECK_EQ(voices[0], voiceID + 1);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_release_voice(system, voiceID), SCE_OK);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES - 1);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_release_voice(system, voices[0]), SCE_OK);
+	render(system, 1);
+
+	/* Linked stereo pair released after rendering returns both voices and is unlinked */
+
+	voiceID = vitaSAS_system_alloc_voice_PCM(system, stereo, &voiceParam, NULL, NULL);
+	render(system, 1);
+	HOST_TEST_CHECK(vitaSAS_internal_voice_pool_is_linked(&system->voicePool, voiceID));
+	HOST_TEST_CHECK_EQ(vitaSAS_system_release_voice(system, voiceID), SCE_OK);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES);
+	HOST_TEST_CHECK(!vitaSAS_internal_voice_pool_is_linked(&system->voicePool, voiceID));
+
+	/* Finished stereo pair is reclaimed as a whole and unlinked */
+
+	voiceID = vitaSAS_system_alloc_voice_PCM(system, stereo, &voiceParam, NULL, NULL);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_set_key_on(system, voiceID), SCE_OK);
+	render(system, 4);
+	HOST_TEST_CHECK(vitaSAS_internal_voice_pool_is_linked(&system->voicePool, voiceID));
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES - 2);
+
+	render(system, TEST_NUM_FRAMES / 256 + 4);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES);
+	HOST_TEST_CHECK(!vitaSAS_internal_voice_pool_is_linked(&system->voicePool, voiceID));
+
+	/* Keyed on voice can't be released while pending, armed or active, and is reclaimed once it ends */
+
+	voiceID = vitaSAS_system_alloc_voice_PCM(system, mono, &voiceParam, NULL, NULL);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_set_key_on(system, voiceID), SCE_OK);
+	render(system, 1);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_release_voice(system, voiceID), VITASAS_ERROR_VOICE_IN_USE);
+	render(system, 1);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_release_voice(system, voiceID), VITASAS_ERROR_VOICE_IN_USE);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES - 1);
+
+	render(system, TEST_NUM_FRAMES / 256 + 4);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), TEST_NUM_VOICES);
+	HOST_TEST_CHECK(vitaSAS_system_release_voice(system, voiceID) < 0);
+
+	/* Pairs never straddle a word, so every pair can be reallocated */
+
+	for (int i = 0; i < TEST_NUM_VOICES / 2; i++)
+		HOST_TEST_CHECK(vitaSAS_system_alloc_voice_PCM(system, stereo, &voiceParam, NULL, NULL) >= 0);
+	HOST_TEST_CHECK_EQ(vitaSAS_system_get_free_voice_count(system), 0);
+
+	vitaSAS_system_destroy(system);
+
+	stereo->numChannels = 1;
+	vitaSAS_free_audio(stereo);
+	vitaSAS_free_audio(mono);
+	vitaSAS_finish();
+
+	return host_test_result("test_voice_pool");
+}
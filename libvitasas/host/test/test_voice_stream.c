@@ -0,0 +1,177 @@
+#include <pthread.h>
+
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "host_test.h"
+
+/*
+ * Streams are opened and closed from the main thread while another thread renders and the loader
+ * refills rings and frees released streams. Streams are closed before key on, while playing and
+ * after their voice has ended, so close races with the render thread releasing the stream and the
+ * loader freeing it. Every ring must be freed exactly once.
+ */
+
+#define TEST_NUM_VOICES		8
+#define TEST_NUM_STREAMS	400
+#define TEST_NUM_SAMPLES	12000
+
+static vitaSASSystem* s_system;
+static volatile int s_isRendering = 1;
+
+static void* render_thread(void* arg)
+{
+	static int16_t out[256 * 2];
+
+	(void)arg;
+
+	while (s_isRendering) {
+		vitaSAS_system_render_grains(s_system, out, 1);
+		usleep(20);
+	}
+
+	return NULL;
+}
+
+/* Looping stream never ends on its own, close must not lose its key off to a full command queue */
+
+static void check_close_queue_full(char* path, const vitaSASVoiceParam* voiceParam)
+{
+	static int16_t out[256 * 2];
+	vitaSASStreamParam streamParam;
+	vitaSASCommand command;
+	vitaSASStream* stream;
+
+	streamParam.format = VITASAS_STREAM_FORMAT_PCM;
+	streamParam.loop = 1;
+	streamParam.blockSize = 2048;
+	streamParam.numBlocks = 4;
+
+	stream = vitaSAS_system_open_stream(s_system, 0, path, 0, &streamParam, voiceParam);
+	HOST_TEST_CHECK(stream != NULL);
+	if (stream == NULL)
+		return;
+
+	vitaSAS_system_set_key_on(s_system, 0);
+	for (int i = 0; i < 10; i++)
+		vitaSAS_system_render_grains(s_system, out, 1);
+
+	command.type = VITASAS_COMMAND_SET_PITCH;
+	command.voiceID = 0;
+	command.ptr = NULL;
+	command.arg[0] = 4096;
+	while (vitaSAS_internal_command_queue_push(&s_system->commandQueue, &command) == SCE_OK);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_close_stream(stream), VITASAS_ERROR_COMMAND_QUEUE_FULL);
+
+	vitaSAS_system_render_grains(s_system, out, 1);
+	HOST_TEST_CHECK_EQ(vitaSAS_close_stream(stream), SCE_OK);
+
+	for (int i = 0; i < 200 && vitaSAS_get_sample_pool_usage() != 0; i++) {
+		vitaSAS_system_render_grains(s_system, out, 1);
+		usleep(10000);
+	}
+
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_pool_usage(), 0);
+}
+
+int main(void)
+{
+	static int16_t pcm[TEST_NUM_SAMPLES];
+	vitaSASStream* streams[TEST_NUM_VOICES] = {NULL};
+	vitaSASStreamParam streamParam;
+	vitaSASVoiceParam voiceParam;
+	pthread_t renderer;
+	uint32_t random = 1;
+	char dir[256], path[300];
+	unsigned int voiceID;
+
+	for (int i = 0; i < TEST_NUM_SAMPLES; i++)
+		pcm[i] = (int16_t)((i % 100) * 300 - 15000);
+
+	if (host_test_make_dir(dir, sizeof(dir)) < 0)
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/stream.pcm", dir);
+	HOST_TEST_CHECK_EQ(host_test_write_file(path, pcm, sizeof(pcm)), 0);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_init(0), SCE_OK);
+	HOST_TEST_CHECK_EQ(vitaSAS_start_loader(64, 0x4000, 0), SCE_OK);
+
+	s_system = host_test_create_system("numVoices=8", 256);
+	HOST_TEST_CHECK(s_system != NULL);
+	if (s_system == NULL)
+		return host_test_result("test_voice_stream");
+
+	host_test_voice_param(&voiceParam);
+	voiceParam.adsr2 = 0x20 | 8;
+
+	streamParam.format = VITASAS_STREAM_FORMAT_PCM;
+	streamParam.loop = 0;
+	streamParam.blockSize = 2048;
+	streamParam.numBlocks = 4;
+
+	pthread_create(&renderer, NULL, render_thread, NULL);
+
+	for (int i = 0; i < TEST_NUM_STREAMS; i++) {
+		voiceID = i % TEST_NUM_VOICES;
+
+		if (streams[voiceID] != NULL)
+			vitaSAS_close_stream(streams[voiceID]);
+
+		streams[voiceID] = vitaSAS_system_open_stream(s_system, voiceID, path, 0, &streamParam, &voiceParam);
+		HOST_TEST_CHECK(streams[voiceID] != NULL);
+		if (streams[voiceID] == NULL)
+			continue;
+
+		switch (host_test_rand(&random) % 3) {
+		case 0:
+
+			/* Closed before key on */
+
+			vitaSAS_close_stream(streams[voiceID]);
+			streams[voiceID] = NULL;
+			break;
+		case 1:
+
+			/* Closed while playing or around its end */
+
+			vitaSAS_system_set_key_on(s_system, voiceID);
+			usleep(host_test_rand(&random) % 3000);
+			vitaSAS_close_stream(streams[voiceID]);
+			streams[voiceID] = NULL;
+			break;
+		default:
+
+			/* Left playing, closed when the voice is reused */
+
+			vitaSAS_system_set_key_on(s_system, voiceID);
+			break;
+		}
+	}
+
+	for (int i = 0; i < TEST_NUM_VOICES; i++) {
+		if (streams[i] != NULL)
+			vitaSAS_close_stream(streams[i]);
+	}
+
+	/* Voices end, the render thread releases the streams and the loader frees them */
+
+	for (int i = 0; i < 200 && vitaSAS_get_sample_pool_usage() != 0; i++)
+		usleep(10000);
+
+	HOST_TEST_CHECK_EQ(vitaSAS_get_sample_pool_usage(), 0);
+
+	s_isRendering = 0;
+	pthread_join(renderer, NULL);
+
+	check_close_queue_full(path, &voiceParam);
+
+	vitaSAS_system_destroy(s_system);
+	vitaSAS_stop_loader();
+	vitaSAS_finish();
+
+	host_test_remove_dir(dir);
+
+	return host_test_result("test_voice_stream");
+}
@@ -0,0 +1,81 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <scebase.h>
+
+#if defined(__SNC__)
+#include <sce_atomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Full memory barrier */
+
+#if defined(__SNC__)
+#define ATOMIC_BARRIER()	__builtin_dmb()
+#else
+#define ATOMIC_BARRIER()	__sync_synchronize()
+#endif
+
+/* All read-modify-write operations return the value before the operation */
+
+static __inline__ int32_t atomic_cas32(volatile int32_t *ptr, int32_t oldValue, int32_t newValue)
+{
+#if defined(__SNC__)
+	return sceAtomicCompareAndSwap32(ptr, oldValue, newValue);
+#else
+	return __sync_val_compare_and_swap(ptr, oldValue, newValue);
+#endif
+}
+
+static __inline__ int32_t atomic_add32(volatile int32_t *ptr, int32_t value)
+{
+#if defined(__SNC__)
+	return sceAtomicAdd32(ptr, value);
+#else
+	return __sync_fetch_and_add(ptr, value);
+#endif
+}
+
+static __inline__ int32_t atomic_or32(volatile int32_t *ptr, int32_t value)
+{
+#if defined(__SNC__)
+	return sceAtomicOr32(ptr, value);
+#else
+	return __sync_fetch_and_or(ptr, value);
+#endif
+}
+
+static __inline__ int32_t atomic_and32(volatile int32_t *ptr, int32_t value)
+{
+#if defined(__SNC__)
+	return sceAtomicAnd32(ptr, value);
+#else
+	return __sync_fetch_and_and(ptr, value);
+#endif
+}
+
+/* Load with acquire semantics */
+
+static __inline__ int32_t atomic_load32(const volatile int32_t *ptr)
+{
+	int32_t value = *ptr;
+	ATOMIC_BARRIER();
+	return value;
+}
+
+/* Store with release semantics */
+
+static __inline__ void atomic_store32(volatile int32_t *ptr, int32_t value)
+{
+	ATOMIC_BARRIER();
+	*ptr = value;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -55,6 +55,7 @@ void *heap_alloc_heap_memory_with_option(void *heap, unsigned int nbytes, const
 int   heap_free_heap_memory(void *heap, void *ptr);
 void *heap_realloc_heap_memory(void *heap, void *ptr, unsigned int nbytes);
 void *heap_free_heap_memory_with_option(void *heap, void *ptr, unsigned int nbytes, const heap_alloc_opt_param *optParam);
+int   _heap_query_block_info(void *heap, void *ptr, unsigned int *puiSize, int *piBlockIndex, heap_mspace_link **msplink);
 
 #define HEAP_OFFSET_TO_VALID_HEAP	768
 #define HEAP_MSPACE_LINK_OVERHEAD	720
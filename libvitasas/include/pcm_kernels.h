@@ -0,0 +1,102 @@
+#ifndef PCM_KERNELS_H
+#define PCM_KERNELS_H
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every kernel has a scalar reference implementation, which also handles whatever a vector loop leaves over.
+ * The vector loops are NEON on ARM and SSE2 on x86, selected at compile time. Define PCM_KERNELS_SCALAR to
+ * build the reference only. All variants produce bit identical results.
+ */
+
+#if !defined(PCM_KERNELS_SCALAR)
+#if defined(__ARM_NEON__)
+#define PCM_KERNELS_NEON
+#elif defined(__SSE2__)
+#define PCM_KERNELS_SSE2
+#endif
+#endif
+
+/* Gains use SAS volume scale: SCE_SAS_VOLUME_MAX (4096) is unity */
+
+#define PCM_KERNELS_GAIN_SHIFT	12
+#define PCM_KERNELS_GAIN_MAX	0x7FFF
+
+/* dst = src * gain, interleaved S16 stereo, saturated */
+void pcm_kernels_scale_s16_stereo(int16_t* dst, const int16_t* src, unsigned int numFrames, uint32_t volL, uint32_t volR);
+
+/* dst = dst + src * gain, interleaved S16 stereo, saturated */
+void pcm_kernels_mix_s16_stereo(int16_t* dst, const int16_t* src, unsigned int numFrames, uint32_t volL, uint32_t volR);
+
+/* dstL, dstR = src, interleaved S16 stereo into planar channels */
+void pcm_kernels_deinterleave_s16_stereo(int16_t* dstL, int16_t* dstR, const int16_t* src, unsigned int numFrames);
+
+/* dst = srcL, srcR, planar channels into interleaved S16 stereo */
+void pcm_kernels_interleave_s16_stereo(int16_t* dst, const int16_t* srcL, const int16_t* srcR, unsigned int numFrames);
+
+/* dst = dst + src, saturated */
+void pcm_kernels_add_s16(int16_t* dst, const int16_t* src, unsigned int numSamples);
+
+/* dst = src * gain, interleaved S16 stereo, saturated, gain of frame i is start + (end - start) * i / numFrames */
+void pcm_kernels_ramp_s16_stereo(int16_t* dst, const int16_t* src, unsigned int numFrames, uint32_t startL, uint32_t startR, uint32_t endL, uint32_t endR);
+
+/* dst = src in both channels, mono S16 into interleaved stereo */
+void pcm_kernels_mono_to_stereo_s16(int16_t* dst, const int16_t* src, unsigned int numFrames);
+
+/* dst = (left + right) >> 1, interleaved S16 stereo into mono */
+void pcm_kernels_stereo_to_mono_s16(int16_t* dst, const int16_t* src, unsigned int numFrames);
+
+/*
+ * Sample format conversion to S16, sample order is kept. Reduction from more than 16 bits rounds to nearest,
+ * or adds TPDF dither of +-1 LSB when a dither state is passed. dst must not overlap src.
+ */
+
+typedef struct pcm_kernels_dither {
+	uint32_t state[4];
+} pcm_kernels_dither;
+
+void pcm_kernels_dither_init(pcm_kernels_dither* dither, uint32_t seed);
+
+/* dst = (src - 128) << 8, unsigned 8-bit */
+void pcm_kernels_convert_u8_s16(int16_t* dst, const uint8_t* src, unsigned int numSamples);
+
+/* dst = src >> 8, packed little endian signed 24-bit */
+void pcm_kernels_convert_s24_s16(int16_t* dst, const uint8_t* src, unsigned int numSamples, pcm_kernels_dither* dither);
+
+/* dst = src >> 16 */
+void pcm_kernels_convert_s32_s16(int16_t* dst, const int32_t* src, unsigned int numSamples, pcm_kernels_dither* dither);
+
+/* dst = src * 32768, clipped to [-1, 1] */
+void pcm_kernels_convert_f32_s16(int16_t* dst, const float* src, unsigned int numSamples, pcm_kernels_dither* dither);
+
+/* dst = src / 32768 */
+void pcm_kernels_convert_s16_f32(float* dst, const int16_t* src, unsigned int numSamples);
+
+/* Signal level of S16 data, peak of -32768 is 32768 and rms is rounded down */
+
+typedef struct pcm_kernels_level {
+	uint32_t peak;
+	uint32_t rms;
+	uint64_t sumSquares;
+} pcm_kernels_level;
+
+void pcm_kernels_measure_s16(const int16_t* src, unsigned int numSamples, pcm_kernels_level* level);
+
+/* acc = acc + src * gain, mono S16 source into interleaved S32 stereo accumulator */
+void pcm_kernels_accumulate_mono_s16(int32_t* acc, const int16_t* src, unsigned int numFrames, int32_t volL, int32_t volR);
+
+/* dst = acc, saturated */
+void pcm_kernels_pack_s32_s16(int16_t* dst, const int32_t* acc, unsigned int numSamples);
+
+/* dst = acc + dst * gain, interleaved stereo, saturated */
+void pcm_kernels_pack_mix_s32_s16_stereo(int16_t* dst, const int32_t* acc, unsigned int numFrames, int32_t volL, int32_t volR);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
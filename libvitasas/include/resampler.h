@@ -0,0 +1,46 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Polyphase windowed-sinc sample rate converter for whole S16 mono buffers. The ratio is reduced to
+ * inRate / outRate, and every output position then falls on one of outRate filter phases. Conversions that
+ * would need more than RESAMPLER_PHASES_MAX phases use the nearest of RESAMPLER_PHASES_MAX phases.
+ * Coefficients are Q14, taps per phase grow with the decimation factor to keep the transition band width.
+ */
+
+#define RESAMPLER_PHASES_MAX	1024
+#define RESAMPLER_TAPS_MIN		32
+#define RESAMPLER_TAPS_MAX		128
+#define RESAMPLER_COEF_SHIFT	14
+
+typedef struct resampler {
+	uint32_t inRate;
+	uint32_t outRate;
+	uint32_t numPhases;
+	uint32_t numTaps;
+	const int16_t* coefs;
+} resampler;
+
+/* Size of the coefficient table for a conversion in bytes */
+unsigned int resampler_get_table_size(uint32_t inRate, uint32_t outRate);
+
+/* Fill table and set up rs, table must stay valid while rs is used */
+void resampler_init(resampler* rs, uint32_t inRate, uint32_t outRate, int16_t* table);
+
+/* Number of output samples for numInput input samples */
+unsigned int resampler_get_num_output(const resampler* rs, unsigned int numInput);
+
+/* dst = src converted, samples outside of src are treated as silence */
+void resampler_process(const resampler* rs, int16_t* dst, unsigned int numOutput, const int16_t* src, unsigned int numInput);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
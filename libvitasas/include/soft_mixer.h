@@ -0,0 +1,83 @@
+#ifndef SOFT_MIXER_H
+#define SOFT_MIXER_H
+
+#include <kernel.h>
+
+#include "vitaSAS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SOFT_MIXER_VOICE_NONE		0
+#define SOFT_MIXER_VOICE_PCM		1
+#define SOFT_MIXER_VOICE_NOISE		2
+
+/* Envelope curves, same numbering as SAS ADSR modes */
+
+#define SOFT_MIXER_CURVE_LINEAR_INC		0
+#define SOFT_MIXER_CURVE_LINEAR_DEC		1
+#define SOFT_MIXER_CURVE_LINEAR_BENT	2
+#define SOFT_MIXER_CURVE_EXPONENT_DEC	3
+#define SOFT_MIXER_CURVE_EXPONENT_INC	4
+#define SOFT_MIXER_CURVE_DIRECT			5
+
+#define SOFT_MIXER_PHASE_ATTACK		0
+#define SOFT_MIXER_PHASE_DECAY		1
+#define SOFT_MIXER_PHASE_SUSTAIN	2
+#define SOFT_MIXER_PHASE_RELEASE	3
+#define SOFT_MIXER_PHASE_OFF		4
+
+#define SOFT_MIXER_ENVELOPE_MAX		0x40000000
+
+#define SOFT_MIXER_ADSR_ATTACK_VALID	0x1
+#define SOFT_MIXER_ADSR_DECAY_VALID		0x2
+#define SOFT_MIXER_ADSR_SUSTAIN_VALID	0x4
+#define SOFT_MIXER_ADSR_RELEASE_VALID	0x8
+
+typedef struct SoftMixerEnvelope {
+	int32_t height;
+	uint32_t phase;
+	uint32_t rate[4];
+	uint32_t curve[4];
+	int32_t sustainLevel;
+} SoftMixerEnvelope;
+
+typedef struct SoftMixerVoice {
+	uint32_t type;
+	const int16_t* data;
+	uint32_t numSamples;
+	int32_t loopPos;
+	uint32_t position;
+	uint32_t fraction;
+	uint32_t pitch;
+	int32_t volLDry;
+	int32_t volRDry;
+	int32_t volLWet;
+	int32_t volRWet;
+	uint32_t noiseClock;
+	uint32_t noiseCounter;
+	uint32_t noiseLFSR;
+	uint32_t isPlaying;
+	SoftMixerEnvelope envelope;
+} SoftMixerVoice;
+
+typedef struct vitaSASSoftMixer {
+	SceKernelLwMutexWork mutex;
+	uint32_t numVoices;
+	SoftMixerVoice* voices;
+	int32_t* accumulator;
+	int16_t* voiceBuffer;
+} vitaSASSoftMixer;
+
+vitaSASSoftMixer* vitaSAS_internal_soft_mixer_create(unsigned int numVoices);
+void vitaSAS_internal_soft_mixer_destroy(vitaSASSoftMixer* mixer);
+int vitaSAS_internal_soft_mixer_apply(vitaSASSoftMixer* mixer, const vitaSASCommand* command);
+int vitaSAS_internal_soft_mixer_get_end_state(vitaSASSoftMixer* mixer, unsigned int voiceID);
+void vitaSAS_internal_soft_mixer_render(vitaSASSoftMixer* mixer, int16_t* buffer, unsigned int numGrain, int32_t mixVolL, int32_t mixVolR);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
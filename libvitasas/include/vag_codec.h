@@ -0,0 +1,62 @@
+#ifndef VAG_CODEC_H
+#define VAG_CODEC_H
+
+#include <scebase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * VAG (PS-ADPCM) encoding and decoding. A VAG file is a 48-byte big endian header followed by 16-byte blocks
+ * of 28 samples: a shift/filter byte, a flags byte and 14 bytes of 4-bit residuals. The codec uses the five
+ * classic prediction filters, which are the first five filters of HE-ADPCM, so encoder output plays on SAS
+ * VAG voices as is. Data using the extended HE-ADPCM filters is rejected by the decoder.
+ */
+
+#define VAG_CODEC_HEADER_SIZE		48
+#define VAG_CODEC_BLOCK_SIZE		16
+#define VAG_CODEC_BLOCK_SAMPLES		28
+#define VAG_CODEC_NUM_FILTERS		5
+
+#define VAG_CODEC_MAGIC				0x56414770	/* "VAGp" */
+#define VAG_CODEC_VERSION			0x20
+
+#define VAG_CODEC_FLAG_LOOP_END		0x01
+#define VAG_CODEC_FLAG_LOOP_REPEAT	0x02
+#define VAG_CODEC_FLAG_LOOP_START	0x04
+
+#define VAG_CODEC_ERROR_INVALID		-1
+#define VAG_CODEC_ERROR_FILTER		-2
+
+/* Header fields, then block scan results. Loop positions are sample indices, -1 when the data doesn't loop */
+
+typedef struct vag_codec_info {
+	uint32_t samplingRate;
+	uint32_t dataOffset;
+	uint32_t dataSize;
+	uint32_t numSamples;
+	int32_t loopStart;
+	int32_t loopEnd;
+} vag_codec_info;
+
+/* Size of the VAG file for numSamples mono samples, header included */
+unsigned int vag_codec_get_encoded_size(unsigned int numSamples);
+
+/* Encode mono S16 into a complete VAG file, returns its size */
+unsigned int vag_codec_encode(uint8_t* dst, const int16_t* src, unsigned int numSamples, uint32_t samplingRate);
+
+/* Fill samplingRate, dataOffset and dataSize from the header of a VAG file of size bytes, dataSize is clipped to the file */
+int vag_codec_parse_header(const uint8_t* data, unsigned int size, vag_codec_info* info);
+
+/* Fill numSamples and loop positions from block flags, the data ends with the first block flagged as loop end */
+void vag_codec_scan_blocks(const uint8_t* data, vag_codec_info* info);
+
+/* dst = info->numSamples decoded samples, returns numSamples or VAG_CODEC_ERROR_FILTER */
+int vag_codec_decode(int16_t* dst, const uint8_t* data, const vag_codec_info* info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
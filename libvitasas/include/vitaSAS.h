@@ -10,7 +10,7 @@
 extern "C" {
 #endif
 
-#define VITASAS_VERSION_INTERNAL 0121
+#define VITASAS_VERSION_INTERNAL 0122
 
 #ifndef VITASAS_VERSION
 #define VITASAS_VERSION VITASAS_VERSION_INTERNAL
@@ -26,47 +26,410 @@ extern "C" {
 
 #define ROUND_UP(x, a)	((((unsigned int)x)+((a)-1u))&(~((a)-1u)))
 #define VITASAS_GRAIN_MAX 2048
+#define VITASAS_GRAIN_ALIGN 64
 #define SCE_SAS_LOOP_DISABLE_PCM -1
 #define VITASAS_NO_SUBSYSTEM -1
 #define VITASAS_USE_MAIN_MEMORY 1
 #define VITASAS_USE_PHYCONT_MEMORY 0
+#define VITASAS_MIXER_SAS 0
+#define VITASAS_MIXER_SOFTWARE 1
 
 #define DEFAULT_HEAP_SIZE 1 * 1024 * 1024;
+#define VITASAS_SAMPLE_POOL_BLOCK_SIZE_DEFAULT (256 * 1024)
+#define VITASAS_SAMPLE_ALIGN 64
 
-/* SAS system limits */
+/* Error codes */
 
-#define MAX_SAS_SYSTEM_NUM			8
+#define VITASAS_ERROR_COMMAND_QUEUE_FULL	-2142175231	/* 0x80510001 */
+#define VITASAS_ERROR_NO_FREE_VOICE			-2142175230	/* 0x80510002 */
+#define VITASAS_ERROR_INVALID_MIX_GRAPH		-2142175229	/* 0x80510003 */
+#define VITASAS_ERROR_NOT_SUPPORTED			-2142175228	/* 0x80510004 */
+#define VITASAS_ERROR_INVALID_BANK			-2142175227	/* 0x80510005 */
+#define VITASAS_ERROR_NO_FREE_FRAME			-2142175226	/* 0x80510006 */
+#define VITASAS_ERROR_VOICE_IN_USE			-2142175225	/* 0x80510007 */
+
+/* SAS system limits. System table grows in chunks up to MAX_SAS_SYSTEM_NUM systems */
+
+#define VITASAS_SYSTEM_TABLE_CHUNK_SIZE		32
+#define VITASAS_SYSTEM_TABLE_CHUNK_MAX		32
+#define MAX_SAS_SYSTEM_NUM			(VITASAS_SYSTEM_TABLE_CHUNK_SIZE * VITASAS_SYSTEM_TABLE_CHUNK_MAX)
 #define CHANNEL_MAX					2
+#define VITASAS_VOICE_NUM_DEFAULT	32
+#define VITASAS_VOICE_POOL_MAX		128
+#define VITASAS_VOICE_POOL_WORDS	(VITASAS_VOICE_POOL_MAX / 32)
 #define BUFFER_MAX					2
+#define VITASAS_OUTPUT_BUFFER_MAX	16
 
 typedef void(*AudioOutRenderHandler)(void* buffer, int SASSystemNum);
 
+/* Render statistics, times are in microseconds. Histogram bucket 0 counts 0, bucket N counts [2^(N-1), 2^N), last bucket is open ended. */
+
+#define VITASAS_RENDER_STATS_BUCKETS	16
+
+typedef struct vitaSASRenderStats {
+	uint32_t numGrains;
+	uint32_t numDeadlineMisses;
+	uint32_t numUnderruns;
+	uint32_t grainTime;
+	uint32_t renderTimeMax;
+	uint32_t waitTimeMax;
+	uint64_t renderTimeTotal;
+	uint64_t waitTimeTotal;
+	uint32_t renderTimeHistogram[VITASAS_RENDER_STATS_BUCKETS];
+	uint32_t waitTimeHistogram[VITASAS_RENDER_STATS_BUCKETS];
+} vitaSASRenderStats;
+
+typedef struct vitaSASRenderStatsWork {
+	volatile int32_t sequence;
+	vitaSASRenderStats stats;
+} vitaSASRenderStatsWork;
+
+/* Output ring slot, grain and render time travel with the audio when rendering ahead */
+
+typedef struct AudioOutSlot {
+	short* buffer;
+	uint32_t numGrain;
+	uint32_t renderTime;
+} AudioOutSlot;
+
 typedef struct AudioOutWork {
 	int systemNum;
 	SceUID updateThreadId;
+	SceUID renderThreadId;
 	SceUID eventFlagId;
+	SceUID freeSemaId;
+	SceUID readySemaId;
 	SceUID portId;
 	volatile uint32_t isAborted;
 	uint32_t numGrain;
 	uint32_t outputSamplingRate;
 	uint32_t outputPort;
+	uint32_t numGrainMin;
+	uint32_t numGrainMax;
+	uint32_t numBuffers;
+	uint32_t renderAhead;
+	volatile int32_t numReady;
+	volatile int32_t requestedGrain;
+	AudioOutSlot* slots;
 	AudioOutRenderHandler renderHandler;
+	vitaSASRenderStatsWork renderStats;
 } AudioOutWork;
 
+/* Owner of sample data, user data is never freed by the library */
+
+#define VITASAS_AUDIO_STORAGE_USER		0
+#define VITASAS_AUDIO_STORAGE_MEMBLOCK	1
+#define VITASAS_AUDIO_STORAGE_POOL		2
+#define VITASAS_AUDIO_STORAGE_CACHE		3
+
+/* Stereo audio holds the left channel followed by the right channel, data_size / 2 bytes each */
+
 typedef struct vitaSASAudio {
 	void* datap;
 	size_t data_size;
 	SceUID data_id;
+	uint32_t storage;
+	uint32_t numChannels;
 } vitaSASAudio;
 
+/* Load-time processing of PCM and WAV samples */
+
+#define VITASAS_LOAD_FLAG_DITHER		0x00000001	/* TPDF dither when reducing 24-bit, 32-bit and float data to 16 bits */
+#define VITASAS_LOAD_FLAG_RESAMPLE		0x00000002	/* Convert to samplingRate so voices can play at unity pitch */
+#define VITASAS_LOAD_FLAG_ENCODE_VAG	0x00000004	/* Encode mono samples to VAG for vitaSAS_set_voice_VAG(), after resampling */
+
+/* Header and block flags of a VAG sample */
+
+typedef struct vitaSASVAGInfo {
+	uint32_t samplingRate;
+	uint32_t dataSize;				/* ADPCM data after the header */
+	uint32_t numSamples;			/* Up to the end block */
+	int32_t loopStart;				/* Sample index, -1 if the sample doesn't loop */
+	int32_t loopEnd;
+} vitaSASVAGInfo;
+
+typedef struct vitaSASLoadParam {
+	uint32_t flags;
+	uint32_t samplingRate;			/* Target rate, normally VitaSASSystemParam samplingRate */
+	uint32_t sourceSamplingRate;	/* Rate of raw PCM files, WAV files carry their own */
+} vitaSASLoadParam;
+
+/*
+ * Sample bank. A bank file starts with vitaSASBankHeader followed by numEntries vitaSASBankEntry records,
+ * a hash table of hashTableSize slots and the sample data at dataOffset. Hash table slots hold entry index + 1
+ * (0 for empty slots) and are probed linearly from the FNV-1a hash of the sample name. Offsets are relative
+ * to the start of the bank and sample data is aligned to VITASAS_BANK_DATA_ALIGN.
+ */
+
+#define VITASAS_BANK_MAGIC			0x4B4E4253	/* "SBNK" */
+#define VITASAS_BANK_VERSION		1
+#define VITASAS_BANK_DATA_ALIGN		64
+#define VITASAS_BANK_FORMAT_VAG		0
+#define VITASAS_BANK_FORMAT_PCM		1
+
+typedef struct vitaSASBankHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numEntries;
+	uint32_t hashTableSize;
+	uint32_t dataOffset;
+	uint32_t size;
+	uint32_t reserved[2];
+} vitaSASBankHeader;
+
+typedef struct vitaSASBankEntry {
+	uint32_t nameHash;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t format;
+	uint32_t samplingRate;
+	uint32_t loop;
+	int32_t loopSize;
+	uint32_t reserved;
+} vitaSASBankEntry;
+
+typedef struct vitaSASBankSource {
+	const char* name;
+	const void* data;
+	uint32_t size;
+	uint32_t format;
+	uint32_t samplingRate;
+	uint32_t loop;
+	int32_t loopSize;
+} vitaSASBankSource;
+
+/* Batch sample loading, neighbouring ranges of one backing file are merged into a single read */
+
+#define VITASAS_BATCH_GAP_MAX		(64 * 1024)
+#define VITASAS_BATCH_READ_MAX		(1024 * 1024)
+
+/* Asynchronous sample loading */
+
+#define VITASAS_LOAD_PATH_MAX		256
+
+#define VITASAS_LOAD_TYPE_VAG		0
+#define VITASAS_LOAD_TYPE_PCM		1
+#define VITASAS_LOAD_TYPE_WAV		2
+
+#define VITASAS_LOAD_STATE_PENDING	0
+#define VITASAS_LOAD_STATE_DONE		1
+#define VITASAS_LOAD_STATE_FAILED	2
+
+struct vitaSASLoadRequest;
+
+typedef void(*vitaSASLoadCallback)(struct vitaSASLoadRequest* request, vitaSASAudio* audio, void* userdata);
+
+typedef struct vitaSASLoadRequest {
+	struct vitaSASLoadRequest* next;
+	volatile int32_t state;
+	uint32_t type;
+	int io_type;
+	SceUID waitSemaId;
+	vitaSASAudio* audio;
+	vitaSASLoadCallback callback;
+	void* userdata;
+	char path[VITASAS_LOAD_PATH_MAX];
+} vitaSASLoadRequest;
+
+typedef struct vitaSASBank {
+	const vitaSASBankHeader* header;
+	const vitaSASBankEntry* entries;
+	const uint32_t* hashTable;
+	vitaSASAudio* audio;
+	SceUID data_id;
+	uint32_t storage;
+} vitaSASBank;
+
+/* Streaming voices */
+
+#define VITASAS_STREAM_FORMAT_VAG			0
+#define VITASAS_STREAM_FORMAT_PCM			1
+
+#define VITASAS_STREAM_BLOCK_SIZE_DEFAULT	(8 * 1024)
+#define VITASAS_STREAM_NUM_BLOCKS_DEFAULT	4
+#define VITASAS_STREAM_BLOCK_ALIGN			16
+
+typedef struct vitaSASStreamParam {
+	uint32_t format;
+	uint32_t loop;
+	uint32_t blockSize;
+	uint32_t numBlocks;
+} vitaSASStreamParam;
+
+typedef struct vitaSASStream {
+	struct vitaSASStream* next;
+	struct vitaSASSystem* system;
+	unsigned int voiceID;
+	uint32_t format;
+	uint32_t loop;
+	int io_type;
+	SceUID file;
+	uint32_t dataOffset;
+	uint32_t dataSize;
+	uint32_t numSamples;
+	uint8_t* ring;
+	SceUID ring_id;
+	uint32_t blockSize;
+	uint32_t numBlocks;
+	uint32_t samplesPerBlock;
+	volatile int32_t isClosed;
+
+	/* Owned by the render thread */
+
+	uint32_t pitch;
+	uint32_t position;
+	uint32_t fraction;
+	uint32_t isPlaying;
+	uint32_t isVoiceSet;
+	volatile int32_t consumedBlocks;
+	volatile int32_t rewindCount;
+	volatile int32_t isEnded;
+	volatile int32_t numUnderruns;
+	volatile int32_t isReleased;
+
+	/* Owned by the loader thread */
+
+	volatile int32_t filledBlocks;
+	int32_t seenRewindCount;
+	uint32_t isKeyedOff;
+} vitaSASStream;
+
+/* Voice command queue */
+
+#define VITASAS_COMMAND_SET_VOICE			0
+#define VITASAS_COMMAND_SET_VOICE_PCM		1
+#define VITASAS_COMMAND_SET_NOISE			2
+#define VITASAS_COMMAND_SET_PITCH			3
+#define VITASAS_COMMAND_SET_VOLUME			4
+#define VITASAS_COMMAND_SET_SIMPLE_ADSR		5
+#define VITASAS_COMMAND_SET_SL				6
+#define VITASAS_COMMAND_SET_ADSR_MODE		7
+#define VITASAS_COMMAND_SET_ADSR			8
+#define VITASAS_COMMAND_SET_KEY_ON			9
+#define VITASAS_COMMAND_SET_KEY_OFF			10
+#define VITASAS_COMMAND_SET_EFFECT			11
+#define VITASAS_COMMAND_SET_EFFECT_TYPE		12
+#define VITASAS_COMMAND_SET_SWITCH_CONFIG	13
+#define VITASAS_COMMAND_LINK_VOICE			14
+#define VITASAS_COMMAND_RELEASE_SAMPLE		15
+
+/* SET_VOICE and SET_VOICE_PCM pass the reference to the cached sample the voice plays in arg[2], 0 for none */
+
+typedef struct vitaSASCommand {
+	volatile int32_t sequence;
+	uint32_t type;
+	uint32_t voiceID;
+	uint32_t arg[5];
+	const void* ptr;
+} vitaSASCommand;
+
+/*
+ * Commands a thread submits inside a frame are staged in the frame, keyed by thread ID, and published
+ * together when the frame is committed. Staging holds as many commands as the queue.
+ */
+
+#define VITASAS_COMMAND_FRAME_MAX	4
+
+typedef struct vitaSASCommandFrame {
+	volatile int32_t threadId;	/* 0 - free */
+	uint32_t depth;
+	uint32_t numCommands;
+	int32_t result;
+	vitaSASCommand* commands;
+} vitaSASCommandFrame;
+
+typedef struct vitaSASCommandQueue {
+	vitaSASCommand* commands;
+	uint32_t mask;
+	volatile int32_t writePos;
+	int32_t readPos;
+	volatile int32_t numFrames;
+	vitaSASCommandFrame frames[VITASAS_COMMAND_FRAME_MAX];
+} vitaSASCommandQueue;
+
+/* Voice pool */
+
+struct vitaSASSystem;
+
+typedef void(*vitaSASVoiceEndCallback)(struct vitaSASSystem* system, unsigned int voiceID, void* userdata);
+
+typedef struct vitaSASVoicePool {
+	uint32_t numVoices;
+	volatile int32_t freeMask[VITASAS_VOICE_POOL_WORDS];
+	volatile int32_t pendingMask[VITASAS_VOICE_POOL_WORDS];
+	volatile int32_t armedMask[VITASAS_VOICE_POOL_WORDS];
+	volatile int32_t activeMask[VITASAS_VOICE_POOL_WORDS];
+	volatile int32_t linkMask[VITASAS_VOICE_POOL_WORDS];
+	volatile int32_t pairMask[VITASAS_VOICE_POOL_WORDS];
+	volatile int32_t sample[VITASAS_VOICE_POOL_MAX];
+	vitaSASVoiceEndCallback callback[VITASAS_VOICE_POOL_MAX];
+	void* userdata[VITASAS_VOICE_POOL_MAX];
+} vitaSASVoicePool;
+
+/* Mix graph */
+
+#define VITASAS_MIX_OP_IN_PLACE		0	/* rendered straight into parent buffer, mixed by parent SAS core */
+#define VITASAS_MIX_OP_COPY			1	/* first of several children, scaled into parent buffer */
+#define VITASAS_MIX_OP_ADD			2	/* other children, scaled and added to parent buffer */
+
+typedef struct vitaSASMixPlanEntry {
+	struct vitaSASSystem* system;
+	struct vitaSASSystem* inPlaceChild;
+	int16_t* buffer;	/* NULL - output buffer */
+	int16_t* mixTarget;	/* NULL - output buffer */
+	uint32_t mixOp;
+	uint32_t numChildren;
+} vitaSASMixPlanEntry;
+
+typedef struct vitaSASMixPlanJob {
+	uint32_t start;
+	uint32_t end;
+} vitaSASMixPlanJob;
+
+typedef struct vitaSASMixPlan {
+	vitaSASMixPlanEntry* entries;
+	uint32_t numEntries;
+	vitaSASMixPlanJob* jobs;	/* one per subtree of the root, only if root has several children */
+	uint32_t numJobs;
+} vitaSASMixPlan;
+
+/* Parallel rendering */
+
+#define VITASAS_RENDER_WORKER_MAX	3
+
+typedef struct vitaSASRenderWorkers {
+	SceUID threadId[VITASAS_RENDER_WORKER_MAX];
+	uint32_t numWorkers;
+	SceUID startSemaId;
+	SceUID doneSemaId;
+	volatile uint32_t isAborted;
+	volatile int32_t nextJob;
+	const vitaSASMixPlan* plan;
+	void* buffer;
+	uint32_t numGrain;
+} vitaSASRenderWorkers;
+
 typedef struct vitaSASSystem {
 	AudioOutWork audioWork;
+	vitaSASCommandQueue commandQueue;
+	vitaSASVoicePool voicePool;
 	SceUID sasSystemHandle;
 	int systemNum;
 	int isSubSystem;
 	int subSystemNum;
 	uint32_t subSystemMixVolL;
 	uint32_t subSystemMixVolR;
+	struct vitaSASSystem* parent;
+	struct vitaSASSystem* firstChild;
+	struct vitaSASSystem* nextSibling;
+	uint32_t numChildren;
+	uint32_t mixVolL;
+	uint32_t mixVolR;
+	int16_t* mixBuffer;
+	SceKernelLwMutexWork mixPlanMutex;
+	vitaSASMixPlan mixPlan;
+	vitaSASRenderWorkers* renderWorkers;
+	struct vitaSASSoftMixer* softMixer;
 } vitaSASSystem;
 
 typedef struct File {
@@ -117,6 +480,44 @@ typedef struct vitaSASVoiceParam {
 	SceUInt32 adsr2;
 } vitaSASVoiceParam;
 
+/* Batched voice setup */
+
+#define VITASAS_VOICE_TYPE_VAG		0
+#define VITASAS_VOICE_TYPE_PCM		1
+#define VITASAS_VOICE_TYPE_NOISE	2
+
+typedef struct vitaSASVoiceSetup {
+	SceUInt32 voiceID;
+	SceUInt32 type;
+	const vitaSASAudio* audio;
+	SceUInt32 noiseClock;
+	SceUInt32 keyOn;
+	vitaSASVoiceParam param;
+} vitaSASVoiceSetup;
+
+#define VITASAS_VOICE_UPDATE_PITCH			0x01
+#define VITASAS_VOICE_UPDATE_VOLUME			0x02
+#define VITASAS_VOICE_UPDATE_SIMPLE_ADSR	0x04
+#define VITASAS_VOICE_UPDATE_KEY_ON			0x08
+#define VITASAS_VOICE_UPDATE_KEY_OFF		0x10
+
+typedef struct vitaSASVoiceUpdateBatch {
+	SceUInt32 numVoices;
+	SceUInt32 updateMask;
+	const SceUInt32* voiceID;
+	const SceUInt32* pitch;
+	const SceUInt32* volLDry;
+	const SceUInt32* volRDry;
+	const SceUInt32* volLWet;
+	const SceUInt32* volRWet;
+	const SceUInt32* adsr1;
+	const SceUInt32* adsr2;
+} vitaSASVoiceUpdateBatch;
+
+/* Output port for systems that are rendered by the application with vitaSAS_system_render_grains() */
+
+#define VITASAS_OUTPUT_PORT_NONE	0xFFFFFFFF
+
 typedef struct VitaSASSystemParam {
 	SceUInt32 outputPort;
 	SceUInt32 samplingRate;
@@ -128,6 +529,14 @@ typedef struct VitaSASSystemParam {
 	SceUInt32 subSystemMixVolL;
 	SceUInt32 subSystemMixVolR;
 	SceInt32 subSystemNum;
+	SceUInt32 commandQueueSize;
+	SceUInt32 numRenderWorkers;
+	SceUInt32 renderWorkerCpu;
+	SceUInt32 mixerType;
+	SceUInt32 numGrainMin;
+	SceUInt32 numGrainMax;
+	SceUInt32 numOutputBuffers;
+	SceUInt32 renderAhead;
 } VitaSASSystemParam;
 
 /*----------------------------- Common -----------------------------*/
@@ -151,6 +560,26 @@ typedef struct VitaSASSystemParam {
  */
 PRX_INTERFACE void vitaSAS_set_heap_size(unsigned int size);
 
+/**
+ * Set sample pool configuration. Call this before initialization.
+ *
+ * Sample data loaded from files is packed into memory blocks of blockSize bytes (VITASAS_SAMPLE_POOL_BLOCK_SIZE_DEFAULT
+ * by default) with VITASAS_SAMPLE_ALIGN alignment, samples larger than a block get a block of their own. Memory of freed
+ * samples is reused. Set blockSize to 0 to allocate a separate memory block for each sample.
+ *
+ * @param[in] blockSize - size of pool memory blocks in bytes
+ * @param[in] budget - maximum number of bytes used by samples, 0 for no limit
+ *
+ */
+PRX_INTERFACE void vitaSAS_set_sample_pool_size(unsigned int blockSize, unsigned int budget);
+
+/**
+ * Get number of bytes used by samples in the sample pool
+ *
+ * @return sample pool usage in bytes.
+ */
+PRX_INTERFACE unsigned int vitaSAS_get_sample_pool_usage(void);
+
 /**
  * Initialize libvitaSAS
  *
@@ -170,6 +599,38 @@ PRX_INTERFACE int vitaSAS_finish(void);
 /**
  * Create SAS system instance
  *
+ * If systemInitParam->commandQueueSize is not 0, voice and effect calls for this system are queued
+ * and applied by the render thread right before the next grain is rendered instead of calling SAS directly.
+ * The queue size is rounded up to the next power of two. Set to 0 to call SAS directly from the calling thread.
+ * Separate calls can land on different grains, calls between vitaSAS_begin_commands() and vitaSAS_commit_commands()
+ * and batch calls always land on the same grain.
+ *
+ * If systemInitParam->subSystemNum is not VITASAS_NO_SUBSYSTEM, that subsystem is connected as the first child of
+ * the new system with subSystemMixVolL/subSystemMixVolR. Use vitaSAS_connect_system() to add more children.
+ *
+ * If systemInitParam->numRenderWorkers is not 0 (up to VITASAS_RENDER_WORKER_MAX), children of the system render
+ * in parallel on that many worker threads together with the output thread, and the output thread mixes the results.
+ * Workers are pinned to renderWorkerCpu, or to user cores not in thCpu if it is 0. End callbacks of voice pools of
+ * the children are then called from worker threads.
+ *
+ * If systemInitParam->mixerType is VITASAS_MIXER_SOFTWARE, voices of the system are mixed by the portable software mixer
+ * instead of SAS. It supports PCM and noise voices with pitch, dry volumes and ADSR, up to VITASAS_VOICE_POOL_MAX voices.
+ * VAG voices and effects are not supported and the system has no SAS handle.
+ *
+ * If systemInitParam->numGrainMax is not 0, the output thread adapts the grain of the whole system tree to the measured
+ * render cost between numGrainMin and numGrainMax, starting at numGrain. Grain is doubled when a grain is rendered late,
+ * the port underruns or render takes most of the grain, and halved after a calm period. Bounds must be multiples of
+ * VITASAS_GRAIN_ALIGN.
+ *
+ * systemInitParam->numOutputBuffers sets the depth of the output buffer ring (BUFFER_MAX if 0, up to
+ * VITASAS_OUTPUT_BUFFER_MAX). If systemInitParam->renderAhead is not 0, grains are rendered on a separate thread
+ * that keeps that many grains ready ahead of the port, so render spikes are absorbed by the ring at the cost of
+ * renderAhead grains of latency. The ring is deepened to renderAhead + 2 buffers if needed. Set to 0 to render
+ * each grain right before it is output. Use vitaSAS_get_output_latency() to query the resulting latency.
+ *
+ * If systemInitParam->outputPort is VITASAS_OUTPUT_PORT_NONE, no output thread is started for the system and
+ * audio is pulled with vitaSAS_system_render_grains() instead.
+ *
  * @param[in] systemInitParam - parameters related to SAS system instance
  *
  * @return SAS system number, <0 on error.
@@ -215,12 +676,48 @@ PRX_INTERFACE int vitaSAS_pause_system_render(void);
 PRX_INTERFACE int vitaSAS_resume_system_render(void);
 
 /**
- * Get currently selected SAS system handle
+ * Get SAS core handle of currently selected system, see vitaSAS_system_get_handle()
  *
- * @return SAS system handle
+ * @return SAS core handle, -1 for software mixer systems
  */
 PRX_INTERFACE SceUID vitaSAS_get_system_handle(void);
 
+/**
+ * Render audio of the current SAS system into application buffer
+ *
+ * System must be a root system created with VITASAS_OUTPUT_PORT_NONE. Rendering is not paced and runs
+ * as fast as the calling thread allows, pause state of the system is ignored.
+ *
+ * @param[out] buffer - interleaved S16 stereo buffer, numGrains * numGrain frames
+ * @param[in] numGrains - number of grains to render
+ *
+ * @return SCE_OK, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_render_grains(int16_t* buffer, unsigned int numGrains);
+
+/**
+ * Get render statistics of the current SAS system
+ *
+ * Statistics are collected for every grain rendered by the output thread or by vitaSAS_render_grains():
+ * render time, time spent waiting for the output port, grains that took longer to render than they play
+ * (deadline misses) and grains that found the port already drained (underruns).
+ *
+ * @param[out] stats - consistent snapshot of statistics
+ *
+ * @return SCE_OK, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_get_render_stats(vitaSASRenderStats* stats);
+
+/**
+ * Get output latency of the current SAS system
+ *
+ * Latency is the audio queued between the renderer and the speaker: grains rendered ahead and waiting
+ * in the output ring plus samples the port has not played yet.
+ *
+ * @return latency in samples, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_get_output_latency(void);
+
 /**
  * Set mixer volume for currently selected SAS system 
  * Only effective if currently selected SAS system is running in subsystem mode
@@ -232,7 +729,30 @@ PRX_INTERFACE SceUID vitaSAS_get_system_handle(void);
 PRX_INTERFACE void vitaSAS_set_sub_system_vol(unsigned int subSystemMixVolL, unsigned int subSystemMixVolR);
 
 /**
- * Delete SAS sample audio data
+ * Connect SAS system as a child of another SAS system. Output of all children is mixed into parent before parent renders.
+ * Child must be created as subsystem and use the same grain as parent.
+ *
+ * @param[in] childSystemNum - SAS system number of the child
+ * @param[in] parentSystemNum - SAS system number of the parent
+ * @param[in] mixVolL - volume of the child left channel in parent mix
+ * @param[in] mixVolR - volume of the child right channel in parent mix
+ *
+ * @return SCE_OK, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_connect_system(int childSystemNum, int parentSystemNum, unsigned int mixVolL, unsigned int mixVolR);
+
+/**
+ * Disconnect SAS system from its parent
+ *
+ * @param[in] childSystemNum - SAS system number of the child
+ *
+ * @return SCE_OK, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_disconnect_system(int childSystemNum);
+
+/**
+ * Delete SAS sample audio data. Audio from the sample cache is released, its data stays loaded
+ * until it is evicted.
  *
  * @param[in] info - voice information structure
  *
@@ -260,7 +780,19 @@ PRX_INTERFACE vitaSASAudio* vitaSAS_load_audio_VAG(char* soundPath, int io_type)
 PRX_INTERFACE vitaSASAudio* vitaSAS_load_audio_PCM(char* soundPath, int io_type);
 
 /**
- * Create SAS sample audio data from WAV file
+ * Create SAS sample audio data from raw PCM file with load-time processing
+ *
+ * @param[in] soundPath - path to the raw PCM file
+ * @param[in] io_type - set to 0 to use normal IO or to 1 to use FIOS2
+ * @param[in] param - load parameters, NULL for defaults
+ *
+ * @return SAS voice information structure, NULL on error.
+ */
+PRX_INTERFACE vitaSASAudio* vitaSAS_load_audio_PCM_with_param(char* soundPath, int io_type, const vitaSASLoadParam* param);
+
+/**
+ * Create SAS sample audio data from WAV file. Stereo files are split into left and right channels.
+ * 8, 24 and 32-bit integer and 32-bit float files are converted to 16-bit PCM while they are read.
  *
  * @param[in] soundPath - path to the WAV file
  * @param[in] io_type - set to 0 to use normal IO or to 1 to use FIOS2
@@ -269,6 +801,17 @@ PRX_INTERFACE vitaSASAudio* vitaSAS_load_audio_PCM(char* soundPath, int io_type)
  */
 PRX_INTERFACE vitaSASAudio* vitaSAS_load_audio_WAV(char* soundPath, int io_type);
 
+/**
+ * Create SAS sample audio data from WAV file with load-time processing
+ *
+ * @param[in] soundPath - path to the WAV file
+ * @param[in] io_type - set to 0 to use normal IO or to 1 to use FIOS2
+ * @param[in] param - load parameters, NULL for defaults
+ *
+ * @return SAS voice information structure, NULL on error.
+ */
+PRX_INTERFACE vitaSASAudio* vitaSAS_load_audio_WAV_with_param(char* soundPath, int io_type, const vitaSASLoadParam* param);
+
 /**
  * Create SAS sample audio data from data buffer
  *
@@ -279,13 +822,35 @@ PRX_INTERFACE vitaSASAudio* vitaSAS_load_audio_WAV(char* soundPath, int io_type)
  */
 PRX_INTERFACE vitaSASAudio* vitaSAS_load_audio_custom(void* pData, unsigned int dataSize);
 
+/**
+ * Read header and loop flags of VAG sample audio data. Filters of the data blocks are not checked,
+ * HE-ADPCM samples are reported like PS-ADPCM ones but can't be decoded by vitaSAS_decode_VAG_to_PCM().
+ *
+ * @param[in] info - VAG sample audio data
+ * @param[out] vagInfo - VAG information
+ *
+ * @return SCE_OK, VITASAS_ERROR_NOT_SUPPORTED if info is not a VAG sample.
+ */
+PRX_INTERFACE int vitaSAS_get_VAG_info(const vitaSASAudio* info, vitaSASVAGInfo* vagInfo);
+
+/**
+ * Decode VAG sample audio data to a new 16-bit PCM sample, for example for previews or loudness analysis.
+ * Only PS-ADPCM data (prediction filters 0 to 4) is supported, samples using the extended HE-ADPCM filter set
+ * still play on SAS voices but can't be decoded.
+ *
+ * @param[in] vag - VAG sample audio data
+ *
+ * @return SAS voice information structure, NULL on error or if a block uses an HE-ADPCM filter.
+ */
+PRX_INTERFACE vitaSASAudio* vitaSAS_decode_VAG_to_PCM(const vitaSASAudio* vag);
+
 /**
  * NEON-optimized channel separation for raw PCM
  *
  * @param[out] pBufL - pointer to the output buffer that will hold left channel data
  * @param[out] pBufR - pointer to the output buffer that will hold right channel data
  * @param[in] pBufSrc - pointer to the buffer that holds input stereo PCM data
- * @param[in] bufSrcSize - size of the input PCM data buffer
+ * @param[in] bufSrcSize - number of stereo frames in the input PCM data buffer, any count including odd ones
  *
  */
 PRX_INTERFACE void vitaSAS_separate_channels_PCM(short* pBufL, short* pBufR, short* pBufSrc, unsigned int bufSrcSize);
@@ -295,7 +860,7 @@ PRX_INTERFACE void vitaSAS_separate_channels_PCM(short* pBufL, short* pBufR, sho
  *
  * @param[in] voiceID - voice ID to enable vocalization for
  *
- * @return SCE_OK, <0 on error.
+ * @return SCE_OK, VITASAS_ERROR_COMMAND_QUEUE_FULL if command queue is full, <0 on error.
  */
 PRX_INTERFACE int vitaSAS_set_key_on(unsigned int voiceID);
 
@@ -304,7 +869,7 @@ PRX_INTERFACE int vitaSAS_set_key_on(unsigned int voiceID);
  *
  * @param[in] voiceID - voice ID to disable vocalization for
  *
- * @return SCE_OK, <0 on error.
+ * @return SCE_OK, VITASAS_ERROR_COMMAND_QUEUE_FULL if command queue is full, <0 on error.
  */
 PRX_INTERFACE int vitaSAS_set_key_off(unsigned int voiceID);
 
@@ -317,6 +882,288 @@ PRX_INTERFACE int vitaSAS_set_key_off(unsigned int voiceID);
  */
 PRX_INTERFACE int vitaSAS_get_end_state(unsigned int voiceID);
 
+/*----------------------------- Asynchronous loading -----------------------------*/
+
+/**
+ * Start sample loader thread. Asynchronous loads are served in submission order by this thread,
+ * which does all I/O, parsing and allocation.
+ *
+ * @param[in] thPriority - loader thread priority
+ * @param[in] thStackSize - loader thread stack size
+ * @param[in] thCpu - loader thread CPU affinity mask
+ *
+ * @return SCE_OK, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_start_loader(unsigned int thPriority, unsigned int thStackSize, unsigned int thCpu);
+
+/**
+ * Stop sample loader thread. Requests still queued fail. Close streams before stopping the loader
+ * and call this before vitaSAS_finish().
+ *
+ */
+PRX_INTERFACE void vitaSAS_stop_loader(void);
+
+/**
+ * Queue loading of sample audio data from VAG file
+ *
+ * Callback, if not NULL, is called from the loader thread with the loaded audio, or NULL on error,
+ * before the request is reported as finished.
+ *
+ * @param[in] soundPath - path to the VAG file, copied into the request
+ * @param[in] io_type - set to 0 to use normal IO or to 1 to use FIOS2
+ * @param[in] callback - completion callback
+ * @param[in] userdata - user data passed to the callback
+ *
+ * @return load request, NULL on error. Free with vitaSAS_free_load().
+ */
+PRX_INTERFACE vitaSASLoadRequest* vitaSAS_load_audio_VAG_async(char* soundPath, int io_type, vitaSASLoadCallback callback, void* userdata);
+
+/**
+ * Queue loading of sample audio data from raw PCM file, see vitaSAS_load_audio_VAG_async()
+ *
+ */
+PRX_INTERFACE vitaSASLoadRequest* vitaSAS_load_audio_PCM_async(char* soundPath, int io_type, vitaSASLoadCallback callback, void* userdata);
+
+/**
+ * Queue loading of sample audio data from WAV file, see vitaSAS_load_audio_VAG_async()
+ *
+ */
+PRX_INTERFACE vitaSASLoadRequest* vitaSAS_load_audio_WAV_async(char* soundPath, int io_type, vitaSASLoadCallback callback, void* userdata);
+
+/**
+ * Get state of load request
+ *
+ * @param[in] request - load request
+ *
+ * @return VITASAS_LOAD_STATE_PENDING, VITASAS_LOAD_STATE_DONE or VITASAS_LOAD_STATE_FAILED.
+ */
+PRX_INTERFACE int vitaSAS_poll_load(const vitaSASLoadRequest* request);
+
+/**
+ * Wait for load request to finish
+ *
+ * @param[in] request - load request
+ *
+ * @return loaded audio, NULL on error. Audio is owned by the caller and freed with vitaSAS_free_audio().
+ */
+PRX_INTERFACE vitaSASAudio* vitaSAS_wait_load(vitaSASLoadRequest* request);
+
+/**
+ * Free load request, waiting for it to finish first. Loaded audio is not freed.
+ *
+ * @param[in] request - load request
+ *
+ */
+PRX_INTERFACE void vitaSAS_free_load(vitaSASLoadRequest* request);
+
+/**
+ * Load sample audio data of many raw VAG or PCM files at once
+ *
+ * All files are resolved first and read in order of their physical location. With FIOS2, files
+ * stored close to each other in one archive are read together with a single large read and split
+ * into separate samples afterwards. Files that can't be resolved or read are left NULL.
+ *
+ * @param[in] soundPaths - paths to the files
+ * @param[in] count - number of files
+ * @param[in] io_type - set to 0 to use normal IO or to 1 to use FIOS2
+ * @param[out] outAudio - array of count loaded audio pointers, free each with vitaSAS_free_audio()
+ *
+ * @return number of loaded files, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_load_audio_batch(char** soundPaths, unsigned int count, int io_type, vitaSASAudio** outAudio);
+
+/**
+ * Enable sample cache. Afterwards vitaSAS_load_audio_VAG(), vitaSAS_load_audio_PCM() and vitaSAS_load_audio_WAV(),
+ * including their asynchronous variants, return one shared reference counted sample for every path that names
+ * the same file. Paths are compared without case, with '\' and '/' treated alike and "." and ".." resolved.
+ * Each load must be matched with vitaSAS_free_audio(). Voices keep the sample they play referenced until they
+ * get another waveform, voices from vitaSAS_system_alloc_voice_VAG() and vitaSAS_system_alloc_voice_PCM() also
+ * until they finish. See vitaSAS_set_sample_cache_budget() for when the data is freed.
+ * Loads with parameters, batch loads and banks are not cached.
+ *
+ * @param[in] maxSamples - number of distinct samples, further samples are loaded without sharing
+ *
+ * @return SCE_OK, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_enable_sample_cache(unsigned int maxSamples);
+
+/**
+ * Disable sample cache
+ *
+ * @return SCE_OK, VITASAS_ERROR_NOT_SUPPORTED if cached samples are still referenced.
+ */
+PRX_INTERFACE int vitaSAS_disable_sample_cache(void);
+
+/**
+ * Set memory budget of the sample cache. Freed samples stay loaded for reuse, when loaded samples exceed
+ * the budget the least recently used ones that are neither referenced nor set on a voice are evicted.
+ * They are loaded again when requested. Unused samples are also evicted when sample memory can't be allocated.
+ *
+ * @param[in] budget - budget in bytes, 0 to evict only when allocation fails
+ *
+ */
+PRX_INTERFACE void vitaSAS_set_sample_cache_budget(unsigned int budget);
+
+/**
+ * Get size of sample data loaded by the sample cache
+ *
+ * @return size in bytes.
+ */
+PRX_INTERFACE unsigned int vitaSAS_get_sample_cache_usage(void);
+
+/*----------------------------- Streaming voices -----------------------------*/
+
+/**
+ * Open streaming voice that plays raw VAG or PCM file from disk through a small ring of blocks
+ * instead of keeping the whole file resident. The voice loops over the ring, the loader thread
+ * refills blocks once the voice has played past them. Ring memory is streamParam->numBlocks *
+ * streamParam->blockSize bytes, the ring must hold enough audio to cover loader latency.
+ * Loader must be running, see vitaSAS_start_loader().
+ *
+ * Key the voice on and off as usual. Keying a stream that has played before on again restarts it
+ * from the beginning, call vitaSAS_rewind_stream() first to have the start of the file buffered.
+ * Pitch changes must go through this library for the stream to follow the voice.
+ *
+ * @param[in] system - SAS system handle
+ * @param[in] voiceID - voice ID to stream to
+ * @param[in] soundPath - path to the VAG or raw PCM file
+ * @param[in] io_type - set to 0 to use normal IO or to 1 to use FIOS2
+ * @param[in] streamParam - stream format, looping and ring size. Block size must be a multiple of VITASAS_STREAM_BLOCK_ALIGN, at least 2 blocks.
+ * @param[in] voiceParam - voice parameters, loop is ignored
+ *
+ * @return stream, NULL on error.
+ */
+PRX_INTERFACE vitaSASStream* vitaSAS_system_open_stream(vitaSASSystem* system, unsigned int voiceID, char* soundPath, int io_type, const vitaSASStreamParam* streamParam, const vitaSASVoiceParam* voiceParam);
+
+/**
+ * Open streaming voice on current system, see vitaSAS_system_open_stream()
+ *
+ */
+PRX_INTERFACE vitaSASStream* vitaSAS_open_stream(unsigned int voiceID, char* soundPath, int io_type, const vitaSASStreamParam* streamParam, const vitaSASVoiceParam* voiceParam);
+
+/**
+ * Refill stream ring from the beginning of the file. Call while the stream voice is not playing.
+ *
+ * @param[in] stream - stream
+ *
+ * @return SCE_OK, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_rewind_stream(vitaSASStream* stream);
+
+/**
+ * Get number of grains that played data which wasn't loaded in time
+ *
+ * @param[in] stream - stream
+ *
+ * @return number of underruns.
+ */
+PRX_INTERFACE unsigned int vitaSAS_get_stream_underruns(const vitaSASStream* stream);
+
+/**
+ * Close stream. Voice is keyed off, the stream is freed by the loader once the voice has ended,
+ * or when its system is destroyed. If the key off can't be submitted the stream stays open and
+ * the call can be retried once the render thread has applied pending commands. Key off is queued
+ * right away even if the calling thread has a command frame open.
+ *
+ * @param[in] stream - stream
+ *
+ * @return SCE_OK, VITASAS_ERROR_COMMAND_QUEUE_FULL if the key off was dropped, stream must not be used after SCE_OK.
+ */
+PRX_INTERFACE int vitaSAS_close_stream(vitaSASStream* stream);
+
+/*----------------------------- Sample banks -----------------------------*/
+
+/**
+ * Load sample bank from file. The whole bank is read with a single read into a single sample allocation.
+ *
+ * @param[in] bankPath - path to the bank file
+ * @param[in] io_type - set to 0 to use normal IO or to 1 to use FIOS2
+ *
+ * @return sample bank, NULL on error.
+ */
+PRX_INTERFACE vitaSASBank* vitaSAS_load_bank(char* bankPath, int io_type);
+
+/**
+ * Create sample bank from data buffer. Bank is used in place, for example from a mapped archive,
+ * and the buffer must stay valid until the bank is freed.
+ *
+ * @param[in] pData - pointer to the bank data, 4-byte aligned
+ * @param[in] dataSize - size of the bank data
+ *
+ * @return sample bank, NULL on error.
+ */
+PRX_INTERFACE vitaSASBank* vitaSAS_load_bank_custom(void* pData, unsigned int dataSize);
+
+/**
+ * Delete sample bank. Audio returned by vitaSAS_bank_get_audio() is invalid afterwards.
+ *
+ * @param[in] bank - sample bank
+ *
+ */
+PRX_INTERFACE void vitaSAS_free_bank(vitaSASBank* bank);
+
+/**
+ * Get hash of sample name as stored in sample banks. Hashes can be computed offline and used as sample IDs.
+ *
+ * @param[in] name - sample name
+ *
+ * @return 32-bit FNV-1a hash of the name.
+ */
+PRX_INTERFACE uint32_t vitaSAS_bank_hash(const char* name);
+
+/**
+ * Find sample in bank by name
+ *
+ * @param[in] bank - sample bank
+ * @param[in] name - sample name
+ *
+ * @return sample index, <0 if not found.
+ */
+PRX_INTERFACE int vitaSAS_bank_find(const vitaSASBank* bank, const char* name);
+
+/**
+ * Find sample in bank by name hash
+ *
+ * @param[in] bank - sample bank
+ * @param[in] nameHash - hash of sample name from vitaSAS_bank_hash()
+ *
+ * @return sample index, <0 if not found.
+ */
+PRX_INTERFACE int vitaSAS_bank_find_hash(const vitaSASBank* bank, uint32_t nameHash);
+
+/**
+ * Get sample audio. Audio points into the bank, don't pass it to vitaSAS_free_audio().
+ *
+ * @param[in] bank - sample bank
+ * @param[in] index - sample index
+ *
+ * @return sample audio, NULL on error.
+ */
+PRX_INTERFACE const vitaSASAudio* vitaSAS_bank_get_audio(const vitaSASBank* bank, unsigned int index);
+
+/**
+ * Get sample format, sampling rate and loop information
+ *
+ * @param[in] bank - sample bank
+ * @param[in] index - sample index
+ *
+ * @return sample entry, NULL on error.
+ */
+PRX_INTERFACE const vitaSASBankEntry* vitaSAS_bank_get_entry(const vitaSASBank* bank, unsigned int index);
+
+/**
+ * Pack samples into a sample bank. VAG samples are stored with their VAG header, PCM samples as mono S16.
+ * Names must have distinct hashes.
+ *
+ * @param[in] sources - samples to pack
+ * @param[in] numSources - number of samples
+ * @param[out] pBuffer - buffer to write the bank to, NULL to only compute the size
+ * @param[in] bufferSize - size of the buffer
+ *
+ * @return size of the bank, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_pack_bank(const vitaSASBankSource* sources, unsigned int numSources, void* pBuffer, unsigned int bufferSize);
+
 /*----------------------------- Codec Engine decoding -----------------------------*/
 
 /**
@@ -444,6 +1291,10 @@ PRX_INTERFACE void vitaSAS_set_voice_VAG(unsigned int voiceID, const vitaSASAudi
 /**
  * Set PCM voice from preloaded voice data
  *
+ * Stereo data takes voices voiceID (left) and voiceID + 1 (right). The pair is linked: pitch, ADSR,
+ * key on/off and volume set on voiceID apply to both voices, left volumes going to the left voice
+ * and right volumes to the right one. Setting a new waveform on voiceID unlinks the pair.
+ *
  * @param[in] voiceID - voice ID to assign to the new voice
  * @param[in] info - SAS voice information structure (from .pcm or .wav)
  * @param[in] voiceParam - initial voice parameters
@@ -461,6 +1312,42 @@ PRX_INTERFACE void vitaSAS_set_voice_PCM(unsigned int voiceID, const vitaSASAudi
  */
 PRX_INTERFACE void vitaSAS_set_voice_noise(unsigned int voiceID, unsigned int clock, const vitaSASVoiceParam* voiceParam);
 
+/**
+ * Set up several voices in one pass
+ *
+ * @param[in] setup - array of voice setup entries (type is one of VITASAS_VOICE_TYPE_XXX, audio is ignored for noise voices)
+ * @param[in] numVoices - number of entries in setup
+ *
+ * @return SCE_OK, <0 on error. With command queue enabled, either all commands are queued and applied on the same grain or none are.
+ */
+PRX_INTERFACE int vitaSAS_set_voices_batch(const vitaSASVoiceSetup* setup, unsigned int numVoices);
+
+/**
+ * Update parameters of several voices in one pass
+ *
+ * @param[in] batch - structure-of-arrays parameter block. Only arrays selected by updateMask (VITASAS_VOICE_UPDATE_XXX) are read.
+ *
+ * @return SCE_OK, <0 on error. With command queue enabled, either all commands are queued and applied on the same grain or none are.
+ */
+PRX_INTERFACE int vitaSAS_update_voices_batch(const vitaSASVoiceUpdateBatch* batch);
+
+/**
+ * Begin command frame of the calling thread. Voice and effect calls the thread makes until vitaSAS_commit_commands()
+ * are staged and applied on the same grain, calls of other threads are not affected. Frames nest, only the outermost
+ * commit publishes. Without command queue calls are applied immediately as usual.
+ *
+ * @return SCE_OK, VITASAS_ERROR_NO_FREE_FRAME if VITASAS_COMMAND_FRAME_MAX threads already have a frame open, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_begin_commands(void);
+
+/**
+ * Commit command frame of the calling thread
+ *
+ * @return SCE_OK, VITASAS_ERROR_COMMAND_QUEUE_FULL if the staged commands don't fit the queue, in which case none of them
+ * are applied, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_commit_commands(void);
+
 /* Effects */
 
 /**
@@ -557,9 +1444,188 @@ PRX_INTERFACE void vitaSAS_set_ADSR_mode(unsigned int voiceID, unsigned int flag
  */
 PRX_INTERFACE void vitaSAS_set_ADSR(unsigned int voiceID, unsigned int flag, unsigned int a, unsigned int d, unsigned int s, unsigned int r);
 
+/*----------------------------- Explicit system handle API -----------------------------*/
+
+/*
+ * Functions below take SAS system handle explicitly and do not depend on vitaSAS_select_system().
+ * Different threads can safely drive different SAS systems at the same time.
+ * Calls without vitaSAS_system_ prefix operate on the currently selected system.
+ *
+ * Handles are not reference counted. The thread that destroys a system must make sure that no other
+ * thread still uses its handle, including handles obtained with vitaSAS_get_system().
+ */
+
+/**
+ * Create SAS system instance and return its handle. At most MAX_SAS_SYSTEM_NUM (1024) systems can exist at the same time
+ *
+ * @param[in] sasConfig - SAS system configuration string. Ex. "numGrains=256 numVoices=1 numReverbs=1"
+ * @param[in] systemInitParam - parameters related to SAS system instance
+ *
+ * @return SAS system handle, NULL on error.
+ */
+PRX_INTERFACE vitaSASSystem* vitaSAS_system_create(const char* sasConfig, VitaSASSystemParam* systemInitParam);
+
+/**
+ * Destroy SAS system. Handle becomes invalid immediately, so no other thread may use it at this point
+ *
+ * @param[in] system - SAS system handle
+ *
+ */
+PRX_INTERFACE void vitaSAS_system_destroy(vitaSASSystem* system);
+
+/**
+ * Get SAS system handle from SAS system number. Lookup is lock-free but does not keep the system alive:
+ * returned handle is only valid until the system is destroyed, and system numbers are reused afterwards.
+ *
+ * @param[in] systemNum - SAS system number, 0 to MAX_SAS_SYSTEM_NUM - 1
+ *
+ * @return SAS system handle, NULL if there is no such system.
+ */
+PRX_INTERFACE vitaSASSystem* vitaSAS_get_system(int systemNum);
+
+PRX_INTERFACE int vitaSAS_system_pause_render(vitaSASSystem* system);
+PRX_INTERFACE int vitaSAS_system_resume_render(vitaSASSystem* system);
+
+/**
+ * Get handle of the SAS core instance behind a SAS system, for calling sceSas*Internal() functions directly
+ *
+ * @param[in] system - SAS system handle
+ *
+ * @return SAS core handle from sceSasInitInternal(), -1 for systems created with VITASAS_MIXER_SOFTWARE,
+ * which have no SAS core instance.
+ */
+PRX_INTERFACE SceUID vitaSAS_system_get_handle(vitaSASSystem* system);
+
+PRX_INTERFACE int vitaSAS_system_render_grains(vitaSASSystem* system, int16_t* buffer, unsigned int numGrains);
+PRX_INTERFACE int vitaSAS_system_get_render_stats(vitaSASSystem* system, vitaSASRenderStats* stats);
+PRX_INTERFACE int vitaSAS_system_get_output_latency(vitaSASSystem* system);
+PRX_INTERFACE void vitaSAS_system_set_sub_system_vol(vitaSASSystem* system, unsigned int subSystemMixVolL, unsigned int subSystemMixVolR);
+
+/**
+ * Connect SAS system as a child of another SAS system. Output of all children is mixed into parent before parent renders,
+ * children of one parent are mixed in connection order. From then on the whole child tree is rendered by the thread of
+ * the root of parent tree.
+ *
+ * Child must be created as subsystem (VitaSASSystemParam::isSubSystem set). Root systems, including roots with an output
+ * port, can't be connected under a parent: their output is never redirected and the call fails.
+ * Child must use the same grain as parent, unless the root of parent tree is adaptive (numGrainMax != 0):
+ * grain of the child is then changed to the current grain of parent and follows the root afterwards.
+ *
+ * @param[in] child - SAS system handle of the child
+ * @param[in] parent - SAS system handle of the parent
+ * @param[in] mixVolL - volume of the child left channel in parent mix, 0 to SCE_SAS_VOLUME_MAX (unity)
+ * @param[in] mixVolR - volume of the child right channel in parent mix, 0 to SCE_SAS_VOLUME_MAX (unity)
+ *
+ * @return SCE_OK, VITASAS_ERROR_INVALID_MIX_GRAPH if either system is NULL, child is parent, child has its own output,
+ * child is already connected, connection would create a cycle or grains don't match. <0 if mix plan of the new tree
+ * can't be built, child stays disconnected in that case.
+ */
+PRX_INTERFACE int vitaSAS_system_connect(vitaSASSystem* child, vitaSASSystem* parent, unsigned int mixVolL, unsigned int mixVolR);
+
+/**
+ * Disconnect SAS system from its parent. Child stops contributing to parent mix from the next grain on and becomes
+ * root of its own tree together with its children. Grain set by an adaptive root is kept.
+ *
+ * @param[in] child - SAS system handle of the child
+ *
+ * @return SCE_OK, VITASAS_ERROR_INVALID_MIX_GRAPH if child is NULL or not connected.
+ */
+PRX_INTERFACE int vitaSAS_system_disconnect(vitaSASSystem* child);
+
+/**
+ * Set volume of a connected SAS system in its parent mix. Volumes are read on every grain, new values take effect
+ * from the next rendered grain without a ramp. vitaSAS_system_connect() overwrites volumes set before connection.
+ *
+ * @param[in] child - SAS system handle of the child
+ * @param[in] mixVolL - volume of the child left channel in parent mix, 0 to SCE_SAS_VOLUME_MAX (unity)
+ * @param[in] mixVolR - volume of the child right channel in parent mix, 0 to SCE_SAS_VOLUME_MAX (unity)
+ *
+ */
+PRX_INTERFACE void vitaSAS_system_set_mix_vol(vitaSASSystem* child, unsigned int mixVolL, unsigned int mixVolR);
+
+PRX_INTERFACE void vitaSAS_system_set_voice_VAG(vitaSASSystem* system, unsigned int voiceID, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam);
+PRX_INTERFACE void vitaSAS_system_set_voice_PCM(vitaSASSystem* system, unsigned int voiceID, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam);
+PRX_INTERFACE void vitaSAS_system_set_voice_noise(vitaSASSystem* system, unsigned int voiceID, unsigned int clock, const vitaSASVoiceParam* voiceParam);
+PRX_INTERFACE int vitaSAS_system_set_voices_batch(vitaSASSystem* system, const vitaSASVoiceSetup* setup, unsigned int numVoices);
+PRX_INTERFACE int vitaSAS_system_update_voices_batch(vitaSASSystem* system, const vitaSASVoiceUpdateBatch* batch);
+PRX_INTERFACE int vitaSAS_system_begin_commands(vitaSASSystem* system);
+PRX_INTERFACE int vitaSAS_system_commit_commands(vitaSASSystem* system);
+
+PRX_INTERFACE void vitaSAS_system_set_effect(vitaSASSystem* system, unsigned int effectType, unsigned int volL, unsigned int volR, unsigned int delayTime, unsigned int feedbackLevel);
+PRX_INTERFACE void vitaSAS_system_reset_effect(vitaSASSystem* system);
+PRX_INTERFACE void vitaSAS_system_set_switch_config(vitaSASSystem* system, unsigned int drySwitch, unsigned int wetSwitch);
+
+PRX_INTERFACE void vitaSAS_system_set_pitch(vitaSASSystem* system, unsigned int voiceID, unsigned int pitch);
+PRX_INTERFACE void vitaSAS_system_set_volume(vitaSASSystem* system, unsigned int voiceID, unsigned int volLDry,
+	unsigned int volRDry, unsigned int volLWet, unsigned int volRWet);
+PRX_INTERFACE void vitaSAS_system_set_simple_ADSR(vitaSASSystem* system, unsigned int voiceID, unsigned int adsr1, unsigned int adsr2);
+PRX_INTERFACE void vitaSAS_system_set_SL(vitaSASSystem* system, unsigned int voiceID, unsigned int sustainLevel);
+PRX_INTERFACE void vitaSAS_system_set_ADSR_mode(vitaSASSystem* system, unsigned int voiceID, unsigned int flag, unsigned int a, unsigned int d, unsigned int s, unsigned int r);
+PRX_INTERFACE void vitaSAS_system_set_ADSR(vitaSASSystem* system, unsigned int voiceID, unsigned int flag, unsigned int a, unsigned int d, unsigned int s, unsigned int r);
+PRX_INTERFACE int vitaSAS_system_set_key_on(vitaSASSystem* system, unsigned int voiceID);
+PRX_INTERFACE int vitaSAS_system_set_key_off(vitaSASSystem* system, unsigned int voiceID);
+PRX_INTERFACE int vitaSAS_system_get_end_state(vitaSASSystem* system, unsigned int voiceID);
+
+/*----------------------------- Voice pool -----------------------------*/
+
+/*
+ * Every SAS system has a pool covering all of its voices (numVoices from the configuration string, 32 by default).
+ * Voices handed out by the pool are watched by the render thread once keyed on and are returned to the pool
+ * automatically when they reach end state. Do not mix pool allocation with manually chosen voice IDs on the same system.
+ */
+
+/**
+ * Allocate free voice and set it up for VAG playback. Key on the voice to start playback.
+ *
+ * @param[in] system - SAS system handle
+ * @param[in] info - SAS voice information structure
+ * @param[in] voiceParam - initial voice parameters
+ * @param[in] callback - function called from the render thread when the voice has finished, can be NULL
+ * @param[in] userdata - user data passed to callback
+ *
+ * @return voice ID, VITASAS_ERROR_NO_FREE_VOICE if all voices are in use.
+ */
+PRX_INTERFACE int vitaSAS_system_alloc_voice_VAG(vitaSASSystem* system, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam, vitaSASVoiceEndCallback callback, void* userdata);
+
+/**
+ * Allocate free voice and set it up for PCM playback. Key on the voice to start playback.
+ * Stereo data gets a linked pair of neighbouring voices, see vitaSAS_set_voice_PCM().
+ *
+ * @param[in] system - SAS system handle
+ * @param[in] info - SAS voice information structure (from .pcm or .wav)
+ * @param[in] voiceParam - initial voice parameters
+ * @param[in] callback - function called from the render thread when the voice has finished, can be NULL
+ * @param[in] userdata - user data passed to callback
+ *
+ * @return voice ID, VITASAS_ERROR_NO_FREE_VOICE if all voices are in use.
+ */
+PRX_INTERFACE int vitaSAS_system_alloc_voice_PCM(vitaSASSystem* system, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam, vitaSASVoiceEndCallback callback, void* userdata);
+
+/**
+ * Return allocated voice that has never been keyed on back to the pool. Stereo voices return both voices of the pair.
+ * Voices that were keyed on are returned automatically after they finish or are keyed off. A key on that is still
+ * in the command queue can't be seen, so don't release a voice after keying it on. Cached sample set on the voice
+ * is no longer kept referenced.
+ *
+ * @param[in] system - SAS system handle
+ * @param[in] voiceID - voice ID to return
+ *
+ * @return SCE_OK, VITASAS_ERROR_VOICE_IN_USE if the voice was keyed on and is watched by the render thread, <0 on error.
+ */
+PRX_INTERFACE int vitaSAS_system_release_voice(vitaSASSystem* system, unsigned int voiceID);
+
+/**
+ * Get number of voices available for allocation
+ *
+ * @param[in] system - SAS system handle
+ *
+ * @return number of free voices.
+ */
+PRX_INTERFACE unsigned int vitaSAS_system_get_free_voice_count(vitaSASSystem* system);
+
 /*----------------------------- Internal functions -----------------------------*/
 
-void vitaSAS_internal_set_initial_params(unsigned int voiceID, unsigned int pitch, unsigned int volLDry,
+void vitaSAS_internal_set_initial_params(vitaSASSystem* system, unsigned int voiceID, unsigned int pitch, unsigned int volLDry,
 	unsigned int volRDry, unsigned int volLWet, unsigned int volRWet, unsigned int adsr1, unsigned int adsr2);
 
 CodecEngineMemBlock* vitaSAS_internal_allocate_memory_for_codec_engine(unsigned int codecType, SceAudiodecCtrl* addecctrl, unsigned int useMainMem);
@@ -567,10 +1633,75 @@ void vitaSAS_internal_free_memory_for_codec_engine(const CodecEngineMemBlock* co
 void vitaSAS_internal_output_for_decoder(Buffer *pOutput);
 int vitaSAS_internal_getFileSize(const char *pInputFileName, uint32_t *pInputFileSize);
 int vitaSAS_internal_readFile(const char *pInputFileName, void *pInputBuf, uint32_t inputFileSize);
+void* vitaSAS_internal_load_audio(char *path, size_t *outSize, SceUID* mem_id_ret, int io_type);
+void* vitaSAS_internal_get_VAG_data(const vitaSASAudio* info, uint32_t* size);
+
+int vitaSAS_internal_sample_pool_init(void);
+void vitaSAS_internal_sample_pool_term(void);
+void* vitaSAS_internal_sample_alloc(unsigned int size, SceUID* mem_id_ret);
+void vitaSAS_internal_sample_free(void* data, SceUID mem_id);
+
+vitaSASAudio* vitaSAS_internal_load_audio_uncached(uint32_t type, char* soundPath, int io_type);
+int vitaSAS_internal_sample_cache_is_enabled(void);
+vitaSASAudio* vitaSAS_internal_sample_cache_load(uint32_t type, char* soundPath, int io_type);
+void vitaSAS_internal_sample_cache_release(vitaSASAudio* info);
+uint32_t vitaSAS_internal_sample_cache_acquire_voice(const vitaSASAudio* info);
+void vitaSAS_internal_sample_cache_release_voice(uint32_t sample);
+unsigned int vitaSAS_internal_sample_cache_reclaim(unsigned int size);
+void vitaSAS_internal_sample_cache_term(void);
+
+int vitaSAS_internal_stream_init(void);
+void vitaSAS_internal_stream_term(void);
+void vitaSAS_internal_stream_apply_command(vitaSASSystem* system, const vitaSASCommand* command);
+void vitaSAS_internal_stream_advance(vitaSASSystem* system, unsigned int numGrain);
+void vitaSAS_internal_stream_service(void);
+void vitaSAS_internal_stream_close_system(vitaSASSystem* system);
+int vitaSAS_internal_loader_is_running(void);
+void vitaSAS_internal_loader_wake(void);
+
+int vitaSAS_internal_apply_command(vitaSASSystem* system, const vitaSASCommand* command);
+int vitaSAS_internal_submit_command(vitaSASSystem* system, const vitaSASCommand* command);
+int vitaSAS_internal_get_end_state(vitaSASSystem* system, unsigned int voiceID);
+void vitaSAS_internal_apply_command_queue(vitaSASSystem* system);
+
+int vitaSAS_internal_command_queue_create(vitaSASCommandQueue* queue, unsigned int size);
+void vitaSAS_internal_command_queue_destroy(vitaSASCommandQueue* queue);
+int vitaSAS_internal_command_queue_push(vitaSASCommandQueue* queue, const vitaSASCommand* command);
+int vitaSAS_internal_command_queue_pop(vitaSASCommandQueue* queue, vitaSASCommand* command);
+int vitaSAS_internal_command_queue_reserve(vitaSASCommandQueue* queue, unsigned int count, int32_t* pos);
+void vitaSAS_internal_command_queue_commit(vitaSASCommandQueue* queue, int32_t pos, unsigned int count);
+int vitaSAS_internal_command_queue_begin_frame(vitaSASCommandQueue* queue, int32_t threadId);
+vitaSASCommandFrame* vitaSAS_internal_command_queue_find_frame(vitaSASCommandQueue* queue, int32_t threadId);
+int vitaSAS_internal_command_queue_stage(vitaSASCommandQueue* queue, vitaSASCommandFrame* frame, const vitaSASCommand* command);
+int vitaSAS_internal_command_queue_commit_frame(vitaSASCommandQueue* queue, int32_t threadId);
+
+void vitaSAS_internal_voice_pool_init(vitaSASVoicePool* pool, const char* sasConfig);
+void vitaSAS_internal_voice_pool_key_on(vitaSASVoicePool* pool, unsigned int voiceID);
+void vitaSAS_internal_voice_pool_arm(vitaSASVoicePool* pool);
+void vitaSAS_internal_voice_pool_reclaim(vitaSASSystem* system);
+void vitaSAS_internal_voice_pool_set_link(vitaSASVoicePool* pool, unsigned int voiceID, int isLinked);
+int vitaSAS_internal_voice_pool_is_linked(const vitaSASVoicePool* pool, unsigned int voiceID);
+void vitaSAS_internal_voice_pool_set_sample(vitaSASVoicePool* pool, unsigned int voiceID, uint32_t sample);
+void vitaSAS_internal_voice_pool_release_samples(vitaSASVoicePool* pool);
+
+int vitaSAS_internal_mix_graph_init(void);
+void vitaSAS_internal_mix_graph_term(void);
+int vitaSAS_internal_mix_graph_attach(vitaSASSystem* system);
+void vitaSAS_internal_mix_graph_detach(vitaSASSystem* system);
+void vitaSAS_internal_mix_graph_render_entry(const vitaSASMixPlanEntry* entry, void* buffer);
+void vitaSAS_internal_mix_graph_mix_entry(const vitaSASMixPlanEntry* entry, void* buffer, unsigned int numGrain);
+void vitaSAS_internal_mix_graph_set_grain(vitaSASSystem* root, unsigned int numGrain);
+
+vitaSASRenderWorkers* vitaSAS_internal_render_workers_start(unsigned int numWorkers, unsigned int thPriority, unsigned int thStackSize, unsigned int thCpu, unsigned int workerCpu);
+void vitaSAS_internal_render_workers_stop(vitaSASRenderWorkers* workers);
+void vitaSAS_internal_render_workers_run(vitaSASRenderWorkers* workers, const vitaSASMixPlan* plan, void* buffer, unsigned int numGrain);
 
 int vitaSAS_internal_audio_out_start(AudioOutWork *work, unsigned int thPriority, unsigned int thStackSize, unsigned int thCpu);
 int vitaSAS_internal_audio_out_stop(AudioOutWork* work);
 
+void vitaSAS_internal_render_stats_record(vitaSASRenderStatsWork* work, uint32_t grainTime, uint32_t renderTime, uint32_t waitTime, uint32_t isUnderrun);
+void vitaSAS_internal_render_stats_read(const vitaSASRenderStatsWork* work, vitaSASRenderStats* stats);
+
 #ifdef __cplusplus
 }
 #endif
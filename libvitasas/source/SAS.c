@@ -1,4 +1,4 @@
-#include <kernel.h> 
+﻿#include <kernel.h> 
 #include <audioout.h> 
 #include <libsysmodule.h>
 #include <libdbg.h>
@@ -7,120 +7,26 @@
 
 #include "vitaSAS.h"
 #include "heap.h"
+#include "atomic.h"
+#include "soft_mixer.h"
+#include "pcm_kernels.h"
+#include "resampler.h"
+#include "vag_codec.h"
 
-static int SASSystenEVF[MAX_SAS_SYSTEM_NUM];
+typedef struct vitaSASSystemTableChunk {
+	volatile int32_t usedMask;
+	vitaSASSystem* volatile system[VITASAS_SYSTEM_TABLE_CHUNK_SIZE];
+} vitaSASSystemTableChunk;
 
 void* vitaSAS_heap_internal;
 int g_portIdBGM = 0;
 
-static SceUID SASSystemFlagUID = 0;
 static int SASCurrentSystemNum = 0;
-static vitaSASSystem* SASSystemStorage[MAX_SAS_SYSTEM_NUM];
+static SceKernelLwMutexWork SASSystemTableMutex;
+static vitaSASSystemTableChunk* volatile SASSystemTable[VITASAS_SYSTEM_TABLE_CHUNK_MAX];
 
 static unsigned int heap_size = DEFAULT_HEAP_SIZE;
 
-static void* vitaSAS_internal_search_WAV_header(int dataToSearch, void* ptr, int* bytesMoved)
-{
-	int bytesMovedCount = 0;
-	void* new_ptr = ptr;
-	while (*(int *)new_ptr != dataToSearch) {
-		new_ptr++;
-		bytesMovedCount++;
-	}
-
-	*bytesMoved = bytesMovedCount;
-
-	return new_ptr;
-}
-
-static void vitaSAS_internal_load_audio_WAV_FIOS2(char *mountedFilePath, size_t *outSize, SceUID* mem_id_ret, void** datap)
-{
-	void *data, *header;
-	SceUID mem_id;
-	SceFiosFH file;
-	SceFiosSize size;
-	int result, offset, headerSize;
-	unsigned int mem_size;
-	mem_id = 0;
-
-	file = 0;
-	data = NULL;
-	header = NULL;
-
-	result = sceFiosFHOpenSync(NULL, &file, mountedFilePath, NULL);
-	if (result < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] Can't open %s sceFiosFHOpenSync(): 0x%X", mountedFilePath, result);
-		goto failed;
-	}
-
-	header = heap_alloc_heap_memory(vitaSAS_heap_internal, 64);
-
-	result = sceFiosFHReadSync(NULL, file, header, 64);
-	if (result < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] Can't read %s sceFiosFHReadSync(): 0x%X", mountedFilePath, result);
-		goto failed;
-	}
-
-	header = vitaSAS_internal_search_WAV_header(0x20746D66, header, &headerSize);
-
-	if (*(short *)(header + 10) > 1) {
-		SCE_DBG_LOG_WARNING("[SAS IO] Only mono files are supported");
-		goto failed;
-	}
-
-	if (*(short *)(header + 22) != 16) {
-		SCE_DBG_LOG_WARNING("[SAS IO] Only 16-bit files are supported");
-		goto failed;
-	}
-
-	int bytesMoved;
-	header = vitaSAS_internal_search_WAV_header(0x61746164, header, &bytesMoved);
-	headerSize += bytesMoved;
-
-	size = *(uint32_t *)(header + 4);
-	offset = headerSize + 8;
-
-	heap_free_heap_memory(vitaSAS_heap_internal, header);
-
-	mem_size = ROUND_UP(size, 4 * 1024);
-	mem_id = sceKernelAllocMemBlock("vitaSAS_sample_storage", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, mem_size, NULL);
-
-	if (mem_id < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] sceKernelAllocMemBlock(): 0x%X", mem_id);
-		goto failed;
-	}
-
-	sceKernelGetMemBlockBase(mem_id, &data);
-
-	result = sceFiosFHPreadSync(NULL, file, data, size, (int64_t)offset);
-	if (result < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] Can't read %s sceFiosFHReadSync(): 0x%X", mountedFilePath, result);
-		goto failed;
-	}
-
-	sceFiosFHCloseSync(NULL, file);
-
-	*outSize = (size_t)result;
-	*mem_id_ret = mem_id;
-	*datap = data;
-
-	return;
-
-failed:
-
-	if (header != NULL)
-		heap_free_heap_memory(vitaSAS_heap_internal, header);
-
-	if (mem_id != 0)
-		sceKernelFreeMemBlock(mem_id);
-
-	if (0 < file) {
-		sceFiosFHCloseSync(NULL, file);
-	}
-
-	return;
-}
-
 static void *vitaSAS_internal_load_audio_FIOS2(char *mountedFilePath, size_t *outSize, SceUID* mem_id_ret)
 {
 	void *data;
@@ -128,7 +34,6 @@ static void *vitaSAS_internal_load_audio_FIOS2(char *mountedFilePath, size_t *ou
 	SceFiosFH file;
 	SceFiosSize size;
 	int result;
-	unsigned int mem_size;
 	mem_id = 0;
 
 	file = 0;
@@ -149,16 +54,12 @@ static void *vitaSAS_internal_load_audio_FIOS2(char *mountedFilePath, size_t *ou
 		goto failed;
 	}
 
-	mem_size = ROUND_UP(size, 4 * 1024);
-	mem_id = sceKernelAllocMemBlock("vitaSAS_sample_storage", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, mem_size, NULL);
-
-	if (mem_id < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] sceKernelAllocMemBlock(): 0x%X", mem_id);
+	data = vitaSAS_internal_sample_alloc(size, &mem_id);
+	if (data == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS IO] vitaSAS_internal_sample_alloc() returned NULL");
 		goto failed;
 	}
 
-	sceKernelGetMemBlockBase(mem_id, &data);
-
 	result = sceFiosFHReadSync(NULL, file, data, size);
 	if (result < 0) {
 		SCE_DBG_LOG_ERROR("[SAS IO] Can't read %s sceFiosFHReadSync(): 0x%X", mountedFilePath, result);
@@ -174,7 +75,7 @@ static void *vitaSAS_internal_load_audio_FIOS2(char *mountedFilePath, size_t *ou
 
 failed:
 
-	sceKernelFreeMemBlock(mem_id);
+	vitaSAS_internal_sample_free(data, mem_id);
 
 	if (0 < file) {
 		sceFiosFHCloseSync(NULL, file);
@@ -183,7 +84,7 @@ failed:
 	return NULL;
 }
 
-static void *vitaSAS_internal_load_audio(char *path, size_t *outSize, SceUID* mem_id_ret, int io_type)
+void *vitaSAS_internal_load_audio(char *path, size_t *outSize, SceUID* mem_id_ret, int io_type)
 {
 	if (io_type == 1)
 		return vitaSAS_internal_load_audio_FIOS2(path, outSize, mem_id_ret);
@@ -191,7 +92,6 @@ static void *vitaSAS_internal_load_audio(char *path, size_t *outSize, SceUID* me
 	void *data;
 	SceUID file, mem_id;
 	int result, size;
-	unsigned int mem_size;
 	mem_id = 0;
 
 	file = 0;
@@ -213,16 +113,12 @@ static void *vitaSAS_internal_load_audio(char *path, size_t *outSize, SceUID* me
 		goto failed;
 	}
 
-	mem_size = ROUND_UP(size, 4 * 1024);
-	mem_id = sceKernelAllocMemBlock("vitaSAS_sample_storage", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, mem_size, NULL);
-
-	if (mem_id < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] sceKernelAllocMemBlock(): 0x%X", mem_id);
+	data = vitaSAS_internal_sample_alloc(size, &mem_id);
+	if (data == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS IO] vitaSAS_internal_sample_alloc() returned NULL");
 		goto failed;
 	}
 
-	sceKernelGetMemBlockBase(mem_id, &data);
-
 	result = sceIoRead(file, data, size);
 	if (result < 0) {
 		SCE_DBG_LOG_ERROR("[SAS IO] Can't read %s sceIoRead(): 0x%X", path, result);
@@ -238,7 +134,7 @@ static void *vitaSAS_internal_load_audio(char *path, size_t *outSize, SceUID* me
 
 failed:
 
-	sceKernelFreeMemBlock(mem_id);
+	vitaSAS_internal_sample_free(data, mem_id);
 
 	if (0 < file) {
 		sceIoClose(file);
@@ -247,106 +143,409 @@ failed:
 	return NULL;
 }
 
-static void vitaSAS_internal_load_audio_WAV(char *path, size_t *outSize, SceUID* mem_id_ret, void** datap, int io_type)
+/* WAV files, RIFF chunks are walked until both format and data chunks have been found */
+
+#define VITASAS_WAV_ID_RIFF			0x46464952
+#define VITASAS_WAV_ID_WAVE			0x45564157
+#define VITASAS_WAV_ID_FMT			0x20746D66
+#define VITASAS_WAV_ID_DATA			0x61746164
+
+#define VITASAS_WAV_FORMAT_PCM			1
+#define VITASAS_WAV_FORMAT_FLOAT		3
+#define VITASAS_WAV_FORMAT_EXTENSIBLE	0xFFFE
+
+#define VITASAS_WAV_READ_CHUNK		(16 * 1024)
+#define VITASAS_WAV_DITHER_SEED		0x2545F491
+
+typedef struct vitaSASWAVFormat {
+	uint16_t formatTag;
+	uint16_t numChannels;
+	uint32_t samplingRate;
+	uint32_t byteRate;
+	uint16_t blockAlign;
+	uint16_t bitsPerSample;
+	uint16_t extensionSize;
+	uint16_t validBitsPerSample;
+	uint32_t channelMask;
+	uint16_t subFormat[8];
+} vitaSASWAVFormat;
+
+static int vitaSAS_internal_file_open(const char *path, int io_type, SceUID *file)
+{
+	SceFiosFH fiosFile;
+	int result;
+
+	if (io_type == 1) {
+		result = sceFiosFHOpenSync(NULL, &fiosFile, path, NULL);
+		*file = fiosFile;
+		return result;
+	}
+
+	result = sceIoOpen(path, SCE_O_RDONLY, 0);
+	*file = result;
+
+	return result < 0 ? result : SCE_OK;
+}
+
+static int vitaSAS_internal_file_pread(SceUID file, int io_type, void *buffer, unsigned int size, unsigned int offset)
 {
 	if (io_type == 1)
-		return vitaSAS_internal_load_audio_WAV_FIOS2(path, outSize, mem_id_ret, datap);
+		return (int)sceFiosFHPreadSync(NULL, file, buffer, size, offset);
 
-	void *data, *header;
-	SceUID file, mem_id;
-	int result, offset, headerSize;
-	unsigned int mem_size, size;
-	mem_id = 0;
+	return sceIoPread(file, buffer, size, offset);
+}
 
-	file = 0;
-	data = NULL;
-	header = NULL;
+static void vitaSAS_internal_file_close(SceUID file, int io_type)
+{
+	if (io_type == 1)
+		sceFiosFHCloseSync(NULL, file);
+	else
+		sceIoClose(file);
+}
 
-	file = sceIoOpen(path, SCE_O_RDONLY, 0);
-	if (file < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] Can't open %s sceIoOpen(): 0x%X", path, file);
-		goto failed;
+static int vitaSAS_internal_parse_WAV(SceUID file, int io_type, vitaSASWAVFormat *format, unsigned int *dataOffset, unsigned int *dataSize)
+{
+	uint32_t chunk[3];
+	unsigned int offset, size;
+	int hasFormat = 0;
+	int result;
+
+	result = vitaSAS_internal_file_pread(file, io_type, chunk, 12, 0);
+	if (result != 12 || chunk[0] != VITASAS_WAV_ID_RIFF || chunk[2] != VITASAS_WAV_ID_WAVE)
+		return VITASAS_ERROR_NOT_SUPPORTED;
+
+	for (offset = 12;; offset += 8 + ROUND_UP(chunk[1], 2)) {
+		if (offset < 12)
+			return VITASAS_ERROR_NOT_SUPPORTED;
+
+		result = vitaSAS_internal_file_pread(file, io_type, chunk, 8, offset);
+		if (result != 8)
+			return VITASAS_ERROR_NOT_SUPPORTED;
+
+		if (chunk[0] == VITASAS_WAV_ID_FMT) {
+			if (chunk[1] < 16)
+				return VITASAS_ERROR_NOT_SUPPORTED;
+
+			size = chunk[1] < sizeof(vitaSASWAVFormat) ? chunk[1] : sizeof(vitaSASWAVFormat);
+
+			sceClibMemset(format, 0, sizeof(vitaSASWAVFormat));
+			result = vitaSAS_internal_file_pread(file, io_type, format, size, offset + 8);
+			if (result != size)
+				return VITASAS_ERROR_NOT_SUPPORTED;
+
+			/* Extensible format keeps the actual format in the first two bytes of the sub format GUID */
+
+			if (format->formatTag == VITASAS_WAV_FORMAT_EXTENSIBLE && size == sizeof(vitaSASWAVFormat))
+				format->formatTag = format->subFormat[0];
+
+			hasFormat = 1;
+		}
+		else if (chunk[0] == VITASAS_WAV_ID_DATA) {
+			if (!hasFormat)
+				return VITASAS_ERROR_NOT_SUPPORTED;
+
+			*dataOffset = offset + 8;
+			*dataSize = chunk[1];
+			return SCE_OK;
+		}
 	}
+}
 
-	header = heap_alloc_heap_memory(vitaSAS_heap_internal, 64);
+static int vitaSAS_internal_is_WAV_supported(const vitaSASWAVFormat *format)
+{
+	if (format->formatTag == VITASAS_WAV_FORMAT_FLOAT)
+		return format->bitsPerSample == 32;
+
+	if (format->formatTag == VITASAS_WAV_FORMAT_PCM) {
+		switch (format->bitsPerSample) {
+		case 8:
+		case 16:
+		case 24:
+		case 32:
+			return 1;
+		}
+	}
 
-	result = sceIoRead(file, header, 64);
-	if (result < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] Can't read header %s sceIoRead(): 0x%X", path, result);
-		goto failed;
+	return 0;
+}
+
+static void vitaSAS_internal_convert_WAV(int16_t *dst, const void *src, const vitaSASWAVFormat *format, unsigned int numSamples, pcm_kernels_dither *dither)
+{
+	if (format->formatTag == VITASAS_WAV_FORMAT_FLOAT) {
+		pcm_kernels_convert_f32_s16(dst, src, numSamples, dither);
+		return;
 	}
 
-	header = vitaSAS_internal_search_WAV_header(0x20746D66, header, &headerSize);
+	switch (format->bitsPerSample) {
+	case 8:
+		pcm_kernels_convert_u8_s16(dst, src, numSamples);
+		break;
+	case 24:
+		pcm_kernels_convert_s24_s16(dst, src, numSamples, dither);
+		break;
+	case 32:
+		pcm_kernels_convert_s32_s16(dst, src, numSamples, dither);
+		break;
+	}
+}
 
-	if (*(short *)(header + 10) > 1) {
-		SCE_DBG_LOG_WARNING("[SAS IO] Only mono files are supported");
-		goto failed;
+/*
+ * Everything except 16-bit mono data is read through a staging buffer one chunk at a time. Each chunk is
+ * converted to S16 straight into the sample, stereo chunks go through the second half of the staging buffer
+ * and are split into the two halves of the sample.
+ */
+
+static int vitaSAS_internal_read_WAV_convert(SceUID file, int io_type, const vitaSASWAVFormat *format, int16_t *data, unsigned int dataOffset, unsigned int numFrames, pcm_kernels_dither *dither)
+{
+	unsigned int frameSize = format->numChannels * (format->bitsPerSample / 8);
+	unsigned int chunkFrames, frame, count;
+	uint8_t *staging;
+	int16_t *converted, *pcm;
+	int result = SCE_OK;
+
+	chunkFrames = VITASAS_WAV_READ_CHUNK / (frameSize > format->numChannels * sizeof(int16_t) ? frameSize : format->numChannels * sizeof(int16_t));
+
+	staging = heap_alloc_heap_memory(vitaSAS_heap_internal, VITASAS_WAV_READ_CHUNK * 2);
+	if (staging == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return SCE_KERNEL_ERROR_NO_MEMORY;
 	}
 
-	if (*(short *)(header + 22) != 16) {
-		SCE_DBG_LOG_WARNING("[SAS IO] Only 16-bit files are supported");
-		goto failed;
+	converted = (int16_t *)(staging + VITASAS_WAV_READ_CHUNK);
+
+	for (frame = 0; frame < numFrames; frame += count) {
+		count = numFrames - frame;
+		if (count > chunkFrames)
+			count = chunkFrames;
+
+		result = vitaSAS_internal_file_pread(file, io_type, staging, count * frameSize, dataOffset + frame * frameSize);
+		if (result < 0)
+			break;
+		if (result != count * frameSize) {
+			result = VITASAS_ERROR_NOT_SUPPORTED;
+			break;
+		}
+
+		if (format->bitsPerSample == 16) {
+			pcm = (int16_t *)staging;
+		}
+		else {
+			pcm = format->numChannels == 2 ? converted : data + frame;
+			vitaSAS_internal_convert_WAV(pcm, staging, format, count * format->numChannels, dither);
+		}
+
+		if (format->numChannels == 2)
+			pcm_kernels_deinterleave_s16_stereo(data + frame, data + numFrames + frame, pcm, count);
+
+		result = SCE_OK;
 	}
 
-	int bytesMoved;
-	header = vitaSAS_internal_search_WAV_header(0x61746164, header, &bytesMoved);
-	headerSize += bytesMoved;
+	heap_free_heap_memory(vitaSAS_heap_internal, staging);
 
-	size = *(uint32_t *)(header + 4);
-	offset = headerSize + 8;
+	return result;
+}
 
-	heap_free_heap_memory(vitaSAS_heap_internal, header);
+static void *vitaSAS_internal_load_audio_WAV(char *path, size_t *outSize, SceUID* mem_id_ret, uint32_t *numChannels, uint32_t *samplingRate, int io_type, const vitaSASLoadParam *param)
+{
+	vitaSASWAVFormat format;
+	pcm_kernels_dither dither;
+	unsigned int dataOffset, dataSize, numFrames;
+	SceUID file, mem_id = 0;
+	void *data = NULL;
+	int result;
 
-	mem_size = ROUND_UP(size, 4 * 1024);
-	mem_id = sceKernelAllocMemBlock("vitaSAS_sample_storage", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, mem_size, NULL);
+	result = vitaSAS_internal_file_open(path, io_type, &file);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS IO] Can't open %s: 0x%X", path, result);
+		return NULL;
+	}
 
-	if (mem_id < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] sceKernelAllocMemBlock(): 0x%X", mem_id);
+	result = vitaSAS_internal_parse_WAV(file, io_type, &format, &dataOffset, &dataSize);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS IO] %s is not a valid WAV file", path);
 		goto failed;
 	}
 
-	sceKernelGetMemBlockBase(mem_id, &data);
+	if (!vitaSAS_internal_is_WAV_supported(&format)) {
+		SCE_DBG_LOG_WARNING("[SAS IO] Only 8, 16, 24 and 32-bit PCM and 32-bit float files are supported");
+		goto failed;
+	}
+
+	if (format.numChannels != 1 && format.numChannels != 2) {
+		SCE_DBG_LOG_WARNING("[SAS IO] Only mono and stereo files are supported");
+		goto failed;
+	}
+
+	numFrames = dataSize / (format.numChannels * (format.bitsPerSample / 8));
+	dataSize = numFrames * format.numChannels * sizeof(int16_t);
 
-	result = sceIoPread(file, data, size, offset);
+	data = vitaSAS_internal_sample_alloc(dataSize, &mem_id);
+	if (data == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS IO] vitaSAS_internal_sample_alloc() returned NULL");
+		goto failed;
+	}
+
+	if (param != NULL && (param->flags & VITASAS_LOAD_FLAG_DITHER))
+		pcm_kernels_dither_init(&dither, VITASAS_WAV_DITHER_SEED);
+
+	if (format.numChannels == 1 && format.bitsPerSample == 16) {
+		result = vitaSAS_internal_file_pread(file, io_type, data, dataSize, dataOffset);
+		if (result >= 0 && result != dataSize)
+			result = VITASAS_ERROR_NOT_SUPPORTED;
+	}
+	else {
+		result = vitaSAS_internal_read_WAV_convert(file, io_type, &format, data, dataOffset, numFrames,
+			param != NULL && (param->flags & VITASAS_LOAD_FLAG_DITHER) ? &dither : NULL);
+	}
 	if (result < 0) {
-		SCE_DBG_LOG_ERROR("[SAS IO] Can't read %s sceIoRead(): 0x%X", path, result);
+		SCE_DBG_LOG_ERROR("[SAS IO] Can't read %s: 0x%X", path, result);
 		goto failed;
 	}
 
-	sceIoClose(file);
+	vitaSAS_internal_file_close(file, io_type);
 
-	*outSize = result;
+	*outSize = dataSize;
 	*mem_id_ret = mem_id;
-	*datap = data;
+	*numChannels = format.numChannels;
+	*samplingRate = format.samplingRate;
 
-	return;
+	return data;
 
 failed:
 
-	if (header != NULL)
-		heap_free_heap_memory(vitaSAS_heap_internal, header);
+	vitaSAS_internal_sample_free(data, mem_id);
+	vitaSAS_internal_file_close(file, io_type);
 
-	if (mem_id != 0)
-		sceKernelFreeMemBlock(mem_id);
+	return NULL;
+}
 
-	if (0 < file) {
-		sceIoClose(file);
+/* Replace sample data with a copy converted to outRate, channels are converted separately */
+
+static int vitaSAS_internal_resample_audio(vitaSASAudio *info, uint32_t inRate, uint32_t outRate)
+{
+	resampler rs;
+	int16_t *table, *data;
+	unsigned int numInput, numOutput, channel;
+	SceUID mem_id;
+
+	if (inRate == 0 || outRate == 0) {
+		SCE_DBG_LOG_ERROR("[SAS] Invalid sampling rate");
+		return VITASAS_ERROR_NOT_SUPPORTED;
+	}
+
+	if (inRate == outRate)
+		return SCE_OK;
+
+	table = heap_alloc_heap_memory(vitaSAS_heap_internal, resampler_get_table_size(inRate, outRate));
+	if (table == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	resampler_init(&rs, inRate, outRate, table);
+
+	numInput = info->data_size / (info->numChannels * sizeof(int16_t));
+	numOutput = resampler_get_num_output(&rs, numInput);
+
+	data = vitaSAS_internal_sample_alloc(numOutput * info->numChannels * sizeof(int16_t), &mem_id);
+	if (data == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_sample_alloc() returned NULL");
+		heap_free_heap_memory(vitaSAS_heap_internal, table);
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	for (channel = 0; channel < info->numChannels; channel++)
+		resampler_process(&rs, data + channel * numOutput, numOutput, (int16_t *)info->datap + channel * numInput, numInput);
+
+	heap_free_heap_memory(vitaSAS_heap_internal, table);
+
+	vitaSAS_internal_sample_free(info->datap, info->data_id);
+
+	info->datap = data;
+	info->data_size = numOutput * info->numChannels * sizeof(int16_t);
+	info->data_id = mem_id;
+	info->storage = mem_id != 0 ? VITASAS_AUDIO_STORAGE_MEMBLOCK : VITASAS_AUDIO_STORAGE_POOL;
+
+	return SCE_OK;
+}
+
+/* Replace mono PCM sample data with a VAG file encoded from it */
+
+static int vitaSAS_internal_encode_audio_VAG(vitaSASAudio *info, uint32_t samplingRate)
+{
+	unsigned int numSamples = info->data_size / sizeof(int16_t);
+	SceUID mem_id;
+	uint8_t *data;
+
+	if (info->numChannels != 1) {
+		SCE_DBG_LOG_WARNING("[SAS] Only mono samples can be encoded to VAG");
+		return VITASAS_ERROR_NOT_SUPPORTED;
 	}
 
-	return;
+	data = vitaSAS_internal_sample_alloc(vag_codec_get_encoded_size(numSamples), &mem_id);
+	if (data == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_sample_alloc() returned NULL");
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	info->data_size = vag_codec_encode(data, info->datap, numSamples, samplingRate);
+
+	vitaSAS_internal_sample_free(info->datap, info->data_id);
+
+	info->datap = data;
+	info->data_id = mem_id;
+	info->storage = mem_id != 0 ? VITASAS_AUDIO_STORAGE_MEMBLOCK : VITASAS_AUDIO_STORAGE_POOL;
+
+	return SCE_OK;
+}
+
+/* Load-time processing shared by the PCM and WAV loaders, samplingRate is 0 when the source rate is unknown */
+
+static int vitaSAS_internal_process_audio(vitaSASAudio *info, uint32_t samplingRate, const vitaSASLoadParam *param)
+{
+	int result;
+
+	if (param == NULL)
+		return SCE_OK;
+
+	if (param->flags & VITASAS_LOAD_FLAG_RESAMPLE) {
+		result = vitaSAS_internal_resample_audio(info, samplingRate, param->samplingRate);
+		if (result < 0)
+			return result;
+
+		samplingRate = param->samplingRate;
+	}
+
+	if (param->flags & VITASAS_LOAD_FLAG_ENCODE_VAG) {
+		result = vitaSAS_internal_encode_audio_VAG(info, samplingRate != 0 ? samplingRate : 48000);
+		if (result < 0)
+			return result;
+	}
+
+	return SCE_OK;
 }
 
 int vitaSAS_finish(void)
 {
-	sceKernelDeleteEventFlag(SASSystemFlagUID);
+	/* Release SAS system table, chunks are freed together with the heap */
+
+	sceKernelDeleteLwMutex(&SASSystemTableMutex);
+
+	vitaSAS_internal_mix_graph_term();
+
+	for (int i = 0; i < VITASAS_SYSTEM_TABLE_CHUNK_MAX; i++)
+		SASSystemTable[i] = NULL;
 
 	/* Release decoder BGM port */
 
 	if (g_portIdBGM > 0)
 		sceAudioOutReleasePort(g_portIdBGM);
 
-	/* Delete heap */
+	/* Delete sample pool and heap */
 
+	vitaSAS_internal_stream_term();
+	vitaSAS_internal_sample_cache_term();
+	vitaSAS_internal_sample_pool_term();
 	heap_delete_heap(vitaSAS_heap_internal);
 
 	/* Unload the SAS module */
@@ -359,26 +558,321 @@ void vitaSAS_set_heap_size(unsigned int size)
 	heap_size = size;
 }
 
+/*
+ * Chunks are never freed before vitaSAS_finish(), so the lookup needs no lock. The system itself is not
+ * protected: destroying a system that another thread still uses is an application error.
+ */
+
+vitaSASSystem* vitaSAS_get_system(int systemNum)
+{
+	vitaSASSystemTableChunk* chunk;
+
+	if (systemNum < 0 || systemNum >= MAX_SAS_SYSTEM_NUM)
+		return NULL;
+
+	chunk = SASSystemTable[systemNum / VITASAS_SYSTEM_TABLE_CHUNK_SIZE];
+	ATOMIC_BARRIER();
+
+	if (chunk == NULL)
+		return NULL;
+
+	return chunk->system[systemNum % VITASAS_SYSTEM_TABLE_CHUNK_SIZE];
+}
+
+static vitaSASSystemTableChunk* vitaSAS_internal_grow_system_table(int chunkNum)
+{
+	vitaSASSystemTableChunk* chunk;
+
+	/* Growing is rare, so it is serialized. Slot allocation itself is lock-free */
+
+	sceKernelLockLwMutex(&SASSystemTableMutex, 1, NULL);
+
+	chunk = SASSystemTable[chunkNum];
+	if (chunk == NULL) {
+		chunk = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASSystemTableChunk));
+		if (chunk != NULL) {
+			sceClibMemset(chunk, 0, sizeof(vitaSASSystemTableChunk));
+			ATOMIC_BARRIER();
+			SASSystemTable[chunkNum] = chunk;
+			SCE_DBG_LOG_DEBUG("[SAS] System table extended to %d entries", (chunkNum + 1) * VITASAS_SYSTEM_TABLE_CHUNK_SIZE);
+		}
+		else
+			SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+	}
+
+	sceKernelUnlockLwMutex(&SASSystemTableMutex, 1);
+
+	return chunk;
+}
+
+static int vitaSAS_internal_register_system(vitaSASSystem* system)
+{
+	vitaSASSystemTableChunk* chunk;
+	int32_t usedMask, slotBit;
+	int slot;
+
+	/* Slot N of a chunk is tracked by bit (31 - N) so that CLZ of the inverted mask yields the first free slot */
+
+	for (int i = 0; i < VITASAS_SYSTEM_TABLE_CHUNK_MAX; i++) {
+
+		chunk = SASSystemTable[i];
+		ATOMIC_BARRIER();
+
+		if (chunk == NULL) {
+			chunk = vitaSAS_internal_grow_system_table(i);
+			if (chunk == NULL)
+				return -1;
+		}
+
+		usedMask = atomic_load32(&chunk->usedMask);
+
+		while (usedMask != (int32_t)0xFFFFFFFF) {
+			slot = __builtin_clz(~(uint32_t)usedMask);
+			slotBit = (int32_t)(0x80000000U >> slot);
+
+			if (atomic_cas32(&chunk->usedMask, usedMask, usedMask | slotBit) == usedMask) {
+				SCE_DBG_LOG_DEBUG("[SAS] Found free position: %d", i * VITASAS_SYSTEM_TABLE_CHUNK_SIZE + slot);
+				system->systemNum = i * VITASAS_SYSTEM_TABLE_CHUNK_SIZE + slot;
+				system->audioWork.systemNum = system->systemNum;
+				ATOMIC_BARRIER();
+				chunk->system[slot] = system;
+				return system->systemNum;
+			}
+
+			usedMask = atomic_load32(&chunk->usedMask);
+		}
+	}
+
+	return -1;
+}
+
+static void vitaSAS_internal_unregister_system(vitaSASSystem* system)
+{
+	vitaSASSystemTableChunk* chunk = SASSystemTable[system->systemNum / VITASAS_SYSTEM_TABLE_CHUNK_SIZE];
+	int slot = system->systemNum % VITASAS_SYSTEM_TABLE_CHUNK_SIZE;
+
+	chunk->system[slot] = NULL;
+	atomic_and32(&chunk->usedMask, ~(int32_t)(0x80000000U >> slot));
+}
+
+static int vitaSAS_internal_apply_command_SAS(SceUID handle, const vitaSASCommand* command)
+{
+	switch (command->type) {
+	case VITASAS_COMMAND_SET_VOICE:
+		return sceSasSetVoiceInternal(handle, command->voiceID, command->ptr, command->arg[0], command->arg[1]);
+	case VITASAS_COMMAND_SET_VOICE_PCM:
+		return sceSasSetVoicePCMInternal(handle, command->voiceID, command->ptr, command->arg[0], (SceInt32)command->arg[1]);
+	case VITASAS_COMMAND_SET_NOISE:
+		return sceSasSetNoiseInternal(handle, command->voiceID, command->arg[0]);
+	case VITASAS_COMMAND_SET_PITCH:
+		return sceSasSetPitchInternal(handle, command->voiceID, command->arg[0]);
+	case VITASAS_COMMAND_SET_VOLUME:
+		return sceSasSetVolumeInternal(handle, command->voiceID, command->arg[0], command->arg[1], command->arg[2], command->arg[3]);
+	case VITASAS_COMMAND_SET_SIMPLE_ADSR:
+		return sceSasSetSimpleADSRInternal(handle, command->voiceID, command->arg[0], command->arg[1]);
+	case VITASAS_COMMAND_SET_SL:
+		return sceSasSetSLInternal(handle, command->voiceID, command->arg[0]);
+	case VITASAS_COMMAND_SET_ADSR_MODE:
+		return sceSasSetADSRmodeInternal(handle, command->voiceID, command->arg[0], command->arg[1], command->arg[2], command->arg[3], command->arg[4]);
+	case VITASAS_COMMAND_SET_ADSR:
+		return sceSasSetADSRInternal(handle, command->voiceID, command->arg[0], command->arg[1], command->arg[2], command->arg[3], command->arg[4]);
+	case VITASAS_COMMAND_SET_KEY_ON:
+		return sceSasSetKeyOnInternal(handle, command->voiceID);
+	case VITASAS_COMMAND_SET_KEY_OFF:
+		return sceSasSetKeyOffInternal(handle, command->voiceID);
+	case VITASAS_COMMAND_SET_EFFECT:
+		sceSasSetEffectTypeInternal(handle, command->arg[0]);
+		sceSasSetEffectParamInternal(handle, command->arg[3], command->arg[4]);
+		return sceSasSetEffectVolumeInternal(handle, command->arg[1], command->arg[2]);
+	case VITASAS_COMMAND_SET_EFFECT_TYPE:
+		return sceSasSetEffectTypeInternal(handle, command->arg[0]);
+	case VITASAS_COMMAND_SET_SWITCH_CONFIG:
+		return sceSasSetEffectInternal(handle, command->arg[0], command->arg[1]);
+	default:
+		return -1;
+	}
+}
+
+/* Commands for the left voice of a stereo pair are mirrored to the right voice, volumes are split between them */
+
+static void vitaSAS_internal_apply_command_linked(vitaSASSystem* system, const vitaSASCommand* command)
+{
+	vitaSASCommand linked;
+
+	switch (command->type) {
+	case VITASAS_COMMAND_SET_VOICE:
+	case VITASAS_COMMAND_SET_VOICE_PCM:
+	case VITASAS_COMMAND_SET_NOISE:
+	case VITASAS_COMMAND_LINK_VOICE:
+	case VITASAS_COMMAND_RELEASE_SAMPLE:
+		return;
+	default:
+		break;
+	}
+
+	linked = *command;
+	linked.voiceID = command->voiceID + 1;
+
+	if (command->type == VITASAS_COMMAND_SET_VOLUME) {
+		linked.arg[0] = 0;
+		linked.arg[2] = 0;
+	}
+
+	vitaSAS_internal_apply_command(system, &linked);
+}
+
+int vitaSAS_internal_apply_command(vitaSASSystem* system, const vitaSASCommand* command)
+{
+	const vitaSASCommand* applied = command;
+	vitaSASCommand left;
+	int isLinked;
+	int result;
+
+	if (command->type == VITASAS_COMMAND_LINK_VOICE) {
+		vitaSAS_internal_voice_pool_set_link(&system->voicePool, command->voiceID, command->arg[0]);
+		return SCE_OK;
+	}
+
+	if (command->type == VITASAS_COMMAND_RELEASE_SAMPLE) {
+		vitaSAS_internal_voice_pool_set_sample(&system->voicePool, command->voiceID, 0);
+		return SCE_OK;
+	}
+
+	/* New waveform breaks the pair */
+
+	if (command->type == VITASAS_COMMAND_SET_VOICE || command->type == VITASAS_COMMAND_SET_VOICE_PCM || command->type == VITASAS_COMMAND_SET_NOISE)
+		vitaSAS_internal_voice_pool_set_link(&system->voicePool, command->voiceID, 0);
+
+	isLinked = vitaSAS_internal_voice_pool_is_linked(&system->voicePool, command->voiceID);
+
+	if (isLinked && command->type == VITASAS_COMMAND_SET_VOLUME) {
+		left = *command;
+		left.arg[1] = 0;
+		left.arg[3] = 0;
+		applied = &left;
+	}
+
+	if (system->softMixer != NULL)
+		result = vitaSAS_internal_soft_mixer_apply(system->softMixer, applied);
+	else
+		result = vitaSAS_internal_apply_command_SAS(system->sasSystemHandle, applied);
+
+	if (isLinked)
+		vitaSAS_internal_apply_command_linked(system, command);
+
+	/* Voice takes over the reference to its new cached sample and drops the old one */
+
+	if (command->type == VITASAS_COMMAND_SET_VOICE || command->type == VITASAS_COMMAND_SET_VOICE_PCM)
+		vitaSAS_internal_voice_pool_set_sample(&system->voicePool, command->voiceID, command->arg[2]);
+	else if (command->type == VITASAS_COMMAND_SET_NOISE)
+		vitaSAS_internal_voice_pool_set_sample(&system->voicePool, command->voiceID, 0);
+
+	if (command->type == VITASAS_COMMAND_SET_KEY_ON && result == SCE_OK)
+		vitaSAS_internal_voice_pool_key_on(&system->voicePool, command->voiceID);
+
+	if (result == SCE_OK)
+		vitaSAS_internal_stream_apply_command(system, command);
+
+	return result;
+}
+
+int vitaSAS_internal_get_end_state(vitaSASSystem* system, unsigned int voiceID)
+{
+	if (system->softMixer != NULL)
+		return vitaSAS_internal_soft_mixer_get_end_state(system->softMixer, voiceID);
+
+	return sceSasGetEndStateInternal(system->sasSystemHandle, voiceID);
+}
+
+int vitaSAS_internal_submit_command(vitaSASSystem* system, const vitaSASCommand* command)
+{
+	vitaSASCommandFrame* frame;
+	int result;
+
+	/* Apply directly if command queue is disabled for this system */
+
+	if (system->commandQueue.commands == NULL)
+		return vitaSAS_internal_apply_command(system, command);
+
+	/* Stage if the calling thread has a command frame open */
+
+	frame = vitaSAS_internal_command_queue_find_frame(&system->commandQueue, sceKernelGetThreadId());
+	if (frame != NULL) {
+		result = vitaSAS_internal_command_queue_stage(&system->commandQueue, frame, command);
+		if (result < 0)
+			SCE_DBG_LOG_WARNING("[SAS] Command frame is larger than command queue, frame will be dropped");
+
+		return result;
+	}
+
+	result = vitaSAS_internal_command_queue_push(&system->commandQueue, command);
+	if (result < 0)
+		SCE_DBG_LOG_WARNING("[SAS] Command queue is full, command %u for voice %u dropped", command->type, command->voiceID);
+
+	return result;
+}
+
+void vitaSAS_internal_apply_command_queue(vitaSASSystem* system)
+{
+	vitaSASCommand command;
+
+	if (system->commandQueue.commands == NULL)
+		return;
+
+	/* Apply all pending commands so that they land on the same grain */
+
+	while (vitaSAS_internal_command_queue_pop(&system->commandQueue, &command))
+		vitaSAS_internal_apply_command(system, &command);
+}
+
 void vitaSAS_internal_update(void* buffer, int SASSystemNum)
 {
-	/* Rendering audio frame (grain[samples]) */
+	vitaSASSystem* root = vitaSAS_get_system(SASSystemNum);
+	const vitaSASMixPlan* plan = &root->mixPlan;
+	unsigned int numGrain = root->audioWork.numGrain;
+
+	sceKernelLockLwMutex(&root->mixPlanMutex, 1, NULL);
+
+	if (plan->numEntries == 0)
+		sceClibMemset(buffer, 0, numGrain * sizeof(int16_t) * CHANNEL_MAX);
 
-	if (SASSystemStorage[SASSystemNum]->subSystemNum == -1)
-		sceSasCoreInternal(SASSystemStorage[SASSystemNum]->sasSystemHandle, buffer, 0, 0);
+	/* Rendering audio frame (grain[samples]), children always come before their parent */
+
+	if (root->renderWorkers != NULL && plan->numJobs > 1) {
+
+		/* Render subtrees of root children in parallel, then mix them in order and render root */
+
+		vitaSAS_internal_render_workers_run(root->renderWorkers, plan, buffer, numGrain);
+
+		for (int i = 0; i < plan->numJobs; i++)
+			vitaSAS_internal_mix_graph_mix_entry(&plan->entries[plan->jobs[i].end - 1], buffer, numGrain);
+
+		vitaSAS_internal_mix_graph_render_entry(&plan->entries[plan->numEntries - 1], buffer);
+	}
 	else {
-		vitaSAS_internal_update(buffer, SASSystemStorage[SASSystemNum]->subSystemNum);
-		sceSasCoreInternal(SASSystemStorage[SASSystemNum]->sasSystemHandle, buffer, SASSystemStorage[SASSystemNum]->subSystemMixVolL, SASSystemStorage[SASSystemNum]->subSystemMixVolR);
+		for (int i = 0; i < plan->numEntries; i++) {
+			vitaSAS_internal_mix_graph_render_entry(&plan->entries[i], buffer);
+			vitaSAS_internal_mix_graph_mix_entry(&plan->entries[i], buffer, numGrain);
+		}
 	}
+
+	sceKernelUnlockLwMutex(&root->mixPlanMutex, 1);
 }
 
 int vitaSAS_init(unsigned int openBGM)
 {
-	int SASFlag = 1;
-
 	/* Initialize heap */
 
 	vitaSAS_heap_internal = heap_create_heap("vitaSAS_heap", heap_size, HEAP_AUTO_EXTEND, NULL);
 
+	/* Initialize sample pool, samples get memory blocks of their own if it can't be created */
+
+	vitaSAS_internal_sample_pool_init();
+
+	/* Initialize streaming voices */
+
+	vitaSAS_internal_stream_init();
+
 	/* Open BGM port for Codec Engine decoders */
 
 	if (openBGM) {
@@ -391,22 +885,46 @@ int vitaSAS_init(unsigned int openBGM)
 			SCE_DBG_LOG_ERROR("[DEC] sceAudioOutOpenPort(): 0x%X", g_portIdBGM);
 	}
 
-	/* Initialize SAS system position flag */
+	/* Initialize SAS system table */
 
-	SASSystemFlagUID = sceKernelCreateEventFlag("SASSystemPostionTracker", SCE_KERNEL_ATTR_MULTI, 0, NULL);
+	sceKernelCreateLwMutex(&SASSystemTableMutex, "vitaSAS_system_table", 0, 0, NULL);
 
-	for (int i = 0; i < MAX_SAS_SYSTEM_NUM; i++) {
-		SASSystenEVF[i] = SASFlag;
-		SASFlag *= 2;
-	}
+	for (int i = 0; i < VITASAS_SYSTEM_TABLE_CHUNK_MAX; i++)
+		SASSystemTable[i] = NULL;
+
+	/* Initialize mix graph */
+
+	vitaSAS_internal_mix_graph_init();
 
 	return sceSysmoduleLoadModule(SCE_SYSMODULE_SAS);
 }
 
+void vitaSAS_system_set_sub_system_vol(vitaSASSystem* system, unsigned int subSystemMixVolL, unsigned int subSystemMixVolR)
+{
+	vitaSASSystem* subSystem = vitaSAS_get_system(system->subSystemNum);
+
+	system->subSystemMixVolL = subSystemMixVolL;
+	system->subSystemMixVolR = subSystemMixVolR;
+
+	/* Subsystem set at creation is a child of this system in the mix graph */
+
+	if (subSystem != NULL && subSystem->parent == system)
+		vitaSAS_system_set_mix_vol(subSystem, subSystemMixVolL, subSystemMixVolR);
+}
+
 void vitaSAS_set_sub_system_vol(unsigned int subSystemMixVolL, unsigned int subSystemMixVolR)
 {
-	SASSystemStorage[SASCurrentSystemNum]->subSystemMixVolL = subSystemMixVolL;
-	SASSystemStorage[SASCurrentSystemNum]->subSystemMixVolR = subSystemMixVolR;
+	vitaSAS_system_set_sub_system_vol(vitaSAS_get_system(SASCurrentSystemNum), subSystemMixVolL, subSystemMixVolR);
+}
+
+int vitaSAS_connect_system(int childSystemNum, int parentSystemNum, unsigned int mixVolL, unsigned int mixVolR)
+{
+	return vitaSAS_system_connect(vitaSAS_get_system(childSystemNum), vitaSAS_get_system(parentSystemNum), mixVolL, mixVolR);
+}
+
+int vitaSAS_disconnect_system(int childSystemNum)
+{
+	return vitaSAS_system_disconnect(vitaSAS_get_system(childSystemNum));
 }
 
 void vitaSAS_select_system(int systemNum)
@@ -414,34 +932,105 @@ void vitaSAS_select_system(int systemNum)
 	SASCurrentSystemNum = systemNum;
 }
 
+SceUID vitaSAS_system_get_handle(vitaSASSystem* system)
+{
+	return system->sasSystemHandle;
+}
+
 SceUID vitaSAS_get_system_handle(void)
 {
-	return SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle;
+	return vitaSAS_system_get_handle(vitaSAS_get_system(SASCurrentSystemNum));
 }
 
-void vitaSAS_destroy_system(void)
+int vitaSAS_system_render_grains(vitaSASSystem* system, int16_t* buffer, unsigned int numGrains)
 {
-	size_t bufferSize;
+	unsigned int numGrain = system->audioWork.numGrain;
+	uint32_t grainTime;
+	SceUInt64 renderStart;
+
+	/* Only root systems without output thread can be pulled */
+
+	if (system->isSubSystem || system->audioWork.outputPort != VITASAS_OUTPUT_PORT_NONE)
+		return VITASAS_ERROR_NOT_SUPPORTED;
+
+	grainTime = 0;
+	if (system->audioWork.outputSamplingRate != 0)
+		grainTime = numGrain * 1000000 / system->audioWork.outputSamplingRate;
+
+	for (unsigned int i = 0; i < numGrains; i++) {
+		renderStart = sceKernelGetProcessTimeWide();
+		vitaSAS_internal_update(buffer + i * numGrain * CHANNEL_MAX, system->systemNum);
+		vitaSAS_internal_render_stats_record(&system->audioWork.renderStats, grainTime, (uint32_t)(sceKernelGetProcessTimeWide() - renderStart), 0, 0);
+	}
+
+	return SCE_OK;
+}
+
+int vitaSAS_render_grains(int16_t* buffer, unsigned int numGrains)
+{
+	return vitaSAS_system_render_grains(vitaSAS_get_system(SASCurrentSystemNum), buffer, numGrains);
+}
+
+int vitaSAS_get_render_stats(vitaSASRenderStats* stats)
+{
+	return vitaSAS_system_get_render_stats(vitaSAS_get_system(SASCurrentSystemNum), stats);
+}
+
+int vitaSAS_get_output_latency(void)
+{
+	return vitaSAS_system_get_output_latency(vitaSAS_get_system(SASCurrentSystemNum));
+}
+
+void vitaSAS_system_destroy(vitaSASSystem* system)
+{
+	SceUID eventFlagId = system->audioWork.eventFlagId;
+	SceSize bufferSize;
 	void *buffer;
 
-	/* Stop audio out server*/
+	/* Stop audio out server, this clears audio work of root systems */
 
-	if (!SASSystemStorage[SASCurrentSystemNum]->isSubSystem)
-		vitaSAS_internal_audio_out_stop(&SASSystemStorage[SASCurrentSystemNum]->audioWork);
+	if (!system->isSubSystem)
+		vitaSAS_internal_audio_out_stop(&system->audioWork);
+
+	if (system->renderWorkers != NULL)
+		vitaSAS_internal_render_workers_stop(system->renderWorkers);
+
+	/* Close streams playing on this system */
+
+	vitaSAS_internal_stream_close_system(system);
+
+	/* Remove from mix graph */
+
+	vitaSAS_internal_mix_graph_detach(system);
+
+	/* Unregister SAS system position */
+
+	vitaSAS_internal_unregister_system(system);
 
 	/* Exit SAS system */
 
-	sceSasExitInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, &buffer, &bufferSize);
+	if (system->softMixer != NULL) {
+		vitaSAS_internal_soft_mixer_destroy(system->softMixer);
+	}
+	else {
+		sceSasExitInternal(system->sasSystemHandle, &buffer, &bufferSize);
+		heap_free_heap_memory(vitaSAS_heap_internal, buffer);
+	}
+
+	vitaSAS_internal_command_queue_destroy(&system->commandQueue);
+	vitaSAS_internal_voice_pool_release_samples(&system->voicePool);
 
-	heap_free_heap_memory(vitaSAS_heap_internal, buffer);
-	heap_free_heap_memory(vitaSAS_heap_internal, SASSystemStorage[SASCurrentSystemNum]);
+	sceKernelDeleteEventFlag(eventFlagId);
 
-	/* Unregister SAS system position */
+	heap_free_heap_memory(vitaSAS_heap_internal, system);
+}
 
-	sceKernelClearEventFlag(SASSystemFlagUID, ~SASSystenEVF[SASCurrentSystemNum]);
+void vitaSAS_destroy_system(void)
+{
+	vitaSAS_system_destroy(vitaSAS_get_system(SASCurrentSystemNum));
 }
 
-int vitaSAS_create_system_with_config(const char* sasConfig, VitaSASSystemParam* systemInitParam)
+vitaSASSystem* vitaSAS_system_create(const char* sasConfig, VitaSASSystemParam* systemInitParam)
 {
 	void *buffer = NULL;
 	SceSize bufferSize;
@@ -450,14 +1039,29 @@ int vitaSAS_create_system_with_config(const char* sasConfig, VitaSASSystemParam*
 	/* Check input parameters */
 
 	if (systemInitParam->outputPort != SCE_AUDIO_OUT_PORT_TYPE_MAIN
-		&& systemInitParam->outputPort != SCE_AUDIO_OUT_PORT_TYPE_BGM) {
+		&& systemInitParam->outputPort != SCE_AUDIO_OUT_PORT_TYPE_BGM
+		&& systemInitParam->outputPort != VITASAS_OUTPUT_PORT_NONE) {
 		SCE_DBG_LOG_ERROR("[SAS] Invalid port type");
-		return -1;
+		return NULL;
 	}
 
 	if (VITASAS_GRAIN_MAX < systemInitParam->numGrain) {
 		SCE_DBG_LOG_ERROR("[SAS] Invalid grain value");
-		return -1;
+		return NULL;
+	}
+
+	if (systemInitParam->numGrainMax != 0 && (VITASAS_GRAIN_MAX < systemInitParam->numGrainMax
+		|| systemInitParam->numGrainMin < VITASAS_GRAIN_ALIGN || systemInitParam->numGrain < systemInitParam->numGrainMin
+		|| systemInitParam->numGrainMax < systemInitParam->numGrain
+		|| (systemInitParam->numGrainMin | systemInitParam->numGrainMax) & (VITASAS_GRAIN_ALIGN - 1))) {
+		SCE_DBG_LOG_ERROR("[SAS] Invalid adaptive grain range");
+		return NULL;
+	}
+
+	if (VITASAS_OUTPUT_BUFFER_MAX < systemInitParam->numOutputBuffers
+		|| VITASAS_OUTPUT_BUFFER_MAX - 2 < systemInitParam->renderAhead) {
+		SCE_DBG_LOG_ERROR("[SAS] Invalid output buffer configuration");
+		return NULL;
 	}
 
 	/* Create SAS system instance */
@@ -465,109 +1069,197 @@ int vitaSAS_create_system_with_config(const char* sasConfig, VitaSASSystemParam*
 	vitaSASSystem* system = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASSystem));
 	if (system == NULL) {
 		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
-		return -1;
+		return NULL;
 	}
 
 	/* Clear work */
 
 	sceClibMemset(&system->audioWork, 0, sizeof(AudioOutWork));
+	sceClibMemset(&system->commandQueue, 0, sizeof(vitaSASCommandQueue));
+	system->renderWorkers = NULL;
+	system->softMixer = NULL;
+
+	vitaSAS_internal_voice_pool_init(&system->voicePool, sasConfig);
 
 	/* Prepair work */
 
 	system->audioWork.outputPort = systemInitParam->outputPort;
 	system->audioWork.numGrain = systemInitParam->numGrain;
 	system->audioWork.outputSamplingRate = systemInitParam->samplingRate;
-	system->audioWork.renderHandler = vitaSAS_internal_update;
-
-	/* Search vacant SAS system position and resister new system */
 
-	for (int i = 0; i < MAX_SAS_SYSTEM_NUM; i++) {
-		result = sceKernelPollEventFlag(SASSystemFlagUID, SASSystenEVF[i], SCE_KERNEL_EVF_WAITMODE_AND, NULL);
-		if (result < 0) {
-			SCE_DBG_LOG_DEBUG("[SAS] Found free position: %d", i);
-			sceKernelSetEventFlag(SASSystemFlagUID, SASSystenEVF[i]);
-			system->audioWork.systemNum = i;
-			system->systemNum = i;
-			SASSystemStorage[i] = system;
-			break;
-		}
-	}
+	/* Grain and output ring of subsystems follow their root */
 
-	if (result == 0) {
-		SCE_DBG_LOG_WARNING("[SAS] Can't register new system");
-		goto error;
+	if (!systemInitParam->isSubSystem) {
+		system->audioWork.numGrainMin = systemInitParam->numGrainMin;
+		system->audioWork.numGrainMax = systemInitParam->numGrainMax;
+		system->audioWork.numBuffers = systemInitParam->numOutputBuffers;
+		system->audioWork.renderAhead = systemInitParam->renderAhead;
 	}
+	system->audioWork.renderHandler = vitaSAS_internal_update;
 
 	system->isSubSystem = systemInitParam->isSubSystem;
 	system->subSystemNum = systemInitParam->subSystemNum;
 	system->subSystemMixVolL = systemInitParam->subSystemMixVolL;
 	system->subSystemMixVolR = systemInitParam->subSystemMixVolR;
 
-	/* Initialize SAS system */
+	if (systemInitParam->mixerType == VITASAS_MIXER_SOFTWARE) {
+
+		/* Initialize software mixer */
+
+		system->sasSystemHandle = -1;
+		system->softMixer = vitaSAS_internal_soft_mixer_create(system->voicePool.numVoices);
+		if (system->softMixer == NULL) {
+			SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_soft_mixer_create() returned NULL");
+			goto error;
+		}
+	}
+	else {
+
+		/* Initialize SAS system */
+
+		result = sceSasGetNeededMemorySizeInternal(sasConfig, &bufferSize);
+		if (SCE_SAS_FAILED(result)) {
+			SCE_DBG_LOG_ERROR("[SAS] sceSasGetNeededMemorySizeInternal(): 0x%X", result);
+			goto error;
+		}
+
+		SCE_DBG_LOG_DEBUG("[SAS] SAS system requested: %f MB", (float)bufferSize / 1024.0f / 1024.0f);
+
+		buffer = heap_alloc_heap_memory(vitaSAS_heap_internal, bufferSize);
+		if (buffer == NULL) {
+			SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+			goto error;
+		}
+
+		result = sceSasInitInternal(sasConfig, buffer, bufferSize, &system->sasSystemHandle);
+		if (SCE_SAS_FAILED(result)) {
+			SCE_DBG_LOG_ERROR("[SAS] sceSasInitWithGrainInternal(): 0x%X", result);
+			goto error;
+		}
+
+		result = sceSasSetGrainInternal(system->sasSystemHandle, systemInitParam->numGrain);
+		if (SCE_SAS_FAILED(result)) {
+			SCE_DBG_LOG_ERROR("[SAS] sceSasSetGrainInternal(): 0x%X", result);
+			goto error_exit;
+		}
+	}
 
-	result = sceSasGetNeededMemorySizeInternal(sasConfig, &bufferSize);
-	if (SCE_SAS_FAILED(result)) {
-		SCE_DBG_LOG_ERROR("[SAS] sceSasGetNeededMemorySizeInternal(): 0x%X", result);
-		goto error;
+	/* Create voice command queue */
+
+	if (systemInitParam->commandQueueSize != 0) {
+		result = vitaSAS_internal_command_queue_create(&system->commandQueue, systemInitParam->commandQueueSize);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_command_queue_create(): 0x%X", result);
+			goto error_exit;
+		}
 	}
 
-	SCE_DBG_LOG_DEBUG("[SAS] SAS system requested: %f MB", (float)bufferSize / 1024.0f / 1024.0f);
+	/* Search vacant SAS system position and resister new system */
 
-	buffer = heap_alloc_heap_memory(vitaSAS_heap_internal, bufferSize);
-	if (buffer == NULL) {
-		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
-		goto error;
+	result = vitaSAS_internal_register_system(system);
+	if (result < 0) {
+		SCE_DBG_LOG_WARNING("[SAS] Can't register new system");
+		goto error_exit;
 	}
 
-	result = sceSasInitInternal(sasConfig, buffer, bufferSize, &system->sasSystemHandle);
-	if (SCE_SAS_FAILED(result)) {
-		SCE_DBG_LOG_ERROR("[SAS] sceSasInitWithGrainInternal(): 0x%X", result);
-		goto error;
+	/* Add to mix graph, subsystem from parameters becomes the first child */
+
+	result = vitaSAS_internal_mix_graph_attach(system);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_mix_graph_attach(): 0x%X", result);
+		vitaSAS_internal_unregister_system(system);
+		goto error_exit;
 	}
 
-	result = sceSasSetGrainInternal(system->sasSystemHandle, systemInitParam->numGrain);
-	if (SCE_SAS_FAILED(result)) {
-		SCE_DBG_LOG_ERROR("[SAS] sceSasSetGrainInternal(): 0x%X", result);
-		goto error;
+	if (system->subSystemNum != VITASAS_NO_SUBSYSTEM) {
+		result = vitaSAS_system_connect(vitaSAS_get_system(system->subSystemNum), system, system->subSystemMixVolL, system->subSystemMixVolR);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS] vitaSAS_system_connect(): 0x%X", result);
+			vitaSAS_internal_mix_graph_detach(system);
+			vitaSAS_internal_unregister_system(system);
+			goto error_exit;
+		}
 	}
 
 	/* Create audio out thread pause flag */
 
 	system->audioWork.eventFlagId = sceKernelCreateEventFlag("SASSystemRenderPauseFlag", SCE_KERNEL_ATTR_MULTI, 1, NULL);
 
-	/* Start audioout server */
+	/* Start audioout server, pulled systems are rendered by the application */
 
 	if (!system->isSubSystem) {
 
-		result = vitaSAS_internal_audio_out_start(&system->audioWork, systemInitParam->thPriority, systemInitParam->thStackSize, systemInitParam->thCpu);
+		/* Start parallel render workers */
+
+		if (systemInitParam->numRenderWorkers != 0) {
+			system->renderWorkers = vitaSAS_internal_render_workers_start(systemInitParam->numRenderWorkers, systemInitParam->thPriority,
+				systemInitParam->thStackSize, systemInitParam->thCpu, systemInitParam->renderWorkerCpu);
+			if (system->renderWorkers == NULL)
+				SCE_DBG_LOG_WARNING("[SAS] Can't start render workers, rendering serially");
+		}
+
+		if (systemInitParam->outputPort != VITASAS_OUTPUT_PORT_NONE)
+			result = vitaSAS_internal_audio_out_start(&system->audioWork, systemInitParam->thPriority, systemInitParam->thStackSize, systemInitParam->thCpu);
+		else
+			result = SCE_OK;
 
 		if (result < 0) {
 			SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_audio_out_start(): 0x%X", result);
-			goto error;
+			if (system->renderWorkers != NULL)
+				vitaSAS_internal_render_workers_stop(system->renderWorkers);
+			sceKernelDeleteEventFlag(system->audioWork.eventFlagId);
+			vitaSAS_internal_mix_graph_detach(system);
+			vitaSAS_internal_unregister_system(system);
+			goto error_exit;
 		}
 
 	}
 
-	result = system->systemNum;
+	return system;
 
-	return result;
+error_exit:
+
+	if (system->softMixer != NULL)
+		vitaSAS_internal_soft_mixer_destroy(system->softMixer);
+	else
+		sceSasExitInternal(system->sasSystemHandle, &buffer, &bufferSize);
 
 error:
 
 	if (buffer != NULL)
 		heap_free_heap_memory(vitaSAS_heap_internal, buffer);
+	vitaSAS_internal_command_queue_destroy(&system->commandQueue);
 	heap_free_heap_memory(vitaSAS_heap_internal, system);
-	return -1;
+	return NULL;
+}
+
+int vitaSAS_create_system_with_config(const char* sasConfig, VitaSASSystemParam* systemInitParam)
+{
+	vitaSASSystem* system = vitaSAS_system_create(sasConfig, systemInitParam);
+	if (system == NULL)
+		return -1;
+
+	return system->systemNum;
+}
+
+int vitaSAS_system_pause_render(vitaSASSystem* system)
+{
+	return sceKernelClearEventFlag(system->audioWork.eventFlagId, ~1);
 }
 
 int vitaSAS_pause_system_render(void)
 {
-	return sceKernelClearEventFlag(SASSystemStorage[SASCurrentSystemNum]->audioWork.eventFlagId, ~1);
+	return vitaSAS_system_pause_render(vitaSAS_get_system(SASCurrentSystemNum));
+}
+
+int vitaSAS_system_resume_render(vitaSASSystem* system)
+{
+	return sceKernelSetEventFlag(system->audioWork.eventFlagId, 1);
 }
 
 int vitaSAS_resume_system_render(void)
 {
-	return sceKernelSetEventFlag(SASSystemStorage[SASCurrentSystemNum]->audioWork.eventFlagId, 1);
+	return vitaSAS_system_resume_render(vitaSAS_get_system(SASCurrentSystemNum));
 }
 
 int vitaSAS_create_system(VitaSASSystemParam* systemInitParam)
@@ -577,8 +1269,13 @@ int vitaSAS_create_system(VitaSASSystemParam* systemInitParam)
 
 void vitaSAS_free_audio(vitaSASAudio* info)
 {
-	if (info->data_id)
-		sceKernelFreeMemBlock(info->data_id);
+	if (info->storage == VITASAS_AUDIO_STORAGE_CACHE) {
+		vitaSAS_internal_sample_cache_release(info);
+		return;
+	}
+
+	if (info->storage != VITASAS_AUDIO_STORAGE_USER)
+		vitaSAS_internal_sample_free(info->datap, info->data_id);
 	heap_free_heap_memory(vitaSAS_heap_internal, info);
 }
 
@@ -595,6 +1292,8 @@ vitaSASAudio* vitaSAS_load_audio_custom(void* pData, unsigned int dataSize)
 	info->datap = pData;
 	info->data_size = dataSize;
 	info->data_id = 0;
+	info->storage = VITASAS_AUDIO_STORAGE_USER;
+	info->numChannels = 1;
 
 	if (info->datap == NULL) {
 		SCE_DBG_LOG_ERROR("[SAS] Invalid data pointer");
@@ -605,6 +1304,14 @@ vitaSASAudio* vitaSAS_load_audio_custom(void* pData, unsigned int dataSize)
 }
 
 vitaSASAudio* vitaSAS_load_audio_WAV(char* soundPath, int io_type)
+{
+	if (vitaSAS_internal_sample_cache_is_enabled())
+		return vitaSAS_internal_sample_cache_load(VITASAS_LOAD_TYPE_WAV, soundPath, io_type);
+
+	return vitaSAS_load_audio_WAV_with_param(soundPath, io_type, NULL);
+}
+
+vitaSASAudio* vitaSAS_load_audio_WAV_with_param(char* soundPath, int io_type, const vitaSASLoadParam* param)
 {
 	vitaSASAudio* info = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASAudio));
 	if (info == NULL) {
@@ -616,14 +1323,29 @@ vitaSASAudio* vitaSAS_load_audio_WAV(char* soundPath, int io_type)
 
 	size_t soundDataSize = 0;
 	SceUID mem_id = 0;
-	vitaSAS_internal_load_audio_WAV(soundPath, &soundDataSize, &mem_id, &info->datap, io_type);
+	uint32_t numChannels = 1;
+	uint32_t samplingRate = 0;
+	info->datap = vitaSAS_internal_load_audio_WAV(soundPath, &soundDataSize, &mem_id, &numChannels, &samplingRate, io_type, param);
 	info->data_size = soundDataSize;
 	info->data_id = mem_id;
+	info->storage = mem_id != 0 ? VITASAS_AUDIO_STORAGE_MEMBLOCK : VITASAS_AUDIO_STORAGE_POOL;
+	info->numChannels = numChannels;
+
+	if (info->datap == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_load_audio_WAV() failed");
+		heap_free_heap_memory(vitaSAS_heap_internal, info);
+		return NULL;
+	}
+
+	if (vitaSAS_internal_process_audio(info, samplingRate, param) < 0) {
+		vitaSAS_free_audio(info);
+		return NULL;
+	}
 
 	return info;
 }
 
-vitaSASAudio* vitaSAS_load_audio_VAG(char* soundPath, int io_type)
+static vitaSASAudio* vitaSAS_internal_load_audio_file(char* soundPath, int io_type)
 {
 	vitaSASAudio* info = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASAudio));
 	if (info == NULL) {
@@ -638,9 +1360,112 @@ vitaSASAudio* vitaSAS_load_audio_VAG(char* soundPath, int io_type)
 	info->datap = vitaSAS_internal_load_audio(soundPath, &soundDataSize, &mem_id, io_type);
 	info->data_size = soundDataSize;
 	info->data_id = mem_id;
+	info->storage = mem_id != 0 ? VITASAS_AUDIO_STORAGE_MEMBLOCK : VITASAS_AUDIO_STORAGE_POOL;
+	info->numChannels = 1;
 
 	if (info->datap == NULL) {
 		SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_load_audio() returned NULL");
+		heap_free_heap_memory(vitaSAS_heap_internal, info);
+		return NULL;
+	}
+
+	return info;
+}
+
+/* Load bypassing the sample cache, PCM and VAG files are both read as is */
+
+vitaSASAudio* vitaSAS_internal_load_audio_uncached(uint32_t type, char* soundPath, int io_type)
+{
+	if (type == VITASAS_LOAD_TYPE_WAV)
+		return vitaSAS_load_audio_WAV_with_param(soundPath, io_type, NULL);
+
+	return vitaSAS_internal_load_audio_file(soundPath, io_type);
+}
+
+vitaSASAudio* vitaSAS_load_audio_VAG(char* soundPath, int io_type)
+{
+	if (vitaSAS_internal_sample_cache_is_enabled())
+		return vitaSAS_internal_sample_cache_load(VITASAS_LOAD_TYPE_VAG, soundPath, io_type);
+
+	return vitaSAS_internal_load_audio_file(soundPath, io_type);
+}
+
+/* ADPCM blocks of a VAG sample, files without a valid header keep the old blind 48-byte skip */
+
+void* vitaSAS_internal_get_VAG_data(const vitaSASAudio* info, uint32_t* size)
+{
+	vag_codec_info vagInfo;
+
+	if (vag_codec_parse_header(info->datap, info->data_size, &vagInfo) < 0) {
+		*size = info->data_size - VAG_CODEC_HEADER_SIZE;
+		return (char*)info->datap + VAG_CODEC_HEADER_SIZE;
+	}
+
+	*size = vagInfo.dataSize;
+
+	return (char*)info->datap + vagInfo.dataOffset;
+}
+
+static int vitaSAS_internal_parse_VAG(const vitaSASAudio* info, vag_codec_info* vagInfo)
+{
+	if (info->numChannels != 1 || vag_codec_parse_header(info->datap, info->data_size, vagInfo) < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] Not a VAG sample");
+		return VITASAS_ERROR_NOT_SUPPORTED;
+	}
+
+	vag_codec_scan_blocks(info->datap, vagInfo);
+
+	return SCE_OK;
+}
+
+int vitaSAS_get_VAG_info(const vitaSASAudio* info, vitaSASVAGInfo* vagInfo)
+{
+	vag_codec_info codecInfo;
+	int result;
+
+	result = vitaSAS_internal_parse_VAG(info, &codecInfo);
+	if (result < 0)
+		return result;
+
+	vagInfo->samplingRate = codecInfo.samplingRate;
+	vagInfo->dataSize = codecInfo.dataSize;
+	vagInfo->numSamples = codecInfo.numSamples;
+	vagInfo->loopStart = codecInfo.loopStart;
+	vagInfo->loopEnd = codecInfo.loopEnd;
+
+	return SCE_OK;
+}
+
+vitaSASAudio* vitaSAS_decode_VAG_to_PCM(const vitaSASAudio* vag)
+{
+	vag_codec_info codecInfo;
+	vitaSASAudio* info;
+	SceUID mem_id;
+
+	if (vitaSAS_internal_parse_VAG(vag, &codecInfo) < 0)
+		return NULL;
+
+	info = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASAudio));
+	if (info == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return NULL;
+	}
+
+	info->datap = vitaSAS_internal_sample_alloc(codecInfo.numSamples * sizeof(int16_t), &mem_id);
+	if (info->datap == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_sample_alloc() returned NULL");
+		heap_free_heap_memory(vitaSAS_heap_internal, info);
+		return NULL;
+	}
+
+	info->data_size = codecInfo.numSamples * sizeof(int16_t);
+	info->data_id = mem_id;
+	info->storage = mem_id != 0 ? VITASAS_AUDIO_STORAGE_MEMBLOCK : VITASAS_AUDIO_STORAGE_POOL;
+	info->numChannels = 1;
+
+	if (vag_codec_decode(info->datap, vag->datap, &codecInfo) < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] VAG sample uses HE-ADPCM filters that can't be decoded");
+		vitaSAS_free_audio(info);
 		return NULL;
 	}
 
@@ -649,114 +1474,397 @@ vitaSASAudio* vitaSAS_load_audio_VAG(char* soundPath, int io_type)
 
 vitaSASAudio* vitaSAS_load_audio_PCM(char* soundPath, int io_type)
 {
-	return vitaSAS_load_audio_VAG(soundPath, io_type);
+	if (vitaSAS_internal_sample_cache_is_enabled())
+		return vitaSAS_internal_sample_cache_load(VITASAS_LOAD_TYPE_PCM, soundPath, io_type);
+
+	return vitaSAS_internal_load_audio_file(soundPath, io_type);
+}
+
+vitaSASAudio* vitaSAS_load_audio_PCM_with_param(char* soundPath, int io_type, const vitaSASLoadParam* param)
+{
+	vitaSASAudio* info = vitaSAS_internal_load_audio_file(soundPath, io_type);
+	if (info == NULL)
+		return NULL;
+
+	/* Raw PCM has no header, the source rate comes from the caller */
+
+	if (vitaSAS_internal_process_audio(info, param != NULL ? param->sourceSamplingRate : 0, param) < 0) {
+		vitaSAS_free_audio(info);
+		return NULL;
+	}
+
+	return info;
 }
 
-void vitaSAS_internal_set_initial_params(unsigned int voiceID, unsigned int pitch, unsigned int volLDry,
+void vitaSAS_internal_set_initial_params(vitaSASSystem* system, unsigned int voiceID, unsigned int pitch, unsigned int volLDry,
 	unsigned int volRDry, unsigned int volLWet, unsigned int volRWet, unsigned int adsr1, unsigned int adsr2)
 {
-	sceSasSetPitchInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, pitch);
-	sceSasSetVolumeInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, volLDry, volRDry, volLWet, volRWet);
-	sceSasSetSimpleADSRInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, adsr1, adsr2);
+	vitaSASCommand command;
+
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+
+	command.type = VITASAS_COMMAND_SET_PITCH;
+	command.arg[0] = pitch;
+	vitaSAS_internal_submit_command(system, &command);
+
+	command.type = VITASAS_COMMAND_SET_VOLUME;
+	command.arg[0] = volLDry;
+	command.arg[1] = volRDry;
+	command.arg[2] = volLWet;
+	command.arg[3] = volRWet;
+	vitaSAS_internal_submit_command(system, &command);
+
+	command.type = VITASAS_COMMAND_SET_SIMPLE_ADSR;
+	command.arg[0] = adsr1;
+	command.arg[1] = adsr2;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
-void vitaSAS_set_voice_VAG(unsigned int voiceID, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam)
+void vitaSAS_system_set_voice_VAG(vitaSASSystem* system, unsigned int voiceID, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam)
 {
+	vitaSASCommand command;
+
 	/* Set parameters for playing waveform */
 
-	sceSasSetVoiceInternal(
-		SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle,
-		voiceID,
-		(char*)info->datap + 48,
-		info->data_size - 48,
-		voiceParam->loop);
-	vitaSAS_internal_set_initial_params(voiceID, voiceParam->pitch, voiceParam->volLDry, voiceParam->volRDry, voiceParam->volLWet, voiceParam->volRWet, voiceParam->adsr1, voiceParam->adsr2);
+	command.type = VITASAS_COMMAND_SET_VOICE;
+	command.voiceID = voiceID;
+	command.ptr = vitaSAS_internal_get_VAG_data(info, &command.arg[0]);
+	command.arg[1] = voiceParam->loop;
+	command.arg[2] = vitaSAS_internal_sample_cache_acquire_voice(info);
+	if (vitaSAS_internal_submit_command(system, &command) < 0)
+		vitaSAS_internal_sample_cache_release_voice(command.arg[2]);
+	vitaSAS_internal_set_initial_params(system, voiceID, voiceParam->pitch, voiceParam->volLDry, voiceParam->volRDry, voiceParam->volLWet, voiceParam->volRWet, voiceParam->adsr1, voiceParam->adsr2);
 }
 
-void vitaSAS_set_voice_PCM(unsigned int voiceID, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam)
+void vitaSAS_set_voice_VAG(unsigned int voiceID, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam)
+{
+	vitaSAS_system_set_voice_VAG(vitaSAS_get_system(SASCurrentSystemNum), voiceID, info, voiceParam);
+}
+
+void vitaSAS_system_set_voice_PCM(vitaSASSystem* system, unsigned int voiceID, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam)
 {
+	vitaSASCommand command;
+
 	/* Set parameters for playing waveform */
 
 	int numSamples = info->data_size / 2;
 
-	sceSasSetVoicePCMInternal(
-		SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle,
-		voiceID,
-		(char*)info->datap,
-		numSamples,
-		voiceParam->loopSize);
-	vitaSAS_internal_set_initial_params(voiceID, voiceParam->pitch, voiceParam->volLDry, voiceParam->volRDry, voiceParam->volLWet, voiceParam->volRWet, voiceParam->adsr1, voiceParam->adsr2);
+	if (info->numChannels == 2) {
+		if (voiceID + 1 >= system->voicePool.numVoices) {
+			SCE_DBG_LOG_ERROR("[SAS] Stereo voice %u needs voice %u", voiceID, voiceID + 1);
+			return;
+		}
+
+		numSamples /= 2;
+	}
+
+	command.type = VITASAS_COMMAND_SET_VOICE_PCM;
+	command.voiceID = voiceID;
+	command.ptr = info->datap;
+	command.arg[0] = numSamples;
+	command.arg[1] = (uint32_t)voiceParam->loopSize;
+	command.arg[2] = vitaSAS_internal_sample_cache_acquire_voice(info);
+	if (vitaSAS_internal_submit_command(system, &command) < 0)
+		vitaSAS_internal_sample_cache_release_voice(command.arg[2]);
+
+	/* Right channel goes to the next voice, parameters set below are mirrored to it */
+
+	if (info->numChannels == 2) {
+		command.voiceID = voiceID + 1;
+		command.ptr = (int16_t*)info->datap + numSamples;
+		command.arg[2] = 0;
+		vitaSAS_internal_submit_command(system, &command);
+
+		command.type = VITASAS_COMMAND_LINK_VOICE;
+		command.voiceID = voiceID;
+		command.ptr = NULL;
+		command.arg[0] = 1;
+		vitaSAS_internal_submit_command(system, &command);
+	}
+	vitaSAS_internal_set_initial_params(system, voiceID, voiceParam->pitch, voiceParam->volLDry, voiceParam->volRDry, voiceParam->volLWet, voiceParam->volRWet, voiceParam->adsr1, voiceParam->adsr2);
 }
 
-void vitaSAS_set_voice_noise(unsigned int voiceID, unsigned int clock, const vitaSASVoiceParam* voiceParam)
+void vitaSAS_set_voice_PCM(unsigned int voiceID, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam)
+{
+	vitaSAS_system_set_voice_PCM(vitaSAS_get_system(SASCurrentSystemNum), voiceID, info, voiceParam);
+}
+
+vitaSASStream* vitaSAS_open_stream(unsigned int voiceID, char* soundPath, int io_type, const vitaSASStreamParam* streamParam, const vitaSASVoiceParam* voiceParam)
+{
+	return vitaSAS_system_open_stream(vitaSAS_get_system(SASCurrentSystemNum), voiceID, soundPath, io_type, streamParam, voiceParam);
+}
+
+void vitaSAS_system_set_voice_noise(vitaSASSystem* system, unsigned int voiceID, unsigned int clock, const vitaSASVoiceParam* voiceParam)
 {
+	vitaSASCommand command;
+
 	/* Set parameters for playing waveform */
 
-	sceSasSetNoiseInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, clock);
-	vitaSAS_internal_set_initial_params(voiceID, voiceParam->pitch, voiceParam->volLDry, voiceParam->volRDry, voiceParam->volLWet, voiceParam->volRWet, voiceParam->adsr1, voiceParam->adsr2);
+	command.type = VITASAS_COMMAND_SET_NOISE;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	command.arg[0] = clock;
+	vitaSAS_internal_submit_command(system, &command);
+	vitaSAS_internal_set_initial_params(system, voiceID, voiceParam->pitch, voiceParam->volLDry, voiceParam->volRDry, voiceParam->volLWet, voiceParam->volRWet, voiceParam->adsr1, voiceParam->adsr2);
+}
+
+void vitaSAS_set_voice_noise(unsigned int voiceID, unsigned int clock, const vitaSASVoiceParam* voiceParam)
+{
+	vitaSAS_system_set_voice_noise(vitaSAS_get_system(SASCurrentSystemNum), voiceID, clock, voiceParam);
+}
+
+int vitaSAS_set_voices_batch(const vitaSASVoiceSetup* setup, unsigned int numVoices)
+{
+	return vitaSAS_system_set_voices_batch(vitaSAS_get_system(SASCurrentSystemNum), setup, numVoices);
+}
+
+int vitaSAS_update_voices_batch(const vitaSASVoiceUpdateBatch* batch)
+{
+	return vitaSAS_system_update_voices_batch(vitaSAS_get_system(SASCurrentSystemNum), batch);
+}
+
+int vitaSAS_system_begin_commands(vitaSASSystem* system)
+{
+	if (system == NULL)
+		return -1;
+
+	/* Without command queue every call is applied in place */
+
+	if (system->commandQueue.commands == NULL)
+		return SCE_OK;
+
+	return vitaSAS_internal_command_queue_begin_frame(&system->commandQueue, sceKernelGetThreadId());
+}
+
+int vitaSAS_begin_commands(void)
+{
+	return vitaSAS_system_begin_commands(vitaSAS_get_system(SASCurrentSystemNum));
+}
+
+int vitaSAS_system_commit_commands(vitaSASSystem* system)
+{
+	int result;
+
+	if (system == NULL)
+		return -1;
+
+	if (system->commandQueue.commands == NULL)
+		return SCE_OK;
+
+	result = vitaSAS_internal_command_queue_commit_frame(&system->commandQueue, sceKernelGetThreadId());
+	if (result == VITASAS_ERROR_COMMAND_QUEUE_FULL)
+		SCE_DBG_LOG_WARNING("[SAS] Command queue can't fit command frame, frame dropped");
+
+	return result;
+}
+
+int vitaSAS_commit_commands(void)
+{
+	return vitaSAS_system_commit_commands(vitaSAS_get_system(SASCurrentSystemNum));
+}
+
+void vitaSAS_system_set_effect(vitaSASSystem* system, unsigned int effectType, unsigned int volL, unsigned int volR, unsigned int delayTime, unsigned int feedbackLevel)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_EFFECT;
+	command.voiceID = 0;
+	command.ptr = NULL;
+	command.arg[0] = effectType;
+	command.arg[1] = volL;
+	command.arg[2] = volR;
+	command.arg[3] = delayTime;
+	command.arg[4] = feedbackLevel;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
 void vitaSAS_set_effect(unsigned int effectType, unsigned int volL, unsigned int volR, unsigned int delayTime, unsigned int feedbackLevel)
 {
-	sceSasSetEffectTypeInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, effectType);
-	sceSasSetEffectParamInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, delayTime, feedbackLevel);
-	sceSasSetEffectVolumeInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, volL, volR);
+	vitaSAS_system_set_effect(vitaSAS_get_system(SASCurrentSystemNum), effectType, volL, volR, delayTime, feedbackLevel);
+}
+
+void vitaSAS_system_reset_effect(vitaSASSystem* system)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_EFFECT_TYPE;
+	command.voiceID = 0;
+	command.ptr = NULL;
+	command.arg[0] = (uint32_t)SCE_SAS_FX_TYPE_OFF;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
 void vitaSAS_reset_effect(void)
 {
-	sceSasSetEffectTypeInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, SCE_SAS_FX_TYPE_OFF);
+	vitaSAS_system_reset_effect(vitaSAS_get_system(SASCurrentSystemNum));
+}
+
+void vitaSAS_system_set_switch_config(vitaSASSystem* system, unsigned int drySwitch, unsigned int wetSwitch)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_SWITCH_CONFIG;
+	command.voiceID = 0;
+	command.ptr = NULL;
+	command.arg[0] = drySwitch;
+	command.arg[1] = wetSwitch;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
 void vitaSAS_set_switch_config(unsigned int drySwitch, unsigned int wetSwitch)
 {
-	sceSasSetEffectInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, drySwitch, wetSwitch);
+	vitaSAS_system_set_switch_config(vitaSAS_get_system(SASCurrentSystemNum), drySwitch, wetSwitch);
+}
+
+void vitaSAS_system_set_pitch(vitaSASSystem* system, unsigned int voiceID, unsigned int pitch)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_PITCH;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	command.arg[0] = pitch;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
 void vitaSAS_set_pitch(unsigned int voiceID, unsigned int pitch)
 {
-	sceSasSetPitchInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, pitch);
+	vitaSAS_system_set_pitch(vitaSAS_get_system(SASCurrentSystemNum), voiceID, pitch);
+}
+
+void vitaSAS_system_set_volume(vitaSASSystem* system, unsigned int voiceID, unsigned int volLDry,
+	unsigned int volRDry, unsigned int volLWet, unsigned int volRWet)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_VOLUME;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	command.arg[0] = volLDry;
+	command.arg[1] = volRDry;
+	command.arg[2] = volLWet;
+	command.arg[3] = volRWet;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
 void vitaSAS_set_volume(unsigned int voiceID, unsigned int volLDry,
 	unsigned int volRDry, unsigned int volLWet, unsigned int volRWet)
 {
-	sceSasSetVolumeInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, volLDry, volRDry, volLWet, volRWet);
+	vitaSAS_system_set_volume(vitaSAS_get_system(SASCurrentSystemNum), voiceID, volLDry, volRDry, volLWet, volRWet);
+}
+
+void vitaSAS_system_set_simple_ADSR(vitaSASSystem* system, unsigned int voiceID, unsigned int adsr1, unsigned int adsr2)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_SIMPLE_ADSR;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	command.arg[0] = adsr1;
+	command.arg[1] = adsr2;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
 void vitaSAS_set_simple_ADSR(unsigned int voiceID, unsigned int adsr1, unsigned int adsr2)
 {
-	sceSasSetSimpleADSRInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, adsr1, adsr2);
+	vitaSAS_system_set_simple_ADSR(vitaSAS_get_system(SASCurrentSystemNum), voiceID, adsr1, adsr2);
+}
+
+void vitaSAS_system_set_SL(vitaSASSystem* system, unsigned int voiceID, unsigned int sustainLevel)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_SL;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	command.arg[0] = sustainLevel;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
 void vitaSAS_set_SL(unsigned int voiceID, unsigned int sustainLevel)
 {
-	sceSasSetSLInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, sustainLevel);
+	vitaSAS_system_set_SL(vitaSAS_get_system(SASCurrentSystemNum), voiceID, sustainLevel);
+}
+
+void vitaSAS_system_set_ADSR_mode(vitaSASSystem* system, unsigned int voiceID, unsigned int flag, unsigned int a, unsigned int d, unsigned int s, unsigned int r)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_ADSR_MODE;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	command.arg[0] = flag;
+	command.arg[1] = a;
+	command.arg[2] = d;
+	command.arg[3] = s;
+	command.arg[4] = r;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
 void vitaSAS_set_ADSR_mode(unsigned int voiceID, unsigned int flag, unsigned int a, unsigned int d, unsigned int s, unsigned int r)
 {
-	sceSasSetADSRmodeInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, flag, a, d, s, r);
+	vitaSAS_system_set_ADSR_mode(vitaSAS_get_system(SASCurrentSystemNum), voiceID, flag, a, d, s, r);
+}
+
+void vitaSAS_system_set_ADSR(vitaSASSystem* system, unsigned int voiceID, unsigned int flag, unsigned int a, unsigned int d, unsigned int s, unsigned int r)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_ADSR;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	command.arg[0] = flag;
+	command.arg[1] = a;
+	command.arg[2] = d;
+	command.arg[3] = s;
+	command.arg[4] = r;
+	vitaSAS_internal_submit_command(system, &command);
 }
 
 void vitaSAS_set_ADSR(unsigned int voiceID, unsigned int flag, unsigned int a, unsigned int d, unsigned int s, unsigned int r)
 {
-	sceSasSetADSRInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID, flag, a, d, s, r);
+	vitaSAS_system_set_ADSR(vitaSAS_get_system(SASCurrentSystemNum), voiceID, flag, a, d, s, r);
+}
+
+int vitaSAS_system_set_key_on(vitaSASSystem* system, unsigned int voiceID)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_KEY_ON;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	return vitaSAS_internal_submit_command(system, &command);
 }
 
 int vitaSAS_set_key_on(unsigned int voiceID)
 {
-	return sceSasSetKeyOnInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID);
+	return vitaSAS_system_set_key_on(vitaSAS_get_system(SASCurrentSystemNum), voiceID);
+}
+
+int vitaSAS_system_set_key_off(vitaSASSystem* system, unsigned int voiceID)
+{
+	vitaSASCommand command;
+
+	command.type = VITASAS_COMMAND_SET_KEY_OFF;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	return vitaSAS_internal_submit_command(system, &command);
 }
 
 int vitaSAS_set_key_off(unsigned int voiceID)
 {
-	return sceSasSetKeyOffInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID);
+	return vitaSAS_system_set_key_off(vitaSAS_get_system(SASCurrentSystemNum), voiceID);
+}
+
+int vitaSAS_system_get_end_state(vitaSASSystem* system, unsigned int voiceID)
+{
+	return vitaSAS_internal_get_end_state(system, voiceID);
 }
 
 int vitaSAS_get_end_state(unsigned int voiceID)
 {
-	return sceSasGetEndStateInternal(SASSystemStorage[SASCurrentSystemNum]->sasSystemHandle, voiceID);
+	return vitaSAS_system_get_end_state(vitaSAS_get_system(SASCurrentSystemNum), voiceID);
 }
 
 
@@ -0,0 +1,304 @@
+#include <kernel.h>
+#include <libdbg.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+#include "atomic.h"
+
+extern void* vitaSAS_heap_internal;
+
+/*
+ * Asynchronous sample loader. Requests are queued to a single loader thread that opens, parses and
+ * allocates samples with the regular loaders, so the calling thread never blocks on I/O. Completion
+ * is published through the request state, the optional callback runs on the loader thread first.
+ * Waiting threads get a semaphore of their own that the loader signals when their request finishes.
+ * The same thread refills streaming voices whenever it is woken.
+ */
+
+typedef struct vitaSASLoader {
+	SceUID threadId;
+	SceUID workSemaId;
+	SceKernelLwMutexWork mutex;
+	vitaSASLoadRequest* head;
+	vitaSASLoadRequest* tail;
+	volatile uint32_t isAborted;
+} vitaSASLoader;
+
+static vitaSASLoader* s_loader = NULL;
+
+static vitaSASAudio* vitaSAS_internal_loader_load(const vitaSASLoadRequest* request)
+{
+	switch (request->type) {
+	case VITASAS_LOAD_TYPE_VAG:
+		return vitaSAS_load_audio_VAG((char*)request->path, request->io_type);
+	case VITASAS_LOAD_TYPE_PCM:
+		return vitaSAS_load_audio_PCM((char*)request->path, request->io_type);
+	case VITASAS_LOAD_TYPE_WAV:
+		return vitaSAS_load_audio_WAV((char*)request->path, request->io_type);
+	default:
+		return NULL;
+	}
+}
+
+static void vitaSAS_internal_loader_complete(vitaSASLoader* loader, vitaSASLoadRequest* request, vitaSASAudio* audio)
+{
+	SceUID waitSemaId;
+
+	request->audio = audio;
+
+	if (request->callback != NULL)
+		request->callback(request, audio, request->userdata);
+
+	/* Publish state and wake the waiter under the lock so the waiter can't miss it, request may be freed right after */
+
+	sceKernelLockLwMutex(&loader->mutex, 1, NULL);
+
+	waitSemaId = request->waitSemaId;
+	atomic_store32(&request->state, audio != NULL ? VITASAS_LOAD_STATE_DONE : VITASAS_LOAD_STATE_FAILED);
+	if (0 < waitSemaId)
+		sceKernelSignalSema(waitSemaId, 1);
+
+	sceKernelUnlockLwMutex(&loader->mutex, 1);
+}
+
+static int vitaSAS_internal_loader_thread(unsigned int args, void *argc)
+{
+	vitaSASLoader* loader = *(vitaSASLoader**)argc;
+	vitaSASLoadRequest* request;
+
+	for (;;) {
+		sceKernelWaitSema(loader->workSemaId, 1, NULL);
+
+		/* Streams are refilled before queued loads */
+
+		vitaSAS_internal_stream_service();
+
+		sceKernelLockLwMutex(&loader->mutex, 1, NULL);
+
+		request = loader->head;
+		if (request != NULL) {
+			loader->head = request->next;
+			if (loader->head == NULL)
+				loader->tail = NULL;
+		}
+
+		sceKernelUnlockLwMutex(&loader->mutex, 1);
+
+		if (request == NULL) {
+			if (loader->isAborted)
+				break;
+			continue;
+		}
+
+		/* Requests left after abort fail without touching the file system */
+
+		vitaSAS_internal_loader_complete(loader, request, loader->isAborted ? NULL : vitaSAS_internal_loader_load(request));
+	}
+
+	return sceKernelExitDeleteThread(0);
+}
+
+int vitaSAS_start_loader(unsigned int thPriority, unsigned int thStackSize, unsigned int thCpu)
+{
+	vitaSASLoader* loader;
+	int result;
+
+	if (s_loader != NULL)
+		return VITASAS_ERROR_NOT_SUPPORTED;
+
+	loader = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASLoader));
+	if (loader == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	sceClibMemset(loader, 0, sizeof(vitaSASLoader));
+
+	result = sceKernelCreateLwMutex(&loader->mutex, "vitaSAS_loader", 0, 0, NULL);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateLwMutex(): 0x%X", result);
+		heap_free_heap_memory(vitaSAS_heap_internal, loader);
+		return result;
+	}
+
+	result = loader->workSemaId = sceKernelCreateSema("vitaSAS_loader_work", 0, 0, 0x7FFFFFFF, NULL);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateSema(): 0x%X", result);
+		goto failed;
+	}
+
+	result = loader->threadId = sceKernelCreateThread(
+		"vitaSAS_loader_thread",
+		vitaSAS_internal_loader_thread,
+		thPriority,
+		thStackSize,
+		0,
+		thCpu,
+		NULL);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateThread(): 0x%X", result);
+		goto failed;
+	}
+
+	result = sceKernelStartThread(loader->threadId, sizeof(loader), &loader);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelStartThread(): 0x%X", result);
+		sceKernelDeleteThread(loader->threadId);
+		goto failed;
+	}
+
+	s_loader = loader;
+
+	return SCE_OK;
+
+failed:
+
+	if (0 < loader->workSemaId)
+		sceKernelDeleteSema(loader->workSemaId);
+	sceKernelDeleteLwMutex(&loader->mutex);
+	heap_free_heap_memory(vitaSAS_heap_internal, loader);
+
+	return result;
+}
+
+void vitaSAS_stop_loader(void)
+{
+	vitaSASLoader* loader = s_loader;
+
+	if (loader == NULL)
+		return;
+
+	/* Queued requests fail, the thread exits once the queue is empty */
+
+	loader->isAborted = 1;
+	sceKernelSignalSema(loader->workSemaId, 1);
+	sceKernelWaitThreadEnd(loader->threadId, NULL, NULL);
+
+	sceKernelDeleteSema(loader->workSemaId);
+	sceKernelDeleteLwMutex(&loader->mutex);
+
+	s_loader = NULL;
+	heap_free_heap_memory(vitaSAS_heap_internal, loader);
+}
+
+int vitaSAS_internal_loader_is_running(void)
+{
+	return s_loader != NULL && !s_loader->isAborted;
+}
+
+void vitaSAS_internal_loader_wake(void)
+{
+	vitaSASLoader* loader = s_loader;
+
+	if (loader != NULL)
+		sceKernelSignalSema(loader->workSemaId, 1);
+}
+
+static vitaSASLoadRequest* vitaSAS_internal_load_audio_async(uint32_t type, char* soundPath, int io_type, vitaSASLoadCallback callback, void* userdata)
+{
+	vitaSASLoader* loader = s_loader;
+	vitaSASLoadRequest* request;
+	SceSize pathLength;
+
+	if (loader == NULL || loader->isAborted) {
+		SCE_DBG_LOG_ERROR("[SAS] Loader is not running");
+		return NULL;
+	}
+
+	pathLength = sceClibStrnlen(soundPath, VITASAS_LOAD_PATH_MAX);
+	if (pathLength == VITASAS_LOAD_PATH_MAX) {
+		SCE_DBG_LOG_ERROR("[SAS] Path is too long");
+		return NULL;
+	}
+
+	request = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASLoadRequest));
+	if (request == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return NULL;
+	}
+
+	request->next = NULL;
+	request->state = VITASAS_LOAD_STATE_PENDING;
+	request->type = type;
+	request->io_type = io_type;
+	request->waitSemaId = 0;
+	request->audio = NULL;
+	request->callback = callback;
+	request->userdata = userdata;
+	sceClibMemcpy(request->path, soundPath, pathLength + 1);
+
+	/* Enqueue and wake the loader */
+
+	sceKernelLockLwMutex(&loader->mutex, 1, NULL);
+
+	if (loader->tail != NULL)
+		loader->tail->next = request;
+	else
+		loader->head = request;
+	loader->tail = request;
+
+	sceKernelUnlockLwMutex(&loader->mutex, 1);
+
+	sceKernelSignalSema(loader->workSemaId, 1);
+
+	return request;
+}
+
+vitaSASLoadRequest* vitaSAS_load_audio_VAG_async(char* soundPath, int io_type, vitaSASLoadCallback callback, void* userdata)
+{
+	return vitaSAS_internal_load_audio_async(VITASAS_LOAD_TYPE_VAG, soundPath, io_type, callback, userdata);
+}
+
+vitaSASLoadRequest* vitaSAS_load_audio_PCM_async(char* soundPath, int io_type, vitaSASLoadCallback callback, void* userdata)
+{
+	return vitaSAS_internal_load_audio_async(VITASAS_LOAD_TYPE_PCM, soundPath, io_type, callback, userdata);
+}
+
+vitaSASLoadRequest* vitaSAS_load_audio_WAV_async(char* soundPath, int io_type, vitaSASLoadCallback callback, void* userdata)
+{
+	return vitaSAS_internal_load_audio_async(VITASAS_LOAD_TYPE_WAV, soundPath, io_type, callback, userdata);
+}
+
+int vitaSAS_poll_load(const vitaSASLoadRequest* request)
+{
+	return atomic_load32(&request->state);
+}
+
+vitaSASAudio* vitaSAS_wait_load(vitaSASLoadRequest* request)
+{
+	vitaSASLoader* loader = s_loader;
+	SceUID semaId;
+
+	if (loader == NULL || atomic_load32(&request->state) != VITASAS_LOAD_STATE_PENDING)
+		return request->audio;
+
+	semaId = sceKernelCreateSema("vitaSAS_load_wait", 0, 0, 1, NULL);
+	if (semaId < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateSema(): 0x%X", semaId);
+		return NULL;
+	}
+
+	/* Loader checks for the semaphore under the same lock it publishes state with */
+
+	sceKernelLockLwMutex(&loader->mutex, 1, NULL);
+
+	if (atomic_load32(&request->state) == VITASAS_LOAD_STATE_PENDING) {
+		request->waitSemaId = semaId;
+		sceKernelUnlockLwMutex(&loader->mutex, 1);
+		sceKernelWaitSema(semaId, 1, NULL);
+		request->waitSemaId = 0;
+	}
+	else {
+		sceKernelUnlockLwMutex(&loader->mutex, 1);
+	}
+
+	sceKernelDeleteSema(semaId);
+
+	return request->audio;
+}
+
+void vitaSAS_free_load(vitaSASLoadRequest* request)
+{
+	vitaSAS_wait_load(request);
+	heap_free_heap_memory(vitaSAS_heap_internal, request);
+}
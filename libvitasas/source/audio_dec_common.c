@@ -1,23 +1,17 @@
-﻿#include <arm_neon.h>
-#include <codecengine.h> 
+﻿#include <codecengine.h> 
 #include <kernel.h> 
 #include <libdbg.h>
 
 #include "vitaSAS.h"
 #include "heap.h"
+#include "pcm_kernels.h"
 
 extern void* vitaSAS_heap_internal;
 extern unsigned int g_portIdBGM;
 
 void vitaSAS_separate_channels_PCM(short* pBufL, short* pBufR, short* pBufSrc, unsigned int bufSrcSize)
 {
-	unsigned int num16x8 = bufSrcSize / 8;
-	int16x8x2_t separated;
-	for (int i = 0; i < num16x8; i++) {
-		separated = vld2q_s16(pBufSrc + 2 * 8 * i);
-		vst1q_s16(pBufL + 8 * i, separated.val[0]);
-		vst1q_s16(pBufR + 8 * i, separated.val[1]);
-	}
+	pcm_kernels_deinterleave_s16_stereo(pBufL, pBufR, pBufSrc, bufSrcSize);
 }
 
 int vitaSAS_internal_getFileSize(const char *pInputFileName, uint32_t *pInputFileSize)
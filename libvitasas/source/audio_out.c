@@ -4,6 +4,7 @@
 
 #include "vitaSAS.h"
 #include "heap.h"
+#include "atomic.h"
 
 extern unsigned int g_portIdBGM;
 extern void* vitaSAS_heap_internal;
@@ -28,21 +29,180 @@ void vitaSAS_internal_output_for_decoder(Buffer *pOutput)
 	}
 }
 
+/* Adaptive grain: load is render time relative to grain time, measured over windows of about 250 ms */
+
+#define ADAPTIVE_GRAIN_WINDOW_TIME		250000
+#define ADAPTIVE_GRAIN_CALM_WINDOWS		8
+#define ADAPTIVE_GRAIN_LOAD_HIGH		75
+#define ADAPTIVE_GRAIN_LOAD_LOW			25
+
+typedef struct AdaptiveGrainState {
+	uint32_t numGrains;
+	uint32_t renderTimeMax;
+	uint32_t numCalmWindows;
+} AdaptiveGrainState;
+
+static uint32_t vitaSAS_internal_adaptive_grain_next(const AudioOutWork *work, AdaptiveGrainState *state,
+	uint32_t numGrain, uint32_t grainTime, uint32_t renderTime, uint32_t isLate)
+{
+	/* Jitter, raise grain right away */
+
+	if (isLate || renderTime * 100 > grainTime * ADAPTIVE_GRAIN_LOAD_HIGH) {
+		sceClibMemset(state, 0, sizeof(*state));
+		numGrain *= 2;
+		if (numGrain > work->numGrainMax)
+			numGrain = work->numGrainMax;
+		return numGrain;
+	}
+
+	if (state->renderTimeMax < renderTime)
+		state->renderTimeMax = renderTime;
+
+	state->numGrains++;
+	if (state->numGrains * grainTime < ADAPTIVE_GRAIN_WINDOW_TIME)
+		return numGrain;
+
+	/* End of window, lower grain after enough calm windows in a row */
+
+	if (state->renderTimeMax * 100 < grainTime * ADAPTIVE_GRAIN_LOAD_LOW)
+		state->numCalmWindows++;
+	else
+		state->numCalmWindows = 0;
+
+	state->numGrains = 0;
+	state->renderTimeMax = 0;
+
+	if (state->numCalmWindows < ADAPTIVE_GRAIN_CALM_WINDOWS)
+		return numGrain;
+
+	state->numCalmWindows = 0;
+	numGrain = (numGrain / 2) & ~(VITASAS_GRAIN_ALIGN - 1);
+	if (numGrain < work->numGrainMin)
+		numGrain = work->numGrainMin;
+
+	return numGrain;
+}
+
+/* State of the audio out port, owned by the output thread */
+
+typedef struct AudioOutPortState {
+	int portId;
+	uint32_t numGrain;
+	uint32_t grainTime;
+	uint32_t numOutputs;
+	AdaptiveGrainState adaptiveState;
+} AudioOutPortState;
+
+/* Render one grain into a ring slot, grain changes requested by the output thread are applied first */
+
+static void vitaSAS_internal_audio_out_render(AudioOutWork *work, AudioOutSlot *slot)
+{
+	SceUInt64 renderStart;
+	uint32_t requestedGrain;
+
+	requestedGrain = (uint32_t)atomic_load32(&work->requestedGrain);
+	if (requestedGrain != 0 && requestedGrain != work->numGrain)
+		vitaSAS_internal_mix_graph_set_grain(vitaSAS_get_system(work->systemNum), requestedGrain);
+
+	renderStart = sceKernelGetProcessTimeWide();
+
+	(*work->renderHandler)(slot->buffer, work->systemNum);
+
+	slot->renderTime = (uint32_t)(sceKernelGetProcessTimeWide() - renderStart);
+	slot->numGrain = work->numGrain;
+}
+
+/* Output one rendered slot, the port follows the grain the slot was rendered with */
+
+static int vitaSAS_internal_audio_out_output(AudioOutWork *work, AudioOutPortState *port, const AudioOutSlot *slot)
+{
+	SceUInt64 waitStart;
+	uint32_t isUnderrun, numGrain;
+	int result;
+
+	if (slot->numGrain != port->numGrain) {
+		result = sceAudioOutSetConfig(port->portId, slot->numGrain, -1, -1);
+		if (result < 0) {
+			SCE_DBG_LOG_WARNING("[SAS] sceAudioOutSetConfig(): 0x%X", result);
+		}
+		else {
+			port->numGrain = slot->numGrain;
+			port->grainTime = slot->numGrain * 1000000 / work->outputSamplingRate;
+		}
+	}
+
+	/* Port has already played everything we gave it, there will be a gap */
+
+	isUnderrun = port->numOutputs > 0 && sceAudioOutGetRestSample(port->portId) == 0;
+
+	/* Output audio */
+
+	waitStart = sceKernelGetProcessTimeWide();
+
+	result = sceAudioOutOutput(port->portId, slot->buffer);
+	if (result < 0)
+		return result;
+
+	port->numOutputs++;
+
+	vitaSAS_internal_render_stats_record(&work->renderStats, port->grainTime, slot->renderTime,
+		(uint32_t)(sceKernelGetProcessTimeWide() - waitStart), isUnderrun);
+
+	/* Adapt grain of the whole tree, the change is picked up by the next render */
+
+	if (work->numGrainMax != 0) {
+		numGrain = vitaSAS_internal_adaptive_grain_next(work, &port->adaptiveState, port->numGrain, port->grainTime,
+			slot->renderTime, isUnderrun || slot->renderTime > port->grainTime);
+		if (numGrain != port->numGrain)
+			atomic_store32(&work->requestedGrain, (int32_t)numGrain);
+	}
+
+	return SCE_OK;
+}
+
+int vitaSAS_internal_render_thread(unsigned int args, void *argc)
+{
+	AudioOutWork *work;
+	unsigned int slotId;
+
+	work = *(AudioOutWork**)argc;
+
+	/* Render loop, free slots are handed back by the output thread */
+
+	for (slotId = 0; ; slotId = (slotId + 1) % work->numBuffers)
+	{
+		/* Check render pause flag */
+
+		sceKernelWaitEventFlag(work->eventFlagId, 1, SCE_KERNEL_EVF_WAITMODE_AND, NULL, NULL);
+
+		sceKernelWaitSema(work->freeSemaId, 1, NULL);
+
+		if (work->isAborted != 0)
+			break;
+
+		vitaSAS_internal_audio_out_render(work, &work->slots[slotId]);
+
+		atomic_add32(&work->numReady, 1);
+		sceKernelSignalSema(work->readySemaId, 1);
+	}
+
+	return sceKernelExitDeleteThread(0);
+}
+
 int vitaSAS_internal_update_thread(unsigned int args, void *argc)
 {
 	AudioOutWork *work;
-	unsigned int bufferId;
-	int result, aVolume[CHANNEL_MAX], portId;
+	unsigned int slotId;
+	int result, aVolume[CHANNEL_MAX];
+	AudioOutPortState port;
 
 	work = *(AudioOutWork**)argc;
 
-	short* aBuffer[BUFFER_MAX];
-	aBuffer[0] = heap_alloc_heap_memory(vitaSAS_heap_internal, work->numGrain * 4);
-	aBuffer[1] = heap_alloc_heap_memory(vitaSAS_heap_internal, work->numGrain * 4);
+	sceClibMemset(&port, 0, sizeof(port));
 
 	/* Open audio out port */
 
-	result = portId = sceAudioOutOpenPort(
+	result = port.portId = sceAudioOutOpenPort(
 			work->outputPort,
 			work->numGrain,
 			work->outputSamplingRate,
@@ -52,63 +212,163 @@ int vitaSAS_internal_update_thread(unsigned int args, void *argc)
 		goto abort;
 	}
 
-	work->portId = portId;
+	work->portId = port.portId;
 
 	/* Set volume */
 
 	aVolume[0] = aVolume[1] = SCE_AUDIO_VOLUME_0DB;
 
-	sceAudioOutSetVolume(portId, (SCE_AUDIO_VOLUME_FLAG_L_CH | SCE_AUDIO_VOLUME_FLAG_R_CH), aVolume);
+	sceAudioOutSetVolume(port.portId, (SCE_AUDIO_VOLUME_FLAG_L_CH | SCE_AUDIO_VOLUME_FLAG_R_CH), aVolume);
 
 	/* Output loop */
 
-	bufferId = 0;
+	port.numGrain = work->numGrain;
+	port.grainTime = work->numGrain * 1000000 / work->outputSamplingRate;
 
-	while (work->isAborted == 0)
+	for (slotId = 0; work->isAborted == 0; slotId = (slotId + 1) % work->numBuffers)
 	{
-		/* Check render pause flag */
+		if (work->renderAhead == 0) {
 
-		sceKernelWaitEventFlag(work->eventFlagId, 1, SCE_KERNEL_EVF_WAITMODE_AND, NULL, NULL);
-
-		/* Call rendering handler */
+			/* Check render pause flag */
 
-		(*work->renderHandler)(aBuffer[bufferId], work->systemNum);
+			sceKernelWaitEventFlag(work->eventFlagId, 1, SCE_KERNEL_EVF_WAITMODE_AND, NULL, NULL);
 
-		/* Output audio */
+			vitaSAS_internal_audio_out_render(work, &work->slots[slotId]);
 
-		result = sceAudioOutOutput(portId, aBuffer[bufferId]);
-		if (result < 0) {
-			goto abort;
+			result = vitaSAS_internal_audio_out_output(work, &port, &work->slots[slotId]);
+			if (result < 0) {
+				goto abort;
+			}
 		}
+		else {
 
-		/* Swap buffer */
+			/* Wait for the render thread */
 
-		bufferId ^= 1;
-	}
+			sceKernelWaitSema(work->readySemaId, 1, NULL);
 
-abort:
+			if (work->isAborted != 0)
+				break;
 
-	/* Free buffers */
+			result = vitaSAS_internal_audio_out_output(work, &port, &work->slots[slotId]);
 
-	heap_free_heap_memory(vitaSAS_heap_internal, aBuffer[0]);
-	heap_free_heap_memory(vitaSAS_heap_internal, aBuffer[1]);
+			atomic_add32(&work->numReady, -1);
+
+			if (result < 0) {
+				goto abort;
+			}
+
+			/* Port has taken the previous buffer, it can be rendered into again */
+
+			if (port.numOutputs > 1)
+				sceKernelSignalSema(work->freeSemaId, 1);
+		}
+	}
+
+abort:
 
 	/* Flush buffer */
 
-	sceAudioOutOutput(portId, NULL);
+	sceAudioOutOutput(port.portId, NULL);
 
 	/* Release audio output port */
 
-	result = sceAudioOutReleasePort(portId);
+	result = sceAudioOutReleasePort(port.portId);
 
 	SCE_DBG_LOG_DEBUG("[SAS] SAS sytem audio output has been aborted");
 
 	return sceKernelExitDeleteThread(0);
 }
 
+static void vitaSAS_internal_audio_out_free(AudioOutWork *work)
+{
+	if (0 < work->freeSemaId) {
+		sceKernelDeleteSema(work->freeSemaId);
+		work->freeSemaId = 0;
+	}
+
+	if (0 < work->readySemaId) {
+		sceKernelDeleteSema(work->readySemaId);
+		work->readySemaId = 0;
+	}
+
+	if (work->slots != NULL) {
+		heap_free_heap_memory(vitaSAS_heap_internal, work->slots[0].buffer);
+		heap_free_heap_memory(vitaSAS_heap_internal, work->slots);
+		work->slots = NULL;
+	}
+}
+
 int vitaSAS_internal_audio_out_start(AudioOutWork *work, unsigned int thPriority, unsigned int thStackSize, unsigned int thCpu)
 {
 	int result;
+	unsigned int bufferGrain, i;
+	short* buffer;
+
+	/* Ring must hold the grains rendered ahead, the one being played and the one queued behind it */
+
+	if (work->numBuffers == 0)
+		work->numBuffers = BUFFER_MAX;
+	if (work->renderAhead != 0 && work->numBuffers < work->renderAhead + 2)
+		work->numBuffers = work->renderAhead + 2;
+
+	/* Buffers fit the largest grain the system may adapt to */
+
+	bufferGrain = work->numGrainMax != 0 ? work->numGrainMax : work->numGrain;
+
+	work->portId = -1;
+	work->slots = heap_alloc_heap_memory(vitaSAS_heap_internal, work->numBuffers * sizeof(AudioOutSlot));
+	if (work->slots == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		result = SCE_KERNEL_ERROR_NO_MEMORY;
+		goto failed;
+	}
+
+	buffer = heap_alloc_heap_memory(vitaSAS_heap_internal, work->numBuffers * bufferGrain * 4);
+	if (buffer == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		heap_free_heap_memory(vitaSAS_heap_internal, work->slots);
+		work->slots = NULL;
+		result = SCE_KERNEL_ERROR_NO_MEMORY;
+		goto failed;
+	}
+
+	for (i = 0; i < work->numBuffers; i++) {
+		work->slots[i].buffer = buffer + i * bufferGrain * CHANNEL_MAX;
+		work->slots[i].numGrain = work->numGrain;
+		work->slots[i].renderTime = 0;
+	}
+
+	if (work->renderAhead != 0) {
+
+		/* Render thread may fill renderAhead slots and the one the port takes next */
+
+		result = work->freeSemaId = sceKernelCreateSema("vitaSAS_audio_out_free", 0, work->renderAhead + 1, work->numBuffers + 1, NULL);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateSema(): 0x%X", result);
+			goto failed;
+		}
+
+		result = work->readySemaId = sceKernelCreateSema("vitaSAS_audio_out_ready", 0, 0, work->numBuffers + 1, NULL);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateSema(): 0x%X", result);
+			goto failed;
+		}
+
+		/* Create render thread */
+
+		result = work->renderThreadId = sceKernelCreateThread(
+				"vitaSAS_audio_render_thread",
+				vitaSAS_internal_render_thread,
+				thPriority,
+				thStackSize,
+				0,
+				thCpu,
+				NULL);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateThread(): 0x%X", result);
+			goto failed;
+		}
+	}
 
 	/* Create update thread */
 
@@ -125,11 +385,27 @@ int vitaSAS_internal_audio_out_start(AudioOutWork *work, unsigned int thPriority
 		goto failed;
 	}
 
+	/* Start render thread */
+
+	if (0 < work->renderThreadId) {
+		result = sceKernelStartThread(work->renderThreadId, sizeof(work), &work);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS] sceKernelStartThread(): 0x%X", result);
+			goto failed;
+		}
+	}
+
 	/* Start update thread */
 
 	result = sceKernelStartThread(work->updateThreadId, sizeof(work), &work);
 	if (result < 0) {
 		SCE_DBG_LOG_ERROR("[SAS] sceKernelStartThread(): 0x%X", result);
+		if (0 < work->renderThreadId) {
+			work->isAborted = 1;
+			sceKernelSignalSema(work->freeSemaId, 1);
+			sceKernelWaitThreadEnd(work->renderThreadId, NULL, NULL);
+			work->renderThreadId = 0;
+		}
 		goto failed;
 	}
 
@@ -142,21 +418,55 @@ failed:
 		work->updateThreadId = 0;
 	}
 
+	if (0 < work->renderThreadId) {
+		sceKernelDeleteThread(work->renderThreadId);
+		work->renderThreadId = 0;
+	}
+
+	vitaSAS_internal_audio_out_free(work);
+
 	return result;
 }
 
 int vitaSAS_internal_audio_out_stop(AudioOutWork* work)
 {
-	/* Shutdown update thread */
+	/* Shutdown update and render threads, paused threads and threads waiting on the ring are woken up */
 
 	if (0 < work->updateThreadId) {
 		work->isAborted = 1;
+
+		if (0 < work->renderThreadId) {
+			sceKernelSetEventFlag(work->eventFlagId, 1);
+			sceKernelSignalSema(work->freeSemaId, 1);
+			sceKernelSignalSema(work->readySemaId, 1);
+			sceKernelWaitThreadEnd(work->renderThreadId, NULL, NULL);
+		}
+
 		sceKernelWaitThreadEnd(work->updateThreadId, NULL, NULL);
 	}
 
+	vitaSAS_internal_audio_out_free(work);
+
 	/* Clear work */
 
 	sceClibMemset(work, 0, sizeof(*work));
 
 	return 0;
 }
+
+int vitaSAS_system_get_output_latency(vitaSASSystem* system)
+{
+	AudioOutWork* work = &system->audioWork;
+	int restSample;
+
+	if (system->isSubSystem || work->updateThreadId <= 0)
+		return VITASAS_ERROR_NOT_SUPPORTED;
+
+	/* Port may not be open yet */
+
+	restSample = work->portId < 0 ? 0 : sceAudioOutGetRestSample(work->portId);
+	if (restSample < 0)
+		restSample = 0;
+
+	return atomic_load32(&work->numReady) * (int)work->numGrain + restSample;
+}
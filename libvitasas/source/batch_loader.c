@@ -0,0 +1,319 @@
+#include <kernel.h>
+#include <libdbg.h>
+#include <fios2.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+
+extern void* vitaSAS_heap_internal;
+
+/*
+ * Batch sample loading. All files are resolved first, reads are sorted by backing file and offset,
+ * and neighbouring ranges of the same backing file (files of one archive) are merged into one read
+ * into a staging block, which is then split into samples. Files that resolve to themselves are read
+ * directly into their sample.
+ */
+
+typedef struct vitaSASBatchEntry {
+	unsigned int index;
+	const char* backingPath;
+	SceFiosOffset offset;
+	SceFiosSize size;
+} vitaSASBatchEntry;
+
+typedef struct vitaSASBatchBacking {
+	struct vitaSASBatchBacking* next;
+	char path[];
+} vitaSASBatchBacking;
+
+/* Backing files are shared by all entries that resolve into them, entries compare them by pointer */
+
+static const char* vitaSAS_internal_batch_backing(vitaSASBatchBacking** backings, const char* path)
+{
+	vitaSASBatchBacking* backing;
+	SceSize length;
+
+	for (backing = *backings; backing != NULL; backing = backing->next) {
+		if (sceClibStrcmp(backing->path, path) == 0)
+			return backing->path;
+	}
+
+	length = sceClibStrnlen(path, SCE_FIOS_PATH_MAX - 1);
+
+	backing = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASBatchBacking) + length + 1);
+	if (backing == NULL)
+		return NULL;
+
+	sceClibMemcpy(backing->path, path, length);
+	backing->path[length] = '\0';
+	backing->next = *backings;
+	*backings = backing;
+
+	return backing->path;
+}
+
+static int vitaSAS_internal_batch_resolve(vitaSASBatchEntry* entry, char* path, int io_type, SceFiosTuple* tuple, vitaSASBatchBacking** backings)
+{
+	SceFiosStat fiosStat;
+	SceIoStat ioStat;
+	int result;
+
+	entry->backingPath = path;
+	entry->offset = 0;
+
+	if (io_type != 1) {
+		result = sceIoGetstat(path, &ioStat);
+		if (result < 0)
+			return result;
+
+		entry->size = ioStat.st_size;
+		return SCE_OK;
+	}
+
+	/* Files inside archives resolve to a range of the archive */
+
+	sceClibMemset(tuple, 0, sizeof(SceFiosTuple));
+	sceClibStrncpy(tuple->path, path, SCE_FIOS_PATH_MAX - 1);
+
+	result = sceFiosResolveSync(NULL, tuple, tuple);
+	if (result < 0)
+		return result;
+
+	if (tuple->size != 0 && sceClibStrcmp(tuple->path, path) != 0) {
+		entry->backingPath = vitaSAS_internal_batch_backing(backings, tuple->path);
+		if (entry->backingPath == NULL)
+			return SCE_KERNEL_ERROR_NO_MEMORY;
+
+		entry->offset = tuple->offset;
+		entry->size = tuple->size;
+		return SCE_OK;
+	}
+
+	result = sceFiosStatSync(NULL, path, &fiosStat);
+	if (result < 0)
+		return result;
+
+	entry->size = fiosStat.fileSize;
+
+	return SCE_OK;
+}
+
+/* Insertion sort by backing file and offset, batches are a few hundred files at most */
+
+static void vitaSAS_internal_batch_sort(vitaSASBatchEntry* entries, unsigned int count)
+{
+	vitaSASBatchEntry entry;
+	unsigned int i, j;
+
+	for (i = 1; i < count; i++) {
+		entry = entries[i];
+
+		for (j = i; j > 0; j--) {
+			if ((uintptr_t)entries[j - 1].backingPath < (uintptr_t)entry.backingPath)
+				break;
+			if (entries[j - 1].backingPath == entry.backingPath && entries[j - 1].offset <= entry.offset)
+				break;
+			entries[j] = entries[j - 1];
+		}
+
+		entries[j] = entry;
+	}
+}
+
+/* Number of entries starting at first that are read together */
+
+static unsigned int vitaSAS_internal_batch_run(const vitaSASBatchEntry* entries, unsigned int first, unsigned int count, SceFiosSize* runSize)
+{
+	SceFiosOffset runStart = entries[first].offset;
+	SceFiosOffset runEnd = runStart + entries[first].size;
+	SceFiosOffset end;
+	unsigned int last;
+
+	for (last = first + 1; last < count; last++) {
+		if (entries[last].backingPath != entries[first].backingPath)
+			break;
+
+		end = entries[last].offset + entries[last].size;
+		if (entries[last].offset > runEnd + VITASAS_BATCH_GAP_MAX || (end > runEnd ? end : runEnd) - runStart > VITASAS_BATCH_READ_MAX)
+			break;
+
+		if (end > runEnd)
+			runEnd = end;
+	}
+
+	*runSize = runEnd - runStart;
+
+	return last - first;
+}
+
+static vitaSASAudio* vitaSAS_internal_batch_audio(unsigned int size)
+{
+	vitaSASAudio* info;
+	SceUID mem_id;
+
+	info = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASAudio));
+	if (info == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return NULL;
+	}
+
+	info->datap = vitaSAS_internal_sample_alloc(size, &mem_id);
+	if (info->datap == NULL) {
+		heap_free_heap_memory(vitaSAS_heap_internal, info);
+		return NULL;
+	}
+
+	info->data_size = size;
+	info->data_id = mem_id;
+	info->storage = mem_id != 0 ? VITASAS_AUDIO_STORAGE_MEMBLOCK : VITASAS_AUDIO_STORAGE_POOL;
+	info->numChannels = 1;
+
+	return info;
+}
+
+static int vitaSAS_internal_batch_read(const char* path, int io_type, void* buffer, SceFiosSize size, SceFiosOffset offset)
+{
+	SceFiosFH fiosFile;
+	SceUID ioFile;
+	int result;
+
+	if (io_type == 1) {
+		result = sceFiosFHOpenSync(NULL, &fiosFile, path, NULL);
+		if (result < 0)
+			return result;
+
+		result = (int)sceFiosFHPreadSync(NULL, fiosFile, buffer, size, offset);
+		sceFiosFHCloseSync(NULL, fiosFile);
+	}
+	else {
+		ioFile = sceIoOpen(path, SCE_O_RDONLY, 0);
+		if (ioFile < 0)
+			return ioFile;
+
+		result = sceIoPread(ioFile, buffer, size, offset);
+		sceIoClose(ioFile);
+	}
+
+	if (result >= 0 && result != size)
+		result = VITASAS_ERROR_NOT_SUPPORTED;
+
+	return result;
+}
+
+int vitaSAS_load_audio_batch(char** soundPaths, unsigned int count, int io_type, vitaSASAudio** outAudio)
+{
+	vitaSASBatchEntry* entries;
+	vitaSASBatchBacking* backings = NULL;
+	vitaSASBatchBacking* backing;
+	vitaSASAudio* info;
+	SceFiosTuple* tuple;
+	SceFiosSize runSize, stagingSize = 0;
+	SceUID stagingId = 0;
+	void* staging = NULL;
+	unsigned int i, j, numResolved = 0, runLength;
+	int result, numLoaded = 0;
+
+	for (i = 0; i < count; i++)
+		outAudio[i] = NULL;
+
+	entries = heap_alloc_heap_memory(vitaSAS_heap_internal, count * sizeof(vitaSASBatchEntry));
+	tuple = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(SceFiosTuple));
+	if (entries == NULL || tuple == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		result = SCE_KERNEL_ERROR_NO_MEMORY;
+		goto exit;
+	}
+
+	/* Resolve all files, files that can't be resolved are left out */
+
+	for (i = 0; i < count; i++) {
+		entries[numResolved].index = i;
+
+		result = vitaSAS_internal_batch_resolve(&entries[numResolved], soundPaths[i], io_type, tuple, &backings);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS IO] Can't resolve %s: 0x%X", soundPaths[i], result);
+			continue;
+		}
+
+		numResolved++;
+	}
+
+	vitaSAS_internal_batch_sort(entries, numResolved);
+
+	/* Staging block fits the largest merged read */
+
+	for (i = 0; i < numResolved; i += runLength) {
+		runLength = vitaSAS_internal_batch_run(entries, i, numResolved, &runSize);
+		if (runLength > 1 && stagingSize < runSize)
+			stagingSize = runSize;
+	}
+
+	if (stagingSize != 0) {
+		stagingId = sceKernelAllocMemBlock("vitaSAS_batch_staging", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, ROUND_UP(stagingSize, 4 * 1024), NULL);
+		if (stagingId < 0) {
+			SCE_DBG_LOG_ERROR("[SAS IO] sceKernelAllocMemBlock(): 0x%X", stagingId);
+			result = stagingId;
+			goto exit;
+		}
+
+		sceKernelGetMemBlockBase(stagingId, &staging);
+	}
+
+	/* Read runs in physical order */
+
+	for (i = 0; i < numResolved; i += runLength) {
+		runLength = vitaSAS_internal_batch_run(entries, i, numResolved, &runSize);
+
+		if (runLength == 1) {
+			info = vitaSAS_internal_batch_audio((unsigned int)entries[i].size);
+			if (info == NULL)
+				continue;
+
+			result = vitaSAS_internal_batch_read(entries[i].backingPath, io_type, info->datap, entries[i].size, entries[i].offset);
+			if (result < 0) {
+				SCE_DBG_LOG_ERROR("[SAS IO] Can't read %s: 0x%X", soundPaths[entries[i].index], result);
+				vitaSAS_free_audio(info);
+				continue;
+			}
+
+			outAudio[entries[i].index] = info;
+			numLoaded++;
+			continue;
+		}
+
+		result = vitaSAS_internal_batch_read(entries[i].backingPath, io_type, staging, runSize, entries[i].offset);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS IO] Can't read %s: 0x%X", entries[i].backingPath, result);
+			continue;
+		}
+
+		for (j = i; j < i + runLength; j++) {
+			info = vitaSAS_internal_batch_audio((unsigned int)entries[j].size);
+			if (info == NULL)
+				continue;
+
+			sceClibMemcpy(info->datap, (char*)staging + (entries[j].offset - entries[i].offset), (SceSize)entries[j].size);
+
+			outAudio[entries[j].index] = info;
+			numLoaded++;
+		}
+	}
+
+	result = numLoaded;
+
+exit:
+
+	if (0 < stagingId)
+		sceKernelFreeMemBlock(stagingId);
+
+	while (backings != NULL) {
+		backing = backings->next;
+		heap_free_heap_memory(vitaSAS_heap_internal, backings);
+		backings = backing;
+	}
+
+	heap_free_heap_memory(vitaSAS_heap_internal, tuple);
+	heap_free_heap_memory(vitaSAS_heap_internal, entries);
+
+	return result;
+}
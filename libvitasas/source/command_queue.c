@@ -0,0 +1,282 @@
+#include <kernel.h>
+#include <libdbg.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+#include "atomic.h"
+
+extern void* vitaSAS_heap_internal;
+
+/*
+ * Bounded multi-producer single-consumer queue.
+ * Every slot carries a sequence number: a producer claims a slot by advancing writePos and
+ * publishes it by storing pos + 1 into the slot sequence. The consumer (render thread) releases
+ * the slot for the next lap by storing pos + size.
+ */
+
+static void vitaSAS_internal_command_copy(vitaSASCommand* dst, const vitaSASCommand* src)
+{
+	dst->type = src->type;
+	dst->voiceID = src->voiceID;
+	dst->arg[0] = src->arg[0];
+	dst->arg[1] = src->arg[1];
+	dst->arg[2] = src->arg[2];
+	dst->arg[3] = src->arg[3];
+	dst->arg[4] = src->arg[4];
+	dst->ptr = src->ptr;
+}
+
+int vitaSAS_internal_command_queue_create(vitaSASCommandQueue* queue, unsigned int size)
+{
+	unsigned int numCommands = 1;
+
+	while (numCommands < size)
+		numCommands <<= 1;
+
+	queue->commands = heap_alloc_heap_memory(vitaSAS_heap_internal, numCommands * sizeof(vitaSASCommand));
+	if (queue->commands == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return -1;
+	}
+
+	for (int i = 0; i < numCommands; i++)
+		queue->commands[i].sequence = i;
+
+	queue->mask = numCommands - 1;
+	queue->writePos = 0;
+	queue->readPos = 0;
+	queue->numFrames = 0;
+
+	for (int i = 0; i < VITASAS_COMMAND_FRAME_MAX; i++) {
+		queue->frames[i].threadId = 0;
+		queue->frames[i].commands = NULL;
+	}
+
+	return 0;
+}
+
+void vitaSAS_internal_command_queue_destroy(vitaSASCommandQueue* queue)
+{
+	if (queue->commands != NULL)
+		heap_free_heap_memory(vitaSAS_heap_internal, queue->commands);
+
+	for (int i = 0; i < VITASAS_COMMAND_FRAME_MAX; i++) {
+		if (queue->frames[i].commands != NULL)
+			heap_free_heap_memory(vitaSAS_heap_internal, queue->frames[i].commands);
+		queue->frames[i].commands = NULL;
+	}
+
+	queue->commands = NULL;
+	queue->mask = 0;
+}
+
+int vitaSAS_internal_command_queue_push(vitaSASCommandQueue* queue, const vitaSASCommand* command)
+{
+	vitaSASCommand* slot;
+	int32_t pos, sequence, prev, diff;
+
+	pos = atomic_load32(&queue->writePos);
+
+	for (;;) {
+		slot = &queue->commands[pos & queue->mask];
+		sequence = atomic_load32(&slot->sequence);
+		diff = (int32_t)((uint32_t)sequence - (uint32_t)pos);
+
+		if (diff == 0) {
+
+			/* Slot is free for this lap, try to claim it */
+
+			prev = atomic_cas32(&queue->writePos, pos, (int32_t)((uint32_t)pos + 1));
+			if (prev == pos)
+				break;
+			pos = prev;
+		}
+		else if (diff < 0) {
+
+			/* Render thread has not consumed this slot yet */
+
+			return VITASAS_ERROR_COMMAND_QUEUE_FULL;
+		}
+		else
+			pos = atomic_load32(&queue->writePos);
+	}
+
+	vitaSAS_internal_command_copy(slot, command);
+
+	/* Publish */
+
+	atomic_store32(&slot->sequence, (int32_t)((uint32_t)pos + 1));
+
+	return SCE_OK;
+}
+
+int vitaSAS_internal_command_queue_reserve(vitaSASCommandQueue* queue, unsigned int count, int32_t* pos)
+{
+	int32_t first, last, sequence, prev, diff;
+
+	if (count == 0 || count > queue->mask + 1)
+		return VITASAS_ERROR_COMMAND_QUEUE_FULL;
+
+	first = atomic_load32(&queue->writePos);
+
+	for (;;) {
+
+		/* Slots are released in order, so if the last one is free for this lap all of them are */
+
+		last = (int32_t)((uint32_t)first + count - 1);
+		sequence = atomic_load32(&queue->commands[last & queue->mask].sequence);
+		diff = (int32_t)((uint32_t)sequence - (uint32_t)last);
+
+		if (diff == 0) {
+			prev = atomic_cas32(&queue->writePos, first, (int32_t)((uint32_t)first + count));
+			if (prev == first)
+				break;
+			first = prev;
+		}
+		else if (diff < 0)
+			return VITASAS_ERROR_COMMAND_QUEUE_FULL;
+		else
+			first = atomic_load32(&queue->writePos);
+	}
+
+	*pos = first;
+
+	return SCE_OK;
+}
+
+void vitaSAS_internal_command_queue_commit(vitaSASCommandQueue* queue, int32_t pos, unsigned int count)
+{
+	/*
+	 * Publish back to front: the render thread stops at the first unpublished slot,
+	 * so it either sees the whole range or nothing of it and the range lands on a single grain.
+	 */
+
+	while (count > 0) {
+		count--;
+		atomic_store32(&queue->commands[((uint32_t)pos + count) & queue->mask].sequence, (int32_t)((uint32_t)pos + count + 1));
+	}
+}
+
+int vitaSAS_internal_command_queue_pop(vitaSASCommandQueue* queue, vitaSASCommand* command)
+{
+	vitaSASCommand* slot;
+	int32_t pos, sequence;
+
+	pos = queue->readPos;
+	slot = &queue->commands[pos & queue->mask];
+	sequence = atomic_load32(&slot->sequence);
+
+	if (sequence != (int32_t)((uint32_t)pos + 1))
+		return 0;
+
+	vitaSAS_internal_command_copy(command, slot);
+
+	/* Release slot for the next lap */
+
+	atomic_store32(&slot->sequence, (int32_t)((uint32_t)pos + queue->mask + 1));
+	queue->readPos = (int32_t)((uint32_t)pos + 1);
+
+	return 1;
+}
+
+/*
+ * Frames are claimed by thread ID with a CAS and only touched by their thread until released.
+ * numFrames lets submits outside of frames skip the lookup.
+ */
+
+vitaSASCommandFrame* vitaSAS_internal_command_queue_find_frame(vitaSASCommandQueue* queue, int32_t threadId)
+{
+	if (atomic_load32(&queue->numFrames) == 0)
+		return NULL;
+
+	for (int i = 0; i < VITASAS_COMMAND_FRAME_MAX; i++) {
+		if (atomic_load32(&queue->frames[i].threadId) == threadId)
+			return &queue->frames[i];
+	}
+
+	return NULL;
+}
+
+int vitaSAS_internal_command_queue_begin_frame(vitaSASCommandQueue* queue, int32_t threadId)
+{
+	vitaSASCommandFrame* frame = vitaSAS_internal_command_queue_find_frame(queue, threadId);
+
+	if (frame != NULL) {
+		frame->depth++;
+		return SCE_OK;
+	}
+
+	for (int i = 0; i < VITASAS_COMMAND_FRAME_MAX; i++) {
+		frame = &queue->frames[i];
+
+		if (atomic_cas32(&frame->threadId, 0, threadId) != 0)
+			continue;
+
+		/* Staging is allocated on first use of the frame and kept until the queue is destroyed */
+
+		if (frame->commands == NULL) {
+			frame->commands = heap_alloc_heap_memory(vitaSAS_heap_internal, (queue->mask + 1) * sizeof(vitaSASCommand));
+			if (frame->commands == NULL) {
+				SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+				atomic_store32(&frame->threadId, 0);
+				return -1;
+			}
+		}
+
+		frame->depth = 1;
+		frame->numCommands = 0;
+		frame->result = SCE_OK;
+		atomic_add32(&queue->numFrames, 1);
+
+		return SCE_OK;
+	}
+
+	return VITASAS_ERROR_NO_FREE_FRAME;
+}
+
+int vitaSAS_internal_command_queue_stage(vitaSASCommandQueue* queue, vitaSASCommandFrame* frame, const vitaSASCommand* command)
+{
+	/* A frame that can't fit the queue is dropped as a whole on commit */
+
+	if (frame->numCommands > queue->mask) {
+		frame->result = VITASAS_ERROR_COMMAND_QUEUE_FULL;
+		return VITASAS_ERROR_COMMAND_QUEUE_FULL;
+	}
+
+	vitaSAS_internal_command_copy(&frame->commands[frame->numCommands], command);
+	frame->numCommands++;
+
+	return SCE_OK;
+}
+
+int vitaSAS_internal_command_queue_commit_frame(vitaSASCommandQueue* queue, int32_t threadId)
+{
+	vitaSASCommandFrame* frame = vitaSAS_internal_command_queue_find_frame(queue, threadId);
+	int32_t pos;
+	int result;
+
+	if (frame == NULL)
+		return -1;
+
+	frame->depth--;
+	if (frame->depth != 0)
+		return SCE_OK;
+
+	result = frame->result;
+
+	if (result == SCE_OK && frame->numCommands != 0) {
+		result = vitaSAS_internal_command_queue_reserve(queue, frame->numCommands, &pos);
+		if (result == SCE_OK) {
+			for (uint32_t i = 0; i < frame->numCommands; i++)
+				vitaSAS_internal_command_copy(&queue->commands[((uint32_t)pos + i) & queue->mask], &frame->commands[i]);
+
+			vitaSAS_internal_command_queue_commit(queue, pos, frame->numCommands);
+		}
+	}
+
+	frame->numCommands = 0;
+	atomic_add32(&queue->numFrames, -1);
+	atomic_store32(&frame->threadId, 0);
+
+	return result;
+}
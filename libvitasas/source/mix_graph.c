@@ -0,0 +1,419 @@
+#include <kernel.h>
+#include <libdbg.h>
+#include <sas.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+#include "pcm_kernels.h"
+#include "soft_mixer.h"
+
+extern void* vitaSAS_heap_internal;
+
+/*
+ * Every SAS system is a node of the mix graph. Only root nodes are rendered by an audio out thread,
+ * each root owns a flat render plan of its whole tree in post-order (children before parents).
+ * Plans are rebuilt on graph change only, so the render thread never walks the graph itself.
+ *
+ * Graph edits are serialized by SASMixGraphMutex. Each root's plan is swapped under its own mixPlanMutex,
+ * which the render thread holds for one grain, so independent outputs never contend with each other.
+ */
+
+static SceKernelLwMutexWork SASMixGraphMutex;
+
+int vitaSAS_internal_mix_graph_init(void)
+{
+	return sceKernelCreateLwMutex(&SASMixGraphMutex, "vitaSAS_mix_graph", 0, 0, NULL);
+}
+
+void vitaSAS_internal_mix_graph_term(void)
+{
+	sceKernelDeleteLwMutex(&SASMixGraphMutex);
+}
+
+static vitaSASSystem* vitaSAS_internal_mix_graph_root(vitaSASSystem* system)
+{
+	while (system->parent != NULL)
+		system = system->parent;
+
+	return system;
+}
+
+static unsigned int vitaSAS_internal_mix_graph_count(const vitaSASSystem* system)
+{
+	unsigned int count = 1;
+
+	for (const vitaSASSystem* child = system->firstChild; child != NULL; child = child->nextSibling)
+		count += vitaSAS_internal_mix_graph_count(child);
+
+	return count;
+}
+
+static int vitaSAS_internal_mix_graph_build(vitaSASSystem* system, vitaSASMixPlanEntry* entries, unsigned int* numEntries,
+	int16_t* buffer, int16_t* mixTarget, unsigned int mixOp)
+{
+	vitaSASMixPlanEntry* entry;
+	int16_t* childBuffer;
+	unsigned int childOp;
+	int result;
+
+	for (vitaSASSystem* child = system->firstChild; child != NULL; child = child->nextSibling) {
+
+		/* Single child renders in place, several children are mixed in software */
+
+		if (system->numChildren == 1) {
+			childBuffer = buffer;
+			childOp = VITASAS_MIX_OP_IN_PLACE;
+		}
+		else {
+			if (child->mixBuffer == NULL) {
+				child->mixBuffer = heap_alloc_heap_memory(vitaSAS_heap_internal, VITASAS_GRAIN_MAX * sizeof(int16_t) * CHANNEL_MAX);
+				if (child->mixBuffer == NULL) {
+					SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+					return -1;
+				}
+			}
+			childBuffer = child->mixBuffer;
+			childOp = child == system->firstChild ? VITASAS_MIX_OP_COPY : VITASAS_MIX_OP_ADD;
+		}
+
+		result = vitaSAS_internal_mix_graph_build(child, entries, numEntries, childBuffer, buffer, childOp);
+		if (result < 0)
+			return result;
+	}
+
+	entry = &entries[*numEntries];
+	entry->system = system;
+	entry->inPlaceChild = system->numChildren == 1 ? system->firstChild : NULL;
+	entry->buffer = buffer;
+	entry->mixTarget = mixTarget;
+	entry->mixOp = mixOp;
+	entry->numChildren = system->numChildren;
+
+	(*numEntries)++;
+
+	return SCE_OK;
+}
+
+static void vitaSAS_internal_mix_graph_swap_plan(vitaSASSystem* system, const vitaSASMixPlan* plan)
+{
+	vitaSASMixPlanEntry* oldEntries;
+
+	sceKernelLockLwMutex(&system->mixPlanMutex, 1, NULL);
+
+	oldEntries = system->mixPlan.entries;
+
+	if (plan != NULL)
+		system->mixPlan = *plan;
+	else
+		sceClibMemset(&system->mixPlan, 0, sizeof(vitaSASMixPlan));
+
+	sceKernelUnlockLwMutex(&system->mixPlanMutex, 1);
+
+	if (oldEntries != NULL)
+		heap_free_heap_memory(vitaSAS_heap_internal, oldEntries);
+}
+
+static int vitaSAS_internal_mix_graph_rebuild(vitaSASSystem* root)
+{
+	vitaSASMixPlan plan;
+	unsigned int count = vitaSAS_internal_mix_graph_count(root);
+	unsigned int start = 0;
+	int result;
+
+	/* Entries and jobs share one allocation */
+
+	plan.entries = heap_alloc_heap_memory(vitaSAS_heap_internal, count * sizeof(vitaSASMixPlanEntry) + root->numChildren * sizeof(vitaSASMixPlanJob));
+	if (plan.entries == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return -1;
+	}
+
+	plan.numEntries = 0;
+	plan.jobs = (vitaSASMixPlanJob*)(plan.entries + count);
+	plan.numJobs = 0;
+
+	result = vitaSAS_internal_mix_graph_build(root, plan.entries, &plan.numEntries, NULL, NULL, VITASAS_MIX_OP_IN_PLACE);
+	if (result < 0) {
+		heap_free_heap_memory(vitaSAS_heap_internal, plan.entries);
+		return result;
+	}
+
+	/* Subtrees of root children are contiguous and end with the child itself. They only share the root buffer */
+
+	if (root->numChildren > 1) {
+		for (int i = 0; i < plan.numEntries; i++) {
+			if (plan.entries[i].system->parent == root) {
+				plan.jobs[plan.numJobs].start = start;
+				plan.jobs[plan.numJobs].end = i + 1;
+				plan.numJobs++;
+				start = i + 1;
+			}
+		}
+	}
+
+	vitaSAS_internal_mix_graph_swap_plan(root, &plan);
+
+	return SCE_OK;
+}
+
+static void vitaSAS_internal_mix_graph_rebuild_or_mute(vitaSASSystem* root)
+{
+	/* Plan must never reference a removed system, drop it if it can't be rebuilt */
+
+	if (vitaSAS_internal_mix_graph_rebuild(root) < 0)
+		vitaSAS_internal_mix_graph_swap_plan(root, NULL);
+}
+
+static void vitaSAS_internal_mix_graph_unlink(vitaSASSystem* child)
+{
+	vitaSASSystem* parent = child->parent;
+	vitaSASSystem** link = &parent->firstChild;
+
+	while (*link != child)
+		link = &(*link)->nextSibling;
+
+	*link = child->nextSibling;
+	child->nextSibling = NULL;
+	child->parent = NULL;
+	parent->numChildren--;
+}
+
+int vitaSAS_internal_mix_graph_attach(vitaSASSystem* system)
+{
+	int result;
+
+	system->parent = NULL;
+	system->firstChild = NULL;
+	system->nextSibling = NULL;
+	system->numChildren = 0;
+	system->mixVolL = SCE_SAS_VOLUME_MAX;
+	system->mixVolR = SCE_SAS_VOLUME_MAX;
+	system->mixBuffer = NULL;
+	sceClibMemset(&system->mixPlan, 0, sizeof(vitaSASMixPlan));
+
+	result = sceKernelCreateLwMutex(&system->mixPlanMutex, "vitaSAS_mix_plan", 0, 0, NULL);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateLwMutex(): 0x%X", result);
+		return result;
+	}
+
+	/* New system is a root of its own single node tree */
+
+	sceKernelLockLwMutex(&SASMixGraphMutex, 1, NULL);
+	result = vitaSAS_internal_mix_graph_rebuild(system);
+	sceKernelUnlockLwMutex(&SASMixGraphMutex, 1);
+
+	if (result < 0)
+		sceKernelDeleteLwMutex(&system->mixPlanMutex);
+
+	return result;
+}
+
+void vitaSAS_internal_mix_graph_detach(vitaSASSystem* system)
+{
+	vitaSASSystem* parent = system->parent;
+	vitaSASSystem* child;
+
+	sceKernelLockLwMutex(&SASMixGraphMutex, 1, NULL);
+
+	/* Take system out of its parent tree */
+
+	if (parent != NULL) {
+		vitaSAS_internal_mix_graph_unlink(system);
+		vitaSAS_internal_mix_graph_rebuild_or_mute(vitaSAS_internal_mix_graph_root(parent));
+	}
+
+	/* Orphaned children become roots of their own trees */
+
+	while (system->firstChild != NULL) {
+		child = system->firstChild;
+		vitaSAS_internal_mix_graph_unlink(child);
+		vitaSAS_internal_mix_graph_rebuild_or_mute(child);
+	}
+
+	sceKernelUnlockLwMutex(&SASMixGraphMutex, 1);
+
+	/* Render thread of this system has been stopped already */
+
+	if (system->mixPlan.entries != NULL)
+		heap_free_heap_memory(vitaSAS_heap_internal, system->mixPlan.entries);
+	if (system->mixBuffer != NULL)
+		heap_free_heap_memory(vitaSAS_heap_internal, system->mixBuffer);
+
+	sceClibMemset(&system->mixPlan, 0, sizeof(vitaSASMixPlan));
+	system->mixBuffer = NULL;
+
+	sceKernelDeleteLwMutex(&system->mixPlanMutex);
+}
+
+void vitaSAS_internal_mix_graph_render_entry(const vitaSASMixPlanEntry* entry, void* buffer)
+{
+	vitaSASSystem* system = entry->system;
+	int16_t* target = entry->buffer != NULL ? entry->buffer : (int16_t*)buffer;
+
+	uint32_t mixVolL, mixVolR;
+
+	vitaSAS_internal_apply_command_queue(system);
+	vitaSAS_internal_voice_pool_arm(&system->voicePool);
+
+	if (entry->numChildren == 0) {
+		mixVolL = 0;
+		mixVolR = 0;
+	}
+	else if (entry->inPlaceChild != NULL) {
+		mixVolL = entry->inPlaceChild->mixVolL;
+		mixVolR = entry->inPlaceChild->mixVolR;
+	}
+	else {
+		mixVolL = SCE_SAS_VOLUME_MAX;
+		mixVolR = SCE_SAS_VOLUME_MAX;
+	}
+
+	if (system->softMixer != NULL)
+		vitaSAS_internal_soft_mixer_render(system->softMixer, target, system->audioWork.numGrain, mixVolL, mixVolR);
+	else
+		sceSasCoreInternal(system->sasSystemHandle, target, mixVolL, mixVolR);
+
+	/* Return finished voices to the pool */
+
+	vitaSAS_internal_voice_pool_reclaim(system);
+
+	/* Follow streaming voices */
+
+	vitaSAS_internal_stream_advance(system, system->audioWork.numGrain);
+}
+
+void vitaSAS_internal_mix_graph_mix_entry(const vitaSASMixPlanEntry* entry, void* buffer, unsigned int numGrain)
+{
+	vitaSASSystem* system = entry->system;
+	int16_t* source = entry->buffer != NULL ? entry->buffer : (int16_t*)buffer;
+	int16_t* target = entry->mixTarget != NULL ? entry->mixTarget : (int16_t*)buffer;
+
+	/* Mix into parent if parent has several children */
+
+	if (entry->mixOp == VITASAS_MIX_OP_COPY)
+		pcm_kernels_scale_s16_stereo(target, source, numGrain, system->mixVolL, system->mixVolR);
+	else if (entry->mixOp == VITASAS_MIX_OP_ADD)
+		pcm_kernels_mix_s16_stereo(target, source, numGrain, system->mixVolL, system->mixVolR);
+}
+
+static void vitaSAS_internal_mix_graph_apply_grain(vitaSASSystem* system, unsigned int numGrain)
+{
+	int result;
+
+	system->audioWork.numGrain = numGrain;
+
+	if (system->softMixer == NULL) {
+		result = sceSasSetGrainInternal(system->sasSystemHandle, numGrain);
+		if (SCE_SAS_FAILED(result))
+			SCE_DBG_LOG_WARNING("[SAS] sceSasSetGrainInternal(): 0x%X", result);
+	}
+
+	for (vitaSASSystem* child = system->firstChild; child != NULL; child = child->nextSibling)
+		vitaSAS_internal_mix_graph_apply_grain(child, numGrain);
+}
+
+void vitaSAS_internal_mix_graph_set_grain(vitaSASSystem* root, unsigned int numGrain)
+{
+	/* Called by the render thread between grains, so only graph edits have to be excluded */
+
+	sceKernelLockLwMutex(&SASMixGraphMutex, 1, NULL);
+	vitaSAS_internal_mix_graph_apply_grain(root, numGrain);
+	sceKernelUnlockLwMutex(&SASMixGraphMutex, 1);
+}
+
+int vitaSAS_system_connect(vitaSASSystem* child, vitaSASSystem* parent, unsigned int mixVolL, unsigned int mixVolR)
+{
+	vitaSASSystem** link;
+	int result;
+
+	if (child == NULL || parent == NULL || child == parent)
+		return VITASAS_ERROR_INVALID_MIX_GRAPH;
+
+	/* Child output goes to its parent only */
+
+	if (!child->isSubSystem) {
+		SCE_DBG_LOG_ERROR("[SAS] System %d has its own audio output and can't be connected", child->systemNum);
+		return VITASAS_ERROR_INVALID_MIX_GRAPH;
+	}
+
+	sceKernelLockLwMutex(&SASMixGraphMutex, 1, NULL);
+
+	if (child->parent != NULL || vitaSAS_internal_mix_graph_root(parent) == child) {
+		sceKernelUnlockLwMutex(&SASMixGraphMutex, 1);
+		SCE_DBG_LOG_ERROR("[SAS] System %d is already connected or connection would create a cycle", child->systemNum);
+		return VITASAS_ERROR_INVALID_MIX_GRAPH;
+	}
+
+	/* Grain of adaptive roots changes at run time, new children follow the current one */
+
+	if (child->audioWork.numGrain != parent->audioWork.numGrain) {
+		if (vitaSAS_internal_mix_graph_root(parent)->audioWork.numGrainMax == 0) {
+			sceKernelUnlockLwMutex(&SASMixGraphMutex, 1);
+			SCE_DBG_LOG_ERROR("[SAS] Grain of system %d doesn't match grain of system %d", child->systemNum, parent->systemNum);
+			return VITASAS_ERROR_INVALID_MIX_GRAPH;
+		}
+
+		vitaSAS_internal_mix_graph_apply_grain(child, parent->audioWork.numGrain);
+	}
+
+	child->mixVolL = mixVolL;
+	child->mixVolR = mixVolR;
+
+	/* Keep children in connection order */
+
+	link = &parent->firstChild;
+	while (*link != NULL)
+		link = &(*link)->nextSibling;
+
+	*link = child;
+	child->parent = parent;
+	parent->numChildren++;
+
+	result = vitaSAS_internal_mix_graph_rebuild(vitaSAS_internal_mix_graph_root(parent));
+	if (result < 0) {
+		vitaSAS_internal_mix_graph_unlink(child);
+	}
+	else {
+
+		/* Child tree is rendered through its new root from now on */
+
+		vitaSAS_internal_mix_graph_swap_plan(child, NULL);
+	}
+
+	sceKernelUnlockLwMutex(&SASMixGraphMutex, 1);
+
+	return result;
+}
+
+int vitaSAS_system_disconnect(vitaSASSystem* child)
+{
+	vitaSASSystem* parent;
+
+	if (child == NULL)
+		return VITASAS_ERROR_INVALID_MIX_GRAPH;
+
+	sceKernelLockLwMutex(&SASMixGraphMutex, 1, NULL);
+
+	parent = child->parent;
+	if (parent == NULL) {
+		sceKernelUnlockLwMutex(&SASMixGraphMutex, 1);
+		return VITASAS_ERROR_INVALID_MIX_GRAPH;
+	}
+
+	vitaSAS_internal_mix_graph_unlink(child);
+	vitaSAS_internal_mix_graph_rebuild_or_mute(vitaSAS_internal_mix_graph_root(parent));
+	vitaSAS_internal_mix_graph_rebuild_or_mute(child);
+
+	sceKernelUnlockLwMutex(&SASMixGraphMutex, 1);
+
+	return SCE_OK;
+}
+
+void vitaSAS_system_set_mix_vol(vitaSASSystem* child, unsigned int mixVolL, unsigned int mixVolR)
+{
+	/* Volumes are read by the render thread on every grain, no rebuild needed */
+
+	child->mixVolL = mixVolL;
+	child->mixVolR = mixVolR;
+}
@@ -0,0 +1,869 @@
+#include "pcm_kernels.h"
+
+#if defined(PCM_KERNELS_NEON)
+#include <arm_neon.h>
+#elif defined(PCM_KERNELS_SSE2)
+#include <emmintrin.h>
+#endif
+
+static __inline__ int16_t pcm_kernels_saturate_s16(int32_t value)
+{
+	if (value > 32767)
+		return 32767;
+	if (value < -32768)
+		return -32768;
+	return (int16_t)value;
+}
+
+/* Dither generators are 32-bit LCGs, sample i of a call always uses generator i % 4 on every path */
+
+#define PCM_KERNELS_LCG_MUL		1664525
+#define PCM_KERNELS_LCG_ADD		1013904223
+
+/* Sum of two uniform bytes, triangular over +-1 LSB of the S16 result in 1/256 LSB steps */
+
+static __inline__ int32_t pcm_kernels_dither_next(pcm_kernels_dither* dither, unsigned int lane)
+{
+	uint32_t state = dither->state[lane] * PCM_KERNELS_LCG_MUL + PCM_KERNELS_LCG_ADD;
+
+	dither->state[lane] = state;
+
+	return (int32_t)(state >> 24) + (int32_t)((state >> 16) & 0xFF) - 255;
+}
+
+static __inline__ int16_t pcm_kernels_reduce_s24(int32_t value, pcm_kernels_dither* dither, unsigned int index)
+{
+	if (dither != NULL)
+		value += pcm_kernels_dither_next(dither, index & 3);
+
+	return pcm_kernels_saturate_s16((value + 128) >> 8);
+}
+
+static __inline__ int32_t pcm_kernels_load_s24(const uint8_t* src)
+{
+	return (int32_t)((uint32_t)src[0] << 8 | (uint32_t)src[1] << 16 | (uint32_t)src[2] << 24) >> 8;
+}
+
+static __inline__ int32_t pcm_kernels_f32_s24(float value)
+{
+	if (value > 1.0f)
+		value = 1.0f;
+	else if (value < -1.0f)
+		value = -1.0f;
+	else if (value != value)
+		value = 0.0f;
+
+	return (int32_t)(value * 8388608.0f);
+}
+
+#if defined(PCM_KERNELS_NEON)
+static __inline__ int32x4_t pcm_kernels_dither_next_neon(uint32x4_t* state)
+{
+	uint32x4_t noise;
+
+	*state = vmlaq_u32(vdupq_n_u32(PCM_KERNELS_LCG_ADD), *state, vdupq_n_u32(PCM_KERNELS_LCG_MUL));
+	noise = vaddq_u32(vshrq_n_u32(*state, 24), vandq_u32(vshrq_n_u32(*state, 16), vdupq_n_u32(0xFF)));
+
+	return vsubq_s32(vreinterpretq_s32_u32(noise), vdupq_n_s32(255));
+}
+
+/* 24-bit values to S16, rounded and optionally dithered */
+
+static __inline__ int16x4_t pcm_kernels_reduce_s24_neon(int32x4_t value, pcm_kernels_dither* dither, uint32x4_t* state)
+{
+	value = vaddq_s32(value, vdupq_n_s32(128));
+	if (dither != NULL)
+		value = vaddq_s32(value, pcm_kernels_dither_next_neon(state));
+
+	return vqshrn_n_s32(value, 8);
+}
+#elif defined(PCM_KERNELS_SSE2)
+
+/* Low 32 bits of lane products, the same for signed and unsigned lanes */
+
+static __inline__ __m128i pcm_kernels_mullo_s32_sse2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static __inline__ __m128i pcm_kernels_widen_low_sse2(__m128i value)
+{
+	return _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+}
+
+static __inline__ __m128i pcm_kernels_widen_high_sse2(__m128i value)
+{
+	return _mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16);
+}
+
+/* (value * gain) >> PCM_KERNELS_GAIN_SHIFT, saturated, gain lanes are 0 to PCM_KERNELS_GAIN_MAX */
+
+static __inline__ __m128i pcm_kernels_scale_sse2(__m128i value, __m128i gain)
+{
+	__m128i lo = _mm_mullo_epi16(value, gain);
+	__m128i hi = _mm_mulhi_epi16(value, gain);
+
+	return _mm_packs_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), PCM_KERNELS_GAIN_SHIFT), _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), PCM_KERNELS_GAIN_SHIFT));
+}
+
+static __inline__ __m128i pcm_kernels_dither_next_sse2(__m128i* state)
+{
+	__m128i noise;
+
+	*state = _mm_add_epi32(pcm_kernels_mullo_s32_sse2(*state, _mm_set1_epi32(PCM_KERNELS_LCG_MUL)), _mm_set1_epi32(PCM_KERNELS_LCG_ADD));
+	noise = _mm_add_epi32(_mm_srli_epi32(*state, 24), _mm_and_si128(_mm_srli_epi32(*state, 16), _mm_set1_epi32(0xFF)));
+
+	return _mm_sub_epi32(noise, _mm_set1_epi32(255));
+}
+
+/* 24-bit values to S16 in the low half, rounded and optionally dithered */
+
+static __inline__ __m128i pcm_kernels_reduce_s24_sse2(__m128i value, pcm_kernels_dither* dither, __m128i* state)
+{
+	value = _mm_add_epi32(value, _mm_set1_epi32(128));
+	if (dither != NULL)
+		value = _mm_add_epi32(value, pcm_kernels_dither_next_sse2(state));
+
+	value = _mm_srai_epi32(value, 8);
+
+	return _mm_packs_epi32(value, value);
+}
+#endif
+
+void pcm_kernels_scale_s16_stereo(int16_t* dst, const int16_t* src, unsigned int numFrames, uint32_t volL, uint32_t volR)
+{
+	unsigned int i = 0;
+
+	if (volL > PCM_KERNELS_GAIN_MAX)
+		volL = PCM_KERNELS_GAIN_MAX;
+	if (volR > PCM_KERNELS_GAIN_MAX)
+		volR = PCM_KERNELS_GAIN_MAX;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		const int16_t gainLanes[4] = { (int16_t)volL, (int16_t)volR, (int16_t)volL, (int16_t)volR };
+		int16x4_t gain = vld1_s16(gainLanes);
+		int16x8_t in;
+		int32x4_t lo, hi;
+
+		/* 4 frames per iteration */
+
+		for (; i + 4 <= numFrames; i += 4) {
+			in = vld1q_s16(src + i * 2);
+			lo = vmull_s16(vget_low_s16(in), gain);
+			hi = vmull_s16(vget_high_s16(in), gain);
+			vst1q_s16(dst + i * 2, vcombine_s16(vqshrn_n_s32(lo, PCM_KERNELS_GAIN_SHIFT), vqshrn_n_s32(hi, PCM_KERNELS_GAIN_SHIFT)));
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i gain = _mm_set_epi16((int16_t)volR, (int16_t)volL, (int16_t)volR, (int16_t)volL, (int16_t)volR, (int16_t)volL, (int16_t)volR, (int16_t)volL);
+
+		/* 4 frames per iteration */
+
+		for (; i + 4 <= numFrames; i += 4)
+			_mm_storeu_si128((__m128i*)(dst + i * 2), pcm_kernels_scale_sse2(_mm_loadu_si128((const __m128i*)(src + i * 2)), gain));
+	}
+#endif
+
+	for (; i < numFrames; i++) {
+		dst[i * 2] = pcm_kernels_saturate_s16((src[i * 2] * (int32_t)volL) >> PCM_KERNELS_GAIN_SHIFT);
+		dst[i * 2 + 1] = pcm_kernels_saturate_s16((src[i * 2 + 1] * (int32_t)volR) >> PCM_KERNELS_GAIN_SHIFT);
+	}
+}
+
+void pcm_kernels_mix_s16_stereo(int16_t* dst, const int16_t* src, unsigned int numFrames, uint32_t volL, uint32_t volR)
+{
+	unsigned int i = 0;
+
+	if (volL > PCM_KERNELS_GAIN_MAX)
+		volL = PCM_KERNELS_GAIN_MAX;
+	if (volR > PCM_KERNELS_GAIN_MAX)
+		volR = PCM_KERNELS_GAIN_MAX;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		const int16_t gainLanes[4] = { (int16_t)volL, (int16_t)volR, (int16_t)volL, (int16_t)volR };
+		int16x4_t gain = vld1_s16(gainLanes);
+		int16x8_t in, scaled;
+		int32x4_t lo, hi;
+
+		/* 4 frames per iteration */
+
+		for (; i + 4 <= numFrames; i += 4) {
+			in = vld1q_s16(src + i * 2);
+			lo = vmull_s16(vget_low_s16(in), gain);
+			hi = vmull_s16(vget_high_s16(in), gain);
+			scaled = vcombine_s16(vqshrn_n_s32(lo, PCM_KERNELS_GAIN_SHIFT), vqshrn_n_s32(hi, PCM_KERNELS_GAIN_SHIFT));
+			vst1q_s16(dst + i * 2, vqaddq_s16(vld1q_s16(dst + i * 2), scaled));
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i gain = _mm_set_epi16((int16_t)volR, (int16_t)volL, (int16_t)volR, (int16_t)volL, (int16_t)volR, (int16_t)volL, (int16_t)volR, (int16_t)volL);
+		__m128i scaled;
+
+		/* 4 frames per iteration */
+
+		for (; i + 4 <= numFrames; i += 4) {
+			scaled = pcm_kernels_scale_sse2(_mm_loadu_si128((const __m128i*)(src + i * 2)), gain);
+			_mm_storeu_si128((__m128i*)(dst + i * 2), _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(dst + i * 2)), scaled));
+		}
+	}
+#endif
+
+	for (; i < numFrames; i++) {
+		dst[i * 2] = pcm_kernels_saturate_s16(dst[i * 2] + pcm_kernels_saturate_s16((src[i * 2] * (int32_t)volL) >> PCM_KERNELS_GAIN_SHIFT));
+		dst[i * 2 + 1] = pcm_kernels_saturate_s16(dst[i * 2 + 1] + pcm_kernels_saturate_s16((src[i * 2 + 1] * (int32_t)volR) >> PCM_KERNELS_GAIN_SHIFT));
+	}
+}
+
+void pcm_kernels_deinterleave_s16_stereo(int16_t* dstL, int16_t* dstR, const int16_t* src, unsigned int numFrames)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		int16x8x2_t in;
+
+		/* 8 frames per iteration */
+
+		for (; i + 8 <= numFrames; i += 8) {
+			in = vld2q_s16(src + i * 2);
+			vst1q_s16(dstL + i, in.val[0]);
+			vst1q_s16(dstR + i, in.val[1]);
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i lo, hi;
+
+		/* 8 frames per iteration, left is the sign extended low half of each frame and right the high half */
+
+		for (; i + 8 <= numFrames; i += 8) {
+			lo = _mm_loadu_si128((const __m128i*)(src + i * 2));
+			hi = _mm_loadu_si128((const __m128i*)(src + i * 2 + 8));
+			_mm_storeu_si128((__m128i*)(dstL + i), _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(lo, 16), 16), _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16)));
+			_mm_storeu_si128((__m128i*)(dstR + i), _mm_packs_epi32(_mm_srai_epi32(lo, 16), _mm_srai_epi32(hi, 16)));
+		}
+	}
+#endif
+
+	for (; i < numFrames; i++) {
+		dstL[i] = src[i * 2];
+		dstR[i] = src[i * 2 + 1];
+	}
+}
+
+void pcm_kernels_dither_init(pcm_kernels_dither* dither, uint32_t seed)
+{
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+		dither->state[i] = seed + i * 0x9E3779B9;
+}
+
+void pcm_kernels_convert_u8_s16(int16_t* dst, const uint8_t* src, unsigned int numSamples)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	for (; i + 8 <= numSamples; i += 8)
+		vst1q_s16(dst + i, vshll_n_s8(vreinterpret_s8_u8(veor_u8(vld1_u8(src + i), vdup_n_u8(0x80))), 8));
+#elif defined(PCM_KERNELS_SSE2)
+	for (; i + 8 <= numSamples; i += 8)
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(_mm_setzero_si128(), _mm_xor_si128(_mm_loadl_epi64((const __m128i*)(src + i)), _mm_set1_epi8((char)0x80))));
+#endif
+
+	for (; i < numSamples; i++)
+		dst[i] = (int16_t)((src[i] - 128) * 256);
+}
+
+void pcm_kernels_convert_s24_s16(int16_t* dst, const uint8_t* src, unsigned int numSamples, pcm_kernels_dither* dither)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		uint32x4_t state = vdupq_n_u32(0);
+		uint8x8x3_t in;
+		uint16x8_t low;
+		int16x8_t high;
+		int32x4_t lo, hi;
+
+		if (dither != NULL)
+			state = vld1q_u32(dither->state);
+
+		/* 8 samples per iteration, upper 16 bits are widened and the low byte is merged back in */
+
+		for (; i + 8 <= numSamples; i += 8) {
+			in = vld3_u8(src + i * 3);
+			high = vreinterpretq_s16_u16(vorrq_u16(vshll_n_u8(in.val[2], 8), vmovl_u8(in.val[1])));
+			low = vmovl_u8(in.val[0]);
+			lo = vorrq_s32(vshlq_n_s32(vmovl_s16(vget_low_s16(high)), 8), vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(low))));
+			hi = vorrq_s32(vshlq_n_s32(vmovl_s16(vget_high_s16(high)), 8), vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(low))));
+			vst1_s16(dst + i, pcm_kernels_reduce_s24_neon(lo, dither, &state));
+			vst1_s16(dst + i + 4, pcm_kernels_reduce_s24_neon(hi, dither, &state));
+		}
+
+		if (dither != NULL)
+			vst1q_u32(dither->state, state);
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i state = _mm_setzero_si128();
+		__m128i value;
+
+		if (dither != NULL)
+			state = _mm_loadu_si128((const __m128i*)dither->state);
+
+		/* 4 samples per iteration, there is no byte shuffle so samples are gathered one by one */
+
+		for (; i + 4 <= numSamples; i += 4) {
+			value = _mm_set_epi32(pcm_kernels_load_s24(src + i * 3 + 9), pcm_kernels_load_s24(src + i * 3 + 6), pcm_kernels_load_s24(src + i * 3 + 3), pcm_kernels_load_s24(src + i * 3));
+			_mm_storel_epi64((__m128i*)(dst + i), pcm_kernels_reduce_s24_sse2(value, dither, &state));
+		}
+
+		if (dither != NULL)
+			_mm_storeu_si128((__m128i*)dither->state, state);
+	}
+#endif
+
+	for (; i < numSamples; i++)
+		dst[i] = pcm_kernels_reduce_s24(pcm_kernels_load_s24(src + i * 3), dither, i);
+}
+
+void pcm_kernels_convert_s32_s16(int16_t* dst, const int32_t* src, unsigned int numSamples, pcm_kernels_dither* dither)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		uint32x4_t state = vdupq_n_u32(0);
+
+		if (dither != NULL)
+			state = vld1q_u32(dither->state);
+
+		/* 4 samples per iteration */
+
+		for (; i + 4 <= numSamples; i += 4)
+			vst1_s16(dst + i, pcm_kernels_reduce_s24_neon(vshrq_n_s32(vld1q_s32(src + i), 8), dither, &state));
+
+		if (dither != NULL)
+			vst1q_u32(dither->state, state);
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i state = _mm_setzero_si128();
+
+		if (dither != NULL)
+			state = _mm_loadu_si128((const __m128i*)dither->state);
+
+		/* 4 samples per iteration */
+
+		for (; i + 4 <= numSamples; i += 4)
+			_mm_storel_epi64((__m128i*)(dst + i), pcm_kernels_reduce_s24_sse2(_mm_srai_epi32(_mm_loadu_si128((const __m128i*)(src + i)), 8), dither, &state));
+
+		if (dither != NULL)
+			_mm_storeu_si128((__m128i*)dither->state, state);
+	}
+#endif
+
+	for (; i < numSamples; i++)
+		dst[i] = pcm_kernels_reduce_s24(src[i] >> 8, dither, i);
+}
+
+void pcm_kernels_convert_f32_s16(int16_t* dst, const float* src, unsigned int numSamples, pcm_kernels_dither* dither)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		uint32x4_t state = vdupq_n_u32(0);
+		float32x4_t in;
+
+		if (dither != NULL)
+			state = vld1q_u32(dither->state);
+
+		/* 4 samples per iteration, NaN converts to 0 */
+
+		for (; i + 4 <= numSamples; i += 4) {
+			in = vminq_f32(vmaxq_f32(vld1q_f32(src + i), vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+			vst1_s16(dst + i, pcm_kernels_reduce_s24_neon(vcvtq_s32_f32(vmulq_f32(in, vdupq_n_f32(8388608.0f))), dither, &state));
+		}
+
+		if (dither != NULL)
+			vst1q_u32(dither->state, state);
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i state = _mm_setzero_si128();
+		__m128 in;
+
+		if (dither != NULL)
+			state = _mm_loadu_si128((const __m128i*)dither->state);
+
+		/* 4 samples per iteration, NaN lanes are masked to 0 before clamping */
+
+		for (; i + 4 <= numSamples; i += 4) {
+			in = _mm_loadu_ps(src + i);
+			in = _mm_and_ps(in, _mm_cmpord_ps(in, in));
+			in = _mm_min_ps(_mm_max_ps(in, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+			_mm_storel_epi64((__m128i*)(dst + i), pcm_kernels_reduce_s24_sse2(_mm_cvttps_epi32(_mm_mul_ps(in, _mm_set1_ps(8388608.0f))), dither, &state));
+		}
+
+		if (dither != NULL)
+			_mm_storeu_si128((__m128i*)dither->state, state);
+	}
+#endif
+
+	for (; i < numSamples; i++)
+		dst[i] = pcm_kernels_reduce_s24(pcm_kernels_f32_s24(src[i]), dither, i);
+}
+
+void pcm_kernels_accumulate_mono_s16(int32_t* acc, const int16_t* src, unsigned int numFrames, int32_t volL, int32_t volR)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		int16x4_t in;
+		int32x4x2_t sum;
+
+		/* 4 frames per iteration */
+
+		for (; i + 4 <= numFrames; i += 4) {
+			in = vld1_s16(src + i);
+			sum = vld2q_s32(acc + i * 2);
+			sum.val[0] = vaddq_s32(sum.val[0], vshrq_n_s32(vmulq_n_s32(vmovl_s16(in), volL), PCM_KERNELS_GAIN_SHIFT));
+			sum.val[1] = vaddq_s32(sum.val[1], vshrq_n_s32(vmulq_n_s32(vmovl_s16(in), volR), PCM_KERNELS_GAIN_SHIFT));
+			vst2q_s32(acc + i * 2, sum);
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i gain = _mm_set_epi32(volR, volL, volR, volL);
+		__m128i in, lo, hi;
+
+		/* 4 frames per iteration, each sample is duplicated into a left and right lane */
+
+		for (; i + 4 <= numFrames; i += 4) {
+			in = _mm_loadl_epi64((const __m128i*)(src + i));
+			in = _mm_unpacklo_epi16(in, in);
+			lo = _mm_srai_epi32(pcm_kernels_mullo_s32_sse2(pcm_kernels_widen_low_sse2(in), gain), PCM_KERNELS_GAIN_SHIFT);
+			hi = _mm_srai_epi32(pcm_kernels_mullo_s32_sse2(pcm_kernels_widen_high_sse2(in), gain), PCM_KERNELS_GAIN_SHIFT);
+			_mm_storeu_si128((__m128i*)(acc + i * 2), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i * 2)), lo));
+			_mm_storeu_si128((__m128i*)(acc + i * 2 + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i * 2 + 4)), hi));
+		}
+	}
+#endif
+
+	for (; i < numFrames; i++) {
+		acc[i * 2] += (src[i] * volL) >> PCM_KERNELS_GAIN_SHIFT;
+		acc[i * 2 + 1] += (src[i] * volR) >> PCM_KERNELS_GAIN_SHIFT;
+	}
+}
+
+void pcm_kernels_pack_s32_s16(int16_t* dst, const int32_t* acc, unsigned int numSamples)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	for (; i + 8 <= numSamples; i += 8)
+		vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(vld1q_s32(acc + i)), vqmovn_s32(vld1q_s32(acc + i + 4))));
+#elif defined(PCM_KERNELS_SSE2)
+	for (; i + 8 <= numSamples; i += 8)
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(acc + i)), _mm_loadu_si128((const __m128i*)(acc + i + 4))));
+#endif
+
+	for (; i < numSamples; i++)
+		dst[i] = pcm_kernels_saturate_s16(acc[i]);
+}
+
+void pcm_kernels_pack_mix_s32_s16_stereo(int16_t* dst, const int32_t* acc, unsigned int numFrames, int32_t volL, int32_t volR)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		const int32_t gainLanes[4] = { volL, volR, volL, volR };
+		int32x4_t gain = vld1q_s32(gainLanes);
+		int32x4_t lo, hi;
+		int16x8_t in;
+
+		/* 4 frames per iteration */
+
+		for (; i + 4 <= numFrames; i += 4) {
+			in = vld1q_s16(dst + i * 2);
+			lo = vaddq_s32(vld1q_s32(acc + i * 2), vshrq_n_s32(vmulq_s32(vmovl_s16(vget_low_s16(in)), gain), PCM_KERNELS_GAIN_SHIFT));
+			hi = vaddq_s32(vld1q_s32(acc + i * 2 + 4), vshrq_n_s32(vmulq_s32(vmovl_s16(vget_high_s16(in)), gain), PCM_KERNELS_GAIN_SHIFT));
+			vst1q_s16(dst + i * 2, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i gain = _mm_set_epi32(volR, volL, volR, volL);
+		__m128i in, lo, hi;
+
+		/* 4 frames per iteration */
+
+		for (; i + 4 <= numFrames; i += 4) {
+			in = _mm_loadu_si128((const __m128i*)(dst + i * 2));
+			lo = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i * 2)), _mm_srai_epi32(pcm_kernels_mullo_s32_sse2(pcm_kernels_widen_low_sse2(in), gain), PCM_KERNELS_GAIN_SHIFT));
+			hi = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i * 2 + 4)), _mm_srai_epi32(pcm_kernels_mullo_s32_sse2(pcm_kernels_widen_high_sse2(in), gain), PCM_KERNELS_GAIN_SHIFT));
+			_mm_storeu_si128((__m128i*)(dst + i * 2), _mm_packs_epi32(lo, hi));
+		}
+	}
+#endif
+
+	for (; i < numFrames; i++) {
+		dst[i * 2] = pcm_kernels_saturate_s16(acc[i * 2] + ((dst[i * 2] * volL) >> PCM_KERNELS_GAIN_SHIFT));
+		dst[i * 2 + 1] = pcm_kernels_saturate_s16(acc[i * 2 + 1] + ((dst[i * 2 + 1] * volR) >> PCM_KERNELS_GAIN_SHIFT));
+	}
+}
+
+void pcm_kernels_interleave_s16_stereo(int16_t* dst, const int16_t* srcL, const int16_t* srcR, unsigned int numFrames)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		int16x8x2_t out;
+
+		/* 8 frames per iteration */
+
+		for (; i + 8 <= numFrames; i += 8) {
+			out.val[0] = vld1q_s16(srcL + i);
+			out.val[1] = vld1q_s16(srcR + i);
+			vst2q_s16(dst + i * 2, out);
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i left, right;
+
+		/* 8 frames per iteration */
+
+		for (; i + 8 <= numFrames; i += 8) {
+			left = _mm_loadu_si128((const __m128i*)(srcL + i));
+			right = _mm_loadu_si128((const __m128i*)(srcR + i));
+			_mm_storeu_si128((__m128i*)(dst + i * 2), _mm_unpacklo_epi16(left, right));
+			_mm_storeu_si128((__m128i*)(dst + i * 2 + 8), _mm_unpackhi_epi16(left, right));
+		}
+	}
+#endif
+
+	for (; i < numFrames; i++) {
+		dst[i * 2] = srcL[i];
+		dst[i * 2 + 1] = srcR[i];
+	}
+}
+
+void pcm_kernels_add_s16(int16_t* dst, const int16_t* src, unsigned int numSamples)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	for (; i + 8 <= numSamples; i += 8)
+		vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+#elif defined(PCM_KERNELS_SSE2)
+	for (; i + 8 <= numSamples; i += 8)
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(dst + i)), _mm_loadu_si128((const __m128i*)(src + i))));
+#endif
+
+	for (; i < numSamples; i++)
+		dst[i] = pcm_kernels_saturate_s16(dst[i] + src[i]);
+}
+
+/*
+ * Gains are 16.16 fixed point stepping by (end - start) / numFrames per frame, so frame i always gets
+ * start + step * i whether it is handled by the vector loop or the scalar tail
+ */
+
+void pcm_kernels_ramp_s16_stereo(int16_t* dst, const int16_t* src, unsigned int numFrames, uint32_t startL, uint32_t startR, uint32_t endL, uint32_t endR)
+{
+	int32_t stepL, stepR, gainL, gainR;
+	unsigned int i = 0;
+
+	if (numFrames == 0)
+		return;
+
+	if (startL > PCM_KERNELS_GAIN_MAX)
+		startL = PCM_KERNELS_GAIN_MAX;
+	if (startR > PCM_KERNELS_GAIN_MAX)
+		startR = PCM_KERNELS_GAIN_MAX;
+	if (endL > PCM_KERNELS_GAIN_MAX)
+		endL = PCM_KERNELS_GAIN_MAX;
+	if (endR > PCM_KERNELS_GAIN_MAX)
+		endR = PCM_KERNELS_GAIN_MAX;
+
+	stepL = ((int32_t)endL - (int32_t)startL) * 65536 / (int32_t)numFrames;
+	stepR = ((int32_t)endR - (int32_t)startR) * 65536 / (int32_t)numFrames;
+	gainL = (int32_t)startL << 16;
+	gainR = (int32_t)startR << 16;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		const int32_t gainLanes[8] = { gainL, gainR, gainL + stepL, gainR + stepR, gainL + stepL * 2, gainR + stepR * 2, gainL + stepL * 3, gainR + stepR * 3 };
+		const int32_t stepLanes[4] = { stepL * 4, stepR * 4, stepL * 4, stepR * 4 };
+		int32x4_t gainLo = vld1q_s32(gainLanes);
+		int32x4_t gainHi = vld1q_s32(gainLanes + 4);
+		int32x4_t step = vld1q_s32(stepLanes);
+		int32x4_t lo, hi;
+		int16x8_t in;
+
+		/* 4 frames per iteration */
+
+		for (; i + 4 <= numFrames; i += 4) {
+			in = vld1q_s16(src + i * 2);
+			lo = vmull_s16(vget_low_s16(in), vshrn_n_s32(gainLo, 16));
+			hi = vmull_s16(vget_high_s16(in), vshrn_n_s32(gainHi, 16));
+			vst1q_s16(dst + i * 2, vcombine_s16(vqshrn_n_s32(lo, PCM_KERNELS_GAIN_SHIFT), vqshrn_n_s32(hi, PCM_KERNELS_GAIN_SHIFT)));
+			gainLo = vaddq_s32(gainLo, step);
+			gainHi = vaddq_s32(gainHi, step);
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i gainLo = _mm_set_epi32(gainR + stepR, gainL + stepL, gainR, gainL);
+		__m128i gainHi = _mm_set_epi32(gainR + stepR * 3, gainL + stepL * 3, gainR + stepR * 2, gainL + stepL * 2);
+		__m128i step = _mm_set_epi32(stepR * 4, stepL * 4, stepR * 4, stepL * 4);
+		__m128i gain;
+
+		/* 4 frames per iteration */
+
+		for (; i + 4 <= numFrames; i += 4) {
+			gain = _mm_packs_epi32(_mm_srai_epi32(gainLo, 16), _mm_srai_epi32(gainHi, 16));
+			_mm_storeu_si128((__m128i*)(dst + i * 2), pcm_kernels_scale_sse2(_mm_loadu_si128((const __m128i*)(src + i * 2)), gain));
+			gainLo = _mm_add_epi32(gainLo, step);
+			gainHi = _mm_add_epi32(gainHi, step);
+		}
+	}
+#endif
+
+	gainL += stepL * (int32_t)i;
+	gainR += stepR * (int32_t)i;
+
+	for (; i < numFrames; i++) {
+		dst[i * 2] = pcm_kernels_saturate_s16((src[i * 2] * (gainL >> 16)) >> PCM_KERNELS_GAIN_SHIFT);
+		dst[i * 2 + 1] = pcm_kernels_saturate_s16((src[i * 2 + 1] * (gainR >> 16)) >> PCM_KERNELS_GAIN_SHIFT);
+		gainL += stepL;
+		gainR += stepR;
+	}
+}
+
+void pcm_kernels_mono_to_stereo_s16(int16_t* dst, const int16_t* src, unsigned int numFrames)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		int16x8x2_t out;
+
+		/* 8 frames per iteration */
+
+		for (; i + 8 <= numFrames; i += 8) {
+			out.val[0] = vld1q_s16(src + i);
+			out.val[1] = out.val[0];
+			vst2q_s16(dst + i * 2, out);
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		__m128i in;
+
+		/* 8 frames per iteration */
+
+		for (; i + 8 <= numFrames; i += 8) {
+			in = _mm_loadu_si128((const __m128i*)(src + i));
+			_mm_storeu_si128((__m128i*)(dst + i * 2), _mm_unpacklo_epi16(in, in));
+			_mm_storeu_si128((__m128i*)(dst + i * 2 + 8), _mm_unpackhi_epi16(in, in));
+		}
+	}
+#endif
+
+	for (; i < numFrames; i++) {
+		dst[i * 2] = src[i];
+		dst[i * 2 + 1] = src[i];
+	}
+}
+
+void pcm_kernels_stereo_to_mono_s16(int16_t* dst, const int16_t* src, unsigned int numFrames)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		int16x8x2_t in;
+
+		/* 8 frames per iteration, halving add rounds down like the scalar shift */
+
+		for (; i + 8 <= numFrames; i += 8) {
+			in = vld2q_s16(src + i * 2);
+			vst1q_s16(dst + i, vhaddq_s16(in.val[0], in.val[1]));
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		const __m128i one = _mm_set1_epi16(1);
+		__m128i lo, hi;
+
+		/* 8 frames per iteration, multiply-add by 1 sums each frame into a 32-bit lane */
+
+		for (; i + 8 <= numFrames; i += 8) {
+			lo = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(src + i * 2)), one), 1);
+			hi = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(src + i * 2 + 8)), one), 1);
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+		}
+	}
+#endif
+
+	for (; i < numFrames; i++)
+		dst[i] = (int16_t)((src[i * 2] + src[i * 2 + 1]) >> 1);
+}
+
+void pcm_kernels_convert_s16_f32(float* dst, const int16_t* src, unsigned int numSamples)
+{
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		const float32x4_t scale = vdupq_n_f32(1.0f / 32768.0f);
+		int16x8_t in;
+
+		/* 8 samples per iteration */
+
+		for (; i + 8 <= numSamples; i += 8) {
+			in = vld1q_s16(src + i);
+			vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in))), scale));
+			vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in))), scale));
+		}
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+		__m128i in;
+
+		/* 8 samples per iteration */
+
+		for (; i + 8 <= numSamples; i += 8) {
+			in = _mm_loadu_si128((const __m128i*)(src + i));
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(pcm_kernels_widen_low_sse2(in)), scale));
+			_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(pcm_kernels_widen_high_sse2(in)), scale));
+		}
+	}
+#endif
+
+	for (; i < numSamples; i++)
+		dst[i] = (float)src[i] * (1.0f / 32768.0f);
+}
+
+/* Integer square root, rounded down */
+
+static uint32_t pcm_kernels_sqrt(uint64_t value)
+{
+	uint64_t result = 0, bit = (uint64_t)1 << 62;
+
+	while (bit > value)
+		bit >>= 2;
+
+	while (bit != 0) {
+		if (value >= result + bit) {
+			value -= result + bit;
+			result = (result >> 1) + bit;
+		}
+		else {
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (uint32_t)result;
+}
+
+void pcm_kernels_measure_s16(const int16_t* src, unsigned int numSamples, pcm_kernels_level* level)
+{
+	int32_t maxValue = 0, minValue = 0;
+	uint64_t sumSquares = 0;
+	unsigned int i = 0;
+
+#if defined(PCM_KERNELS_NEON)
+	{
+		int16x8_t in, maxLanes = vdupq_n_s16(0), minLanes = vdupq_n_s16(0);
+		uint64x2_t sum = vdupq_n_u64(0);
+		int16_t maxStore[8], minStore[8];
+		uint64_t sumStore[2];
+		unsigned int lane;
+
+		/* 8 samples per iteration, squares are at most 2^30 and are widened to 64 bits right away */
+
+		for (; i + 8 <= numSamples; i += 8) {
+			in = vld1q_s16(src + i);
+			maxLanes = vmaxq_s16(maxLanes, in);
+			minLanes = vminq_s16(minLanes, in);
+			sum = vpadalq_u32(sum, vreinterpretq_u32_s32(vmull_s16(vget_low_s16(in), vget_low_s16(in))));
+			sum = vpadalq_u32(sum, vreinterpretq_u32_s32(vmull_s16(vget_high_s16(in), vget_high_s16(in))));
+		}
+
+		vst1q_s16(maxStore, maxLanes);
+		vst1q_s16(minStore, minLanes);
+		vst1q_u64(sumStore, sum);
+
+		for (lane = 0; lane < 8; lane++) {
+			if (maxStore[lane] > maxValue)
+				maxValue = maxStore[lane];
+			if (minStore[lane] < minValue)
+				minValue = minStore[lane];
+		}
+
+		sumSquares = sumStore[0] + sumStore[1];
+	}
+#elif defined(PCM_KERNELS_SSE2)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i in, squares, maxLanes = zero, minLanes = zero, sum = zero;
+		int16_t maxStore[8], minStore[8];
+		uint64_t sumStore[2];
+		unsigned int lane;
+
+		/* 8 samples per iteration, pairs of squares fit in an unsigned 32-bit lane */
+
+		for (; i + 8 <= numSamples; i += 8) {
+			in = _mm_loadu_si128((const __m128i*)(src + i));
+			maxLanes = _mm_max_epi16(maxLanes, in);
+			minLanes = _mm_min_epi16(minLanes, in);
+			squares = _mm_madd_epi16(in, in);
+			sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(squares, zero));
+			sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(squares, zero));
+		}
+
+		_mm_storeu_si128((__m128i*)maxStore, maxLanes);
+		_mm_storeu_si128((__m128i*)minStore, minLanes);
+		_mm_storeu_si128((__m128i*)sumStore, sum);
+
+		for (lane = 0; lane < 8; lane++) {
+			if (maxStore[lane] > maxValue)
+				maxValue = maxStore[lane];
+			if (minStore[lane] < minValue)
+				minValue = minStore[lane];
+		}
+
+		sumSquares = sumStore[0] + sumStore[1];
+	}
+#endif
+
+	for (; i < numSamples; i++) {
+		if (src[i] > maxValue)
+			maxValue = src[i];
+		if (src[i] < minValue)
+			minValue = src[i];
+		sumSquares += (uint64_t)(src[i] * src[i]);
+	}
+
+	level->peak = (uint32_t)(maxValue > -minValue ? maxValue : -minValue);
+	level->rms = numSamples != 0 ? pcm_kernels_sqrt(sumSquares / numSamples) : 0;
+	level->sumSquares = sumSquares;
+}
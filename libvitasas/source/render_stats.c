@@ -0,0 +1,85 @@
+#include <kernel.h>
+
+#include "vitaSAS.h"
+#include "atomic.h"
+
+/*
+ * Render statistics are written only by the thread that renders the system and read by anyone.
+ * The writer bumps the sequence to odd before and back to even after updating, readers copy
+ * the statistics and retry if the sequence changed or was odd.
+ */
+
+static uint32_t vitaSAS_internal_render_stats_bucket(uint32_t time)
+{
+	uint32_t bucket;
+
+	if (time == 0)
+		return 0;
+
+	bucket = 32 - __builtin_clz(time);
+	if (bucket >= VITASAS_RENDER_STATS_BUCKETS)
+		bucket = VITASAS_RENDER_STATS_BUCKETS - 1;
+
+	return bucket;
+}
+
+void vitaSAS_internal_render_stats_record(vitaSASRenderStatsWork* work, uint32_t grainTime, uint32_t renderTime, uint32_t waitTime, uint32_t isUnderrun)
+{
+	vitaSASRenderStats* stats = &work->stats;
+
+	work->sequence++;
+	ATOMIC_BARRIER();
+
+	stats->numGrains++;
+	stats->grainTime = grainTime;
+
+	/* Grain time is 0 if the system has no sampling rate */
+
+	if (grainTime != 0 && renderTime > grainTime)
+		stats->numDeadlineMisses++;
+	if (isUnderrun)
+		stats->numUnderruns++;
+
+	if (stats->renderTimeMax < renderTime)
+		stats->renderTimeMax = renderTime;
+	if (stats->waitTimeMax < waitTime)
+		stats->waitTimeMax = waitTime;
+
+	stats->renderTimeTotal += renderTime;
+	stats->waitTimeTotal += waitTime;
+
+	stats->renderTimeHistogram[vitaSAS_internal_render_stats_bucket(renderTime)]++;
+	stats->waitTimeHistogram[vitaSAS_internal_render_stats_bucket(waitTime)]++;
+
+	atomic_store32(&work->sequence, work->sequence + 1);
+}
+
+void vitaSAS_internal_render_stats_read(const vitaSASRenderStatsWork* work, vitaSASRenderStats* stats)
+{
+	int32_t sequence;
+
+	for (;;) {
+		sequence = atomic_load32(&work->sequence);
+
+		if (sequence & 1)
+			continue;
+
+		sceClibMemcpy(stats, (const void*)&work->stats, sizeof(vitaSASRenderStats));
+		ATOMIC_BARRIER();
+
+		if (work->sequence == sequence)
+			break;
+	}
+}
+
+int vitaSAS_system_get_render_stats(vitaSASSystem* system, vitaSASRenderStats* stats)
+{
+	/* Subsystems are rendered as part of their root */
+
+	if (system->isSubSystem)
+		return VITASAS_ERROR_NOT_SUPPORTED;
+
+	vitaSAS_internal_render_stats_read(&system->audioWork.renderStats, stats);
+
+	return SCE_OK;
+}
@@ -0,0 +1,185 @@
+#include <kernel.h>
+#include <libdbg.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+#include "atomic.h"
+
+extern void* vitaSAS_heap_internal;
+
+/*
+ * Fork-join render pool. For every grain the output thread publishes the plan, wakes all workers
+ * and pulls jobs itself as well. Every job is one subtree of the root and only touches its own buffers,
+ * mixing subtree results into the output buffer is left to the output thread after the join.
+ */
+
+static void vitaSAS_internal_render_workers_process(vitaSASRenderWorkers* workers)
+{
+	const vitaSASMixPlan* plan = workers->plan;
+	const vitaSASMixPlanJob* job;
+	int32_t jobIndex;
+
+	for (;;) {
+		jobIndex = atomic_add32(&workers->nextJob, 1);
+		if (jobIndex >= (int32_t)plan->numJobs)
+			break;
+
+		job = &plan->jobs[jobIndex];
+
+		for (uint32_t i = job->start; i < job->end; i++) {
+			vitaSAS_internal_mix_graph_render_entry(&plan->entries[i], workers->buffer);
+
+			/* Last entry of the job is a root child, it is mixed after the join */
+
+			if (i + 1 < job->end)
+				vitaSAS_internal_mix_graph_mix_entry(&plan->entries[i], workers->buffer, workers->numGrain);
+		}
+	}
+}
+
+static int vitaSAS_internal_render_worker_thread(unsigned int args, void *argc)
+{
+	vitaSASRenderWorkers* workers = *(vitaSASRenderWorkers**)argc;
+
+	for (;;) {
+		sceKernelWaitSema(workers->startSemaId, 1, NULL);
+
+		if (workers->isAborted)
+			break;
+
+		vitaSAS_internal_render_workers_process(workers);
+
+		sceKernelSignalSema(workers->doneSemaId, 1);
+	}
+
+	return sceKernelExitDeleteThread(0);
+}
+
+static unsigned int vitaSAS_internal_render_worker_cpu(unsigned int workerNum, unsigned int thCpu)
+{
+	static const unsigned int userCores[] = { SCE_KERNEL_CPU_MASK_USER_0, SCE_KERNEL_CPU_MASK_USER_1, SCE_KERNEL_CPU_MASK_USER_2 };
+	unsigned int freeCores[3];
+	unsigned int numFreeCores = 0;
+
+	/* Output thread without affinity is assumed to be on the first user core */
+
+	if (thCpu == 0)
+		thCpu = SCE_KERNEL_CPU_MASK_USER_0;
+
+	for (int i = 0; i < 3; i++) {
+		if (!(thCpu & userCores[i]))
+			freeCores[numFreeCores++] = userCores[i];
+	}
+
+	if (numFreeCores == 0)
+		return 0;
+
+	return freeCores[workerNum % numFreeCores];
+}
+
+vitaSASRenderWorkers* vitaSAS_internal_render_workers_start(unsigned int numWorkers, unsigned int thPriority, unsigned int thStackSize, unsigned int thCpu, unsigned int workerCpu)
+{
+	vitaSASRenderWorkers* workers;
+	int result;
+
+	if (numWorkers > VITASAS_RENDER_WORKER_MAX)
+		numWorkers = VITASAS_RENDER_WORKER_MAX;
+
+	workers = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASRenderWorkers));
+	if (workers == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return NULL;
+	}
+
+	sceClibMemset(workers, 0, sizeof(vitaSASRenderWorkers));
+
+	result = workers->startSemaId = sceKernelCreateSema("vitaSAS_render_start", 0, 0, VITASAS_RENDER_WORKER_MAX, NULL);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateSema(): 0x%X", result);
+		goto failed;
+	}
+
+	result = workers->doneSemaId = sceKernelCreateSema("vitaSAS_render_done", 0, 0, VITASAS_RENDER_WORKER_MAX, NULL);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateSema(): 0x%X", result);
+		goto failed;
+	}
+
+	/* Create worker threads */
+
+	for (int i = 0; i < numWorkers; i++) {
+
+		result = workers->threadId[i] = sceKernelCreateThread(
+			"vitaSAS_render_worker_thread",
+			vitaSAS_internal_render_worker_thread,
+			thPriority,
+			thStackSize,
+			0,
+			workerCpu != 0 ? workerCpu : vitaSAS_internal_render_worker_cpu(i, thCpu),
+			NULL);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateThread(): 0x%X", result);
+			goto failed;
+		}
+
+		result = sceKernelStartThread(workers->threadId[i], sizeof(workers), &workers);
+		if (result < 0) {
+			SCE_DBG_LOG_ERROR("[SAS] sceKernelStartThread(): 0x%X", result);
+			sceKernelDeleteThread(workers->threadId[i]);
+			goto failed;
+		}
+
+		workers->numWorkers++;
+	}
+
+	return workers;
+
+failed:
+
+	vitaSAS_internal_render_workers_stop(workers);
+
+	return NULL;
+}
+
+void vitaSAS_internal_render_workers_stop(vitaSASRenderWorkers* workers)
+{
+	/* Shutdown worker threads */
+
+	workers->isAborted = 1;
+
+	if (workers->numWorkers > 0)
+		sceKernelSignalSema(workers->startSemaId, workers->numWorkers);
+
+	for (int i = 0; i < workers->numWorkers; i++)
+		sceKernelWaitThreadEnd(workers->threadId[i], NULL, NULL);
+
+	if (0 < workers->startSemaId)
+		sceKernelDeleteSema(workers->startSemaId);
+	if (0 < workers->doneSemaId)
+		sceKernelDeleteSema(workers->doneSemaId);
+
+	heap_free_heap_memory(vitaSAS_heap_internal, workers);
+}
+
+void vitaSAS_internal_render_workers_run(vitaSASRenderWorkers* workers, const vitaSASMixPlan* plan, void* buffer, unsigned int numGrain)
+{
+	unsigned int numWake = workers->numWorkers;
+
+	/* Don't wake more workers than there are jobs beside the one taken by the output thread */
+
+	if (numWake > plan->numJobs - 1)
+		numWake = plan->numJobs - 1;
+
+	workers->plan = plan;
+	workers->buffer = buffer;
+	workers->numGrain = numGrain;
+	workers->nextJob = 0;
+
+	if (numWake > 0)
+		sceKernelSignalSema(workers->startSemaId, numWake);
+
+	vitaSAS_internal_render_workers_process(workers);
+
+	if (numWake > 0)
+		sceKernelWaitSema(workers->doneSemaId, numWake, NULL);
+}
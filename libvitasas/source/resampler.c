@@ -0,0 +1,238 @@
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "resampler.h"
+
+/* Passband edge relative to the lower Nyquist frequency, the rest is the Blackman transition band */
+
+#define RESAMPLER_CUTOFF	0.83
+#define RESAMPLER_PI		3.14159265358979323846
+
+static __inline__ int16_t resampler_saturate_s16(int32_t value)
+{
+	if (value > 32767)
+		return 32767;
+	if (value < -32768)
+		return -32768;
+	return (int16_t)value;
+}
+
+static uint32_t resampler_gcd(uint32_t a, uint32_t b)
+{
+	uint32_t t;
+
+	while (b != 0) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/* Table generation runs once per load, a series is enough and keeps the library off libm */
+
+static double resampler_sin(double x)
+{
+	double term, sum, x2;
+	int i;
+
+	x -= (double)(int64_t)(x / (2.0 * RESAMPLER_PI)) * (2.0 * RESAMPLER_PI);
+	if (x > RESAMPLER_PI)
+		x -= 2.0 * RESAMPLER_PI;
+	else if (x < -RESAMPLER_PI)
+		x += 2.0 * RESAMPLER_PI;
+
+	x2 = x * x;
+	term = x;
+	sum = x;
+
+	for (i = 1; i < 12; i++) {
+		term *= -x2 / (double)((2 * i) * (2 * i + 1));
+		sum += term;
+	}
+
+	return sum;
+}
+
+static double resampler_cos(double x)
+{
+	return resampler_sin(x + RESAMPLER_PI / 2.0);
+}
+
+/* Windowed sinc at x input samples from the output position */
+
+static double resampler_kernel(double x, double cutoff, double halfWidth)
+{
+	double sinc, window;
+
+	if (x <= -halfWidth || x >= halfWidth)
+		return 0.0;
+
+	sinc = x == 0.0 ? cutoff : resampler_sin(RESAMPLER_PI * cutoff * x) / (RESAMPLER_PI * x);
+	window = 0.42 + 0.5 * resampler_cos(RESAMPLER_PI * x / halfWidth) + 0.08 * resampler_cos(2.0 * RESAMPLER_PI * x / halfWidth);
+
+	return sinc * window;
+}
+
+static void resampler_get_layout(uint32_t inRate, uint32_t outRate, uint32_t* numPhases, uint32_t* numTaps)
+{
+	uint32_t divisor = resampler_gcd(inRate, outRate);
+	uint64_t taps = RESAMPLER_TAPS_MIN;
+
+	inRate /= divisor;
+	outRate /= divisor;
+
+	*numPhases = outRate < RESAMPLER_PHASES_MAX ? outRate : RESAMPLER_PHASES_MAX;
+
+	/* Decimation stretches the kernel by inRate / outRate */
+
+	if (inRate > outRate)
+		taps = ((uint64_t)RESAMPLER_TAPS_MIN * inRate + outRate - 1) / outRate;
+
+	taps = (taps + 7) & ~7;
+	*numTaps = taps < RESAMPLER_TAPS_MAX ? (uint32_t)taps : RESAMPLER_TAPS_MAX;
+}
+
+unsigned int resampler_get_table_size(uint32_t inRate, uint32_t outRate)
+{
+	uint32_t numPhases, numTaps;
+
+	resampler_get_layout(inRate, outRate, &numPhases, &numTaps);
+
+	return numPhases * numTaps * sizeof(int16_t);
+}
+
+void resampler_init(resampler* rs, uint32_t inRate, uint32_t outRate, int16_t* table)
+{
+	uint32_t divisor = resampler_gcd(inRate, outRate);
+	double cutoff = RESAMPLER_CUTOFF;
+	double halfWidth, sum, scale, value;
+	unsigned int phase, tap;
+	int16_t* coefs;
+
+	resampler_get_layout(inRate, outRate, &rs->numPhases, &rs->numTaps);
+
+	rs->inRate = inRate / divisor;
+	rs->outRate = outRate / divisor;
+	rs->coefs = table;
+
+	if (rs->inRate > rs->outRate)
+		cutoff = cutoff * rs->outRate / rs->inRate;
+
+	halfWidth = rs->numTaps / 2;
+
+	/* Tap k of phase p sits at k - numTaps / 2 + 1 - p / numPhases, each phase is normalized to unity gain */
+
+	for (phase = 0; phase < rs->numPhases; phase++) {
+		coefs = table + phase * rs->numTaps;
+		sum = 0.0;
+
+		for (tap = 0; tap < rs->numTaps; tap++)
+			sum += resampler_kernel((double)tap - halfWidth + 1.0 - (double)phase / rs->numPhases, cutoff, halfWidth);
+
+		scale = (double)(1 << RESAMPLER_COEF_SHIFT) / sum;
+
+		for (tap = 0; tap < rs->numTaps; tap++) {
+			value = resampler_kernel((double)tap - halfWidth + 1.0 - (double)phase / rs->numPhases, cutoff, halfWidth) * scale;
+			coefs[tap] = (int16_t)(value < 0.0 ? value - 0.5 : value + 0.5);
+		}
+	}
+}
+
+unsigned int resampler_get_num_output(const resampler* rs, unsigned int numInput)
+{
+	return (unsigned int)(((uint64_t)numInput * rs->outRate + rs->inRate - 1) / rs->inRate);
+}
+
+static __inline__ int32_t resampler_dot(const int16_t* src, const int16_t* coefs, unsigned int numTaps)
+{
+	unsigned int i;
+
+#if defined(__ARM_NEON__)
+	int32x4_t acc = vdupq_n_s32(0);
+	int32x2_t sum;
+	int16x8_t in, coef;
+
+	/* numTaps is a multiple of 8 */
+
+	for (i = 0; i < numTaps; i += 8) {
+		in = vld1q_s16(src + i);
+		coef = vld1q_s16(coefs + i);
+		acc = vmlal_s16(acc, vget_low_s16(in), vget_low_s16(coef));
+		acc = vmlal_s16(acc, vget_high_s16(in), vget_high_s16(coef));
+	}
+
+	sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	sum = vpadd_s32(sum, sum);
+
+	return vget_lane_s32(sum, 0);
+#else
+	int32_t acc = 0;
+
+	for (i = 0; i < numTaps; i++)
+		acc += src[i] * coefs[i];
+
+	return acc;
+#endif
+}
+
+/* Kernel overlapping either end of the input */
+
+static int32_t resampler_dot_edge(const int16_t* src, unsigned int numInput, int first, const int16_t* coefs, unsigned int numTaps)
+{
+	int32_t acc = 0;
+	unsigned int i;
+	int index;
+
+	for (i = 0; i < numTaps; i++) {
+		index = first + (int)i;
+		if (index >= 0 && index < (int)numInput)
+			acc += src[index] * coefs[i];
+	}
+
+	return acc;
+}
+
+void resampler_process(const resampler* rs, int16_t* dst, unsigned int numOutput, const int16_t* src, unsigned int numInput)
+{
+	const uint32_t step = rs->inRate / rs->outRate;
+	const uint32_t stepFrac = rs->inRate % rs->outRate;
+	const int history = (int)rs->numTaps / 2 - 1;
+	uint32_t frac = 0, phase;
+	unsigned int i;
+	int position = 0, first;
+	int32_t acc;
+
+	/* Output i sits at input position + frac / outRate */
+
+	for (i = 0; i < numOutput; i++) {
+		first = position - history;
+
+		if (rs->numPhases == rs->outRate) {
+			phase = frac;
+		}
+		else {
+			phase = (uint32_t)(((uint64_t)frac * rs->numPhases + rs->outRate / 2) / rs->outRate);
+			if (phase == rs->numPhases) {
+				phase = 0;
+				first++;
+			}
+		}
+
+		if (first >= 0 && first + (int)rs->numTaps <= (int)numInput)
+			acc = resampler_dot(src + first, rs->coefs + phase * rs->numTaps, rs->numTaps);
+		else
+			acc = resampler_dot_edge(src, numInput, first, rs->coefs + phase * rs->numTaps, rs->numTaps);
+
+		dst[i] = resampler_saturate_s16((acc + (1 << (RESAMPLER_COEF_SHIFT - 1))) >> RESAMPLER_COEF_SHIFT);
+
+		position += step;
+		frac += stepFrac;
+		if (frac >= rs->outRate) {
+			frac -= rs->outRate;
+			position++;
+		}
+	}
+}
@@ -0,0 +1,257 @@
+#include <kernel.h>
+#include <libdbg.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+
+extern void* vitaSAS_heap_internal;
+
+/*
+ * Sample banks hold many samples in one block with an index built offline. Loading is a single read,
+ * lookups go through the hash table stored in the bank and audio views point straight into bank data.
+ */
+
+#define VITASAS_BANK_FNV_OFFSET		0x811C9DC5
+#define VITASAS_BANK_FNV_PRIME		0x01000193
+
+uint32_t vitaSAS_bank_hash(const char* name)
+{
+	uint32_t hash = VITASAS_BANK_FNV_OFFSET;
+
+	while (*name != '\0') {
+		hash ^= (uint8_t)*name++;
+		hash *= VITASAS_BANK_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static int vitaSAS_internal_bank_validate(const void* pData, unsigned int dataSize)
+{
+	const vitaSASBankHeader* header = pData;
+	const vitaSASBankEntry* entries;
+	const uint32_t* hashTable;
+	unsigned int indexSize, i;
+
+	if (dataSize < sizeof(vitaSASBankHeader) || ((uintptr_t)pData & 3) != 0)
+		return VITASAS_ERROR_INVALID_BANK;
+
+	if (header->magic != VITASAS_BANK_MAGIC || header->version != VITASAS_BANK_VERSION)
+		return VITASAS_ERROR_INVALID_BANK;
+
+	/* Hash table must have a free slot so probing terminates */
+
+	if (header->hashTableSize <= header->numEntries || (header->hashTableSize & (header->hashTableSize - 1)) != 0)
+		return VITASAS_ERROR_INVALID_BANK;
+
+	indexSize = sizeof(vitaSASBankHeader) + header->numEntries * sizeof(vitaSASBankEntry) + header->hashTableSize * sizeof(uint32_t);
+	if (header->numEntries > dataSize / sizeof(vitaSASBankEntry) || header->hashTableSize > dataSize / sizeof(uint32_t)
+		|| header->size > dataSize || indexSize > header->dataOffset || header->dataOffset > header->size)
+		return VITASAS_ERROR_INVALID_BANK;
+
+	entries = (const vitaSASBankEntry*)(header + 1);
+	hashTable = (const uint32_t*)(entries + header->numEntries);
+
+	for (i = 0; i < header->numEntries; i++) {
+		if (entries[i].offset < header->dataOffset || entries[i].offset > header->size
+			|| entries[i].size > header->size - entries[i].offset)
+			return VITASAS_ERROR_INVALID_BANK;
+	}
+
+	for (i = 0; i < header->hashTableSize; i++) {
+		if (hashTable[i] > header->numEntries)
+			return VITASAS_ERROR_INVALID_BANK;
+	}
+
+	return SCE_OK;
+}
+
+static vitaSASBank* vitaSAS_internal_bank_create(void* pData, unsigned int dataSize, SceUID data_id, uint32_t storage)
+{
+	const vitaSASBankHeader* header = pData;
+	vitaSASBank* bank;
+	unsigned int i;
+	int result;
+
+	result = vitaSAS_internal_bank_validate(pData, dataSize);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] Invalid sample bank");
+		return NULL;
+	}
+
+	/* Bank and its audio views are a single allocation */
+
+	bank = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASBank) + header->numEntries * sizeof(vitaSASAudio));
+	if (bank == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return NULL;
+	}
+
+	bank->header = header;
+	bank->entries = (const vitaSASBankEntry*)(header + 1);
+	bank->hashTable = (const uint32_t*)(bank->entries + header->numEntries);
+	bank->audio = (vitaSASAudio*)(bank + 1);
+	bank->data_id = data_id;
+	bank->storage = storage;
+
+	for (i = 0; i < header->numEntries; i++) {
+		bank->audio[i].datap = (char*)pData + bank->entries[i].offset;
+		bank->audio[i].data_size = bank->entries[i].size;
+		bank->audio[i].data_id = 0;
+		bank->audio[i].storage = VITASAS_AUDIO_STORAGE_USER;
+		bank->audio[i].numChannels = 1;
+	}
+
+	return bank;
+}
+
+vitaSASBank* vitaSAS_load_bank(char* bankPath, int io_type)
+{
+	vitaSASBank* bank;
+	void* data;
+	size_t dataSize = 0;
+	SceUID mem_id = 0;
+
+	data = vitaSAS_internal_load_audio(bankPath, &dataSize, &mem_id, io_type);
+	if (data == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] vitaSAS_internal_load_audio() returned NULL");
+		return NULL;
+	}
+
+	bank = vitaSAS_internal_bank_create(data, dataSize, mem_id, mem_id != 0 ? VITASAS_AUDIO_STORAGE_MEMBLOCK : VITASAS_AUDIO_STORAGE_POOL);
+	if (bank == NULL)
+		vitaSAS_internal_sample_free(data, mem_id);
+
+	return bank;
+}
+
+vitaSASBank* vitaSAS_load_bank_custom(void* pData, unsigned int dataSize)
+{
+	if (pData == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] Invalid data pointer");
+		return NULL;
+	}
+
+	return vitaSAS_internal_bank_create(pData, dataSize, 0, VITASAS_AUDIO_STORAGE_USER);
+}
+
+void vitaSAS_free_bank(vitaSASBank* bank)
+{
+	if (bank->storage != VITASAS_AUDIO_STORAGE_USER)
+		vitaSAS_internal_sample_free((void*)bank->header, bank->data_id);
+	heap_free_heap_memory(vitaSAS_heap_internal, bank);
+}
+
+int vitaSAS_bank_find_hash(const vitaSASBank* bank, uint32_t nameHash)
+{
+	uint32_t mask = bank->header->hashTableSize - 1;
+	uint32_t slot, index, i;
+
+	for (i = 0, slot = nameHash & mask; i <= mask; i++, slot = (slot + 1) & mask) {
+		index = bank->hashTable[slot];
+		if (index == 0)
+			break;
+		if (bank->entries[index - 1].nameHash == nameHash)
+			return (int)(index - 1);
+	}
+
+	return VITASAS_ERROR_INVALID_BANK;
+}
+
+int vitaSAS_bank_find(const vitaSASBank* bank, const char* name)
+{
+	return vitaSAS_bank_find_hash(bank, vitaSAS_bank_hash(name));
+}
+
+const vitaSASAudio* vitaSAS_bank_get_audio(const vitaSASBank* bank, unsigned int index)
+{
+	if (index >= bank->header->numEntries)
+		return NULL;
+
+	return &bank->audio[index];
+}
+
+const vitaSASBankEntry* vitaSAS_bank_get_entry(const vitaSASBank* bank, unsigned int index)
+{
+	if (index >= bank->header->numEntries)
+		return NULL;
+
+	return &bank->entries[index];
+}
+
+int vitaSAS_pack_bank(const vitaSASBankSource* sources, unsigned int numSources, void* pBuffer, unsigned int bufferSize)
+{
+	vitaSASBankHeader* header;
+	vitaSASBankEntry* entries;
+	uint32_t* hashTable;
+	unsigned int hashTableSize, dataOffset, size, offset, i;
+	uint32_t mask, slot, nameHash;
+
+	/* Keep hash table at most half full */
+
+	hashTableSize = 2;
+	while (hashTableSize < numSources * 2)
+		hashTableSize *= 2;
+
+	dataOffset = ROUND_UP(sizeof(vitaSASBankHeader) + numSources * sizeof(vitaSASBankEntry) + hashTableSize * sizeof(uint32_t), VITASAS_BANK_DATA_ALIGN);
+
+	size = dataOffset;
+	for (i = 0; i < numSources; i++) {
+		if (sources[i].name == NULL || (sources[i].data == NULL && sources[i].size != 0))
+			return VITASAS_ERROR_INVALID_BANK;
+		size = ROUND_UP(size, VITASAS_BANK_DATA_ALIGN) + sources[i].size;
+	}
+
+	if (pBuffer == NULL)
+		return (int)size;
+
+	if (bufferSize < size || ((uintptr_t)pBuffer & 3) != 0)
+		return VITASAS_ERROR_INVALID_BANK;
+
+	sceClibMemset(pBuffer, 0, size);
+
+	header = pBuffer;
+	entries = (vitaSASBankEntry*)(header + 1);
+	hashTable = (uint32_t*)(entries + numSources);
+	mask = hashTableSize - 1;
+
+	header->magic = VITASAS_BANK_MAGIC;
+	header->version = VITASAS_BANK_VERSION;
+	header->numEntries = numSources;
+	header->hashTableSize = hashTableSize;
+	header->dataOffset = dataOffset;
+	header->size = size;
+
+	offset = dataOffset;
+	for (i = 0; i < numSources; i++) {
+		nameHash = vitaSAS_bank_hash(sources[i].name);
+
+		/* Entries are identified only by hash, colliding names can't be told apart */
+
+		for (slot = nameHash & mask; hashTable[slot] != 0; slot = (slot + 1) & mask) {
+			if (entries[hashTable[slot] - 1].nameHash == nameHash) {
+				SCE_DBG_LOG_ERROR("[SAS] Sample name hash collision: %s", sources[i].name);
+				return VITASAS_ERROR_INVALID_BANK;
+			}
+		}
+
+		hashTable[slot] = i + 1;
+
+		offset = ROUND_UP(offset, VITASAS_BANK_DATA_ALIGN);
+
+		entries[i].nameHash = nameHash;
+		entries[i].offset = offset;
+		entries[i].size = sources[i].size;
+		entries[i].format = sources[i].format;
+		entries[i].samplingRate = sources[i].samplingRate;
+		entries[i].loop = sources[i].loop;
+		entries[i].loopSize = sources[i].loopSize;
+
+		if (sources[i].size != 0)
+			sceClibMemcpy((char*)pBuffer + offset, sources[i].data, sources[i].size);
+
+		offset += sources[i].size;
+	}
+
+	return (int)size;
+}
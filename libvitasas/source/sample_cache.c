@@ -0,0 +1,489 @@
+#include <kernel.h>
+#include <libdbg.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+#include "atomic.h"
+
+extern void* vitaSAS_heap_internal;
+
+/*
+ * Sample cache. Samples loaded by path are shared through entries keyed by normalized path, io_type and
+ * loader type. Slots of an open addressed hash table hold entry index + 1 (0 for empty slots) and entries
+ * are never removed while the cache is enabled, so lookups can probe the table and take a reference with
+ * a compare and swap without locking. Only misses and samples whose last reference is gone take the lock,
+ * which also serializes the loads themselves so a path is never loaded twice.
+ *
+ * Samples without references stay resident until they are evicted, least recently used first, to keep
+ * resident data within the budget or to make room when sample memory can't be allocated. An evicted sample
+ * is loaded again by the next request for it. Voices hold a reference to the cached sample they play, see
+ * vitaSAS_internal_voice_pool_set_sample(), and releasing never takes the lock so the render thread can do it.
+ */
+
+typedef struct vitaSASSampleCacheEntry {
+	vitaSASAudio audio;
+	volatile int32_t refCount;
+	uint32_t isResident;
+	uint32_t dataStorage;
+	volatile int32_t lastUse;
+	uint32_t index;
+	uint32_t hash;
+	uint32_t type;
+	int io_type;
+	char path[];
+} vitaSASSampleCacheEntry;
+
+typedef struct vitaSASSampleCache {
+	SceKernelLwMutexWork mutex;
+	unsigned int maxEntries;
+	unsigned int numEntries;
+	unsigned int slotMask;
+	unsigned int residentSize;
+	volatile int32_t useTick;
+	vitaSASSampleCacheEntry** entries;
+	volatile int32_t* slots;
+} vitaSASSampleCache;
+
+static vitaSASSampleCache* s_cache = NULL;
+static unsigned int sample_cache_budget = 0;
+
+static __inline__ char vitaSAS_internal_cache_lower(char c)
+{
+	return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+/*
+ * Lower case, device followed by '/', '/' separators and no empty, "." or ".." segments, so every spelling
+ * of a path on the case insensitive file systems maps to one key
+ */
+
+static int vitaSAS_internal_cache_normalize(char* dst, const char* src)
+{
+	unsigned int length = 0, root, segmentLength, i;
+	const char* segment;
+
+	for (i = 0; src[i] != '\0' && src[i] != '/' && src[i] != '\\' && src[i] != ':'; i++)
+		;
+
+	if (src[i] == ':') {
+		if (i + 1 >= VITASAS_LOAD_PATH_MAX)
+			return -1;
+
+		for (length = 0; length <= i; length++)
+			dst[length] = vitaSAS_internal_cache_lower(src[length]);
+
+		src += i + 1;
+	}
+
+	root = length;
+
+	while (*src != '\0') {
+		segment = src;
+		while (*src != '\0' && *src != '/' && *src != '\\')
+			src++;
+		segmentLength = (unsigned int)(src - segment);
+		while (*src == '/' || *src == '\\')
+			src++;
+
+		if (segmentLength == 0 || (segmentLength == 1 && segment[0] == '.'))
+			continue;
+
+		if (segmentLength == 2 && segment[0] == '.' && segment[1] == '.') {
+			while (length > root && dst[length - 1] != '/')
+				length--;
+			if (length > root)
+				length--;
+			continue;
+		}
+
+		if (length + 1 + segmentLength >= VITASAS_LOAD_PATH_MAX)
+			return -1;
+
+		dst[length++] = '/';
+		for (i = 0; i < segmentLength; i++)
+			dst[length++] = vitaSAS_internal_cache_lower(segment[i]);
+	}
+
+	dst[length] = '\0';
+
+	return (int)length;
+}
+
+/* Entry for key, or NULL with the free slot the key would go to in *slot */
+
+static vitaSASSampleCacheEntry* vitaSAS_internal_cache_find(vitaSASSampleCache* cache, uint32_t hash, uint32_t type, int io_type, const char* path, unsigned int* slot)
+{
+	vitaSASSampleCacheEntry* entry;
+	unsigned int i;
+	int32_t index;
+
+	for (i = hash & cache->slotMask;; i = (i + 1) & cache->slotMask) {
+		index = atomic_load32(&cache->slots[i]);
+		if (index == 0) {
+			*slot = i;
+			return NULL;
+		}
+
+		entry = cache->entries[index - 1];
+		if (entry->hash == hash && entry->type == type && entry->io_type == io_type && sceClibStrcmp(entry->path, path) == 0)
+			return entry;
+	}
+}
+
+/* Take a reference unless the last one is already gone */
+
+static int vitaSAS_internal_cache_try_acquire(vitaSASSampleCacheEntry* entry)
+{
+	int32_t refCount;
+
+	for (;;) {
+		refCount = atomic_load32(&entry->refCount);
+		if (refCount <= 0)
+			return 0;
+		if (atomic_cas32(&entry->refCount, refCount, refCount + 1) == refCount)
+			return 1;
+	}
+}
+
+static __inline__ void vitaSAS_internal_cache_touch(vitaSASSampleCache* cache, vitaSASSampleCacheEntry* entry)
+{
+	atomic_store32(&entry->lastUse, atomic_add32(&cache->useTick, 1));
+}
+
+/* Use time is updated first so eviction never sees an unreferenced entry with a stale one */
+
+static void vitaSAS_internal_cache_release_entry(vitaSASSampleCache* cache, vitaSASSampleCacheEntry* entry)
+{
+	vitaSAS_internal_cache_touch(cache, entry);
+	atomic_add32(&entry->refCount, -1);
+}
+
+/* Load sample data into entry from the path as requested, called with the lock held */
+
+static int vitaSAS_internal_cache_fill(vitaSASSampleCache* cache, vitaSASSampleCacheEntry* entry, char* soundPath)
+{
+	vitaSASAudio* audio;
+
+	audio = vitaSAS_internal_load_audio_uncached(entry->type, soundPath, entry->io_type);
+	if (audio == NULL)
+		return VITASAS_ERROR_NOT_SUPPORTED;
+
+	entry->audio = *audio;
+	entry->audio.storage = VITASAS_AUDIO_STORAGE_CACHE;
+	entry->dataStorage = audio->storage;
+	entry->isResident = 1;
+	cache->residentSize += entry->audio.data_size;
+
+	heap_free_heap_memory(vitaSAS_heap_internal, audio);
+
+	return SCE_OK;
+}
+
+static void vitaSAS_internal_cache_drop(vitaSASSampleCache* cache, vitaSASSampleCacheEntry* entry)
+{
+	if (entry->dataStorage != VITASAS_AUDIO_STORAGE_USER)
+		vitaSAS_internal_sample_free(entry->audio.datap, entry->audio.data_id);
+
+	cache->residentSize -= entry->audio.data_size;
+	entry->audio.datap = NULL;
+	entry->isResident = 0;
+}
+
+/*
+ * Free least recently used samples without references until resident data fits in size, called with the
+ * lock held. Entries at zero references are only revived under the lock, so they can't be picked up meanwhile.
+ */
+
+static unsigned int vitaSAS_internal_cache_evict(vitaSASSampleCache* cache, unsigned int size)
+{
+	vitaSASSampleCacheEntry* entry;
+	vitaSASSampleCacheEntry* victim;
+	uint32_t now, age, victimAge;
+	unsigned int freed = 0, i;
+
+	while (cache->residentSize > size) {
+		victim = NULL;
+		victimAge = 0;
+		now = (uint32_t)atomic_load32(&cache->useTick);
+
+		for (i = 0; i < cache->numEntries; i++) {
+			entry = cache->entries[i];
+			if (!entry->isResident || atomic_load32(&entry->refCount) != 0)
+				continue;
+
+			age = now - (uint32_t)atomic_load32(&entry->lastUse);
+			if (victim == NULL || age > victimAge) {
+				victim = entry;
+				victimAge = age;
+			}
+		}
+
+		if (victim == NULL)
+			break;
+
+		freed += victim->audio.data_size;
+		vitaSAS_internal_cache_drop(cache, victim);
+	}
+
+	return freed;
+}
+
+void vitaSAS_set_sample_cache_budget(unsigned int budget)
+{
+	vitaSASSampleCache* cache = s_cache;
+
+	sample_cache_budget = budget;
+
+	if (cache == NULL || budget == 0)
+		return;
+
+	sceKernelLockLwMutex(&cache->mutex, 1, NULL);
+	vitaSAS_internal_cache_evict(cache, budget);
+	sceKernelUnlockLwMutex(&cache->mutex, 1);
+}
+
+unsigned int vitaSAS_get_sample_cache_usage(void)
+{
+	vitaSASSampleCache* cache = s_cache;
+
+	return cache != NULL ? cache->residentSize : 0;
+}
+
+/* Make room for size bytes of sample memory, returns the number of bytes freed */
+
+unsigned int vitaSAS_internal_sample_cache_reclaim(unsigned int size)
+{
+	vitaSASSampleCache* cache = s_cache;
+	unsigned int freed;
+
+	if (cache == NULL)
+		return 0;
+
+	sceKernelLockLwMutex(&cache->mutex, 1, NULL);
+	freed = vitaSAS_internal_cache_evict(cache, cache->residentSize > size ? cache->residentSize - size : 0);
+	sceKernelUnlockLwMutex(&cache->mutex, 1);
+
+	return freed;
+}
+
+int vitaSAS_enable_sample_cache(unsigned int maxSamples)
+{
+	vitaSASSampleCache* cache;
+	unsigned int numSlots = 1;
+	int result;
+
+	if (s_cache != NULL || maxSamples == 0)
+		return VITASAS_ERROR_NOT_SUPPORTED;
+
+	/* At most half of the slots are used so probe sequences stay short */
+
+	while (numSlots < maxSamples * 2)
+		numSlots <<= 1;
+
+	cache = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASSampleCache));
+	if (cache == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	sceClibMemset(cache, 0, sizeof(vitaSASSampleCache));
+
+	cache->maxEntries = maxSamples;
+	cache->slotMask = numSlots - 1;
+	cache->entries = heap_alloc_heap_memory(vitaSAS_heap_internal, maxSamples * sizeof(vitaSASSampleCacheEntry*));
+	cache->slots = heap_alloc_heap_memory(vitaSAS_heap_internal, numSlots * sizeof(int32_t));
+	if (cache->entries == NULL || cache->slots == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		result = SCE_KERNEL_ERROR_NO_MEMORY;
+		goto failed;
+	}
+
+	sceClibMemset((void*)cache->slots, 0, numSlots * sizeof(int32_t));
+
+	/* Recursive, loads under the lock can fail to allocate and evict */
+
+	result = sceKernelCreateLwMutex(&cache->mutex, "vitaSAS_sample_cache", SCE_KERNEL_LW_MUTEX_ATTR_RECURSIVE, 0, NULL);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateLwMutex(): 0x%X", result);
+		goto failed;
+	}
+
+	s_cache = cache;
+
+	return SCE_OK;
+
+failed:
+
+	heap_free_heap_memory(vitaSAS_heap_internal, (void*)cache->slots);
+	heap_free_heap_memory(vitaSAS_heap_internal, cache->entries);
+	heap_free_heap_memory(vitaSAS_heap_internal, cache);
+
+	return result;
+}
+
+void vitaSAS_internal_sample_cache_term(void)
+{
+	vitaSASSampleCache* cache = s_cache;
+	unsigned int i;
+
+	if (cache == NULL)
+		return;
+
+	for (i = 0; i < cache->numEntries; i++) {
+		if (cache->entries[i]->isResident)
+			vitaSAS_internal_cache_drop(cache, cache->entries[i]);
+		heap_free_heap_memory(vitaSAS_heap_internal, cache->entries[i]);
+	}
+
+	sceKernelDeleteLwMutex(&cache->mutex);
+
+	heap_free_heap_memory(vitaSAS_heap_internal, (void*)cache->slots);
+	heap_free_heap_memory(vitaSAS_heap_internal, cache->entries);
+	heap_free_heap_memory(vitaSAS_heap_internal, cache);
+
+	s_cache = NULL;
+}
+
+int vitaSAS_disable_sample_cache(void)
+{
+	vitaSASSampleCache* cache = s_cache;
+	unsigned int i;
+
+	if (cache == NULL)
+		return SCE_OK;
+
+	/* Samples still referenced by the game or by voices would be left pointing at freed entries */
+
+	for (i = 0; i < cache->numEntries; i++) {
+		if (atomic_load32(&cache->entries[i]->refCount) > 0) {
+			SCE_DBG_LOG_ERROR("[SAS] Sample cache is still in use");
+			return VITASAS_ERROR_NOT_SUPPORTED;
+		}
+	}
+
+	vitaSAS_internal_sample_cache_term();
+
+	return SCE_OK;
+}
+
+int vitaSAS_internal_sample_cache_is_enabled(void)
+{
+	return s_cache != NULL;
+}
+
+vitaSASAudio* vitaSAS_internal_sample_cache_load(uint32_t type, char* soundPath, int io_type)
+{
+	vitaSASSampleCache* cache = s_cache;
+	vitaSASSampleCacheEntry* entry;
+	char path[VITASAS_LOAD_PATH_MAX];
+	unsigned int slot;
+	uint32_t hash;
+	int length;
+
+	length = vitaSAS_internal_cache_normalize(path, soundPath);
+	if (length < 0)
+		return vitaSAS_internal_load_audio_uncached(type, soundPath, io_type);
+
+	hash = vitaSAS_bank_hash(path);
+
+	/* Hit path, no lock */
+
+	entry = vitaSAS_internal_cache_find(cache, hash, type, io_type, path, &slot);
+	if (entry != NULL && vitaSAS_internal_cache_try_acquire(entry)) {
+		vitaSAS_internal_cache_touch(cache, entry);
+		return &entry->audio;
+	}
+
+	sceKernelLockLwMutex(&cache->mutex, 1, NULL);
+
+	/* Another thread may have inserted the entry since the lookup */
+
+	entry = vitaSAS_internal_cache_find(cache, hash, type, io_type, path, &slot);
+
+	if (entry != NULL) {
+
+		/* Revive an entry whose last reference was dropped, evicted data is loaded again */
+
+		if (!vitaSAS_internal_cache_try_acquire(entry)) {
+			if (!entry->isResident && vitaSAS_internal_cache_fill(cache, entry, soundPath) < 0) {
+				sceKernelUnlockLwMutex(&cache->mutex, 1);
+				return NULL;
+			}
+
+			atomic_store32(&entry->refCount, 1);
+		}
+
+		vitaSAS_internal_cache_touch(cache, entry);
+
+		if (sample_cache_budget != 0)
+			vitaSAS_internal_cache_evict(cache, sample_cache_budget);
+
+		sceKernelUnlockLwMutex(&cache->mutex, 1);
+		return &entry->audio;
+	}
+
+	/* Full cache loads without sharing */
+
+	if (cache->numEntries == cache->maxEntries) {
+		sceKernelUnlockLwMutex(&cache->mutex, 1);
+		return vitaSAS_internal_load_audio_uncached(type, soundPath, io_type);
+	}
+
+	entry = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASSampleCacheEntry) + length + 1);
+	if (entry == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		sceKernelUnlockLwMutex(&cache->mutex, 1);
+		return NULL;
+	}
+
+	entry->index = cache->numEntries;
+	entry->hash = hash;
+	entry->type = type;
+	entry->io_type = io_type;
+	sceClibMemcpy(entry->path, path, length + 1);
+
+	if (vitaSAS_internal_cache_fill(cache, entry, soundPath) < 0) {
+		heap_free_heap_memory(vitaSAS_heap_internal, entry);
+		sceKernelUnlockLwMutex(&cache->mutex, 1);
+		return NULL;
+	}
+
+	entry->refCount = 1;
+	vitaSAS_internal_cache_touch(cache, entry);
+
+	/* Entry is complete before its slot is published */
+
+	cache->entries[cache->numEntries] = entry;
+	cache->numEntries++;
+	atomic_store32(&cache->slots[slot], (int32_t)cache->numEntries);
+
+	if (sample_cache_budget != 0)
+		vitaSAS_internal_cache_evict(cache, sample_cache_budget);
+
+	sceKernelUnlockLwMutex(&cache->mutex, 1);
+
+	return &entry->audio;
+}
+
+void vitaSAS_internal_sample_cache_release(vitaSASAudio* info)
+{
+	vitaSAS_internal_cache_release_entry(s_cache, (vitaSASSampleCacheEntry*)info);
+}
+
+/* Reference for a voice set to play info, returned as entry index + 1, 0 if info isn't cached */
+
+uint32_t vitaSAS_internal_sample_cache_acquire_voice(const vitaSASAudio* info)
+{
+	vitaSASSampleCacheEntry* entry = (vitaSASSampleCacheEntry*)info;
+
+	if (info == NULL || info->storage != VITASAS_AUDIO_STORAGE_CACHE || !vitaSAS_internal_cache_try_acquire(entry))
+		return 0;
+
+	return entry->index + 1;
+}
+
+void vitaSAS_internal_sample_cache_release_voice(uint32_t sample)
+{
+	if (sample != 0)
+		vitaSAS_internal_cache_release_entry(s_cache, s_cache->entries[sample - 1]);
+}
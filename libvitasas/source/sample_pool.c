@@ -0,0 +1,133 @@
+#include <kernel.h>
+#include <libdbg.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+#include "atomic.h"
+
+/*
+ * Sample data is sub-allocated from a dedicated auto-extending heap, so small samples share large
+ * memory blocks instead of taking a 4 KB rounded memory block each. Usage is tracked against an
+ * optional budget. With pool block size set to 0 every sample gets its own memory block as before.
+ * Allocations that fail evict unused samples from the sample cache and are retried.
+ */
+
+static void* vitaSAS_sample_pool = NULL;
+static unsigned int sample_pool_block_size = VITASAS_SAMPLE_POOL_BLOCK_SIZE_DEFAULT;
+static unsigned int sample_pool_budget = 0;
+static volatile int32_t sample_pool_usage = 0;
+
+void vitaSAS_set_sample_pool_size(unsigned int blockSize, unsigned int budget)
+{
+	sample_pool_block_size = blockSize;
+	sample_pool_budget = budget;
+}
+
+unsigned int vitaSAS_get_sample_pool_usage(void)
+{
+	return (unsigned int)atomic_load32(&sample_pool_usage);
+}
+
+int vitaSAS_internal_sample_pool_init(void)
+{
+	if (sample_pool_block_size == 0)
+		return SCE_OK;
+
+	vitaSAS_sample_pool = heap_create_heap("vitaSAS_sample_pool", sample_pool_block_size, HEAP_AUTO_EXTEND, NULL);
+	if (vitaSAS_sample_pool == NULL) {
+		SCE_DBG_LOG_WARNING("[SAS] Can't create sample pool");
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	atomic_store32(&sample_pool_usage, 0);
+
+	return SCE_OK;
+}
+
+void vitaSAS_internal_sample_pool_term(void)
+{
+	if (vitaSAS_sample_pool != NULL) {
+		heap_delete_heap(vitaSAS_sample_pool);
+		vitaSAS_sample_pool = NULL;
+	}
+}
+
+static void* vitaSAS_internal_sample_try_alloc(unsigned int size, SceUID* mem_id_ret)
+{
+	heap_alloc_opt_param optParam;
+	unsigned int usableSize, previousUsage;
+	SceUID mem_id;
+	void* data = NULL;
+
+	*mem_id_ret = 0;
+
+	/* Own memory block if there is no pool */
+
+	if (vitaSAS_sample_pool == NULL) {
+		mem_id = sceKernelAllocMemBlock("vitaSAS_sample_storage", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, ROUND_UP(size, 4 * 1024), NULL);
+		if (mem_id < 0) {
+			SCE_DBG_LOG_ERROR("[SAS IO] sceKernelAllocMemBlock(): 0x%X", mem_id);
+			return NULL;
+		}
+
+		sceKernelGetMemBlockBase(mem_id, &data);
+		*mem_id_ret = mem_id;
+
+		return data;
+	}
+
+	optParam.size = sizeof(heap_alloc_opt_param);
+	optParam.alignment = VITASAS_SAMPLE_ALIGN;
+
+	data = heap_alloc_heap_memory_with_option(vitaSAS_sample_pool, size, &optParam);
+	if (data == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS IO] Can't allocate %u bytes from sample pool", size);
+		return NULL;
+	}
+
+	/* Charge the budget, back out if it is exceeded */
+
+	_heap_query_block_info(vitaSAS_sample_pool, data, &usableSize, NULL, NULL);
+
+	previousUsage = (unsigned int)atomic_add32(&sample_pool_usage, (int32_t)usableSize);
+	if (sample_pool_budget != 0 && previousUsage + usableSize > sample_pool_budget) {
+		SCE_DBG_LOG_ERROR("[SAS IO] Sample pool budget exceeded");
+		atomic_add32(&sample_pool_usage, -(int32_t)usableSize);
+		heap_free_heap_memory(vitaSAS_sample_pool, data);
+		return NULL;
+	}
+
+	return data;
+}
+
+void* vitaSAS_internal_sample_alloc(unsigned int size, SceUID* mem_id_ret)
+{
+	void* data;
+
+	/* Memory block or pool extension failed or budget exceeded, retry while unused cached samples can be evicted */
+
+	do {
+		data = vitaSAS_internal_sample_try_alloc(size, mem_id_ret);
+	} while (data == NULL && vitaSAS_internal_sample_cache_reclaim(size) != 0);
+
+	return data;
+}
+
+void vitaSAS_internal_sample_free(void* data, SceUID mem_id)
+{
+	unsigned int usableSize;
+
+	if (0 < mem_id) {
+		sceKernelFreeMemBlock(mem_id);
+		return;
+	}
+
+	if (data == NULL || vitaSAS_sample_pool == NULL)
+		return;
+
+	if (_heap_query_block_info(vitaSAS_sample_pool, data, &usableSize, NULL, NULL) < 0)
+		return;
+
+	atomic_add32(&sample_pool_usage, -(int32_t)usableSize);
+	heap_free_heap_memory(vitaSAS_sample_pool, data);
+}
@@ -0,0 +1,415 @@
+#include <kernel.h>
+#include <libdbg.h>
+#include <sas.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+#include "soft_mixer.h"
+#include "pcm_kernels.h"
+
+extern void* vitaSAS_heap_internal;
+
+/*
+ * Portable software mixer that stands in for sceSasCore. Supports PCM and noise voices with pitch,
+ * dry volumes and SAS style ADSR envelopes. There is no effect unit, so wet volumes and effect
+ * settings are accepted and ignored. Voices are rendered one by one into a mono scratch buffer
+ * and accumulated into a 32-bit stereo mix, which is saturated into the output buffer at the end.
+ */
+
+#define SOFT_MIXER_PITCH_SHIFT	12
+#define SOFT_MIXER_PITCH_MASK	((1 << SOFT_MIXER_PITCH_SHIFT) - 1)
+
+/* Simple ADSR bitfield decoding */
+
+static uint32_t vitaSAS_internal_soft_mixer_simple_rate(uint32_t n)
+{
+	uint32_t rate;
+
+	n &= 0x7F;
+	if (n == 0x7F)
+		return 0;
+
+	rate = ((7 - (n & 0x3)) << 26) >> (n >> 2);
+
+	return rate != 0 ? rate : 1;
+}
+
+static uint32_t vitaSAS_internal_soft_mixer_exponent_rate(uint32_t n)
+{
+	if (n == 0)
+		return 0x7FFFFFFF;
+
+	return 0x80000000U >> n;
+}
+
+static void vitaSAS_internal_soft_mixer_set_simple_ADSR(SoftMixerEnvelope* envelope, uint32_t adsr1, uint32_t adsr2)
+{
+	static const uint32_t sustainCurves[4] = {
+		SOFT_MIXER_CURVE_LINEAR_INC, SOFT_MIXER_CURVE_LINEAR_DEC, SOFT_MIXER_CURVE_LINEAR_BENT, SOFT_MIXER_CURVE_EXPONENT_DEC
+	};
+	uint32_t releaseRate = adsr2 & 0x1F;
+
+	envelope->curve[SOFT_MIXER_PHASE_ATTACK] = (adsr1 & 0x8000) ? SOFT_MIXER_CURVE_LINEAR_BENT : SOFT_MIXER_CURVE_LINEAR_INC;
+	envelope->rate[SOFT_MIXER_PHASE_ATTACK] = vitaSAS_internal_soft_mixer_simple_rate(adsr1 >> 8);
+
+	envelope->curve[SOFT_MIXER_PHASE_DECAY] = SOFT_MIXER_CURVE_EXPONENT_DEC;
+	envelope->rate[SOFT_MIXER_PHASE_DECAY] = vitaSAS_internal_soft_mixer_exponent_rate((adsr1 >> 4) & 0xF);
+
+	envelope->sustainLevel = ((adsr1 & 0xF) + 1) << 26;
+
+	envelope->curve[SOFT_MIXER_PHASE_SUSTAIN] = sustainCurves[(adsr2 >> 14) & 0x3];
+	envelope->rate[SOFT_MIXER_PHASE_SUSTAIN] = vitaSAS_internal_soft_mixer_simple_rate(adsr2 >> 6);
+
+	if (adsr2 & 0x20) {
+		envelope->curve[SOFT_MIXER_PHASE_RELEASE] = SOFT_MIXER_CURVE_EXPONENT_DEC;
+		envelope->rate[SOFT_MIXER_PHASE_RELEASE] = releaseRate == 31 ? 0 : vitaSAS_internal_soft_mixer_exponent_rate(releaseRate);
+	}
+	else {
+		envelope->curve[SOFT_MIXER_PHASE_RELEASE] = SOFT_MIXER_CURVE_LINEAR_DEC;
+		if (releaseRate == 31)
+			envelope->rate[SOFT_MIXER_PHASE_RELEASE] = 0;
+		else if (releaseRate == 30)
+			envelope->rate[SOFT_MIXER_PHASE_RELEASE] = 0x40000000;
+		else if (releaseRate == 29)
+			envelope->rate[SOFT_MIXER_PHASE_RELEASE] = 1;
+		else
+			envelope->rate[SOFT_MIXER_PHASE_RELEASE] = 0x10000000 >> releaseRate;
+	}
+}
+
+static void vitaSAS_internal_soft_mixer_reset_envelope(SoftMixerEnvelope* envelope)
+{
+	/* Full level for as long as the key is held, instant release */
+
+	envelope->height = 0;
+	envelope->phase = SOFT_MIXER_PHASE_OFF;
+	envelope->curve[SOFT_MIXER_PHASE_ATTACK] = SOFT_MIXER_CURVE_DIRECT;
+	envelope->rate[SOFT_MIXER_PHASE_ATTACK] = SOFT_MIXER_ENVELOPE_MAX;
+	envelope->curve[SOFT_MIXER_PHASE_DECAY] = SOFT_MIXER_CURVE_EXPONENT_DEC;
+	envelope->rate[SOFT_MIXER_PHASE_DECAY] = 0;
+	envelope->curve[SOFT_MIXER_PHASE_SUSTAIN] = SOFT_MIXER_CURVE_LINEAR_DEC;
+	envelope->rate[SOFT_MIXER_PHASE_SUSTAIN] = 0;
+	envelope->curve[SOFT_MIXER_PHASE_RELEASE] = SOFT_MIXER_CURVE_DIRECT;
+	envelope->rate[SOFT_MIXER_PHASE_RELEASE] = 0;
+	envelope->sustainLevel = SOFT_MIXER_ENVELOPE_MAX;
+}
+
+static __inline__ int32_t vitaSAS_internal_soft_mixer_envelope_step(SoftMixerEnvelope* envelope)
+{
+	int32_t height = envelope->height;
+	uint32_t rate;
+	int32_t delta;
+
+	if (envelope->phase == SOFT_MIXER_PHASE_OFF)
+		return 0;
+
+	rate = envelope->rate[envelope->phase];
+
+	switch (envelope->curve[envelope->phase]) {
+	case SOFT_MIXER_CURVE_LINEAR_INC:
+		height += (int32_t)rate;
+		break;
+	case SOFT_MIXER_CURVE_LINEAR_DEC:
+		height -= (int32_t)rate;
+		break;
+	case SOFT_MIXER_CURVE_LINEAR_BENT:
+		height += height < 0x30000000 ? (int32_t)rate : (int32_t)(rate >> 2);
+		break;
+	case SOFT_MIXER_CURVE_EXPONENT_DEC:
+		delta = (int32_t)(((int64_t)height * rate) >> 31);
+		height -= (delta == 0 && rate != 0) ? 1 : delta;
+		break;
+	case SOFT_MIXER_CURVE_EXPONENT_INC:
+		height += (int32_t)(((int64_t)(SOFT_MIXER_ENVELOPE_MAX - height) * rate) >> 31);
+		break;
+	default:
+		height = (int32_t)rate;
+		break;
+	}
+
+	switch (envelope->phase) {
+	case SOFT_MIXER_PHASE_ATTACK:
+		if (height >= SOFT_MIXER_ENVELOPE_MAX) {
+			height = SOFT_MIXER_ENVELOPE_MAX;
+			envelope->phase = SOFT_MIXER_PHASE_DECAY;
+		}
+		break;
+	case SOFT_MIXER_PHASE_DECAY:
+		if (height <= envelope->sustainLevel) {
+			height = envelope->sustainLevel;
+			envelope->phase = SOFT_MIXER_PHASE_SUSTAIN;
+		}
+		break;
+	case SOFT_MIXER_PHASE_SUSTAIN:
+		if (height > SOFT_MIXER_ENVELOPE_MAX)
+			height = SOFT_MIXER_ENVELOPE_MAX;
+		if (height <= 0) {
+			height = 0;
+			envelope->phase = SOFT_MIXER_PHASE_OFF;
+		}
+		break;
+	case SOFT_MIXER_PHASE_RELEASE:
+		if (height <= 0) {
+			height = 0;
+			envelope->phase = SOFT_MIXER_PHASE_OFF;
+		}
+		break;
+	}
+
+	envelope->height = height;
+
+	return height;
+}
+
+/* Voice rendering */
+
+static __inline__ int32_t vitaSAS_internal_soft_mixer_fetch(const SoftMixerVoice* voice, uint32_t position)
+{
+	if (position < voice->numSamples)
+		return voice->data[position];
+
+	if (voice->loopPos >= 0)
+		return voice->data[voice->loopPos];
+
+	return 0;
+}
+
+static __inline__ int32_t vitaSAS_internal_soft_mixer_next_sample(SoftMixerVoice* voice)
+{
+	int32_t sample, next;
+	uint32_t step;
+
+	if (voice->type == SOFT_MIXER_VOICE_NOISE) {
+
+		/* SPU style 16-bit LFSR, clock selects the shift frequency */
+
+		voice->noiseCounter += (4 + (voice->noiseClock & 0x3)) << (voice->noiseClock >> 2);
+		while (voice->noiseCounter >= 0x20000) {
+			voice->noiseCounter -= 0x20000;
+			voice->noiseLFSR = ((voice->noiseLFSR << 1) | (((voice->noiseLFSR >> 15) ^ (voice->noiseLFSR >> 12) ^ (voice->noiseLFSR >> 11) ^ (voice->noiseLFSR >> 10) ^ 1) & 1)) & 0xFFFF;
+		}
+
+		return (int16_t)voice->noiseLFSR;
+	}
+
+	/* Linear interpolation between neighbouring samples */
+
+	sample = voice->data[voice->position];
+	if (voice->fraction != 0) {
+		next = vitaSAS_internal_soft_mixer_fetch(voice, voice->position + 1);
+		sample += ((next - sample) * (int32_t)voice->fraction) >> SOFT_MIXER_PITCH_SHIFT;
+	}
+
+	step = voice->fraction + voice->pitch;
+	voice->position += step >> SOFT_MIXER_PITCH_SHIFT;
+	voice->fraction = step & SOFT_MIXER_PITCH_MASK;
+
+	if (voice->position >= voice->numSamples) {
+		if (voice->loopPos >= 0 && (uint32_t)voice->loopPos < voice->numSamples)
+			voice->position = (uint32_t)voice->loopPos + (voice->position - voice->numSamples) % (voice->numSamples - (uint32_t)voice->loopPos);
+		else
+			voice->isPlaying = 0;
+	}
+
+	return sample;
+}
+
+static void vitaSAS_internal_soft_mixer_render_voice(SoftMixerVoice* voice, int16_t* out, unsigned int numGrain)
+{
+	int32_t height;
+	unsigned int i;
+
+	for (i = 0; i < numGrain && voice->isPlaying; i++) {
+		height = vitaSAS_internal_soft_mixer_envelope_step(&voice->envelope);
+		out[i] = (int16_t)((vitaSAS_internal_soft_mixer_next_sample(voice) * (height >> 15)) >> 15);
+
+		if (voice->envelope.phase == SOFT_MIXER_PHASE_OFF)
+			voice->isPlaying = 0;
+	}
+
+	for (; i < numGrain; i++)
+		out[i] = 0;
+}
+
+/* Interface */
+
+vitaSASSoftMixer* vitaSAS_internal_soft_mixer_create(unsigned int numVoices)
+{
+	vitaSASSoftMixer* mixer;
+	int result;
+
+	mixer = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASSoftMixer));
+	if (mixer == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return NULL;
+	}
+
+	sceClibMemset(mixer, 0, sizeof(vitaSASSoftMixer));
+
+	mixer->numVoices = numVoices;
+	mixer->voices = heap_alloc_heap_memory(vitaSAS_heap_internal, numVoices * sizeof(SoftMixerVoice));
+	mixer->accumulator = heap_alloc_heap_memory(vitaSAS_heap_internal, VITASAS_GRAIN_MAX * CHANNEL_MAX * sizeof(int32_t));
+	mixer->voiceBuffer = heap_alloc_heap_memory(vitaSAS_heap_internal, VITASAS_GRAIN_MAX * sizeof(int16_t));
+	if (mixer->voices == NULL || mixer->accumulator == NULL || mixer->voiceBuffer == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		goto failed;
+	}
+
+	sceClibMemset(mixer->voices, 0, numVoices * sizeof(SoftMixerVoice));
+
+	for (int i = 0; i < numVoices; i++) {
+		mixer->voices[i].pitch = SCE_SAS_PITCH_BASE;
+		mixer->voices[i].loopPos = SCE_SAS_LOOP_DISABLE_PCM;
+		mixer->voices[i].noiseLFSR = 1;
+		vitaSAS_internal_soft_mixer_reset_envelope(&mixer->voices[i].envelope);
+	}
+
+	result = sceKernelCreateLwMutex(&mixer->mutex, "vitaSAS_soft_mixer", 0, 0, NULL);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS] sceKernelCreateLwMutex(): 0x%X", result);
+		goto failed;
+	}
+
+	return mixer;
+
+failed:
+
+	if (mixer->voices != NULL)
+		heap_free_heap_memory(vitaSAS_heap_internal, mixer->voices);
+	if (mixer->accumulator != NULL)
+		heap_free_heap_memory(vitaSAS_heap_internal, mixer->accumulator);
+	if (mixer->voiceBuffer != NULL)
+		heap_free_heap_memory(vitaSAS_heap_internal, mixer->voiceBuffer);
+	heap_free_heap_memory(vitaSAS_heap_internal, mixer);
+
+	return NULL;
+}
+
+void vitaSAS_internal_soft_mixer_destroy(vitaSASSoftMixer* mixer)
+{
+	sceKernelDeleteLwMutex(&mixer->mutex);
+	heap_free_heap_memory(vitaSAS_heap_internal, mixer->voices);
+	heap_free_heap_memory(vitaSAS_heap_internal, mixer->accumulator);
+	heap_free_heap_memory(vitaSAS_heap_internal, mixer->voiceBuffer);
+	heap_free_heap_memory(vitaSAS_heap_internal, mixer);
+}
+
+int vitaSAS_internal_soft_mixer_apply(vitaSASSoftMixer* mixer, const vitaSASCommand* command)
+{
+	SoftMixerVoice* voice;
+	SoftMixerEnvelope* envelope;
+	int result = SCE_OK;
+
+	if (command->voiceID >= mixer->numVoices)
+		return VITASAS_ERROR_NOT_SUPPORTED;
+
+	voice = &mixer->voices[command->voiceID];
+	envelope = &voice->envelope;
+
+	sceKernelLockLwMutex(&mixer->mutex, 1, NULL);
+
+	switch (command->type) {
+	case VITASAS_COMMAND_SET_VOICE:
+		SCE_DBG_LOG_ERROR("[SAS] VAG voices are not supported by software mixer");
+		result = VITASAS_ERROR_NOT_SUPPORTED;
+		break;
+	case VITASAS_COMMAND_SET_VOICE_PCM:
+		voice->type = SOFT_MIXER_VOICE_PCM;
+		voice->data = command->ptr;
+		voice->numSamples = command->arg[0];
+		voice->loopPos = (int32_t)command->arg[1];
+		voice->isPlaying = 0;
+		break;
+	case VITASAS_COMMAND_SET_NOISE:
+		voice->type = SOFT_MIXER_VOICE_NOISE;
+		voice->noiseClock = command->arg[0] & 0x3F;
+		voice->isPlaying = 0;
+		break;
+	case VITASAS_COMMAND_SET_PITCH:
+		voice->pitch = command->arg[0];
+		break;
+	case VITASAS_COMMAND_SET_VOLUME:
+		voice->volLDry = (int32_t)command->arg[0];
+		voice->volRDry = (int32_t)command->arg[1];
+		voice->volLWet = (int32_t)command->arg[2];
+		voice->volRWet = (int32_t)command->arg[3];
+		break;
+	case VITASAS_COMMAND_SET_SIMPLE_ADSR:
+		vitaSAS_internal_soft_mixer_set_simple_ADSR(envelope, command->arg[0], command->arg[1]);
+		break;
+	case VITASAS_COMMAND_SET_SL:
+		envelope->sustainLevel = (int32_t)command->arg[0];
+		break;
+	case VITASAS_COMMAND_SET_ADSR_MODE:
+	case VITASAS_COMMAND_SET_ADSR:
+		for (int i = 0; i < 4; i++) {
+			if (!(command->arg[0] & (1 << i)))
+				continue;
+			if (command->type == VITASAS_COMMAND_SET_ADSR_MODE)
+				envelope->curve[i] = command->arg[1 + i];
+			else
+				envelope->rate[i] = command->arg[1 + i];
+		}
+		break;
+	case VITASAS_COMMAND_SET_KEY_ON:
+		if (voice->type == SOFT_MIXER_VOICE_NONE || (voice->type == SOFT_MIXER_VOICE_PCM && voice->numSamples == 0)) {
+			result = VITASAS_ERROR_NOT_SUPPORTED;
+			break;
+		}
+		voice->position = 0;
+		voice->fraction = 0;
+		voice->noiseCounter = 0;
+		envelope->height = 0;
+		envelope->phase = SOFT_MIXER_PHASE_ATTACK;
+		voice->isPlaying = 1;
+		break;
+	case VITASAS_COMMAND_SET_KEY_OFF:
+		if (voice->isPlaying)
+			envelope->phase = SOFT_MIXER_PHASE_RELEASE;
+		break;
+	default:
+
+		/* No effect unit */
+
+		break;
+	}
+
+	sceKernelUnlockLwMutex(&mixer->mutex, 1);
+
+	return result;
+}
+
+int vitaSAS_internal_soft_mixer_get_end_state(vitaSASSoftMixer* mixer, unsigned int voiceID)
+{
+	if (voiceID >= mixer->numVoices)
+		return VITASAS_ERROR_NOT_SUPPORTED;
+
+	return mixer->voices[voiceID].isPlaying ? 0 : 1;
+}
+
+void vitaSAS_internal_soft_mixer_render(vitaSASSoftMixer* mixer, int16_t* buffer, unsigned int numGrain, int32_t mixVolL, int32_t mixVolR)
+{
+	SoftMixerVoice* voice;
+
+	sceKernelLockLwMutex(&mixer->mutex, 1, NULL);
+
+	sceClibMemset(mixer->accumulator, 0, numGrain * CHANNEL_MAX * sizeof(int32_t));
+
+	for (int i = 0; i < mixer->numVoices; i++) {
+		voice = &mixer->voices[i];
+		if (!voice->isPlaying)
+			continue;
+
+		vitaSAS_internal_soft_mixer_render_voice(voice, mixer->voiceBuffer, numGrain);
+		pcm_kernels_accumulate_mono_s16(mixer->accumulator, mixer->voiceBuffer, numGrain, voice->volLDry, voice->volRDry);
+	}
+
+	sceKernelUnlockLwMutex(&mixer->mutex, 1);
+
+	/* Same semantics as sceSasCore: zero volumes overwrite the buffer, otherwise buffer contents are mixed in */
+
+	if (mixVolL == 0 && mixVolR == 0)
+		pcm_kernels_pack_s32_s16(buffer, mixer->accumulator, numGrain * CHANNEL_MAX);
+	else
+		pcm_kernels_pack_mix_s32_s16_stereo(buffer, mixer->accumulator, numGrain, mixVolL, mixVolR);
+}
@@ -0,0 +1,326 @@
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "vag_codec.h"
+
+/* Prediction filters in 1/64 units, predicted = (s1 * c0 + s2 * c1 + 32) >> 6 */
+
+static const int32_t s_vagFilters[VAG_CODEC_NUM_FILTERS][2] = {
+	{ 0, 0 },
+	{ 60, 0 },
+	{ 115, -52 },
+	{ 98, -55 },
+	{ 122, -60 }
+};
+
+/* Residual of every nibble at every shift, shifts above 12 decode like 9 as on the SPU */
+
+#define VAG_CODEC_DELTA(n, s)	(int16_t)(((n) < 8 ? (n) : (n) - 16) * 4096 / (1 << (s)))
+#define VAG_CODEC_DELTA_ROW(s)	{ \
+	VAG_CODEC_DELTA(0, s), VAG_CODEC_DELTA(1, s), VAG_CODEC_DELTA(2, s), VAG_CODEC_DELTA(3, s), \
+	VAG_CODEC_DELTA(4, s), VAG_CODEC_DELTA(5, s), VAG_CODEC_DELTA(6, s), VAG_CODEC_DELTA(7, s), \
+	VAG_CODEC_DELTA(8, s), VAG_CODEC_DELTA(9, s), VAG_CODEC_DELTA(10, s), VAG_CODEC_DELTA(11, s), \
+	VAG_CODEC_DELTA(12, s), VAG_CODEC_DELTA(13, s), VAG_CODEC_DELTA(14, s), VAG_CODEC_DELTA(15, s) }
+
+static const int16_t s_vagDeltas[16][16] = {
+	VAG_CODEC_DELTA_ROW(0), VAG_CODEC_DELTA_ROW(1), VAG_CODEC_DELTA_ROW(2), VAG_CODEC_DELTA_ROW(3),
+	VAG_CODEC_DELTA_ROW(4), VAG_CODEC_DELTA_ROW(5), VAG_CODEC_DELTA_ROW(6), VAG_CODEC_DELTA_ROW(7),
+	VAG_CODEC_DELTA_ROW(8), VAG_CODEC_DELTA_ROW(9), VAG_CODEC_DELTA_ROW(10), VAG_CODEC_DELTA_ROW(11),
+	VAG_CODEC_DELTA_ROW(12), VAG_CODEC_DELTA_ROW(9), VAG_CODEC_DELTA_ROW(9), VAG_CODEC_DELTA_ROW(9)
+};
+
+static __inline__ int32_t vag_codec_saturate_s16(int32_t value)
+{
+	if (value > 32767)
+		return 32767;
+	if (value < -32768)
+		return -32768;
+	return value;
+}
+
+static void vag_codec_write_be32(uint8_t* dst, uint32_t value)
+{
+	dst[0] = (uint8_t)(value >> 24);
+	dst[1] = (uint8_t)(value >> 16);
+	dst[2] = (uint8_t)(value >> 8);
+	dst[3] = (uint8_t)value;
+}
+
+/*
+ * Largest prediction residual of one block, history holds the two samples before the block followed by
+ * the block itself
+ */
+
+static int32_t vag_codec_get_max_residual(const int16_t* history, int32_t c0, int32_t c1)
+{
+	int32_t maxResidual = 0;
+	int32_t residual;
+	unsigned int i = 0;
+
+#if defined(__ARM_NEON__)
+	{
+		int32x4_t maxVec = vdupq_n_s32(0);
+		int32x4_t predicted;
+		int32x2_t maxPair;
+
+		/* 4 samples per iteration, 28 samples per block */
+
+		for (; i + 4 <= VAG_CODEC_BLOCK_SAMPLES; i += 4) {
+			predicted = vmull_n_s16(vld1_s16(history + i + 1), (int16_t)c0);
+			predicted = vmlal_n_s16(predicted, vld1_s16(history + i), (int16_t)c1);
+			predicted = vrshrq_n_s32(predicted, 6);
+			maxVec = vmaxq_s32(maxVec, vabsq_s32(vsubq_s32(vmovl_s16(vld1_s16(history + i + 2)), predicted)));
+		}
+
+		maxPair = vpmax_s32(vget_low_s32(maxVec), vget_high_s32(maxVec));
+		maxPair = vpmax_s32(maxPair, maxPair);
+		maxResidual = vget_lane_s32(maxPair, 0);
+	}
+#endif
+
+	for (; i < VAG_CODEC_BLOCK_SAMPLES; i++) {
+		residual = history[i + 2] - ((history[i + 1] * c0 + history[i] * c1 + 32) >> 6);
+		if (residual < 0)
+			residual = -residual;
+		if (residual > maxResidual)
+			maxResidual = residual;
+	}
+
+	return maxResidual;
+}
+
+/* Quantize one block against the decoded history so encoder and decoder stay in step, returns the squared error */
+
+static uint64_t vag_codec_encode_block(uint8_t* dst, const int16_t* samples, unsigned int filter, unsigned int shift, int32_t* s1, int32_t* s2)
+{
+	const int32_t c0 = s_vagFilters[filter][0];
+	const int32_t c1 = s_vagFilters[filter][1];
+	int32_t predicted, quantized, decoded;
+	uint64_t error = 0;
+	unsigned int i;
+
+	dst[0] = (uint8_t)((filter << 4) | shift);
+
+	for (i = 0; i < VAG_CODEC_BLOCK_SAMPLES; i++) {
+		predicted = (*s1 * c0 + *s2 * c1 + 32) >> 6;
+		quantized = ((samples[i] - predicted) * (1 << shift) + 2048) >> 12;
+		if (quantized > 7)
+			quantized = 7;
+		else if (quantized < -8)
+			quantized = -8;
+
+		decoded = vag_codec_saturate_s16(((quantized * 4096) >> shift) + predicted);
+		error += (int64_t)(samples[i] - decoded) * (samples[i] - decoded);
+		*s2 = *s1;
+		*s1 = decoded;
+
+		if (i & 1)
+			dst[2 + i / 2] |= (uint8_t)((quantized & 0xF) << 4);
+		else
+			dst[2 + i / 2] = (uint8_t)(quantized & 0xF);
+	}
+
+	return error;
+}
+
+/* Shift that covers a peak residual with the finest step */
+
+static unsigned int vag_codec_get_shift(int32_t maxResidual)
+{
+	unsigned int shift;
+
+	for (shift = 12; shift > 0; shift--) {
+		if (maxResidual <= (7 << 12) >> shift)
+			break;
+	}
+
+	return shift;
+}
+
+unsigned int vag_codec_get_encoded_size(unsigned int numSamples)
+{
+	unsigned int numBlocks = (numSamples + VAG_CODEC_BLOCK_SAMPLES - 1) / VAG_CODEC_BLOCK_SAMPLES;
+
+	/* Silent lead-in block and at least one data block carrying the end flag */
+
+	if (numBlocks == 0)
+		numBlocks = 1;
+
+	return VAG_CODEC_HEADER_SIZE + (numBlocks + 1) * VAG_CODEC_BLOCK_SIZE;
+}
+
+unsigned int vag_codec_encode(uint8_t* dst, const int16_t* src, unsigned int numSamples, uint32_t samplingRate)
+{
+	const unsigned int size = vag_codec_get_encoded_size(numSamples);
+	int16_t history[VAG_CODEC_BLOCK_SAMPLES + 2];
+	uint8_t candidate[VAG_CODEC_BLOCK_SIZE];
+	int32_t s1 = 0, s2 = 0, bestS1 = 0, bestS2 = 0, t1, t2;
+	uint64_t error, bestError;
+	unsigned int offset, count, i, filter, shift, lastShift;
+	uint8_t* block;
+
+	/* Header, reserved fields and name are left zero */
+
+	for (i = 0; i < VAG_CODEC_HEADER_SIZE + VAG_CODEC_BLOCK_SIZE; i++)
+		dst[i] = 0;
+
+	vag_codec_write_be32(dst, VAG_CODEC_MAGIC);
+	vag_codec_write_be32(dst + 4, VAG_CODEC_VERSION);
+	vag_codec_write_be32(dst + 12, size - VAG_CODEC_HEADER_SIZE);
+	vag_codec_write_be32(dst + 16, samplingRate);
+
+	block = dst + VAG_CODEC_HEADER_SIZE + VAG_CODEC_BLOCK_SIZE;
+	history[0] = 0;
+	history[1] = 0;
+
+	for (offset = 0; block < dst + size; offset += VAG_CODEC_BLOCK_SAMPLES, block += VAG_CODEC_BLOCK_SIZE) {
+		count = numSamples - offset < VAG_CODEC_BLOCK_SAMPLES ? numSamples - offset : VAG_CODEC_BLOCK_SAMPLES;
+
+		for (i = 0; i < VAG_CODEC_BLOCK_SAMPLES; i++)
+			history[i + 2] = i < count ? src[offset + i] : 0;
+
+		/*
+		 * Every filter is tried with the shift covering its peak residual and with one step finer, which clips
+		 * the peak but halves the step size. The candidate with the smallest squared error wins.
+		 */
+
+		bestError = UINT64_MAX;
+
+		for (filter = 0; filter < VAG_CODEC_NUM_FILTERS; filter++) {
+			shift = vag_codec_get_shift(vag_codec_get_max_residual(history, s_vagFilters[filter][0], s_vagFilters[filter][1]));
+			lastShift = shift < 12 ? shift + 1 : shift;
+
+			for (; shift <= lastShift; shift++) {
+				t1 = s1;
+				t2 = s2;
+				error = vag_codec_encode_block(candidate, history + 2, filter, shift, &t1, &t2);
+				if (error < bestError) {
+					bestError = error;
+					bestS1 = t1;
+					bestS2 = t2;
+					for (i = 0; i < VAG_CODEC_BLOCK_SIZE; i++)
+						block[i] = candidate[i];
+				}
+			}
+		}
+
+		s1 = bestS1;
+		s2 = bestS2;
+		block[1] = block + VAG_CODEC_BLOCK_SIZE == dst + size ? VAG_CODEC_FLAG_LOOP_END : 0;
+
+		history[0] = history[VAG_CODEC_BLOCK_SAMPLES];
+		history[1] = history[VAG_CODEC_BLOCK_SAMPLES + 1];
+	}
+
+	return size;
+}
+
+static uint32_t vag_codec_read_be32(const uint8_t* src)
+{
+	return (uint32_t)src[0] << 24 | (uint32_t)src[1] << 16 | (uint32_t)src[2] << 8 | (uint32_t)src[3];
+}
+
+int vag_codec_parse_header(const uint8_t* data, unsigned int size, vag_codec_info* info)
+{
+	if (size < VAG_CODEC_HEADER_SIZE || vag_codec_read_be32(data) != VAG_CODEC_MAGIC)
+		return VAG_CODEC_ERROR_INVALID;
+
+	info->samplingRate = vag_codec_read_be32(data + 16);
+	info->dataOffset = VAG_CODEC_HEADER_SIZE;
+	info->dataSize = vag_codec_read_be32(data + 12);
+
+	if (info->dataSize > size - VAG_CODEC_HEADER_SIZE)
+		info->dataSize = size - VAG_CODEC_HEADER_SIZE;
+
+	info->dataSize &= ~(VAG_CODEC_BLOCK_SIZE - 1);
+	info->numSamples = info->dataSize / VAG_CODEC_BLOCK_SIZE * VAG_CODEC_BLOCK_SAMPLES;
+	info->loopStart = -1;
+	info->loopEnd = -1;
+
+	return 0;
+}
+
+void vag_codec_scan_blocks(const uint8_t* data, vag_codec_info* info)
+{
+	const uint8_t* block = data + info->dataOffset;
+	unsigned int numBlocks = info->dataSize / VAG_CODEC_BLOCK_SIZE;
+	unsigned int i;
+	int32_t loopStart = -1;
+
+	for (i = 0; i < numBlocks; i++, block += VAG_CODEC_BLOCK_SIZE) {
+		if ((block[1] & VAG_CODEC_FLAG_LOOP_START) && loopStart < 0)
+			loopStart = (int32_t)(i * VAG_CODEC_BLOCK_SAMPLES);
+
+		if (block[1] & VAG_CODEC_FLAG_LOOP_END) {
+			info->numSamples = (i + 1) * VAG_CODEC_BLOCK_SAMPLES;
+			if ((block[1] & VAG_CODEC_FLAG_LOOP_REPEAT) && loopStart >= 0) {
+				info->loopStart = loopStart;
+				info->loopEnd = (int32_t)info->numSamples;
+			}
+			return;
+		}
+	}
+
+	info->numSamples = numBlocks * VAG_CODEC_BLOCK_SAMPLES;
+}
+
+/* Residuals of one block, deltas[i + 4] belongs to sample i */
+
+static void vag_codec_expand_block(int16_t* deltas, const uint8_t* block, unsigned int shift)
+{
+#if defined(__ARM_NEON__)
+	uint8x16_t in = vld1q_u8(block);
+	uint8x16x2_t nibbles = vzipq_u8(vandq_u8(in, vdupq_n_u8(0x0F)), vshrq_n_u8(in, 4));
+	int16x8_t scale = vdupq_n_s16(-(int16_t)(shift > 12 ? 9 : shift));
+	int8x16_t low, high;
+
+	/* Sign extend nibbles, move them to the top 4 bits of a sample and shift down */
+
+	low = vshrq_n_s8(vshlq_n_s8(vreinterpretq_s8_u8(nibbles.val[0]), 4), 4);
+	high = vshrq_n_s8(vshlq_n_s8(vreinterpretq_s8_u8(nibbles.val[1]), 4), 4);
+
+	vst1q_s16(deltas, vshlq_s16(vshlq_n_s16(vmovl_s8(vget_low_s8(low)), 12), scale));
+	vst1q_s16(deltas + 8, vshlq_s16(vshlq_n_s16(vmovl_s8(vget_high_s8(low)), 12), scale));
+	vst1q_s16(deltas + 16, vshlq_s16(vshlq_n_s16(vmovl_s8(vget_low_s8(high)), 12), scale));
+	vst1q_s16(deltas + 24, vshlq_s16(vshlq_n_s16(vmovl_s8(vget_high_s8(high)), 12), scale));
+#else
+	const int16_t* row = s_vagDeltas[shift];
+	unsigned int i;
+
+	for (i = 0; i < VAG_CODEC_BLOCK_SAMPLES / 2; i++) {
+		deltas[4 + i * 2] = row[block[2 + i] & 0xF];
+		deltas[5 + i * 2] = row[block[2 + i] >> 4];
+	}
+#endif
+}
+
+int vag_codec_decode(int16_t* dst, const uint8_t* data, const vag_codec_info* info)
+{
+	const uint8_t* block = data + info->dataOffset;
+	int16_t deltas[VAG_CODEC_BLOCK_SAMPLES + 4];
+	int32_t c0, c1, s1 = 0, s2 = 0, sample;
+	unsigned int offset, filter, i;
+
+	for (offset = 0; offset < info->numSamples; offset += VAG_CODEC_BLOCK_SAMPLES, block += VAG_CODEC_BLOCK_SIZE) {
+		filter = block[0] >> 4;
+		if (filter >= VAG_CODEC_NUM_FILTERS)
+			return VAG_CODEC_ERROR_FILTER;
+
+		c0 = s_vagFilters[filter][0];
+		c1 = s_vagFilters[filter][1];
+
+		vag_codec_expand_block(deltas, block, block[0] & 0xF);
+
+		/* Prediction is a recurrence on the decoded samples, it stays scalar */
+
+		for (i = 0; i < VAG_CODEC_BLOCK_SAMPLES; i++) {
+			sample = vag_codec_saturate_s16(deltas[i + 4] + ((s1 * c0 + s2 * c1 + 32) >> 6));
+			dst[offset + i] = (int16_t)sample;
+			s2 = s1;
+			s1 = sample;
+		}
+	}
+
+	return (int)info->numSamples;
+}
@@ -0,0 +1,283 @@
+#include <kernel.h>
+#include <libdbg.h>
+#include <sas.h>
+
+#include "vitaSAS.h"
+
+/*
+ * Batched voice commands are counted up front. With command queue enabled the whole batch is reserved
+ * with a single CAS, written straight into the queue slots and published at once. Without the queue
+ * every command is applied in place. Inside a command frame the batch is staged with the rest of the frame.
+ */
+
+typedef struct BatchWriter {
+	vitaSASSystem* system;
+	vitaSASCommand* commands;
+	uint32_t mask;
+	int32_t pos;
+	int isStaged;
+} BatchWriter;
+
+static int vitaSAS_internal_batch_begin(BatchWriter* writer, vitaSASSystem* system, unsigned int numCommands)
+{
+	int ret;
+
+	writer->system = system;
+	writer->commands = system->commandQueue.commands;
+	writer->mask = system->commandQueue.mask;
+	writer->pos = 0;
+	writer->isStaged = 0;
+
+	if (writer->commands == NULL)
+		return SCE_OK;
+
+	if (vitaSAS_internal_command_queue_find_frame(&system->commandQueue, sceKernelGetThreadId()) != NULL) {
+		writer->commands = NULL;
+		writer->isStaged = 1;
+		return SCE_OK;
+	}
+
+	ret = vitaSAS_internal_command_queue_reserve(&system->commandQueue, numCommands, &writer->pos);
+	if (ret < 0)
+		SCE_DBG_LOG_WARNING("[SAS] Command queue can't fit batch of %u commands, batch dropped", numCommands);
+
+	return ret;
+}
+
+static void vitaSAS_internal_batch_end(BatchWriter* writer, int32_t startPos)
+{
+	if (writer->commands != NULL)
+		vitaSAS_internal_command_queue_commit(&writer->system->commandQueue, startPos, (uint32_t)writer->pos - (uint32_t)startPos);
+}
+
+static vitaSASCommand* vitaSAS_internal_batch_next(BatchWriter* writer, vitaSASCommand* local)
+{
+	vitaSASCommand* command;
+
+	if (writer->commands == NULL)
+		return local;
+
+	command = &writer->commands[writer->pos & writer->mask];
+	writer->pos = (int32_t)((uint32_t)writer->pos + 1);
+
+	return command;
+}
+
+static void vitaSAS_internal_batch_emit(BatchWriter* writer, vitaSASCommand* command)
+{
+	/* Queued commands are already in place and get published by vitaSAS_internal_batch_end() */
+
+	if (writer->isStaged)
+		vitaSAS_internal_submit_command(writer->system, command);
+	else if (writer->commands == NULL)
+		vitaSAS_internal_apply_command(writer->system, command);
+}
+
+int vitaSAS_system_set_voices_batch(vitaSASSystem* system, const vitaSASVoiceSetup* setup, unsigned int numVoices)
+{
+	BatchWriter writer;
+	vitaSASCommand local;
+	vitaSASCommand* command;
+	const vitaSASVoiceParam* param;
+	unsigned int numCommands = numVoices * 4;
+	int32_t startPos;
+	int ret;
+
+	if (system == NULL || setup == NULL)
+		return -1;
+
+	for (int i = 0; i < numVoices; i++) {
+		if (setup[i].keyOn)
+			numCommands++;
+		if (setup[i].type == VITASAS_VOICE_TYPE_PCM && setup[i].audio->numChannels == 2)
+			numCommands += 2;
+	}
+
+	if (numCommands == 0)
+		return SCE_OK;
+
+	ret = vitaSAS_internal_batch_begin(&writer, system, numCommands);
+	if (ret < 0)
+		return ret;
+
+	startPos = writer.pos;
+
+	for (int i = 0; i < numVoices; i++) {
+
+		param = &setup[i].param;
+
+		/* Waveform */
+
+		command = vitaSAS_internal_batch_next(&writer, &local);
+		command->voiceID = setup[i].voiceID;
+
+		switch (setup[i].type) {
+		case VITASAS_VOICE_TYPE_VAG:
+			command->type = VITASAS_COMMAND_SET_VOICE;
+			command->ptr = vitaSAS_internal_get_VAG_data(setup[i].audio, &command->arg[0]);
+			command->arg[1] = param->loop;
+			command->arg[2] = vitaSAS_internal_sample_cache_acquire_voice(setup[i].audio);
+			break;
+		case VITASAS_VOICE_TYPE_PCM:
+			command->type = VITASAS_COMMAND_SET_VOICE_PCM;
+			command->ptr = setup[i].audio->datap;
+			command->arg[0] = setup[i].audio->data_size / 2 / (setup[i].audio->numChannels == 2 ? 2 : 1);
+			command->arg[1] = (uint32_t)param->loopSize;
+			command->arg[2] = vitaSAS_internal_sample_cache_acquire_voice(setup[i].audio);
+			break;
+		default:
+			command->type = VITASAS_COMMAND_SET_NOISE;
+			command->ptr = NULL;
+			command->arg[0] = setup[i].noiseClock;
+			break;
+		}
+
+		vitaSAS_internal_batch_emit(&writer, command);
+
+		/* Right channel of stereo data goes to the next voice, linked to the left one */
+
+		if (setup[i].type == VITASAS_VOICE_TYPE_PCM && setup[i].audio->numChannels == 2) {
+			command = vitaSAS_internal_batch_next(&writer, &local);
+			command->type = VITASAS_COMMAND_SET_VOICE_PCM;
+			command->voiceID = setup[i].voiceID + 1;
+			command->ptr = (int16_t*)setup[i].audio->datap + setup[i].audio->data_size / 4;
+			command->arg[0] = setup[i].audio->data_size / 4;
+			command->arg[1] = (uint32_t)param->loopSize;
+			command->arg[2] = 0;
+			vitaSAS_internal_batch_emit(&writer, command);
+
+			command = vitaSAS_internal_batch_next(&writer, &local);
+			command->type = VITASAS_COMMAND_LINK_VOICE;
+			command->voiceID = setup[i].voiceID;
+			command->ptr = NULL;
+			command->arg[0] = 1;
+			vitaSAS_internal_batch_emit(&writer, command);
+		}
+
+		/* Initial parameters */
+
+		command = vitaSAS_internal_batch_next(&writer, &local);
+		command->type = VITASAS_COMMAND_SET_PITCH;
+		command->voiceID = setup[i].voiceID;
+		command->ptr = NULL;
+		command->arg[0] = param->pitch;
+		vitaSAS_internal_batch_emit(&writer, command);
+
+		command = vitaSAS_internal_batch_next(&writer, &local);
+		command->type = VITASAS_COMMAND_SET_VOLUME;
+		command->voiceID = setup[i].voiceID;
+		command->ptr = NULL;
+		command->arg[0] = param->volLDry;
+		command->arg[1] = param->volRDry;
+		command->arg[2] = param->volLWet;
+		command->arg[3] = param->volRWet;
+		vitaSAS_internal_batch_emit(&writer, command);
+
+		command = vitaSAS_internal_batch_next(&writer, &local);
+		command->type = VITASAS_COMMAND_SET_SIMPLE_ADSR;
+		command->voiceID = setup[i].voiceID;
+		command->ptr = NULL;
+		command->arg[0] = param->adsr1;
+		command->arg[1] = param->adsr2;
+		vitaSAS_internal_batch_emit(&writer, command);
+
+		if (setup[i].keyOn) {
+			command = vitaSAS_internal_batch_next(&writer, &local);
+			command->type = VITASAS_COMMAND_SET_KEY_ON;
+			command->voiceID = setup[i].voiceID;
+			command->ptr = NULL;
+			vitaSAS_internal_batch_emit(&writer, command);
+		}
+	}
+
+	vitaSAS_internal_batch_end(&writer, startPos);
+
+	return SCE_OK;
+}
+
+int vitaSAS_system_update_voices_batch(vitaSASSystem* system, const vitaSASVoiceUpdateBatch* batch)
+{
+	BatchWriter writer;
+	vitaSASCommand local;
+	vitaSASCommand* command;
+	uint32_t updateMask, voiceID;
+	unsigned int numCommands = 0;
+	int32_t startPos;
+	int ret;
+
+	if (system == NULL || batch == NULL)
+		return -1;
+
+	updateMask = batch->updateMask & (VITASAS_VOICE_UPDATE_PITCH | VITASAS_VOICE_UPDATE_VOLUME |
+		VITASAS_VOICE_UPDATE_SIMPLE_ADSR | VITASAS_VOICE_UPDATE_KEY_ON | VITASAS_VOICE_UPDATE_KEY_OFF);
+
+	for (uint32_t mask = updateMask; mask != 0; mask &= mask - 1)
+		numCommands++;
+
+	numCommands *= batch->numVoices;
+
+	if (numCommands == 0)
+		return SCE_OK;
+
+	ret = vitaSAS_internal_batch_begin(&writer, system, numCommands);
+	if (ret < 0)
+		return ret;
+
+	startPos = writer.pos;
+
+	for (int i = 0; i < batch->numVoices; i++) {
+
+		voiceID = batch->voiceID[i];
+
+		if (updateMask & VITASAS_VOICE_UPDATE_PITCH) {
+			command = vitaSAS_internal_batch_next(&writer, &local);
+			command->type = VITASAS_COMMAND_SET_PITCH;
+			command->voiceID = voiceID;
+			command->ptr = NULL;
+			command->arg[0] = batch->pitch[i];
+			vitaSAS_internal_batch_emit(&writer, command);
+		}
+
+		if (updateMask & VITASAS_VOICE_UPDATE_VOLUME) {
+			command = vitaSAS_internal_batch_next(&writer, &local);
+			command->type = VITASAS_COMMAND_SET_VOLUME;
+			command->voiceID = voiceID;
+			command->ptr = NULL;
+			command->arg[0] = batch->volLDry[i];
+			command->arg[1] = batch->volRDry[i];
+			command->arg[2] = batch->volLWet[i];
+			command->arg[3] = batch->volRWet[i];
+			vitaSAS_internal_batch_emit(&writer, command);
+		}
+
+		if (updateMask & VITASAS_VOICE_UPDATE_SIMPLE_ADSR) {
+			command = vitaSAS_internal_batch_next(&writer, &local);
+			command->type = VITASAS_COMMAND_SET_SIMPLE_ADSR;
+			command->voiceID = voiceID;
+			command->ptr = NULL;
+			command->arg[0] = batch->adsr1[i];
+			command->arg[1] = batch->adsr2[i];
+			vitaSAS_internal_batch_emit(&writer, command);
+		}
+
+		if (updateMask & VITASAS_VOICE_UPDATE_KEY_ON) {
+			command = vitaSAS_internal_batch_next(&writer, &local);
+			command->type = VITASAS_COMMAND_SET_KEY_ON;
+			command->voiceID = voiceID;
+			command->ptr = NULL;
+			vitaSAS_internal_batch_emit(&writer, command);
+		}
+
+		if (updateMask & VITASAS_VOICE_UPDATE_KEY_OFF) {
+			command = vitaSAS_internal_batch_next(&writer, &local);
+			command->type = VITASAS_COMMAND_SET_KEY_OFF;
+			command->voiceID = voiceID;
+			command->ptr = NULL;
+			vitaSAS_internal_batch_emit(&writer, command);
+		}
+	}
+
+	vitaSAS_internal_batch_end(&writer, startPos);
+
+	return SCE_OK;
+}
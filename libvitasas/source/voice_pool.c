@@ -0,0 +1,312 @@
+#include <kernel.h>
+#include <libdbg.h>
+#include <sas.h>
+
+#include "vitaSAS.h"
+#include "atomic.h"
+
+/*
+ * Voice N is tracked by bit (31 - N % 32) of word N / 32 so that CLZ of a word yields the lowest voice number.
+ *
+ * freeMask    - voices available for allocation, claimed by game threads with CAS, returned by the render thread
+ * pendingMask - allocated voices keyed on since the last grain, set when key on is applied
+ * armedMask   - voices keyed on before the grain just rendered, written by the render thread
+ * activeMask  - voices watched for end state, written by the render thread
+ *
+ * A keyed on voice moves from pendingMask to armedMask to activeMask and is always set in one of them until it is
+ * reclaimed: the next mask is written before the bit leaves the previous one. Reading them in that order from
+ * another thread therefore can't miss a voice that is in use.
+ *
+ * linkMask    - voices whose parameters are mirrored to the next voice (stereo pairs), set by the thread applying commands
+ * pairMask    - voices handed out together with the next voice, kept by the pool because the link command may still be queued
+ *
+ * sample holds the cached sample each voice keeps referenced (entry index + 1, 0 for none), swapped atomically
+ * because voices are reclaimed by the render thread and set by whichever thread applies commands.
+ */
+
+#define VOICE_WORD(voiceID)	((voiceID) / 32)
+#define VOICE_BIT(voiceID)	((int32_t)(0x80000000U >> ((voiceID) % 32)))
+
+static unsigned int vitaSAS_internal_parse_num_voices(const char* sasConfig)
+{
+	static const char key[] = "numVoices=";
+	unsigned int numVoices = 0;
+	int i, j;
+
+	if (sasConfig == NULL)
+		return VITASAS_VOICE_NUM_DEFAULT;
+
+	for (i = 0; sasConfig[i] != 0; i++) {
+		for (j = 0; key[j] != 0 && sasConfig[i + j] == key[j]; j++);
+		if (key[j] == 0)
+			break;
+	}
+
+	if (sasConfig[i] == 0)
+		return VITASAS_VOICE_NUM_DEFAULT;
+
+	for (i += sizeof(key) - 1; sasConfig[i] >= '0' && sasConfig[i] <= '9'; i++)
+		numVoices = numVoices * 10 + (sasConfig[i] - '0');
+
+	if (numVoices == 0)
+		return VITASAS_VOICE_NUM_DEFAULT;
+
+	if (numVoices > VITASAS_VOICE_POOL_MAX)
+		numVoices = VITASAS_VOICE_POOL_MAX;
+
+	return numVoices;
+}
+
+void vitaSAS_internal_voice_pool_init(vitaSASVoicePool* pool, const char* sasConfig)
+{
+	unsigned int numVoices = vitaSAS_internal_parse_num_voices(sasConfig);
+
+	sceClibMemset(pool, 0, sizeof(vitaSASVoicePool));
+
+	pool->numVoices = numVoices;
+
+	for (int i = 0; i < VITASAS_VOICE_POOL_WORDS; i++) {
+		if (numVoices >= 32)
+			pool->freeMask[i] = (int32_t)0xFFFFFFFF;
+		else if (numVoices > 0)
+			pool->freeMask[i] = (int32_t)~(0xFFFFFFFFU >> numVoices);
+		numVoices -= numVoices >= 32 ? 32 : numVoices;
+	}
+}
+
+void vitaSAS_internal_voice_pool_key_on(vitaSASVoicePool* pool, unsigned int voiceID)
+{
+	if (voiceID >= pool->numVoices)
+		return;
+
+	/* Only voices handed out by the pool are watched */
+
+	if (atomic_load32(&pool->freeMask[VOICE_WORD(voiceID)]) & VOICE_BIT(voiceID))
+		return;
+
+	atomic_or32(&pool->pendingMask[VOICE_WORD(voiceID)], VOICE_BIT(voiceID));
+}
+
+void vitaSAS_internal_voice_pool_arm(vitaSASVoicePool* pool)
+{
+	/* Voices keyed on before this grain start being watched once the grain has been rendered */
+
+	int32_t pending;
+
+	for (int i = 0; i < VITASAS_VOICE_POOL_WORDS; i++) {
+		pending = atomic_load32(&pool->pendingMask[i]);
+		atomic_store32(&pool->armedMask[i], pending);
+		if (pending != 0)
+			atomic_and32(&pool->pendingMask[i], ~pending);
+	}
+}
+
+void vitaSAS_internal_voice_pool_reclaim(vitaSASSystem* system)
+{
+	vitaSASVoicePool* pool = &system->voicePool;
+	uint32_t active, remaining;
+	unsigned int voiceID;
+	int bit;
+
+	for (int i = 0; i < VITASAS_VOICE_POOL_WORDS; i++) {
+
+		active = (uint32_t)(pool->activeMask[i] | pool->armedMask[i]);
+		remaining = active;
+
+		while (active != 0) {
+			bit = __builtin_clz(active);
+			active &= ~(0x80000000U >> bit);
+			voiceID = i * 32 + bit;
+
+			if (vitaSAS_internal_get_end_state(system, voiceID) != 1)
+				continue;
+
+			/* Voice has finished, return it to the pool */
+
+			remaining &= ~(0x80000000U >> bit);
+
+			if (pool->callback[voiceID] != NULL)
+				pool->callback[voiceID](system, voiceID, pool->userdata[voiceID]);
+
+			vitaSAS_internal_voice_pool_set_sample(pool, voiceID, 0);
+			vitaSAS_internal_voice_pool_set_link(pool, voiceID, 0);
+			atomic_and32(&pool->pairMask[i], ~(int32_t)(0x80000000U >> bit));
+
+			atomic_or32(&pool->freeMask[i], (int32_t)(0x80000000U >> bit));
+		}
+
+		atomic_store32(&pool->activeMask[i], (int32_t)remaining);
+	}
+}
+
+void vitaSAS_internal_voice_pool_set_link(vitaSASVoicePool* pool, unsigned int voiceID, int isLinked)
+{
+	if (voiceID >= pool->numVoices)
+		return;
+
+	/* Released voices are unlinked from game threads, so the mask is updated atomically */
+
+	if (isLinked)
+		atomic_or32(&pool->linkMask[VOICE_WORD(voiceID)], VOICE_BIT(voiceID));
+	else
+		atomic_and32(&pool->linkMask[VOICE_WORD(voiceID)], ~VOICE_BIT(voiceID));
+}
+
+/* Voice takes over the sample reference and drops the one it held before */
+
+void vitaSAS_internal_voice_pool_set_sample(vitaSASVoicePool* pool, unsigned int voiceID, uint32_t sample)
+{
+	int32_t previous;
+
+	if (voiceID >= VITASAS_VOICE_POOL_MAX) {
+		vitaSAS_internal_sample_cache_release_voice(sample);
+		return;
+	}
+
+	do {
+		previous = atomic_load32(&pool->sample[voiceID]);
+	} while (atomic_cas32(&pool->sample[voiceID], previous, (int32_t)sample) != previous);
+
+	vitaSAS_internal_sample_cache_release_voice((uint32_t)previous);
+}
+
+void vitaSAS_internal_voice_pool_release_samples(vitaSASVoicePool* pool)
+{
+	for (unsigned int i = 0; i < VITASAS_VOICE_POOL_MAX; i++)
+		vitaSAS_internal_voice_pool_set_sample(pool, i, 0);
+}
+
+int vitaSAS_internal_voice_pool_is_linked(const vitaSASVoicePool* pool, unsigned int voiceID)
+{
+	if (voiceID >= pool->numVoices)
+		return 0;
+
+	return (atomic_load32(&pool->linkMask[VOICE_WORD(voiceID)]) & VOICE_BIT(voiceID)) != 0;
+}
+
+/* Claim numVoices (1 or 2) neighbouring voices, pairs never straddle a word */
+
+static int vitaSAS_internal_voice_pool_alloc(vitaSASVoicePool* pool, unsigned int numVoices, vitaSASVoiceEndCallback callback, void* userdata)
+{
+	int32_t freeMask, claimMask;
+	uint32_t candidates;
+	int bit;
+
+	for (int i = 0; i < VITASAS_VOICE_POOL_WORDS; i++) {
+
+		freeMask = atomic_load32(&pool->freeMask[i]);
+
+		for (;;) {
+			candidates = (uint32_t)freeMask;
+			if (numVoices == 2)
+				candidates &= (uint32_t)freeMask << 1;
+			if (candidates == 0)
+				break;
+
+			bit = __builtin_clz(candidates);
+			claimMask = (int32_t)((numVoices == 2 ? 0xC0000000U : 0x80000000U) >> bit);
+
+			if (atomic_cas32(&pool->freeMask[i], freeMask, freeMask & ~claimMask) == freeMask) {
+				pool->callback[i * 32 + bit] = callback;
+				pool->userdata[i * 32 + bit] = userdata;
+				if (numVoices == 2) {
+					pool->callback[i * 32 + bit + 1] = NULL;
+					pool->userdata[i * 32 + bit + 1] = NULL;
+					atomic_or32(&pool->pairMask[i], (int32_t)(0x80000000U >> bit));
+				}
+				return i * 32 + bit;
+			}
+
+			freeMask = atomic_load32(&pool->freeMask[i]);
+		}
+	}
+
+	return VITASAS_ERROR_NO_FREE_VOICE;
+}
+
+int vitaSAS_system_alloc_voice_VAG(vitaSASSystem* system, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam, vitaSASVoiceEndCallback callback, void* userdata)
+{
+	int voiceID = vitaSAS_internal_voice_pool_alloc(&system->voicePool, 1, callback, userdata);
+
+	if (voiceID >= 0)
+		vitaSAS_system_set_voice_VAG(system, voiceID, info, voiceParam);
+
+	return voiceID;
+}
+
+int vitaSAS_system_alloc_voice_PCM(vitaSASSystem* system, const vitaSASAudio* info, const vitaSASVoiceParam* voiceParam, vitaSASVoiceEndCallback callback, void* userdata)
+{
+	int voiceID = vitaSAS_internal_voice_pool_alloc(&system->voicePool, info->numChannels == 2 ? 2 : 1, callback, userdata);
+
+	if (voiceID >= 0)
+		vitaSAS_system_set_voice_PCM(system, voiceID, info, voiceParam);
+
+	return voiceID;
+}
+
+int vitaSAS_system_release_voice(vitaSASSystem* system, unsigned int voiceID)
+{
+	vitaSASVoicePool* pool = &system->voicePool;
+	int32_t voiceBits = VOICE_BIT(voiceID);
+	vitaSASCommand command;
+
+	int word = VOICE_WORD(voiceID);
+
+	if (voiceID >= pool->numVoices)
+		return -1;
+
+	/* Voices that were keyed on belong to the render thread until they are reclaimed */
+
+	if ((atomic_load32(&pool->pendingMask[word]) | atomic_load32(&pool->armedMask[word]) | atomic_load32(&pool->activeMask[word])) & voiceBits) {
+		SCE_DBG_LOG_WARNING("[SAS] Voice %u was keyed on and can't be released", voiceID);
+		return VITASAS_ERROR_VOICE_IN_USE;
+	}
+
+	if (atomic_load32(&pool->freeMask[word]) & voiceBits)
+		return -1;
+
+	pool->callback[voiceID] = NULL;
+	pool->userdata[voiceID] = NULL;
+
+	/*
+	 * Stereo voice owns the next voice too, pairs never straddle a word. The link bit can't tell, the link command
+	 * of a voice that has never been rendered may still be queued, so the pair handed out by the pool is used.
+	 */
+
+	if (atomic_and32(&pool->pairMask[word], ~voiceBits) & voiceBits) {
+		pool->callback[voiceID + 1] = NULL;
+		pool->userdata[voiceID + 1] = NULL;
+		voiceBits |= VOICE_BIT(voiceID + 1);
+	}
+
+	vitaSAS_internal_voice_pool_set_link(pool, voiceID, 0);
+
+	/*
+	 * Cached sample stays pinned by the voice until it is dropped. The waveform command may still be queued and would
+	 * pin it again, so it is dropped in command order before the voice can be handed out again, or right away if
+	 * the command can't be queued.
+	 */
+
+	command.type = VITASAS_COMMAND_RELEASE_SAMPLE;
+	command.voiceID = voiceID;
+	command.ptr = NULL;
+	if (vitaSAS_internal_submit_command(system, &command) < 0)
+		vitaSAS_internal_voice_pool_set_sample(pool, voiceID, 0);
+
+	atomic_or32(&pool->freeMask[word], voiceBits);
+
+	return SCE_OK;
+}
+
+unsigned int vitaSAS_system_get_free_voice_count(vitaSASSystem* system)
+{
+	unsigned int count = 0;
+	uint32_t freeMask;
+
+	for (int i = 0; i < VITASAS_VOICE_POOL_WORDS; i++) {
+		for (freeMask = (uint32_t)atomic_load32(&system->voicePool.freeMask[i]); freeMask != 0; freeMask &= freeMask - 1)
+			count++;
+	}
+
+	return count;
+}
@@ -0,0 +1,604 @@
+#include <kernel.h>
+#include <libdbg.h>
+#include <fios2.h>
+#include <sas.h>
+
+#include "vitaSAS.h"
+#include "heap.h"
+#include "atomic.h"
+
+extern void* vitaSAS_heap_internal;
+
+/*
+ * Streaming voices. The voice loops over a ring of blocks, ring block N % numBlocks holds stream
+ * block N. SAS can't report its read position, so the render thread follows the voice by advancing
+ * a position with the voice pitch every grain and publishes the number of fully played blocks.
+ * The loader thread refills played blocks with the next part of the file.
+ *
+ * streamMutex guards the stream list and render side state, it is never held across I/O.
+ * streamIoMutex serializes the loader with open, close and rewind, list changes need both. Closed
+ * streams are released by the render thread once their voice has ended and freed by the loader,
+ * which owns them from then on.
+ */
+
+#define VITASAS_VAG_HEADER_SIZE			48
+#define VITASAS_VAG_FRAME_SIZE			16
+#define VITASAS_VAG_FRAME_SAMPLES		28
+
+#define VITASAS_VAG_FLAG_LOOP_END		0x01
+#define VITASAS_VAG_FLAG_LOOP_REPEAT	0x02
+#define VITASAS_VAG_FLAG_LOOP_START		0x04
+
+/* Voice may read a little past its position for interpolation and decoding */
+
+#define VITASAS_STREAM_READ_MARGIN		(2 * VITASAS_VAG_FRAME_SAMPLES)
+
+static SceKernelLwMutexWork streamMutex;
+static SceKernelLwMutexWork streamIoMutex;
+static vitaSASStream* streams = NULL;
+static volatile int32_t numStreams = 0;
+
+int vitaSAS_internal_stream_init(void)
+{
+	int result;
+
+	result = sceKernelCreateLwMutex(&streamMutex, "vitaSAS_stream", 0, 0, NULL);
+	if (result < 0)
+		return result;
+
+	result = sceKernelCreateLwMutex(&streamIoMutex, "vitaSAS_stream_io", 0, 0, NULL);
+	if (result < 0) {
+		sceKernelDeleteLwMutex(&streamMutex);
+		return result;
+	}
+
+	return SCE_OK;
+}
+
+void vitaSAS_internal_stream_term(void)
+{
+	sceKernelDeleteLwMutex(&streamIoMutex);
+	sceKernelDeleteLwMutex(&streamMutex);
+}
+
+/* File access */
+
+static int vitaSAS_internal_stream_open_file(vitaSASStream* stream, const char* soundPath)
+{
+	SceFiosStat fiosStat;
+	SceIoStat ioStat;
+	SceFiosFH fiosFile;
+	int result;
+
+	if (stream->io_type == 1) {
+		result = sceFiosStatSync(NULL, soundPath, &fiosStat);
+		if (result < 0)
+			return result;
+
+		result = sceFiosFHOpenSync(NULL, &fiosFile, soundPath, NULL);
+		if (result < 0)
+			return result;
+
+		stream->file = fiosFile;
+		return (int)fiosStat.fileSize;
+	}
+
+	result = sceIoGetstat(soundPath, &ioStat);
+	if (result < 0)
+		return result;
+
+	result = sceIoOpen(soundPath, SCE_O_RDONLY, 0);
+	if (result < 0)
+		return result;
+
+	stream->file = result;
+	return (int)ioStat.st_size;
+}
+
+static void vitaSAS_internal_stream_close_file(vitaSASStream* stream)
+{
+	if (stream->io_type == 1)
+		sceFiosFHCloseSync(NULL, stream->file);
+	else
+		sceIoClose(stream->file);
+}
+
+static int vitaSAS_internal_stream_read(vitaSASStream* stream, void* buffer, uint32_t size, uint32_t offset)
+{
+	if (stream->io_type == 1)
+		return (int)sceFiosFHPreadSync(NULL, stream->file, buffer, size, stream->dataOffset + offset);
+
+	return sceIoPread(stream->file, buffer, size, stream->dataOffset + offset);
+}
+
+/* Load stream block into its ring block, called with streamIoMutex held */
+
+static int vitaSAS_internal_stream_fill_block(vitaSASStream* stream, uint32_t block)
+{
+	uint32_t ringBlock = block % stream->numBlocks;
+	uint8_t* target = stream->ring + ringBlock * stream->blockSize;
+	uint32_t offset = 0, position, size, i;
+	int result;
+
+	/* Looping streams wrap around the file, others are padded with silence */
+
+	while (offset < stream->blockSize) {
+		position = block * stream->blockSize + offset;
+		if (stream->loop)
+			position %= stream->dataSize;
+
+		if (position >= stream->dataSize)
+			break;
+
+		size = stream->dataSize - position;
+		if (size > stream->blockSize - offset)
+			size = stream->blockSize - offset;
+
+		result = vitaSAS_internal_stream_read(stream, target + offset, size, position);
+		if (result < 0)
+			return result;
+		if (result == 0)
+			break;
+
+		offset += result;
+	}
+
+	if (offset < stream->blockSize)
+		sceClibMemset(target + offset, 0, stream->blockSize - offset);
+
+	/* File loop and end flags are replaced with a loop over the whole ring */
+
+	if (stream->format == VITASAS_STREAM_FORMAT_VAG) {
+		for (i = 0; i < stream->blockSize; i += VITASAS_VAG_FRAME_SIZE)
+			target[i + 1] = 0;
+
+		if (ringBlock == 0)
+			target[1] = VITASAS_VAG_FLAG_LOOP_START;
+		if (ringBlock == stream->numBlocks - 1)
+			target[stream->blockSize - VITASAS_VAG_FRAME_SIZE + 1] = VITASAS_VAG_FLAG_LOOP_END | VITASAS_VAG_FLAG_LOOP_REPEAT;
+	}
+
+	return SCE_OK;
+}
+
+static int vitaSAS_internal_stream_prime(vitaSASStream* stream)
+{
+	int result;
+
+	for (uint32_t i = 0; i < stream->numBlocks; i++) {
+		result = vitaSAS_internal_stream_fill_block(stream, i);
+		if (result < 0)
+			return result;
+	}
+
+	atomic_store32(&stream->filledBlocks, (int32_t)stream->numBlocks);
+
+	return SCE_OK;
+}
+
+static void vitaSAS_internal_stream_free(vitaSASStream* stream)
+{
+	vitaSAS_internal_stream_close_file(stream);
+	vitaSAS_internal_sample_free(stream->ring, stream->ring_id);
+	heap_free_heap_memory(vitaSAS_heap_internal, stream);
+}
+
+/* Called with streamIoMutex held */
+
+static void vitaSAS_internal_stream_unlink(vitaSASStream* stream)
+{
+	vitaSASStream** link;
+
+	sceKernelLockLwMutex(&streamMutex, 1, NULL);
+
+	for (link = &streams; *link != NULL; link = &(*link)->next) {
+		if (*link == stream) {
+			*link = stream->next;
+			atomic_add32(&numStreams, -1);
+			break;
+		}
+	}
+
+	sceKernelUnlockLwMutex(&streamMutex, 1);
+}
+
+/* Render thread side */
+
+/* Newest stream the voice has been set to, streams opened since then have not reached the voice yet */
+
+static vitaSASStream* vitaSAS_internal_stream_find(vitaSASSystem* system, unsigned int voiceID)
+{
+	vitaSASStream* stream;
+	vitaSASStream* pending = NULL;
+
+	for (stream = streams; stream != NULL; stream = stream->next) {
+		if (stream->system != system || stream->voiceID != voiceID)
+			continue;
+
+		if (stream->isVoiceSet)
+			return stream;
+
+		if (pending == NULL)
+			pending = stream;
+	}
+
+	return pending;
+}
+
+void vitaSAS_internal_stream_apply_command(vitaSASSystem* system, const vitaSASCommand* command)
+{
+	vitaSASStream* stream;
+	int wake = 0;
+
+	if (atomic_load32(&numStreams) == 0)
+		return;
+
+	sceKernelLockLwMutex(&streamMutex, 1, NULL);
+
+	/*
+	 * New waveform is matched against every stream of the voice, a closed stream may still wait for its voice
+	 * to end while a newer one is set on it. Voice takes over the ring it is given and may read it from now on.
+	 */
+
+	if (command->type == VITASAS_COMMAND_SET_VOICE || command->type == VITASAS_COMMAND_SET_VOICE_PCM || command->type == VITASAS_COMMAND_SET_NOISE) {
+		for (stream = streams; stream != NULL; stream = stream->next) {
+			if (stream->system != system || stream->voiceID != command->voiceID)
+				continue;
+
+			if (command->ptr == stream->ring)
+				stream->isVoiceSet = 1;
+			else
+				stream->isPlaying = 0;
+		}
+
+		sceKernelUnlockLwMutex(&streamMutex, 1);
+		return;
+	}
+
+	stream = vitaSAS_internal_stream_find(system, command->voiceID);
+	if (stream != NULL) {
+		switch (command->type) {
+		case VITASAS_COMMAND_SET_PITCH:
+			stream->pitch = command->arg[0];
+			break;
+		case VITASAS_COMMAND_SET_KEY_ON:
+			stream->position = 0;
+			stream->fraction = 0;
+			stream->isPlaying = 1;
+			atomic_store32(&stream->isEnded, 0);
+			atomic_store32(&stream->consumedBlocks, 0);
+
+			/* Ring no longer holds the start of the file, loader reloads it */
+
+			if (atomic_load32(&stream->filledBlocks) != (int32_t)stream->numBlocks) {
+				atomic_add32(&stream->rewindCount, 1);
+				wake = 1;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	sceKernelUnlockLwMutex(&streamMutex, 1);
+
+	if (wake)
+		vitaSAS_internal_loader_wake();
+}
+
+void vitaSAS_internal_stream_advance(vitaSASSystem* system, unsigned int numGrain)
+{
+	vitaSASStream* stream;
+	uint32_t step, readPosition;
+	int32_t consumed;
+	int wake = 0;
+
+	if (atomic_load32(&numStreams) == 0)
+		return;
+
+	sceKernelLockLwMutex(&streamMutex, 1, NULL);
+
+	for (stream = streams; stream != NULL; stream = stream->next) {
+		if (stream->system != system)
+			continue;
+
+		/* Closed stream is released once its voice has ended, end state means nothing before the voice was set */
+
+		if (atomic_load32(&stream->isClosed) && stream->isVoiceSet && !stream->isReleased && vitaSAS_internal_get_end_state(system, stream->voiceID) == 1) {
+			atomic_store32(&stream->isReleased, 1);
+			wake = 1;
+		}
+
+		if (!stream->isPlaying)
+			continue;
+
+		/* Data of the block being played should have been loaded before this grain */
+
+		if (stream->position / stream->samplesPerBlock >= (uint32_t)atomic_load32(&stream->filledBlocks))
+			atomic_add32(&stream->numUnderruns, 1);
+
+		step = numGrain * stream->pitch + stream->fraction;
+		stream->position += step >> 12;
+		stream->fraction = step & 0xFFF;
+
+		if (vitaSAS_internal_get_end_state(system, stream->voiceID) == 1)
+			stream->isPlaying = 0;
+
+		/* Voice plays silence past the end of the file until the loader keys it off */
+
+		if (!stream->loop && stream->position >= stream->numSamples && !atomic_load32(&stream->isEnded)) {
+			atomic_store32(&stream->isEnded, 1);
+			wake = 1;
+		}
+
+		readPosition = stream->position > VITASAS_STREAM_READ_MARGIN ? stream->position - VITASAS_STREAM_READ_MARGIN : 0;
+		consumed = (int32_t)(readPosition / stream->samplesPerBlock);
+		if (consumed != atomic_load32(&stream->consumedBlocks)) {
+			atomic_store32(&stream->consumedBlocks, consumed);
+			wake = 1;
+		}
+	}
+
+	sceKernelUnlockLwMutex(&streamMutex, 1);
+
+	if (wake)
+		vitaSAS_internal_loader_wake();
+}
+
+/* Loader thread side */
+
+void vitaSAS_internal_stream_service(void)
+{
+	vitaSASCommand command;
+	vitaSASStream* stream;
+	vitaSASStream* next;
+	int32_t rewindCount, target, filled;
+	int result;
+
+	if (atomic_load32(&numStreams) == 0)
+		return;
+
+	sceKernelLockLwMutex(&streamIoMutex, 1, NULL);
+
+	for (stream = streams; stream != NULL; stream = next) {
+		next = stream->next;
+
+		if (atomic_load32(&stream->isReleased)) {
+			vitaSAS_internal_stream_unlink(stream);
+			vitaSAS_internal_stream_free(stream);
+			continue;
+		}
+
+		rewindCount = atomic_load32(&stream->rewindCount);
+		if (rewindCount != stream->seenRewindCount) {
+			stream->seenRewindCount = rewindCount;
+			stream->isKeyedOff = 0;
+			atomic_store32(&stream->filledBlocks, 0);
+		}
+
+		/* Non-looping stream ran past the end of the file */
+
+		if (atomic_load32(&stream->isEnded) && !stream->isKeyedOff) {
+			command.type = VITASAS_COMMAND_SET_KEY_OFF;
+			command.voiceID = stream->voiceID;
+			command.ptr = NULL;
+
+			/* Retried on the next wake if the command queue is full */
+
+			if (vitaSAS_internal_submit_command(stream->system, &command) >= 0)
+				stream->isKeyedOff = 1;
+		}
+
+		/* Keep every ring block but the one being played ahead of the voice */
+
+		target = atomic_load32(&stream->consumedBlocks) + (int32_t)stream->numBlocks;
+		for (filled = atomic_load32(&stream->filledBlocks); filled < target; filled++) {
+			result = vitaSAS_internal_stream_fill_block(stream, (uint32_t)filled);
+			if (result < 0) {
+				SCE_DBG_LOG_ERROR("[SAS IO] Stream read failed: 0x%X", result);
+				break;
+			}
+			atomic_store32(&stream->filledBlocks, filled + 1);
+		}
+	}
+
+	sceKernelUnlockLwMutex(&streamIoMutex, 1);
+}
+
+/* Interface */
+
+vitaSASStream* vitaSAS_system_open_stream(vitaSASSystem* system, unsigned int voiceID, char* soundPath, int io_type, const vitaSASStreamParam* streamParam, const vitaSASVoiceParam* voiceParam)
+{
+	vitaSASStream* stream;
+	vitaSASCommand command;
+	SceUID mem_id;
+	int result;
+
+	if (!vitaSAS_internal_loader_is_running()) {
+		SCE_DBG_LOG_ERROR("[SAS] Loader is not running");
+		return NULL;
+	}
+
+	if (streamParam->numBlocks < 2 || streamParam->blockSize == 0 || streamParam->blockSize % VITASAS_STREAM_BLOCK_ALIGN != 0
+		|| (streamParam->format != VITASAS_STREAM_FORMAT_VAG && streamParam->format != VITASAS_STREAM_FORMAT_PCM)) {
+		SCE_DBG_LOG_ERROR("[SAS] Invalid stream parameters");
+		return NULL;
+	}
+
+	stream = heap_alloc_heap_memory(vitaSAS_heap_internal, sizeof(vitaSASStream));
+	if (stream == NULL) {
+		SCE_DBG_LOG_ERROR("[SAS] heap_alloc_heap_memory() returned NULL");
+		return NULL;
+	}
+
+	sceClibMemset(stream, 0, sizeof(vitaSASStream));
+
+	stream->system = system;
+	stream->voiceID = voiceID;
+	stream->format = streamParam->format;
+	stream->loop = streamParam->loop;
+	stream->io_type = io_type;
+	stream->blockSize = streamParam->blockSize;
+	stream->numBlocks = streamParam->numBlocks;
+	stream->pitch = SCE_SAS_PITCH_BASE;
+
+	result = vitaSAS_internal_stream_open_file(stream, soundPath);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS IO] Can't open %s: 0x%X", soundPath, result);
+		heap_free_heap_memory(vitaSAS_heap_internal, stream);
+		return NULL;
+	}
+
+	if (stream->format == VITASAS_STREAM_FORMAT_VAG) {
+		stream->dataOffset = VITASAS_VAG_HEADER_SIZE;
+		stream->dataSize = result > VITASAS_VAG_HEADER_SIZE ? (result - VITASAS_VAG_HEADER_SIZE) & ~(VITASAS_VAG_FRAME_SIZE - 1) : 0;
+		stream->numSamples = stream->dataSize / VITASAS_VAG_FRAME_SIZE * VITASAS_VAG_FRAME_SAMPLES;
+		stream->samplesPerBlock = stream->blockSize / VITASAS_VAG_FRAME_SIZE * VITASAS_VAG_FRAME_SAMPLES;
+	}
+	else {
+		stream->dataOffset = 0;
+		stream->dataSize = result & ~(sizeof(int16_t) - 1);
+		stream->numSamples = stream->dataSize / sizeof(int16_t);
+		stream->samplesPerBlock = stream->blockSize / sizeof(int16_t);
+	}
+
+	if (stream->dataSize == 0) {
+		SCE_DBG_LOG_ERROR("[SAS IO] %s has no audio data", soundPath);
+		goto failed;
+	}
+
+	stream->ring = vitaSAS_internal_sample_alloc(stream->blockSize * stream->numBlocks, &mem_id);
+	if (stream->ring == NULL)
+		goto failed;
+
+	stream->ring_id = mem_id;
+
+	result = vitaSAS_internal_stream_prime(stream);
+	if (result < 0) {
+		SCE_DBG_LOG_ERROR("[SAS IO] Stream read failed: 0x%X", result);
+		vitaSAS_internal_sample_free(stream->ring, stream->ring_id);
+		goto failed;
+	}
+
+	/* Register before setting the voice so that its pitch is followed */
+
+	sceKernelLockLwMutex(&streamIoMutex, 1, NULL);
+	sceKernelLockLwMutex(&streamMutex, 1, NULL);
+
+	stream->next = streams;
+	streams = stream;
+	atomic_add32(&numStreams, 1);
+
+	sceKernelUnlockLwMutex(&streamMutex, 1);
+	sceKernelUnlockLwMutex(&streamIoMutex, 1);
+
+	command.voiceID = voiceID;
+	command.ptr = stream->ring;
+	if (stream->format == VITASAS_STREAM_FORMAT_VAG) {
+		command.type = VITASAS_COMMAND_SET_VOICE;
+		command.arg[0] = stream->blockSize * stream->numBlocks;
+		command.arg[1] = SCE_SAS_LOOP_ENABLE;
+		command.arg[2] = 0;
+	}
+	else {
+		command.type = VITASAS_COMMAND_SET_VOICE_PCM;
+		command.arg[0] = stream->blockSize * stream->numBlocks / sizeof(int16_t);
+		command.arg[1] = 0;
+		command.arg[2] = 0;
+	}
+
+	/* Voice never reads the ring if the command is dropped */
+
+	if (vitaSAS_internal_submit_command(system, &command) < 0) {
+		sceKernelLockLwMutex(&streamMutex, 1, NULL);
+		stream->isVoiceSet = 1;
+		sceKernelUnlockLwMutex(&streamMutex, 1);
+	}
+
+	vitaSAS_internal_set_initial_params(system, voiceID, voiceParam->pitch, voiceParam->volLDry, voiceParam->volRDry, voiceParam->volLWet, voiceParam->volRWet, voiceParam->adsr1, voiceParam->adsr2);
+
+	return stream;
+
+failed:
+
+	vitaSAS_internal_stream_close_file(stream);
+	heap_free_heap_memory(vitaSAS_heap_internal, stream);
+
+	return NULL;
+}
+
+int vitaSAS_rewind_stream(vitaSASStream* stream)
+{
+	int result;
+
+	sceKernelLockLwMutex(&streamIoMutex, 1, NULL);
+
+	stream->seenRewindCount = atomic_load32(&stream->rewindCount);
+	stream->isKeyedOff = 0;
+
+	result = vitaSAS_internal_stream_prime(stream);
+
+	sceKernelUnlockLwMutex(&streamIoMutex, 1);
+
+	return result;
+}
+
+unsigned int vitaSAS_get_stream_underruns(const vitaSASStream* stream)
+{
+	return (unsigned int)atomic_load32(&stream->numUnderruns);
+}
+
+int vitaSAS_close_stream(vitaSASStream* stream)
+{
+	vitaSASSystem* system = stream->system;
+	vitaSASCommand command;
+	int result;
+
+	/*
+	 * Voice keeps reading the ring until it ends, stream is released by the render thread then and freed by the loader.
+	 * Closed stream is never freed here: end state can't be trusted before the voice commands are applied, and
+	 * the stream may be freed by the loader as soon as it is marked closed.
+	 */
+
+	command.type = VITASAS_COMMAND_SET_KEY_OFF;
+	command.voiceID = stream->voiceID;
+	command.ptr = NULL;
+
+	/*
+	 * Looping voice would never end without the key off, stream stays open if it is dropped. Key off bypasses
+	 * command frames, a frame may still be dropped on commit after the stream has been marked closed.
+	 */
+
+	if (system->commandQueue.commands == NULL)
+		result = vitaSAS_internal_apply_command(system, &command);
+	else
+		result = vitaSAS_internal_command_queue_push(&system->commandQueue, &command);
+
+	if (result < 0)
+		return result;
+
+	atomic_store32(&stream->isClosed, 1);
+
+	return SCE_OK;
+}
+
+/* System is no longer rendered, its streams can be freed right away */
+
+void vitaSAS_internal_stream_close_system(vitaSASSystem* system)
+{
+	vitaSASStream* stream;
+
+	sceKernelLockLwMutex(&streamIoMutex, 1, NULL);
+
+	do {
+		for (stream = streams; stream != NULL && stream->system != system; stream = stream->next);
+
+		if (stream != NULL) {
+			vitaSAS_internal_stream_unlink(stream);
+			vitaSAS_internal_stream_free(stream);
+		}
+
+	} while (stream != NULL);
+
+	sceKernelUnlockLwMutex(&streamIoMutex, 1);
+}